@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 #include <system_error>
 
@@ -33,5 +34,14 @@ public:
   virtual std::error_code write(IWriteBatch& batch) = 0;
 
   virtual std::error_code read(IReadBatch& batch) = 0;
+
+  //Returns false to stop the iteration
+  typedef std::function<bool(const std::string& rawKey, const std::string& rawValue)> IterateFunction;
+
+  //Visits the keys from beginKey up to, but not including, endKey in raw key order. Both keys must belong to the same key prefix
+  virtual std::error_code iterate(const std::string& beginKey, const std::string& endKey, const IterateFunction& visitor) = 0;
+
+  //Visits every key starting with keyStart in raw key order
+  virtual std::error_code iteratePrefix(const std::string& keyStart, const IterateFunction& visitor) = 0;
 };
 }
@@ -0,0 +1,95 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <set>
+
+namespace Common {
+
+/* The median of the last windowSize values pushed, the same as medianValue()
+   of them, kept up to date in O(log n) per push. The lower half of the
+   values, plus the middle one for odd sizes, lives in m_low and the rest in
+   m_high. */
+template <class T>
+class SlidingWindowMedian {
+public:
+  explicit SlidingWindowMedian(size_t windowSize) : m_windowSize(windowSize) {
+    assert(m_windowSize > 0);
+  }
+
+  /* Drops the oldest value once the window is full */
+  void push(T value) {
+    if (m_values.size() == m_windowSize) {
+      erase(m_values.front());
+      m_values.pop_front();
+    }
+
+    m_values.push_back(value);
+
+    if (m_low.empty() || !(*m_low.begin() < value)) {
+      m_low.insert(value);
+    } else {
+      m_high.insert(value);
+    }
+
+    rebalance();
+  }
+
+  void clear() {
+    m_values.clear();
+    m_low.clear();
+    m_high.clear();
+  }
+
+  size_t size() const {
+    return m_values.size();
+  }
+
+  T median() const {
+    if (m_values.empty()) {
+      return T();
+    }
+
+    if (m_low.size() > m_high.size()) {
+      return *m_low.begin();
+    }
+
+    return (*m_low.begin() + *m_high.begin()) / 2;
+  }
+
+private:
+  void erase(const T& value) {
+    auto it = m_low.find(value);
+    if (it != m_low.end()) {
+      m_low.erase(it);
+    } else {
+      m_high.erase(m_high.find(value));
+    }
+
+    rebalance();
+  }
+
+  void rebalance() {
+    if (m_low.size() > m_high.size() + 1) {
+      m_high.insert(*m_low.begin());
+      m_low.erase(m_low.begin());
+    } else if (m_high.size() > m_low.size()) {
+      m_low.insert(*m_high.begin());
+      m_high.erase(m_high.begin());
+    }
+  }
+
+  size_t m_windowSize;
+  std::deque<T> m_values;
+
+  /* Largest first */
+  std::multiset<T, std::greater<T>> m_low;
+  std::multiset<T> m_high;
+};
+
+}
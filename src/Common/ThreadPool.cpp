@@ -0,0 +1,46 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "ThreadPool.h"
+
+#include <cassert>
+#include <limits>
+
+namespace Common {
+
+ThreadPool::ThreadPool(size_t threadCount) : m_jobs(std::numeric_limits<uint64_t>::max()) {
+  assert(threadCount > 0);
+
+  m_threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  m_jobs.close();
+
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::post(std::function<void()>&& job) {
+  m_jobs.push(std::move(job));
+}
+
+size_t ThreadPool::getThreadCount() const {
+  return m_threads.size();
+}
+
+void ThreadPool::workerLoop() {
+  std::function<void()> job;
+
+  while (m_jobs.pop(job)) {
+    job();
+    job = nullptr;
+  }
+}
+
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "BlockingQueue.h"
+
+namespace Common {
+
+/* A fixed set of threads running jobs in the order they are posted. The
+   destructor runs the jobs still queued, then joins the threads. */
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /* Never blocks, the queue is unbounded. The job must not throw. */
+  void post(std::function<void()>&& job);
+
+  size_t getThreadCount() const;
+
+private:
+  void workerLoop();
+
+  BlockingQueue<std::function<void()>> m_jobs;
+  std::vector<std::thread> m_threads;
+};
+
+}
@@ -11,6 +11,7 @@
 
 #include <boost/functional/hash.hpp>
 
+#include "Common/Math.h"
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
 #include "Common/ShuffleGenerator.h"
@@ -100,7 +101,8 @@ bool serialize(PackedOutIndex& value, Common::StringView name, CryptoNote::ISeri
 
 BlockchainCache::BlockchainCache(const std::string& filename, const Currency& currency, std::shared_ptr<Logging::ILogger> logger_,
                                  IBlockchainCache* parent, uint32_t splitBlockIndex)
-    : filename(filename), currency(currency), logger(logger_, "BlockchainCache"), parent(parent), storage(new BlockchainStorage(100)) {
+    : filename(filename), currency(currency), logger(logger_, "BlockchainCache"), parent(parent), storage(new BlockchainStorage(100)),
+      lastBlocksSizes(currency.rewardBlocksWindow()), nextBlockDifficulty(0) {
   if (parent == nullptr) {
     startIndex = 0;
 
@@ -121,6 +123,7 @@ BlockchainCache::BlockchainCache(const std::string& filename, const Currency& cu
     doPushBlock(genesisBlock, transactions, validatorState, coinbaseTransactionSize, minerReward, 1, {toBinaryArray(genesisBlock.getBlock())});
   } else {
     startIndex = splitBlockIndex;
+    resetTopBlockState();
   }
 
   logger(Logging::DEBUGGING) << "BlockchainCache with start block index: " << startIndex << " created";
@@ -138,7 +141,9 @@ void BlockchainCache::doPushBlock(const CachedBlock& cachedBlock,
                                 const std::vector<CachedTransaction>& cachedTransactions,
                                 const TransactionValidatorState& validatorState, size_t blockSize,
                                 uint64_t generatedCoins, uint64_t blockDifficulty, RawBlock&& rawBlock) {
-  logger(Logging::DEBUGGING) << "Pushing block " << cachedBlock.getBlockHash() << " at index " << cachedBlock.getBlockIndex();
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Pushing block " << cachedBlock.getBlockHash() << " at index " << cachedBlock.getBlockIndex();
+  });
 
   assert(blockSize > 0);
   assert(blockDifficulty > 0);
@@ -184,7 +189,9 @@ void BlockchainCache::doPushBlock(const CachedBlock& cachedBlock,
     addSpentKeyImage(keyImage, blockIndex);
   }
 
-  logger(Logging::DEBUGGING) << "Added " << validatorState.spentKeyImages.size() << " spent key images";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Added " << validatorState.spentKeyImages.size() << " spent key images";
+  });
 
   assert(cachedTransactions.size() <= std::numeric_limits<uint16_t>::max());
 
@@ -198,7 +205,12 @@ void BlockchainCache::doPushBlock(const CachedBlock& cachedBlock,
 
   storage->pushBlock(std::move(rawBlock));
 
-  logger(Logging::DEBUGGING) << "Block " << cachedBlock.getBlockHash() << " successfully pushed";
+  lastBlocksSizes.push(blockSize);
+  nextBlockDifficulty = calculateDifficultyForNextBlock(blockIndex);
+
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Block " << cachedBlock.getBlockHash() << " successfully pushed";
+  });
 }
 
 PushedBlockInfo BlockchainCache::getPushedBlockInfo(uint32_t blockIndex) const {
@@ -260,6 +272,9 @@ std::unique_ptr<IBlockchainCache> BlockchainCache::split(uint32_t splitBlockInde
   newCache->children = children;
   children = { newCache.get() };
 
+  resetTopBlockState();
+  newCache->resetTopBlockState();
+
   logger(Logging::DEBUGGING) << "Split successfully completed";
   return std::move(newCache);
 }
@@ -345,7 +360,9 @@ std::vector<Crypto::Hash> BlockchainCache::getTransactionHashes() const {
 
 void BlockchainCache::pushTransaction(const CachedTransaction& cachedTransaction, uint32_t blockIndex,
                                       uint16_t transactionInBlockIndex) {
-  logger(Logging::DEBUGGING) << "Adding transaction " << cachedTransaction.getTransactionHash() << " at block " << blockIndex << ", index in block " << transactionInBlockIndex;
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Adding transaction " << cachedTransaction.getTransactionHash() << " at block " << blockIndex << ", index in block " << transactionInBlockIndex;
+  });
 
   const auto& tx = cachedTransaction.getTransaction();
 
@@ -360,7 +377,9 @@ void BlockchainCache::pushTransaction(const CachedTransaction& cachedTransaction
   transactionCacheInfo.globalIndexes.reserve(tx.outputs.size());
   transactionCacheInfo.outputs.reserve(tx.outputs.size());
 
-  logger(Logging::DEBUGGING) << "Adding " << tx.outputs.size() << " transaction outputs";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Adding " << tx.outputs.size() << " transaction outputs";
+  });
   auto outputCount = 0;
   for (auto& output : tx.outputs) {
     transactionCacheInfo.outputs.push_back(output.target);
@@ -380,15 +399,21 @@ void BlockchainCache::pushTransaction(const CachedTransaction& cachedTransaction
 
   PaymentIdTransactionHashPair paymentIdTransactionHash;
   if (!getPaymentIdFromTxExtra(tx.extra, paymentIdTransactionHash.paymentId)) {
-    logger(Logging::DEBUGGING) << "Transaction " << cachedTransaction.getTransactionHash() << " successfully added";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Transaction " << cachedTransaction.getTransactionHash() << " successfully added";
+    });
     return;
   }
 
-  logger(Logging::DEBUGGING) << "Payment id found: " << paymentIdTransactionHash.paymentId;
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Payment id found: " << paymentIdTransactionHash.paymentId;
+  });
 
   paymentIdTransactionHash.transactionHash = cachedTransaction.getTransactionHash();
   paymentIds.insert(std::move(paymentIdTransactionHash));
-  logger(Logging::DEBUGGING) << "Transaction " << cachedTransaction.getTransactionHash() << " successfully added";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Transaction " << cachedTransaction.getTransactionHash() << " successfully added";
+  });
 }
 
 uint32_t BlockchainCache::insertKeyOutputToGlobalIndex(uint64_t amount, PackedOutIndex output, uint32_t blockIndex) {
@@ -797,6 +822,28 @@ void BlockchainCache::load() {
   CryptoNote::BinaryInputStreamSerializer s(stream);
 
   serialize(s);
+  resetTopBlockState();
+}
+
+//Held in memory, there is nothing to hold back
+void BlockchainCache::beginBatch() {
+}
+
+void BlockchainCache::commitBatch() {
+}
+
+void BlockchainCache::resetTopBlockState() {
+  /* A new segment has no blocks yet, its top is the block it was split
+     off from */
+  const IBlockchainCache& segment = blockInfos.empty() ? *parent : *this;
+  const uint32_t topIndex = blockInfos.empty() ? startIndex - 1 : getTopBlockIndex();
+
+  lastBlocksSizes.clear();
+  for (uint64_t size : segment.getLastBlocksSizes(currency.rewardBlocksWindow(), topIndex, addGenesisBlock)) {
+    lastBlocksSizes.push(size);
+  }
+
+  nextBlockDifficulty = blockInfos.empty() ? parent->getDifficultyForNextBlock(topIndex) : calculateDifficultyForNextBlock(topIndex);
 }
 
 bool BlockchainCache::isTransactionSpendTimeUnlocked(uint64_t unlockTime) const {
@@ -1089,8 +1136,25 @@ uint64_t BlockchainCache::getDifficultyForNextBlock() const {
   return getDifficultyForNextBlock(getTopBlockIndex());
 }
 
+uint64_t BlockchainCache::getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis useGenesis) const {
+  if (count == currency.rewardBlocksWindow() && blockIndex == getTopBlockIndex() && useGenesis) {
+    return lastBlocksSizes.median();
+  }
+
+  auto sizes = getLastBlocksSizes(count, blockIndex, useGenesis);
+  return Common::medianValue(sizes);
+}
+
 uint64_t BlockchainCache::getDifficultyForNextBlock(uint32_t blockIndex) const {
   assert(blockIndex <= getTopBlockIndex());
+  if (blockIndex == getTopBlockIndex()) {
+    return nextBlockDifficulty;
+  }
+
+  return calculateDifficultyForNextBlock(blockIndex);
+}
+
+uint64_t BlockchainCache::calculateDifficultyForNextBlock(uint32_t blockIndex) const {
   uint8_t nextBlockMajorVersion = getBlockMajorVersionForHeight(blockIndex+1);
   auto timestamps = getLastTimestamps(currency.difficultyBlocksCountByBlockVersion(nextBlockMajorVersion, blockIndex), blockIndex, skipGenesisBlock);
   auto commulativeDifficulties =
@@ -29,6 +29,7 @@
 #include <boost/multi_index/random_access_index.hpp>
 
 #include "BlockchainStorage.h"
+#include "Common/SlidingWindowMedian.h"
 #include "Common/StringView.h"
 #include "Currency.h"
 #include "IBlockchainCache.h"
@@ -130,6 +131,7 @@ public:
 
   std::vector<uint64_t> getLastBlocksSizes(size_t count) const override;
   std::vector<uint64_t> getLastBlocksSizes(size_t count, uint32_t blockIndex, UseGenesis) const override;
+  uint64_t getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis) const override;
 
   std::vector<uint64_t> getLastCumulativeDifficulties(size_t count, uint32_t blockIndex, UseGenesis) const override;
   std::vector<uint64_t> getLastCumulativeDifficulties(size_t count) const override;
@@ -169,6 +171,9 @@ public:
   virtual void save() override;
   virtual void load() override;
 
+  virtual void beginBatch() override;
+  virtual void commitBatch() override;
+
   virtual std::vector<BinaryArray> getRawTransactions(const std::vector<Crypto::Hash> &transactions,
     std::vector<Crypto::Hash> &missedTransactions) const override;
   virtual std::vector<BinaryArray> getRawTransactions(const std::vector<Crypto::Hash> &transactions) const override;
@@ -293,8 +298,16 @@ private:
   std::unique_ptr<BlockchainStorage> storage;
 
   std::vector<IBlockchainCache*> children;
+
+  /* Sizes of the reward window ending at the top block, and the difficulty
+     of the block after it. Updated as blocks are added and the segment is
+     split, so validating a block on top doesn't gather them again. */
+  Common::SlidingWindowMedian<uint64_t> lastBlocksSizes;
+  uint64_t nextBlockDifficulty;
  
   void serialize(ISerializer& s);
+  void resetTopBlockState();
+  uint64_t calculateDifficultyForNextBlock(uint32_t blockIndex) const;
 
   void addSpentKeyImage(const Crypto::KeyImage& keyImage, uint32_t blockIndex);
   void pushTransaction(const CachedTransaction& tx, uint32_t blockIndex, uint16_t transactionBlockIndex);
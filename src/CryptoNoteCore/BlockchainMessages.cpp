@@ -97,6 +97,16 @@ auto BlockchainMessage::getChainSwitch() const -> const ChainSwitch & {
   return *chainSwitch;
 }
 
+auto BlockchainMessage::getAddTransaction() const -> const AddTransaction & {
+  assert(getType() == Type::AddTransaction);
+  return *addTransaction;
+}
+
+auto BlockchainMessage::getDeleteTransaction() const -> const DeleteTransaction & {
+  assert(getType() == Type::DeleteTransaction);
+  return *deleteTransaction;
+}
+
 BlockchainMessage makeChainSwitchMessage(uint32_t index, std::vector<Crypto::Hash>&& hashes) {
   return BlockchainMessage{Messages::ChainSwitch{index, std::move(hashes)}};
 }
@@ -95,7 +95,7 @@ BlockchainWriteBatch& BlockchainWriteBatch::insertKeyOutputAmounts(const std::se
 }
 
 BlockchainWriteBatch& BlockchainWriteBatch::insertTimestamp(uint64_t timestamp, const std::vector<Crypto::Hash>& blockHashes) {
-  rawDataToInsert.emplace_back(DB::serialize(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, timestamp, blockHashes));
+  rawDataToInsert.emplace_back(DB::serializeOrderedKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, timestamp), DB::serialize(blockHashes, DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX));
   return *this;
 }
 
@@ -122,9 +122,12 @@ BlockchainWriteBatch& BlockchainWriteBatch::removeCachedTransaction(const Crypto
   return *this;
 }
 
-BlockchainWriteBatch& BlockchainWriteBatch::removePaymentId(const Crypto::Hash paymentId, uint32_t totalTxsCountForPaymentId) {
+BlockchainWriteBatch& BlockchainWriteBatch::removePaymentId(const Crypto::Hash paymentId, uint32_t transactionsToRemoveCount, uint32_t totalTxsCountForPaymentId) {
+  rawKeysToRemove.reserve(rawKeysToRemove.size() + transactionsToRemoveCount);
   rawDataToInsert.emplace_back(DB::serialize(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, paymentId, totalTxsCountForPaymentId));
-  rawKeysToRemove.emplace_back(DB::serializeKey(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, totalTxsCountForPaymentId)));
+  for (uint32_t i = 0; i < transactionsToRemoveCount; ++i) {
+    rawKeysToRemove.emplace_back(DB::serializeKey(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, totalTxsCountForPaymentId + i)));
+  }
   return *this;
 }
 
@@ -156,7 +159,7 @@ BlockchainWriteBatch& BlockchainWriteBatch::removeClosestTimestampBlockIndex(uin
 }
 
 BlockchainWriteBatch& BlockchainWriteBatch::removeTimestamp(uint64_t timestamp) {
-  rawKeysToRemove.emplace_back(DB::serializeKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, timestamp));
+  rawKeysToRemove.emplace_back(DB::serializeOrderedKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, timestamp));
   return *this;
 }
 
@@ -0,0 +1,206 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "BufferedDataBase.h"
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace CryptoNote {
+
+namespace {
+
+class RawWriteBatch : public IWriteBatch {
+public:
+  std::vector<std::pair<std::string, std::string>> rawDataToInsert;
+  std::vector<std::string> rawKeysToRemove;
+
+  virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override {
+    return std::move(rawDataToInsert);
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    return std::move(rawKeysToRemove);
+  }
+};
+
+class RawReadBatch : public IReadBatch {
+public:
+  std::vector<std::string> rawKeys;
+  std::vector<std::string> values;
+  std::vector<bool> resultStates;
+
+  virtual std::vector<std::string> getRawKeys() const override {
+    return rawKeys;
+  }
+
+  virtual void submitRawResult(const std::vector<std::string>& values, const std::vector<bool>& resultStates) override {
+    this->values = values;
+    this->resultStates = resultStates;
+  }
+};
+
+}
+
+BufferedDataBase::BufferedDataBase(IDataBase& database) : database(database) {
+}
+
+void BufferedDataBase::beginBatch() {
+  ++batchDepth;
+}
+
+std::error_code BufferedDataBase::commitBatch() {
+  assert(batchDepth > 0);
+
+  if (--batchDepth > 0 || pendingWrites.empty()) {
+    return std::error_code();
+  }
+
+  RawWriteBatch batch;
+  for (auto& write : pendingWrites) {
+    if (write.second) {
+      batch.rawDataToInsert.emplace_back(write.first, std::move(*write.second));
+    } else {
+      batch.rawKeysToRemove.push_back(write.first);
+    }
+  }
+
+  pendingWrites.clear();
+
+  return database.write(batch);
+}
+
+std::error_code BufferedDataBase::write(IWriteBatch& batch) {
+  if (batchDepth == 0) {
+    return database.write(batch);
+  }
+
+  //The database applies the inserts of a batch first, then the removals
+  for (auto& insert : batch.extractRawDataToInsert()) {
+    pendingWrites[insert.first] = std::move(insert.second);
+  }
+
+  for (auto& key : batch.extractRawKeysToRemove()) {
+    pendingWrites[key] = boost::none;
+  }
+
+  return std::error_code();
+}
+
+std::error_code BufferedDataBase::read(IReadBatch& batch) {
+  if (pendingWrites.empty()) {
+    return database.read(batch);
+  }
+
+  const std::vector<std::string> rawKeys = batch.getRawKeys();
+
+  std::vector<std::string> values(rawKeys.size());
+  std::vector<bool> resultStates(rawKeys.size(), false);
+
+  //Only the keys without a pending write are read from the database
+  RawReadBatch databaseBatch;
+  std::vector<size_t> databasePositions;
+
+  for (size_t i = 0; i < rawKeys.size(); ++i) {
+    auto it = pendingWrites.find(rawKeys[i]);
+    if (it == pendingWrites.end()) {
+      databaseBatch.rawKeys.push_back(rawKeys[i]);
+      databasePositions.push_back(i);
+    } else if (it->second) {
+      values[i] = *it->second;
+      resultStates[i] = true;
+    }
+  }
+
+  if (!databaseBatch.rawKeys.empty()) {
+    auto error = database.read(databaseBatch);
+    if (error) {
+      return error;
+    }
+
+    for (size_t i = 0; i < databasePositions.size(); ++i) {
+      values[databasePositions[i]] = std::move(databaseBatch.values[i]);
+      resultStates[databasePositions[i]] = databaseBatch.resultStates[i];
+    }
+  }
+
+  batch.submitRawResult(values, resultStates);
+  return std::error_code();
+}
+
+std::error_code BufferedDataBase::iterate(const std::string& beginKey, const std::string& endKey, const IterateFunction& visitor) {
+  auto first = pendingWrites.lower_bound(beginKey);
+  auto last = pendingWrites.lower_bound(endKey);
+
+  return iterateMerged(first, last, [&](const IterateFunction& databaseVisitor) {
+    return database.iterate(beginKey, endKey, databaseVisitor);
+  }, visitor);
+}
+
+std::error_code BufferedDataBase::iteratePrefix(const std::string& keyStart, const IterateFunction& visitor) {
+  auto first = pendingWrites.lower_bound(keyStart);
+  auto last = first;
+  while (last != pendingWrites.end() && last->first.compare(0, keyStart.size(), keyStart) == 0) {
+    ++last;
+  }
+
+  return iterateMerged(first, last, [&](const IterateFunction& databaseVisitor) {
+    return database.iteratePrefix(keyStart, databaseVisitor);
+  }, visitor);
+}
+
+std::error_code BufferedDataBase::iterateMerged(PendingWrites::const_iterator first, PendingWrites::const_iterator last,
+  const std::function<std::error_code(const IterateFunction&)>& iterateDataBase, const IterateFunction& visitor) const {
+
+  if (first == last) {
+    return iterateDataBase(visitor);
+  }
+
+  bool stopped = false;
+
+  //Visits the pending writes before rawKey, and says whether to go on
+  const auto visitPendingBefore = [&](const std::string* rawKey) {
+    for (; first != last && (rawKey == nullptr || first->first < *rawKey); ++first) {
+      if (first->second && !visitor(first->first, *first->second)) {
+        stopped = true;
+        return false;
+      }
+    }
+
+    return true;
+  };
+
+  auto error = iterateDataBase([&](const std::string& rawKey, const std::string& rawValue) {
+    if (!visitPendingBefore(&rawKey)) {
+      return false;
+    }
+
+    //A pending write replaces or removes the value in the database
+    const std::string* value = &rawValue;
+    if (first != last && first->first == rawKey) {
+      value = first->second ? &*first->second : nullptr;
+      ++first;
+    }
+
+    if (value != nullptr && !visitor(rawKey, *value)) {
+      stopped = true;
+      return false;
+    }
+
+    return true;
+  });
+
+  if (error) {
+    return error;
+  }
+
+  if (!stopped) {
+    visitPendingBefore(nullptr);
+  }
+
+  return std::error_code();
+}
+
+}
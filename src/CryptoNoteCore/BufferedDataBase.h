@@ -0,0 +1,50 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include "IDataBase.h"
+
+namespace CryptoNote {
+
+/* Passes everything on to another database, except that between
+   beginBatch() and the matching commitBatch() the writes are held in
+   memory and reach the database as one write. Reads and iterations see the
+   writes held back. Batches may nest, only the outermost commit writes.
+
+   Writes must not run concurrently with anything else, reads may run
+   concurrently with each other. */
+class BufferedDataBase : public IDataBase {
+public:
+  explicit BufferedDataBase(IDataBase& database);
+
+  void beginBatch();
+  std::error_code commitBatch();
+
+  virtual std::error_code write(IWriteBatch& batch) override;
+  virtual std::error_code read(IReadBatch& batch) override;
+  virtual std::error_code iterate(const std::string& beginKey, const std::string& endKey, const IterateFunction& visitor) override;
+  virtual std::error_code iteratePrefix(const std::string& keyStart, const IterateFunction& visitor) override;
+
+private:
+  typedef std::map<std::string, boost::optional<std::string>> PendingWrites;
+
+  /* Visits the keys iterateDataBase visits, merged with the pending writes
+     from first up to last */
+  std::error_code iterateMerged(PendingWrites::const_iterator first, PendingWrites::const_iterator last,
+    const std::function<std::error_code(const IterateFunction&)>& iterateDataBase, const IterateFunction& visitor) const;
+
+  IDataBase& database;
+  size_t batchDepth = 0;
+
+  /* The writes held back, by raw key. A removed key has no value. */
+  PendingWrites pendingWrites;
+};
+
+}
@@ -48,30 +48,46 @@ const Crypto::Hash& CachedBlock::getBlockHash() const {
 
 const Crypto::Hash& CachedBlock::getBlockLongHash() const {
   if (!blockLongHash.is_initialized()) {
-    if (block.majorVersion == BLOCK_MAJOR_VERSION_1) {
-      const auto& rawHashingBlock = getBlockHashingBinaryArray();
-      blockLongHash = Hash();
-      cn_slow_hash_v0(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
-    } else if ((block.majorVersion == BLOCK_MAJOR_VERSION_2) || (block.majorVersion == BLOCK_MAJOR_VERSION_3)) {
-      const auto& rawHashingBlock = getParentBlockHashingBinaryArray(true);
-      blockLongHash = Hash();
-      cn_slow_hash_v0(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
-    } else if (block.majorVersion == BLOCK_MAJOR_VERSION_4) {
-      const auto& rawHashingBlock = getParentBlockHashingBinaryArray(true);
-      blockLongHash = Hash();
-      cn_lite_slow_hash_v1(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
-    } else if (block.majorVersion >= BLOCK_MAJOR_VERSION_5) {
-      const auto& rawHashingBlock = getParentBlockHashingBinaryArray(true);
-      blockLongHash = Hash();
-      cn_turtle_lite_slow_hash_v2(rawHashingBlock.data(), rawHashingBlock.size(), blockLongHash.get());
-    } else {
-      throw std::runtime_error("Unknown block major version.");
-    }
+    Hash hash;
+    getBlockLongHash(block.majorVersion, getBlockLongHashingBinaryArray(), hash);
+    blockLongHash = hash;
   }
 
   return blockLongHash.get();
 }
 
+const BinaryArray& CachedBlock::getBlockLongHashingBinaryArray() const {
+  if (block.majorVersion == BLOCK_MAJOR_VERSION_1) {
+    return getBlockHashingBinaryArray();
+  }
+
+  return getParentBlockHashingBinaryArray(true);
+}
+
+size_t CachedBlock::getBlockLongHashingNonceOffset() const {
+  // Both the block header and the parent block header start with the major version,
+  // minor version and timestamp as varints, then the previous block hash, then the nonce.
+  if (block.majorVersion == BLOCK_MAJOR_VERSION_1) {
+    return Tools::get_varint_data(block.majorVersion).size() + Tools::get_varint_data(block.minorVersion).size() +
+           Tools::get_varint_data(block.timestamp).size() + sizeof(Crypto::Hash);
+  }
+
+  return Tools::get_varint_data(block.parentBlock.majorVersion).size() + Tools::get_varint_data(block.parentBlock.minorVersion).size() +
+         Tools::get_varint_data(block.timestamp).size() + sizeof(Crypto::Hash);
+}
+
+void CachedBlock::getBlockLongHash(uint8_t majorVersion, const BinaryArray& hashingBinaryArray, Crypto::Hash& hash) {
+  if (majorVersion == BLOCK_MAJOR_VERSION_1 || majorVersion == BLOCK_MAJOR_VERSION_2 || majorVersion == BLOCK_MAJOR_VERSION_3) {
+    cn_slow_hash_v0(hashingBinaryArray.data(), hashingBinaryArray.size(), hash);
+  } else if (majorVersion == BLOCK_MAJOR_VERSION_4) {
+    cn_lite_slow_hash_v1(hashingBinaryArray.data(), hashingBinaryArray.size(), hash);
+  } else if (majorVersion >= BLOCK_MAJOR_VERSION_5) {
+    cn_turtle_lite_slow_hash_v2(hashingBinaryArray.data(), hashingBinaryArray.size(), hash);
+  } else {
+    throw std::runtime_error("Unknown block major version.");
+  }
+}
+
 const Crypto::Hash& CachedBlock::getAuxiliaryBlockHeaderHash() const {
   if (!auxiliaryBlockHeaderHash.is_initialized()) {
     auxiliaryBlockHeaderHash = getObjectHash(getBlockHashingBinaryArray());
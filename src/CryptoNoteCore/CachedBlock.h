@@ -18,6 +18,13 @@ public:
   const Crypto::Hash& getTransactionTreeHash() const;
   const Crypto::Hash& getBlockHash() const;
   const Crypto::Hash& getBlockLongHash() const;
+
+  // The blob which is slow hashed to get the block long hash. The 4 byte nonce sits at
+  // getBlockLongHashingNonceOffset() inside it, so miners can try new nonces by patching
+  // the blob in place instead of reserializing the block for every nonce.
+  const BinaryArray& getBlockLongHashingBinaryArray() const;
+  size_t getBlockLongHashingNonceOffset() const;
+  static void getBlockLongHash(uint8_t majorVersion, const BinaryArray& hashingBinaryArray, Crypto::Hash& hash);
   const Crypto::Hash& getAuxiliaryBlockHeaderHash() const;
   const BinaryArray& getBlockHashingBinaryArray() const;
   const BinaryArray& getParentBlockBinaryArray(bool headerOnly) const;
@@ -6,6 +6,9 @@
 // Please see the included LICENSE file for more information.
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 #include <numeric>
 
@@ -32,6 +35,7 @@
 #include <CryptoNoteProtocol/CryptoNoteProtocolHandlerCommon.h>
 
 #include <set>
+#include <thread>
 
 #include <System/Timer.h>
 
@@ -108,6 +112,11 @@ size_t getMaximumTransactionAllowedSize(size_t blockSizeMedian, const Currency&
   return blockSizeMedian * 2 - currency.minerTxBlobReservedSize();
 }
 
+size_t getMaxBlockTemplateTransactionsSize(size_t medianSize, size_t maxCumulativeSize, const Currency& currency) {
+  size_t maxTotalSize = (125 * medianSize) / 100;
+  return std::min(maxTotalSize, maxCumulativeSize) - currency.minerTxBlobReservedSize();
+}
+
 BlockTemplate extractBlockTemplate(const RawBlock& block) {
   BlockTemplate blockTemplate;
   if (!fromBinaryArray(blockTemplate, block.block)) {
@@ -156,8 +165,7 @@ int64_t getEmissionChange(const Currency& currency, IBlockchainCache& segment, u
   uint64_t reward = 0;
   int64_t emissionChange = 0;
   auto alreadyGeneratedCoins = segment.getAlreadyGeneratedCoins(previousBlockIndex);
-  auto lastBlocksSizes = segment.getLastBlocksSizes(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
-  auto blocksSizeMedian = Common::medianValue(lastBlocksSizes);
+  auto blocksSizeMedian = segment.getLastBlocksSizesMedian(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
   if (!currency.getBlockReward(cachedBlock.getBlock().majorVersion, blocksSizeMedian,
                                cumulativeSize, alreadyGeneratedCoins, cumulativeFee, reward, emissionChange)) {
     throw std::system_error(make_error_code(error::BlockValidationError::CUMULATIVE_BLOCK_SIZE_TOO_BIG));
@@ -189,13 +197,28 @@ uint32_t findCommonRoot(IMainChainStorage& storage, IBlockchainCache& rootSegmen
 
 const std::chrono::seconds OUTDATED_TRANSACTION_POLLING_INTERVAL = std::chrono::seconds(60);
 
+const uint32_t IMPORT_PREFETCH_BLOCKS = 1000;
+
+/* Blocks imported from the storage per database write */
+const uint32_t IMPORT_COMMIT_BLOCKS = 100;
+
+size_t getSignatureWorkerCount() {
+  /* The thread adding the block does its share of the checks too */
+  const size_t threads = std::thread::hardware_concurrency();
+  return threads > 1 ? threads - 1 : 1;
+}
+
 }
 
 Core::Core(const Currency& currency, std::shared_ptr<Logging::ILogger> logger, Checkpoints&& checkpoints, System::Dispatcher& dispatcher,
            std::unique_ptr<IBlockchainCacheFactory>&& blockchainCacheFactory, std::unique_ptr<IMainChainStorage>&& mainchainStorage)
     : currency(currency), dispatcher(dispatcher), contextGroup(dispatcher), logger(logger, "Core"), checkpoints(std::move(checkpoints)),
       upgradeManager(new UpgradeManager()), blockchainCacheFactory(std::move(blockchainCacheFactory)),
-      mainChainStorage(std::move(mainchainStorage)), initialized(false) {
+      mainChainStorage(std::move(mainchainStorage)), initialized(false),
+      signatureWorkers(new Common::ThreadPool(getSignatureWorkerCount())),
+      walletSyncDataMaxBlockCount(WALLET_SYNC_DATA_DEFAULT_MAX_BLOCK_COUNT),
+      walletSyncDataMaxResponseSize(WALLET_SYNC_DATA_MAX_RESPONSE_MB_DEFAULT_SIZE * 1024 * 1024),
+      poolTransactionSizeLimit(std::numeric_limits<size_t>::max()) {
 
   upgradeManager->addMajorBlockVersion(BLOCK_MAJOR_VERSION_2, currency.upgradeHeight(BLOCK_MAJOR_VERSION_2));
   upgradeManager->addMajorBlockVersion(BLOCK_MAJOR_VERSION_3, currency.upgradeHeight(BLOCK_MAJOR_VERSION_3));
@@ -224,6 +247,8 @@ bool Core::removeMessageQueue(MessageQueue<BlockchainMessage>& messageQueue) {
 
 bool Core::notifyObservers(BlockchainMessage&& msg) /* noexcept */ {
   try {
+    updateBlockTemplateState(msg);
+
     for (auto& queue : queueList) {
       queue.push(std::move(msg));
     }
@@ -590,7 +615,9 @@ bool Core::getWalletSyncData(
         /* Current height */
         uint64_t currentIndex = mainChain->getTopBlockIndex();
 
-        uint64_t actualBlockCount = std::min(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, blockCount);
+        /* Clients may ask for larger batches to save round trips, up to
+           our limit. The response size is bounded separately below. */
+        uint64_t actualBlockCount = std::min(walletSyncDataMaxBlockCount, blockCount);
 
         if (actualBlockCount == 0) {
             actualBlockCount = BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
@@ -662,32 +689,57 @@ bool Core::getWalletSyncData(
             return true;
         }
 
-        std::vector<RawBlock> rawBlocks = mainChain->getBlocksByHeight(startIndex, endIndex);
+        /* Block data we've added to the response so far */
+        size_t responseSize = 0;
 
-        for (const auto rawBlock : rawBlocks)
+        /* Read the blocks in chunks, so a large request stops hitting the DB
+           once the response size budget is used up. We always return at
+           least one block, however large it is. */
+        while (startIndex < endIndex && responseSize < walletSyncDataMaxResponseSize)
         {
-            BlockTemplate block;
+            const uint64_t chunkEndIndex = std::min(endIndex, startIndex + BLOCKS_SYNCHRONIZING_DEFAULT_COUNT);
 
-            fromBinaryArray(block, rawBlock.block);
+            std::vector<RawBlock> rawBlocks = mainChain->getBlocksByHeight(startIndex, chunkEndIndex);
+
+            if (rawBlocks.empty())
+            {
+                break;
+            }
 
-            WalletTypes::WalletBlockInfo walletBlock;
+            for (const auto &rawBlock : rawBlocks)
+            {
+                if (responseSize >= walletSyncDataMaxResponseSize)
+                {
+                    break;
+                }
 
-            walletBlock.blockHeight = startIndex++;
-            walletBlock.blockHash = CachedBlock(block).getBlockHash();
-            walletBlock.blockTimestamp = block.timestamp;
+                BlockTemplate block;
 
-            walletBlock.coinbaseTransaction = getRawCoinbaseTransaction(
-                block.baseTransaction
-            );
+                fromBinaryArray(block, rawBlock.block);
 
-            for (const auto &transaction : rawBlock.transactions)
-            {
-                walletBlock.transactions.push_back(
-                    getRawTransaction(transaction)
+                WalletTypes::WalletBlockInfo walletBlock;
+
+                walletBlock.blockHeight = startIndex++;
+                walletBlock.blockHash = CachedBlock(block).getBlockHash();
+                walletBlock.blockTimestamp = block.timestamp;
+
+                walletBlock.coinbaseTransaction = getRawCoinbaseTransaction(
+                    block.baseTransaction
                 );
-            }
 
-            walletBlocks.push_back(walletBlock);
+                responseSize += rawBlock.block.size();
+
+                for (const auto &transaction : rawBlock.transactions)
+                {
+                    walletBlock.transactions.push_back(
+                        getRawTransaction(transaction)
+                    );
+
+                    responseSize += transaction.size();
+                }
+
+                walletBlocks.push_back(std::move(walletBlock));
+            }
         }
 
         return true;
@@ -932,21 +984,11 @@ uint64_t Core::getBlockDifficulty(uint32_t blockIndex) const {
   return difficulties[0];
 }
 
-// TODO: just use mainChain->getDifficultyForNextBlock() ?
+/* The same difficulty the next block is validated against, which the
+   main chain keeps up to date as blocks are added */
 uint64_t Core::getDifficultyForNextBlock() const {
   throwIfNotInitialized();
-  IBlockchainCache* mainChain = chainsLeaves[0];
-
-  uint32_t topBlockIndex = mainChain->getTopBlockIndex();
-
-  uint8_t nextBlockMajorVersion = getBlockMajorVersionForHeight(topBlockIndex);
-
-  size_t blocksCount = std::min(static_cast<size_t>(topBlockIndex), currency.difficultyBlocksCountByBlockVersion(nextBlockMajorVersion, topBlockIndex));
-
-  auto timestamps = mainChain->getLastTimestamps(blocksCount);
-  auto difficulties = mainChain->getLastCumulativeDifficulties(blocksCount);
-
-  return currency.getNextDifficulty(nextBlockMajorVersion, topBlockIndex, timestamps, difficulties);
+  return chainsLeaves[0]->getDifficultyForNextBlock();
 }
 
 std::vector<Crypto::Hash> Core::findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds,
@@ -963,16 +1005,80 @@ std::vector<Crypto::Hash> Core::findBlockchainSupplement(const std::vector<Crypt
 }
 
 std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock) {
+  return doAddBlock(cachedBlock, std::move(rawBlock), nullptr);
+}
+
+std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock,
+                               std::vector<CachedTransaction>&& transactions) {
+  return doAddBlock(cachedBlock, std::move(rawBlock), &transactions);
+}
+
+bool Core::prepareBlock(const CachedBlock& cachedBlock, const RawBlock& rawBlock,
+                        std::vector<CachedTransaction>& transactions) const {
+  if (rawBlock.transactions.size() != cachedBlock.getBlock().transactionHashes.size()) {
+    return false;
+  }
+
+  try {
+    transactions.clear();
+    transactions.reserve(rawBlock.transactions.size());
+
+    for (const auto& rawTransaction : rawBlock.transactions) {
+      if (rawTransaction.size() > currency.maxTxSize()) {
+        return false;
+      }
+
+      transactions.emplace_back(rawTransaction);
+
+      /* Warm up the hashes we need for validation */
+      transactions.back().getTransactionHash();
+      transactions.back().getTransactionPrefixHash();
+    }
+
+    /* Checkpointed blocks are checked by hash, not proof of work */
+    if (!checkpoints.isInCheckpointZone(cachedBlock.getBlockIndex())) {
+      cachedBlock.getBlockLongHash();
+    }
+  } catch (std::exception&) {
+    return false;
+  }
+
+  return true;
+}
+
+void Core::beginBlockBatch() {
+  auto lock = lockForWriting();
+
+  //The root segment, the one kept in the database, is always the first
+  chainsStorage.front()->beginBatch();
+}
+
+void Core::commitBlockBatch() {
+  auto lock = lockForWriting();
+
+  chainsStorage.front()->commitBatch();
+}
+
+std::error_code Core::doAddBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock,
+                                 std::vector<CachedTransaction>* preparedTransactions) {
   throwIfNotInitialized();
+  auto lock = lockForWriting();
   uint32_t blockIndex = cachedBlock.getBlockIndex();
   Crypto::Hash blockHash = cachedBlock.getBlockHash();
-  std::ostringstream os;
-  os << blockIndex << " (" << blockHash << ")";
-  std::string blockStr = os.str();
-
-  logger(Logging::DEBUGGING) << "Request to add block " << blockStr;
+  /* Only formatted when it's going to be logged */
+  auto blockStr = [&]() {
+    std::ostringstream os;
+    os << blockIndex << " (" << blockHash << ")";
+    return os.str();
+  };
+
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Request to add block " << blockStr();
+  });
   if (hasBlock(cachedBlock.getBlockHash())) {
-    logger(Logging::DEBUGGING) << "Block " << blockStr << " already exists";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Block " << blockStr() << " already exists";
+    });
     return error::AddBlockErrorCode::ALREADY_EXISTS;
   }
 
@@ -983,14 +1089,24 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
 
   auto cache = findSegmentContainingBlock(previousBlockHash);
   if (cache == nullptr) {
-    logger(Logging::DEBUGGING) << "Block " << blockStr << " rejected as orphaned";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Block " << blockStr() << " rejected as orphaned";
+    });
     return error::AddBlockErrorCode::REJECTED_AS_ORPHANED;
   }
 
   std::vector<CachedTransaction> transactions;
   uint64_t cumulativeSize = 0;
-  if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize)) {
-    logger(Logging::DEBUGGING) << "Couldn't deserialize raw block transactions in block " << blockStr;
+  if (preparedTransactions != nullptr) {
+    transactions = std::move(*preparedTransactions);
+
+    for (const auto& rawTransaction : rawBlock.transactions) {
+      cumulativeSize += rawTransaction.size();
+    }
+  } else if (!extractTransactions(rawBlock.transactions, transactions, cumulativeSize)) {
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Couldn't deserialize raw block transactions in block " << blockStr();
+    });
     return error::AddBlockErrorCode::DESERIALIZATION_FAILED;
   }
 
@@ -1004,20 +1120,26 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
   bool addOnTop = cache->getTopBlockIndex() == previousBlockIndex;
   auto maxBlockCumulativeSize = currency.maxBlockCumulativeSize(previousBlockIndex + 1);
   if (cumulativeBlockSize > maxBlockCumulativeSize) {
-    logger(Logging::DEBUGGING) << "Block " << blockStr << " has too big cumulative size";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Block " << blockStr() << " has too big cumulative size";
+    });
     return error::BlockValidationError::CUMULATIVE_BLOCK_SIZE_TOO_BIG;
   }
 
   uint64_t minerReward = 0;
   auto blockValidationResult = validateBlock(cachedBlock, cache, minerReward);
   if (blockValidationResult) {
-    logger(Logging::DEBUGGING) << "Failed to validate block " << blockStr << ": " << blockValidationResult.message();
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Failed to validate block " << blockStr() << ": " << blockValidationResult.message();
+    });
     return blockValidationResult;
   }
 
   auto currentDifficulty = cache->getDifficultyForNextBlock(previousBlockIndex);
   if (currentDifficulty == 0) {
-    logger(Logging::DEBUGGING) << "Block " << blockStr << " has difficulty overhead";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Block " << blockStr() << " has difficulty overhead";
+    });
     return error::BlockValidationError::DIFFICULTY_OVERHEAD;
   }
 
@@ -1046,42 +1168,68 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
 
   uint64_t cumulativeFee = 0;
 
-  for (const auto& transaction : transactions) {
+  /* Key image and output lookups have to go through the validator state and
+     the cache in order, so do those first, and save the signature checks */
+  std::vector<InputSignatureCheck> signatureChecks;
+  std::vector<size_t> signatureCheckOwners;
+
+  for (size_t i = 0; i < transactions.size(); i++) {
+    const auto& transaction = transactions[i];
+
     uint64_t fee = 0;
-    auto transactionValidationResult = validateTransaction(transaction, validatorState, cache, fee, previousBlockIndex);
+    auto transactionValidationResult = validateTransaction(transaction, validatorState, cache, fee, previousBlockIndex, signatureChecks);
     if (transactionValidationResult) {
-      logger(Logging::DEBUGGING) << "Failed to validate transaction " << transaction.getTransactionHash() << ": " << transactionValidationResult.message();
+      logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+        message << "Failed to validate transaction " << transaction.getTransactionHash() << ": " << transactionValidationResult.message();
+      });
       return transactionValidationResult;
     }
 
+    signatureCheckOwners.resize(signatureChecks.size(), i);
+
     cumulativeFee += fee;
   }
 
+  /* Then verify the signatures across all our cores */
+  size_t failedCheck = 0;
+
+  if (auto signatureResult = checkInputSignatures(signatureChecks, true, failedCheck)) {
+    const auto& transaction = transactions[signatureCheckOwners[failedCheck]];
+
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Failed to validate transaction " << transaction.getTransactionHash() << ": " << signatureResult.message();
+    });
+    return signatureResult;
+  }
+
   uint64_t reward = 0;
   int64_t emissionChange = 0;
   auto alreadyGeneratedCoins = cache->getAlreadyGeneratedCoins(previousBlockIndex);
-  auto lastBlocksSizes = cache->getLastBlocksSizes(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
-  auto blocksSizeMedian = Common::medianValue(lastBlocksSizes);
+  auto blocksSizeMedian = cache->getLastBlocksSizesMedian(currency.rewardBlocksWindow(), previousBlockIndex, addGenesisBlock);
 
   if (!currency.getBlockReward(cachedBlock.getBlock().majorVersion, blocksSizeMedian,
                                cumulativeBlockSize, alreadyGeneratedCoins, cumulativeFee, reward, emissionChange)) {
-    logger(Logging::DEBUGGING) << "Block " << blockStr << " has too big cumulative size";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Block " << blockStr() << " has too big cumulative size";
+    });
     return error::BlockValidationError::CUMULATIVE_BLOCK_SIZE_TOO_BIG;
   }
 
   if (minerReward != reward) {
-    logger(Logging::DEBUGGING) << "Block reward mismatch for block " << blockStr
-                             << ". Expected reward: " << reward << ", got reward: " << minerReward;
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Block reward mismatch for block " << blockStr()
+        << ". Expected reward: " << reward << ", got reward: " << minerReward;
+    });
     return error::BlockValidationError::BLOCK_REWARD_MISMATCH;
   }
 
   if (checkpoints.isInCheckpointZone(cachedBlock.getBlockIndex())) {
     if (!checkpoints.checkBlock(cachedBlock.getBlockIndex(), cachedBlock.getBlockHash())) {
-      logger(Logging::WARNING) << "Checkpoint block hash mismatch for block " << blockStr;
+      logger(Logging::WARNING) << "Checkpoint block hash mismatch for block " << blockStr();
       return error::BlockValidationError::CHECKPOINT_BLOCK_HASH_MISMATCH;
     }
   } else if (!currency.checkProofOfWork(cachedBlock, currentDifficulty)) {
-    logger(Logging::WARNING) << "Proof of work too weak for block " << blockStr;
+    logger(Logging::WARNING) << "Proof of work too weak for block " << blockStr();
     return error::BlockValidationError::PROOF_OF_WORK_TOO_WEAK;
   }
 
@@ -1102,15 +1250,19 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
         actualizePoolTransactionsLite(validatorState);
 
         ret = error::AddBlockErrorCode::ADDED_TO_MAIN;
-        logger(Logging::DEBUGGING) << "Block " << blockStr << " added to main chain.";
+        logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+          message << "Block " << blockStr() << " added to main chain.";
+        });
         if ((previousBlockIndex + 1) % 100 == 0) {
-          logger(Logging::INFO) << "Block " << blockStr << " added to main chain";
+          logger(Logging::INFO) << "Block " << blockStr() << " added to main chain";
         }
 
         notifyObservers(makeDelTransactionMessage(std::move(hashes), Messages::DeleteTransaction::Reason::InBlock));
       } else {
         cache->pushBlock(cachedBlock, transactions, validatorState, cumulativeBlockSize, emissionChange, currentDifficulty, std::move(rawBlock));
-        logger(Logging::DEBUGGING) << "Block " << blockStr << " added to alternative chain.";
+        logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+          message << "Block " << blockStr() << " added to alternative chain.";
+        });
 
         auto mainChainCache = chainsLeaves[0];
         if (cache->getCurrentCumulativeDifficulty() > mainChainCache->getCurrentCumulativeDifficulty()) {
@@ -1129,7 +1281,7 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
 
           ret = error::AddBlockErrorCode::ADDED_TO_ALTERNATIVE_AND_SWITCHED;
 
-          logger(Logging::INFO) << "Resolved: " << blockStr
+          logger(Logging::INFO) << "Resolved: " << blockStr()
                                 << ", Previous: " << chainsLeaves[endpointIndex]->getTopBlockIndex() << " ("
                                 << chainsLeaves[endpointIndex]->getTopBlockHash() << ")";
         }
@@ -1143,7 +1295,9 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
       chainsStorage.emplace_back(std::move(newCache));
       chainsLeaves.push_back(newlyForkedChainPtr);
 
-      logger(Logging::DEBUGGING) << "Resolving: " << blockStr;
+      logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+        message << "Resolving: " << blockStr();
+      });
 
       newlyForkedChainPtr->pushBlock(cachedBlock, transactions, validatorState, cumulativeBlockSize, emissionChange,
                                      currentDifficulty, std::move(rawBlock));
@@ -1152,7 +1306,9 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
       updateBlockMedianSize();
     }
   } else {
-    logger(Logging::DEBUGGING) << "Resolving: " << blockStr;
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Resolving: " << blockStr();
+    });
 
     auto upperSegment = cache->split(previousBlockIndex + 1);
     //[cache] is lower segment now
@@ -1184,7 +1340,9 @@ std::error_code Core::addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlo
     updateMainChainSet();
   }
 
-  logger(Logging::DEBUGGING) << "Block: " << blockStr << " successfully added";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Block: " << blockStr() << " successfully added";
+  });
   notifyOnSuccess(ret, previousBlockIndex, cachedBlock, *cache);
 
   return ret;
@@ -1206,15 +1364,26 @@ void Core::actualizePoolTransactions() {
 
 void Core::actualizePoolTransactionsLite(const TransactionValidatorState& validatorState) {
   auto& pool = *transactionPool;
-  auto hashes = pool.getTransactionHashes();
+  auto hashes = pool.getConflictingTransactionHashes(validatorState);
+
+  /* Sizes only need checking when the maximum shrank below what pool
+     transactions may have been let in with */
+  const size_t maxTransactionSize = getMaximumTransactionAllowedSize(blockMedianSize, currency);
+  if (maxTransactionSize < poolTransactionSizeLimit) {
+    pool.forEachTransactionByFee([&hashes, maxTransactionSize](const CachedTransaction& transaction) {
+      if (transaction.getTransactionBinaryArray().size() > maxTransactionSize) {
+        hashes.push_back(transaction.getTransactionHash());
+      }
 
-  for (auto& hash : hashes) {
-    auto tx = pool.getTransaction(hash);
+      return true;
+    });
 
-    auto txState = extractSpentOutputs(tx);
+    poolTransactionSizeLimit = maxTransactionSize;
+  }
 
-    if (hasIntersections(validatorState, txState) || tx.getTransactionBinaryArray().size() > getMaximumTransactionAllowedSize(blockMedianSize, currency)) {
-      pool.removeTransaction(hash);
+  for (auto& hash : hashes) {
+    //A transaction can both conflict and be too big
+    if (pool.removeTransaction(hash)) {
       notifyObservers(makeDelTransactionMessage({ hash }, Messages::DeleteTransaction::Reason::NotActual));
     }
   }
@@ -1416,8 +1585,11 @@ bool Core::addTransactionToPool(const BinaryArray& transactionBinaryArray) {
   CachedTransaction cachedTransaction(std::move(transaction));
   auto transactionHash = cachedTransaction.getTransactionHash();
 
-  if (!addTransactionToPool(std::move(cachedTransaction))) {
-    return false;
+  {
+    auto lock = lockForWriting();
+    if (!addTransactionToPool(std::move(cachedTransaction))) {
+      return false;
+    }
   }
 
   notifyObservers(makeAddTransactionMessage({transactionHash}));
@@ -1433,12 +1605,22 @@ bool Core::addTransactionToPool(CachedTransaction&& cachedTransaction) {
 
   auto transactionHash = cachedTransaction.getTransactionHash();
 
+  /* Pool transactions are read from other threads, fill in the values
+     computed on first use while nothing else can see the transaction */
+  cachedTransaction.getTransactionBinaryArray();
+  cachedTransaction.getTransactionPrefixHash();
+  cachedTransaction.getTransactionFee();
+
   if (!transactionPool->pushTransaction(std::move(cachedTransaction), std::move(validatorState))) {
-    logger(Logging::DEBUGGING) << "Failed to push transaction " << transactionHash << " to pool, already exists";
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Failed to push transaction " << transactionHash << " to pool, already exists";
+    });
     return false;
   }
 
-  logger(Logging::DEBUGGING) << "Transaction " << transactionHash << " has been added to pool";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "Transaction " << transactionHash << " has been added to pool";
+  });
   return true;
 }
 
@@ -1462,8 +1644,10 @@ bool Core::isTransactionValidForPool(const CachedTransaction& cachedTransaction,
   uint64_t fee;
 
   if (auto validationResult = validateTransaction(cachedTransaction, validatorState, chainsLeaves[0], fee, getTopBlockIndex())) {
-    logger(Logging::DEBUGGING) << "Transaction " << cachedTransaction.getTransactionHash()
-      << " is not valid. Reason: " << validationResult.message();
+    logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+      message << "Transaction " << cachedTransaction.getTransactionHash()
+        << " is not valid. Reason: " << validationResult.message();
+    });
     return false;
   }
 
@@ -1541,99 +1725,221 @@ bool Core::getBlockTemplate(BlockTemplate& b, const AccountPublicAddress& adr, c
                             uint64_t& difficulty, uint32_t& height) const {
   throwIfNotInitialized();
 
-  height = getTopBlockIndex() + 1;
-  difficulty = getDifficultyForNextBlock();
-  if (difficulty == 0) {
-    logger(Logging::ERROR, Logging::BRIGHT_RED) << "difficulty overhead.";
+  auto startTime = std::chrono::steady_clock::now();
+
+  BlockTemplateState& state = blockTemplateState;
+
+  /* Not every change of the top block comes with a message */
+  if (state.chainValid && (state.height != getTopBlockIndex() + 1 || state.block.previousBlockHash != getTopBlockHash())) {
+    state.chainValid = false;
+  }
+
+  const bool cached = state.chainValid && state.transactionsValid && state.minerTransactionValid;
+
+  if (!updateBlockTemplateState()) {
     return false;
   }
 
-  b = boost::value_initialized<BlockTemplate>();
-  b.majorVersion = getBlockMajorVersionForHeight(height);
+  if (!state.minerTransactionValid || state.address.spendPublicKey != adr.spendPublicKey ||
+      state.address.viewPublicKey != adr.viewPublicKey || state.extraNonce != extraNonce) {
+    state.minerTransactionValid = false;
 
-  if (b.majorVersion == BLOCK_MAJOR_VERSION_1) {
-    b.minorVersion = currency.upgradeHeight(BLOCK_MAJOR_VERSION_2) == IUpgradeDetector::UNDEF_HEIGHT ? BLOCK_MINOR_VERSION_1 : BLOCK_MINOR_VERSION_0;
-  } else if (b.majorVersion >= BLOCK_MAJOR_VERSION_2) {
-    if (currency.upgradeHeight(BLOCK_MAJOR_VERSION_3) == IUpgradeDetector::UNDEF_HEIGHT) {
-      b.minorVersion = b.majorVersion == BLOCK_MAJOR_VERSION_2 ? BLOCK_MINOR_VERSION_1 : BLOCK_MINOR_VERSION_0;
-    } else {
-      b.minorVersion = BLOCK_MINOR_VERSION_0;
+    if (!constructBlockTemplateMinerTransaction(state.block, adr, extraNonce)) {
+      return false;
     }
 
-    b.parentBlock.majorVersion = BLOCK_MAJOR_VERSION_1;
-    b.parentBlock.majorVersion = BLOCK_MINOR_VERSION_0;
-    b.parentBlock.transactionCount = 1;
+    state.address = adr;
+    state.extraNonce = extraNonce;
+    state.minerTransactionValid = true;
+  }
+
+  b = state.block;
+  b.timestamp = std::max<uint64_t>(time(nullptr), state.medianTimestamp);
+  difficulty = state.difficulty;
+  height = state.height;
 
-    TransactionExtraMergeMiningTag mmTag = boost::value_initialized<decltype(mmTag)>();
-    if (!appendMergeMiningTagToExtra(b.parentBlock.baseTransaction.extra, mmTag)) {
-      logger(Logging::ERROR, Logging::BRIGHT_RED)
-          << "Failed to append merge mining tag to extra of the parent block miner transaction";
+  logger(Logging::TRACE) << "Block template for height " << height << (cached ? " served from cache in " : " built in ")
+                         << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count() << " us";
+
+  return true;
+}
+
+bool Core::updateBlockTemplateState() const {
+  BlockTemplateState& state = blockTemplateState;
+
+  if (!state.chainValid) {
+    state.transactionsValid = false;
+    state.minerTransactionValid = false;
+
+    const uint32_t height = getTopBlockIndex() + 1;
+    state.height = height;
+    state.difficulty = getDifficultyForNextBlock();
+    if (state.difficulty == 0) {
+      logger(Logging::ERROR, Logging::BRIGHT_RED) << "difficulty overhead.";
       return false;
     }
-  }
 
-  b.previousBlockHash = getTopBlockHash();
-  b.timestamp = time(nullptr);
+    BlockTemplate& b = state.block;
+    state.medianTimestamp = 0;
+
+    b = boost::value_initialized<BlockTemplate>();
+    b.majorVersion = getBlockMajorVersionForHeight(height);
 
-  /* Ok, so if an attacker is fiddling around with timestamps on the network,
-     they can make it so all the valid pools / miners don't produce valid
-     blocks. This is because the timestamp is created as the users current time,
-     however, if the attacker is a large % of the hashrate, they can slowly
-     increase the timestamp into the future, shifting the median timestamp
-     forwards. At some point, this will mean the valid pools will submit a
-     block with their valid timestamps, and it will be rejected for being
-     behind the median timestamp / too far in the past. The simple way to
-     handle this is just to check if our timestamp is going to be invalid, and
-     set it to the median.
+    if (b.majorVersion == BLOCK_MAJOR_VERSION_1) {
+      b.minorVersion = currency.upgradeHeight(BLOCK_MAJOR_VERSION_2) == IUpgradeDetector::UNDEF_HEIGHT ? BLOCK_MINOR_VERSION_1 : BLOCK_MINOR_VERSION_0;
+    } else if (b.majorVersion >= BLOCK_MAJOR_VERSION_2) {
+      if (currency.upgradeHeight(BLOCK_MAJOR_VERSION_3) == IUpgradeDetector::UNDEF_HEIGHT) {
+        b.minorVersion = b.majorVersion == BLOCK_MAJOR_VERSION_2 ? BLOCK_MINOR_VERSION_1 : BLOCK_MINOR_VERSION_0;
+      } else {
+        b.minorVersion = BLOCK_MINOR_VERSION_0;
+      }
 
-     Once the attack ends, the median timestamp will remain how it is, until
-     the time on the clock goes forwards, and we can start submitting valid
-     timestamps again, and then we are back to normal. */
+      b.parentBlock.majorVersion = BLOCK_MAJOR_VERSION_1;
+      b.parentBlock.majorVersion = BLOCK_MINOR_VERSION_0;
+      b.parentBlock.transactionCount = 1;
 
-  /* Thanks to jagerman for this patch:
-     https://github.com/loki-project/loki/pull/26 */
+      TransactionExtraMergeMiningTag mmTag = boost::value_initialized<decltype(mmTag)>();
+      if (!appendMergeMiningTagToExtra(b.parentBlock.baseTransaction.extra, mmTag)) {
+        logger(Logging::ERROR, Logging::BRIGHT_RED)
+            << "Failed to append merge mining tag to extra of the parent block miner transaction";
+        return false;
+      }
+    }
 
-  /* How many blocks we look in the past to calculate the median timestamp */
-  uint64_t blockchain_timestamp_check_window;
+    b.previousBlockHash = getTopBlockHash();
 
-  if (height >= CryptoNote::parameters::LWMA_2_DIFFICULTY_BLOCK_INDEX)
-  {
-      blockchain_timestamp_check_window = CryptoNote::parameters::BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW_V3;
+    /* Ok, so if an attacker is fiddling around with timestamps on the network,
+       they can make it so all the valid pools / miners don't produce valid
+       blocks. This is because the timestamp is created as the users current time,
+       however, if the attacker is a large % of the hashrate, they can slowly
+       increase the timestamp into the future, shifting the median timestamp
+       forwards. At some point, this will mean the valid pools will submit a
+       block with their valid timestamps, and it will be rejected for being
+       behind the median timestamp / too far in the past. The simple way to
+       handle this is just to check if our timestamp is going to be invalid, and
+       set it to the median.
+
+       Once the attack ends, the median timestamp will remain how it is, until
+       the time on the clock goes forwards, and we can start submitting valid
+       timestamps again, and then we are back to normal. */
+
+    /* Thanks to jagerman for this patch:
+       https://github.com/loki-project/loki/pull/26 */
+
+    /* How many blocks we look in the past to calculate the median timestamp */
+    uint64_t blockchain_timestamp_check_window;
+
+    if (height >= CryptoNote::parameters::LWMA_2_DIFFICULTY_BLOCK_INDEX)
+    {
+        blockchain_timestamp_check_window = CryptoNote::parameters::BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW_V3;
+    }
+    else
+    {
+        blockchain_timestamp_check_window = CryptoNote::parameters::BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW;
+    }
+
+    /* Skip the first N blocks, we don't have enough blocks to calculate a
+       proper median yet */
+    if (height >= blockchain_timestamp_check_window)
+    {
+        std::vector<uint64_t> timestamps;
+
+        /* For the last N blocks, get their timestamps */
+        for (size_t offset = height - blockchain_timestamp_check_window; offset < height; offset++)
+        {
+            timestamps.push_back(getBlockTimestampByIndex(offset));
+        }
+
+        /* The timestamp itself is set for each request */
+        state.medianTimestamp = Common::medianValue(timestamps);
+    }
+
+    state.medianSize = calculateCumulativeBlocksizeLimit(height) / 2;
+    state.maxTransactionsSize = getMaxBlockTemplateTransactionsSize(state.medianSize, currency.maxBlockCumulativeSize(height), currency);
+
+    assert(!chainsStorage.empty());
+    assert(!chainsLeaves.empty());
+    state.alreadyGeneratedCoins = chainsLeaves[0]->getAlreadyGeneratedCoins();
+
+    state.chainValid = true;
   }
-  else
-  {
-      blockchain_timestamp_check_window = CryptoNote::parameters::BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW;
+
+  if (!state.transactionsValid) {
+    state.block.transactionHashes.clear();
+    fillBlockTemplate(state.block, state.medianSize, currency.maxBlockCumulativeSize(state.height), state.height, state.transactionsSize, state.fee);
+
+    state.transactionHashes.clear();
+    state.transactionHashes.insert(state.block.transactionHashes.begin(), state.block.transactionHashes.end());
+    state.transactionsValid = true;
+    state.minerTransactionValid = false;
   }
 
-  /* Skip the first N blocks, we don't have enough blocks to calculate a
-     proper median yet */
-  if (height >= blockchain_timestamp_check_window)
-  {
-      std::vector<uint64_t> timestamps;
+  return true;
+}
 
-      /* For the last N blocks, get their timestamps */
-      for (size_t offset = height - blockchain_timestamp_check_window; offset < height; offset++)
-      {
-          timestamps.push_back(getBlockTimestampByIndex(offset));
+void Core::updateBlockTemplateState(const BlockchainMessage& message) {
+  BlockTemplateState& state = blockTemplateState;
+
+  switch (message.getType()) {
+    case BlockchainMessage::Type::NewBlock:
+    case BlockchainMessage::Type::ChainSwitch:
+      state.chainValid = false;
+      break;
+    case BlockchainMessage::Type::AddTransaction:
+      for (const auto& hash : message.getAddTransaction().hashes) {
+        appendBlockTemplateTransaction(hash);
+      }
+      break;
+    case BlockchainMessage::Type::DeleteTransaction:
+      for (const auto& hash : message.getDeleteTransaction().hashes) {
+        if (state.transactionHashes.count(hash) != 0) {
+          state.transactionsValid = false;
+          break;
+        }
       }
+      break;
+    default:
+      break;
+  }
+}
 
-      uint64_t medianTimestamp = Common::medianValue(timestamps);
+void Core::appendBlockTemplateTransaction(const Crypto::Hash& transactionHash) {
+  BlockTemplateState& state = blockTemplateState;
 
-      if (b.timestamp < medianTimestamp)
-      {
-          b.timestamp = medianTimestamp;
-      }
+  if (!state.chainValid || !state.transactionsValid || !transactionPool->checkIfTransactionPresent(transactionHash)) {
+    return;
   }
 
-  size_t medianSize = calculateCumulativeBlocksizeLimit(height) / 2;
+  const CachedTransaction& transaction = transactionPool->getTransaction(transactionHash);
+  const size_t transactionSize = transaction.getTransactionBinaryArray().size();
 
-  assert(!chainsStorage.empty());
-  assert(!chainsLeaves.empty());
-  uint64_t alreadyGeneratedCoins = chainsLeaves[0]->getAlreadyGeneratedCoins();
+  /* Fusion transactions are picked first, and one that doesn't fit may pay
+     more than some already in, so fillBlockTemplate() has to decide those */
+  if (transaction.getTransactionFee() == 0 || state.transactionsSize + transactionSize > state.maxTransactionsSize) {
+    state.transactionsValid = false;
+    return;
+  }
 
-  size_t transactionsSize;
-  uint64_t fee;
-  fillBlockTemplate(b, medianSize, currency.maxBlockCumulativeSize(height), height, transactionsSize, fee);
+  /* Pool transactions never share key images, so it can't conflict with
+     the ones already in */
+  if (!validateBlockTemplateTransaction(transaction, state.height)) {
+    return;
+  }
+
+  state.block.transactionHashes.push_back(transactionHash);
+  state.transactionHashes.insert(transactionHash);
+  state.transactionsSize += transactionSize;
+  state.fee += transaction.getTransactionFee();
+  state.minerTransactionValid = false;
+}
+
+bool Core::constructBlockTemplateMinerTransaction(BlockTemplate& b, const AccountPublicAddress& adr, const BinaryArray& extraNonce) const {
+  const BlockTemplateState& state = blockTemplateState;
+  const uint32_t height = state.height;
+  const size_t medianSize = state.medianSize;
+  const uint64_t alreadyGeneratedCoins = state.alreadyGeneratedCoins;
+  const size_t transactionsSize = state.transactionsSize;
+  const uint64_t fee = state.fee;
 
   /*
      two-phase miner transaction generation: we don't know exact block size until we prepare block, but we don't know
@@ -1768,6 +2074,20 @@ bool Core::extractTransactions(const std::vector<BinaryArray>& rawTransactions,
 
 std::error_code Core::validateTransaction(const CachedTransaction& cachedTransaction, TransactionValidatorState& state,
                                           IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex) {
+  std::vector<InputSignatureCheck> signatureChecks;
+
+  auto error = validateTransaction(cachedTransaction, state, cache, fee, blockIndex, signatureChecks);
+  if (error != error::TransactionValidationError::VALIDATION_SUCCESS) {
+    return error;
+  }
+
+  size_t failedCheck = 0;
+  return checkInputSignatures(signatureChecks, false, failedCheck);
+}
+
+std::error_code Core::validateTransaction(const CachedTransaction& cachedTransaction, TransactionValidatorState& state,
+                                          IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex,
+                                          std::vector<InputSignatureCheck>& signatureChecks) {
   // TransactionValidatorState currentState;
   const auto& transaction = cachedTransaction.getTransaction();
 auto error = validateSemantic(transaction, fee, blockIndex);
@@ -1783,6 +2103,12 @@ auto error = validateSemantic(transaction, fee, blockIndex);
         return error::TransactionValidationError::INPUT_KEYIMAGE_ALREADY_SPENT;
       }
 
+      InputSignatureCheck check;
+      check.prefixHash = cachedTransaction.getTransactionPrefixHash();
+      check.keyImage = in.keyImage;
+      check.signatures = nullptr;
+      check.checkRingSignature = false;
+
       if (!checkpoints.isInCheckpointZone(blockIndex + 1)) {
         if (cache->checkIfSpent(in.keyImage, blockIndex)) {
           return error::TransactionValidationError::INPUT_KEYIMAGE_ALREADY_SPENT;
@@ -1812,11 +2138,12 @@ auto error = validateSemantic(transaction, fee, blockIndex);
           return error::TransactionValidationError::INPUT_INVALID_SIGNATURES_COUNT;
         }
 
-        if (!Crypto::crypto_ops::checkRingSignature(cachedTransaction.getTransactionPrefixHash(), in.keyImage, outputKeys, transaction.signatures[inputIndex])) {
-          return error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
-        }
+        check.outputKeys = std::move(outputKeys);
+        check.signatures = &transaction.signatures[inputIndex];
+        check.checkRingSignature = true;
       }
 
+      signatureChecks.push_back(std::move(check));
     } else {
       assert(false);
       return error::TransactionValidationError::INPUT_UNKNOWN_TYPE;
@@ -1828,6 +2155,118 @@ auto error = validateSemantic(transaction, fee, blockIndex);
   return error::TransactionValidationError::VALIDATION_SUCCESS;
 }
 
+std::error_code Core::checkInputSignature(const InputSignatureCheck& check) const {
+    // parameters used for the additional key_image check
+    static const Crypto::KeyImage I = { {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } };
+    static const Crypto::KeyImage L = { {0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 } };
+
+  // Fix discovered by Monero Lab and suggested by "fluffypony" (bitcointalk.org)
+  if (!(scalarmultKey(check.keyImage, L) == I)) {
+    return error::TransactionValidationError::INPUT_INVALID_DOMAIN_KEYIMAGES;
+  }
+
+  if (check.checkRingSignature && !Crypto::crypto_ops::checkRingSignature(check.prefixHash, check.keyImage, check.outputKeys, *check.signatures)) {
+    return error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
+  }
+
+  return error::TransactionValidationError::VALIDATION_SUCCESS;
+}
+
+std::error_code Core::checkInputSignatures(const std::vector<InputSignatureCheck>& signatureChecks, bool parallel,
+                                           size_t& failedCheck) const {
+  /* Shared with the jobs posted to the pool. A job may only start after this
+     call returned, if the pool was busy, and then finds no checks left
+     without touching signatureChecks. */
+  struct SignatureBatch {
+    const std::vector<InputSignatureCheck>* checks;
+    size_t checkCount;
+    std::vector<std::error_code> results;
+    std::atomic<size_t> nextCheck;
+
+    /* Lowest index of a check which failed. Workers skip any check above this,
+       but every check below it still gets run, so we always report the first
+       failure in the block, regardless of how the work was scheduled */
+    std::atomic<size_t> firstFailure;
+
+    std::mutex mutex;
+    std::condition_variable checksDoneChanged;
+    size_t checksDone;
+  };
+
+  auto batch = std::make_shared<SignatureBatch>();
+  batch->checks = &signatureChecks;
+  batch->checkCount = signatureChecks.size();
+  batch->results.resize(signatureChecks.size());
+  batch->nextCheck = 0;
+  batch->firstFailure = std::numeric_limits<size_t>::max();
+  batch->checksDone = 0;
+
+  auto processChecks = [this](SignatureBatch& batch) {
+    size_t processed = 0;
+    size_t i;
+
+    while ((i = batch.nextCheck++) < batch.checkCount) {
+      processed++;
+
+      if (i > batch.firstFailure) {
+        continue;
+      }
+
+      std::error_code ec;
+
+      try {
+        ec = checkInputSignature((*batch.checks)[i]);
+      } catch (const std::exception&) {
+        ec = error::TransactionValidationError::INPUT_INVALID_SIGNATURES;
+      }
+
+      batch.results[i] = ec;
+
+      if (ec != error::TransactionValidationError::VALIDATION_SUCCESS) {
+        size_t current = batch.firstFailure;
+
+        while (i < current && !batch.firstFailure.compare_exchange_weak(current, i)) {
+        }
+      }
+    }
+
+    if (processed == 0) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    batch.checksDone += processed;
+
+    if (batch.checksDone == batch.checkCount) {
+      batch.checksDoneChanged.notify_all();
+    }
+  };
+
+  /* The current thread works too, and there's no point waking more workers
+     than we have checks to do */
+  const size_t threads = parallel ? signatureWorkers->getThreadCount() + 1 : 1;
+
+  for (size_t i = 1; i < std::min(threads, batch->checkCount); i++) {
+    signatureWorkers->post([batch, processChecks] {
+      processChecks(*batch);
+    });
+  }
+
+  processChecks(*batch);
+
+  {
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->checksDoneChanged.wait(lock, [&batch] { return batch->checksDone == batch->checkCount; });
+  }
+
+  if (batch->firstFailure != std::numeric_limits<size_t>::max()) {
+    failedCheck = batch->firstFailure;
+    return batch->results[failedCheck];
+  }
+
+  return error::TransactionValidationError::VALIDATION_SUCCESS;
+}
+
 std::error_code Core::validateSemantic(const Transaction& transaction, uint64_t& fee, uint32_t blockIndex) {
   if (transaction.inputs.empty()) {
     return error::TransactionValidationError::EMPTY_INPUTS;
@@ -1864,12 +2303,6 @@ std::error_code Core::validateSemantic(const Transaction& transaction, uint64_t&
     summaryOutputAmount += output.amount;
   }
 
-    // parameters used for the additional key_image check
-    static const Crypto::KeyImage Z = { {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } };
-    if (Z == Z) {}
-    static const Crypto::KeyImage I = { {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } };
-    static const Crypto::KeyImage L = { {0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 } };
-
   uint64_t summaryInputAmount = 0;
   std::unordered_set<Crypto::KeyImage> ki;
   std::set<std::pair<uint64_t, uint32_t>> outputsUsage;
@@ -1888,11 +2321,7 @@ std::error_code Core::validateSemantic(const Transaction& transaction, uint64_t&
 
       // outputIndexes are packed here, first is absolute, others are offsets to previous,
       // so first can be zero, others can't
-      // Fix discovered by Monero Lab and suggested by "fluffypony" (bitcointalk.org)
-      if (!(scalarmultKey(in.keyImage, L) == I)) {
-        return error::TransactionValidationError::INPUT_INVALID_DOMAIN_KEYIMAGES;
-      }
-
+      // (the key image domain check is done with the signatures, in checkInputSignature)
       if (std::find(++std::begin(in.outputIndexes), std::end(in.outputIndexes), 0) != std::end(in.outputIndexes)) {
         return error::TransactionValidationError::INPUT_IDENTICAL_OUTPUT_INDEXES;
       }
@@ -2029,6 +2458,7 @@ const Currency& Core::getCurrency() const {
 
 void Core::save() {
   throwIfNotInitialized();
+  auto lock = lockForWriting();
 
   deleteAlternativeChains();
   mergeMainChainSegments();
@@ -2036,6 +2466,8 @@ void Core::save() {
 }
 
 void Core::load() {
+  auto lock = lockForWriting();
+
   initRootSegment();
 
   start_time = std::time(nullptr);
@@ -2091,7 +2523,16 @@ void Core::importBlocksFromStorage() {
 
   auto previousBlockHash = getBlockHash(mainChainStorage->getBlockByIndex(commonIndex));
   auto blockCount = mainChainStorage->getBlockCount();
+
+  /* Write the blocks to the database a batch at a time, rather than one by one */
+  chainsLeaves[0]->beginBatch();
+
   for (uint32_t i = commonIndex + 1; i < blockCount; ++i) {
+    /* Keep the storage reading a window ahead of the blocks being added */
+    if ((i - commonIndex - 1) % IMPORT_PREFETCH_BLOCKS == 0) {
+      mainChainStorage->prefetchBlocks(i, 2 * IMPORT_PREFETCH_BLOCKS);
+    }
+
     RawBlock rawBlock = mainChainStorage->getBlockByIndex(i);
     auto blockTemplate = extractBlockTemplate(rawBlock);
     CachedBlock cachedBlock(blockTemplate);
@@ -2123,10 +2564,17 @@ void Core::importBlocksFromStorage() {
     int64_t emissionChange = getEmissionChange(currency, *chainsLeaves[0], i - 1, cachedBlock, cumulativeSize, cumulativeFee);
     chainsLeaves[0]->pushBlock(cachedBlock, transactions, spentOutputs, cumulativeSize, emissionChange, currentDifficulty, std::move(rawBlock));
 
+    if ((i - commonIndex) % IMPORT_COMMIT_BLOCKS == 0) {
+      chainsLeaves[0]->commitBatch();
+      chainsLeaves[0]->beginBatch();
+    }
+
     if (i % 1000 == 0) {
       logger(Logging::INFO) << "Imported block with index " << i << " / " << (blockCount - 1);
     }
   }
+
+  chainsLeaves[0]->commitBatch();
 }
 
 void Core::cutSegment(IBlockchainCache& segment, uint32_t startIndex) {
@@ -2393,8 +2841,7 @@ size_t Core::calculateCumulativeBlocksizeLimit(uint32_t height) const {
   assert(!chainsStorage.empty());
   assert(!chainsLeaves.empty());
   // FIXME: skip gensis here?
-  auto sizes = chainsLeaves[0]->getLastBlocksSizes(currency.rewardBlocksWindow());
-  uint64_t median = Common::medianValue(sizes);
+  uint64_t median = chainsLeaves[0]->getLastBlocksSizesMedian(currency.rewardBlocksWindow(), chainsLeaves[0]->getTopBlockIndex(), addGenesisBlock);
   if (median <= nextBlockGrantedFullRewardZone) {
     median = nextBlockGrantedFullRewardZone;
   }
@@ -2442,14 +2889,25 @@ void Core::fillBlockTemplate(
   transactionsSize = 0;
   fee = 0;
 
-  size_t maxTotalSize = (125 * medianSize) / 100;
-  maxTotalSize = std::min(maxTotalSize, maxCumulativeSize) - currency.minerTxBlobReservedSize();
+  const size_t maxTotalSize = getMaxBlockTemplateTransactionsSize(medianSize, maxCumulativeSize, currency);
 
   TransactionSpentInputsChecker spentInputsChecker;
 
-  std::vector<CachedTransaction> poolTransactions = transactionPool->getPoolTransactions();
-  for (auto it = poolTransactions.rbegin(); it != poolTransactions.rend() && it->getTransactionFee() == 0; ++it) {
-    const CachedTransaction& transaction = *it;
+  //The pool can't change while it is visited, so invalid transactions are removed at the end
+  std::vector<Crypto::Hash> invalidTransactions;
+
+  //Fusion transactions have no fee, so they come last. They are taken from the end as before
+  std::vector<const CachedTransaction*> fusionTransactions;
+  transactionPool->forEachTransactionByFee([&fusionTransactions](const CachedTransaction& transaction) {
+    if (transaction.getTransactionFee() == 0) {
+      fusionTransactions.push_back(&transaction);
+    }
+
+    return true;
+  });
+
+  for (auto it = fusionTransactions.rbegin(); it != fusionTransactions.rend(); ++it) {
+    const CachedTransaction& transaction = **it;
 
     auto transactionBlobSize = transaction.getTransactionBinaryArray().size();
     if (currency.fusionTxMaxSize() < transactionsSize + transactionBlobSize) {
@@ -2458,37 +2916,52 @@ void Core::fillBlockTemplate(
 
     if (!validateBlockTemplateTransaction(transaction, height))
     {
-        transactionPool->removeTransaction(transaction.getTransactionHash());
+        invalidTransactions.push_back(transaction.getTransactionHash());
         continue;
     }
 
     if (!spentInputsChecker.haveSpentInputs(transaction.getTransaction())) {
       block.transactionHashes.emplace_back(transaction.getTransactionHash());
       transactionsSize += transactionBlobSize;
-      logger(Logging::TRACE) << "Fusion transaction " << transaction.getTransactionHash() << " included to block template";
+      logger.log(Logging::TRACE, [&](std::ostream& message) {
+        message << "Fusion transaction " << transaction.getTransactionHash() << " included to block template";
+      });
     }
   }
 
-  for (const auto& cachedTransaction : poolTransactions) {
+  transactionPool->forEachTransactionByFee([&](const CachedTransaction& cachedTransaction) {
     size_t blockSizeLimit = (cachedTransaction.getTransactionFee() == 0) ? medianSize : maxTotalSize;
 
     if (blockSizeLimit < transactionsSize + cachedTransaction.getTransactionBinaryArray().size()) {
-      continue;
+      return true;
     }
 
     if (!validateBlockTemplateTransaction(cachedTransaction, height))
     {
-        transactionPool->removeTransaction(cachedTransaction.getTransactionHash());
-        continue;
+        invalidTransactions.push_back(cachedTransaction.getTransactionHash());
+        return true;
     }
 
     if (!spentInputsChecker.haveSpentInputs(cachedTransaction.getTransaction())) {
       transactionsSize += cachedTransaction.getTransactionBinaryArray().size();
       fee += cachedTransaction.getTransactionFee();
       block.transactionHashes.emplace_back(cachedTransaction.getTransactionHash());
-      logger(Logging::TRACE) << "Transaction " << cachedTransaction.getTransactionHash() << " included to block template";
+      logger.log(Logging::TRACE, [&](std::ostream& message) {
+        message << "Transaction " << cachedTransaction.getTransactionHash() << " included to block template";
+      });
     } else {
-      logger(Logging::TRACE) << "Transaction " << cachedTransaction.getTransactionHash() << " is failed to include to block template";
+      logger.log(Logging::TRACE, [&](std::ostream& message) {
+        message << "Transaction " << cachedTransaction.getTransactionHash() << " is failed to include to block template";
+      });
+    }
+
+    return true;
+  });
+
+  if (!invalidTransactions.empty()) {
+    auto lock = lockForWriting();
+    for (const auto& hash : invalidTransactions) {
+      transactionPool->removeTransaction(hash);
     }
   }
 }
@@ -2644,8 +3117,7 @@ BlockDetails Core::getBlockDetails(const Crypto::Hash& blockHash) const {
   uint64_t prevBlockGeneratedCoins = 0;
   blockDetails.sizeMedian = 0;
   if (blockDetails.index > 0) {
-    auto lastBlocksSizes = segment->getLastBlocksSizes(currency.rewardBlocksWindow(), blockDetails.index - 1, addGenesisBlock);
-    blockDetails.sizeMedian = Common::medianValue(lastBlocksSizes);
+    blockDetails.sizeMedian = segment->getLastBlocksSizesMedian(currency.rewardBlocksWindow(), blockDetails.index - 1, addGenesisBlock);
     prevBlockGeneratedCoins = segment->getAlreadyGeneratedCoins(blockDetails.index - 1);
   }
 
@@ -2901,7 +3373,12 @@ void Core::transactionPoolCleaningProcedure() {
     for (;;) {
       timer.sleep(OUTDATED_TRANSACTION_POLLING_INTERVAL);
 
-      auto deletedTransactions = transactionPool->clean(getTopBlockIndex());
+      std::vector<Crypto::Hash> deletedTransactions;
+      {
+        auto lock = lockForWriting();
+        deletedTransactions = transactionPool->clean(getTopBlockIndex());
+      }
+
       notifyObservers(makeDelTransactionMessage(std::move(deletedTransactions), Messages::DeleteTransaction::Reason::Outdated));
     }
   } catch (System::InterruptedException&) {
@@ -2916,9 +3393,12 @@ void Core::updateBlockMedianSize() {
 
   size_t nextBlockGrantedFullRewardZone = currency.blockGrantedFullRewardZoneByBlockVersion(upgradeManager->getBlockMajorVersion(mainChain->getTopBlockIndex() + 1));
 
-  auto lastBlockSizes = mainChain->getLastBlocksSizes(currency.rewardBlocksWindow());
+  uint64_t lastBlocksSizesMedian = mainChain->getLastBlocksSizesMedian(currency.rewardBlocksWindow(), mainChain->getTopBlockIndex(), addGenesisBlock);
 
-  blockMedianSize = std::max(Common::medianValue(lastBlockSizes), static_cast<uint64_t>(nextBlockGrantedFullRewardZone));
+  blockMedianSize = std::max(lastBlocksSizesMedian, static_cast<uint64_t>(nextBlockGrantedFullRewardZone));
+
+  /* Transactions up to the new maximum may enter the pool from now on */
+  poolTransactionSizeLimit = std::max(poolTransactionSizeLimit, getMaximumTransactionAllowedSize(blockMedianSize, currency));
 }
 
 uint64_t Core::get_current_blockchain_height() const
@@ -2932,5 +3412,19 @@ std::time_t Core::getStartTime() const
   return start_time;
 }
 
+std::shared_lock<std::shared_mutex> Core::lockForReading() const {
+  std::lock_guard<std::mutex> turn(writerTurn);
+  return std::shared_lock<std::shared_mutex>(stateLock);
+}
+
+std::unique_lock<std::shared_mutex> Core::lockForWriting() const {
+  std::lock_guard<std::mutex> turn(writerTurn);
+  return std::unique_lock<std::shared_mutex>(stateLock);
+}
+
+void Core::setWalletSyncDataLimits(uint64_t maxBlockCount, size_t maxResponseSize) {
+  walletSyncDataMaxBlockCount = maxBlockCount;
+  walletSyncDataMaxResponseSize = maxResponseSize;
 }
 
+}
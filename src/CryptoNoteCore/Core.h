@@ -5,8 +5,11 @@
 
 #pragma once
 #include <ctime>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include "BlockchainCache.h"
 #include "BlockchainMessages.h"
 #include "CachedBlock.h"
@@ -25,6 +28,7 @@
 #include "MessageQueue.h"
 #include "TransactionValidatiorState.h"
 
+#include <Common/ThreadPool.h>
 #include <System/ContextGroup.h>
 
 #include <WalletTypes.h>
@@ -85,6 +89,14 @@ public:
   virtual std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock) override;
   virtual std::error_code addBlock(RawBlock&& rawBlock) override;
 
+  virtual bool prepareBlock(const CachedBlock& cachedBlock, const RawBlock& rawBlock,
+                            std::vector<CachedTransaction>& transactions) const override;
+  virtual std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock,
+                                   std::vector<CachedTransaction>&& transactions) override;
+
+  virtual void beginBlockBatch() override;
+  virtual void commitBlockBatch() override;
+
   virtual std::error_code submitBlock(BinaryArray&& rawBlockTemplate) override;
 
   virtual bool getTransactionGlobalIndexes(const Crypto::Hash& transactionHash, std::vector<uint32_t>& globalIndexes) const override;
@@ -129,6 +141,15 @@ public:
 
   virtual uint64_t get_current_blockchain_height() const;
 
+  /* Held by threads other than the dispatcher while they read from the
+     core. The dispatcher is the only thread that changes the core, and
+     takes the lock exclusively while it does, so it reads without one. */
+  std::shared_lock<std::shared_mutex> lockForReading() const;
+
+  /* The most blocks, and the most bytes of block data, a getwalletsyncdata
+     request is answered with. At least one block is always returned. */
+  void setWalletSyncDataLimits(uint64_t maxBlockCount, size_t maxResponseSize);
+
 private:
   const Currency& currency;
   System::Dispatcher& dispatcher;
@@ -148,15 +169,80 @@ private:
   std::unique_ptr<IMainChainStorage> mainChainStorage;
   bool initialized;
 
+  /* Verifies the input signatures of each new block, alongside the thread
+     adding it. Created once, rather than spawning threads per block. */
+  std::unique_ptr<Common::ThreadPool> signatureWorkers;
+
   time_t start_time;
 
+  mutable std::shared_mutex stateLock;
+
+  /* Taken by a writer while it waits for stateLock, and briefly by each
+     reader before it, so a steady stream of readers can't hold off a
+     writer */
+  mutable std::mutex writerTurn;
+
   size_t blockMedianSize;
 
+  uint64_t walletSyncDataMaxBlockCount;
+  size_t walletSyncDataMaxResponseSize;
+
+  /* No pool transaction is bigger than this. Transactions are checked
+     against the maximum allowed size as they enter the pool, so the pool
+     only needs checking again when that maximum shrinks below it. */
+  size_t poolTransactionSizeLimit;
+
+  /* The parts of a block template that don't depend on who asks for it,
+     kept between getblocktemplate calls. Rebuilt on a new top block, and
+     patched as transactions enter and leave the pool, see
+     updateBlockTemplateState(). The miner transaction is kept for the last
+     address and extra nonce, which pools keep asking with. Only used from
+     the dispatcher thread. */
+  struct BlockTemplateState {
+    bool chainValid = false;
+    bool transactionsValid = false;
+    bool minerTransactionValid = false;
+
+    BlockTemplate block;
+    uint32_t height = 0;
+    uint64_t difficulty = 0;
+    uint64_t medianTimestamp = 0;
+    size_t medianSize = 0;
+    size_t maxTransactionsSize = 0;
+    uint64_t alreadyGeneratedCoins = 0;
+
+    size_t transactionsSize = 0;
+    uint64_t fee = 0;
+    std::unordered_set<Crypto::Hash> transactionHashes;
+
+    AccountPublicAddress address;
+    BinaryArray extraNonce;
+  };
+
+  mutable BlockTemplateState blockTemplateState;
+
+  /* The expensive, self contained part of validating a transaction input.
+     These are gathered up by validateTransaction() so the inputs of a whole
+     block can be checked in parallel once the sequential checks have passed */
+  struct InputSignatureCheck {
+    Crypto::Hash prefixHash;
+    Crypto::KeyImage keyImage;
+    std::vector<Crypto::PublicKey> outputKeys;
+    const std::vector<Crypto::Signature>* signatures;
+    /* Inside the checkpoint zone we only check the key image domain */
+    bool checkRingSignature;
+  };
+
   void throwIfNotInitialized() const;
   bool extractTransactions(const std::vector<BinaryArray>& rawTransactions, std::vector<CachedTransaction>& transactions, uint64_t& cumulativeSize);
+  std::error_code doAddBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock, std::vector<CachedTransaction>* preparedTransactions);
 
   std::error_code validateSemantic(const Transaction& transaction, uint64_t& fee, uint32_t blockIndex);
   std::error_code validateTransaction(const CachedTransaction& transaction, TransactionValidatorState& state, IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex);
+  std::error_code validateTransaction(const CachedTransaction& transaction, TransactionValidatorState& state, IBlockchainCache* cache, uint64_t& fee, uint32_t blockIndex,
+                                      std::vector<InputSignatureCheck>& signatureChecks);
+  std::error_code checkInputSignature(const InputSignatureCheck& check) const;
+  std::error_code checkInputSignatures(const std::vector<InputSignatureCheck>& signatureChecks, bool parallel, size_t& failedCheck) const;
 
   uint32_t findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds) const;
   std::vector<Crypto::Hash> getBlockHashes(uint32_t startBlockIndex, uint32_t maxCount) const;
@@ -205,6 +291,11 @@ private:
     size_t& transactionsSize,
     uint64_t& fee) const;
 
+  bool updateBlockTemplateState() const;
+  void updateBlockTemplateState(const BlockchainMessage& message);
+  void appendBlockTemplateTransaction(const Crypto::Hash& transactionHash);
+  bool constructBlockTemplateMinerTransaction(BlockTemplate& b, const AccountPublicAddress& adr, const BinaryArray& extraNonce) const;
+
   void deleteAlternativeChains();
   void deleteLeaf(size_t leafIndex);
   void mergeMainChainSegments();
@@ -213,6 +304,7 @@ private:
   void notifyOnSuccess(error::AddBlockErrorCode opResult, uint32_t previousBlockIndex, const CachedBlock& cachedBlock,
                        const IBlockchainCache& cache);
   void copyTransactionsToPool(IBlockchainCache* alt);
+  std::unique_lock<std::shared_mutex> lockForWriting() const;
 
   void actualizePoolTransactions();
   void actualizePoolTransactionsLite(const TransactionValidatorState& validatorState); //Checks pool txs only for double spend.
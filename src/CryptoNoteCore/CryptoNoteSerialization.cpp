@@ -36,6 +36,7 @@
 #include <config/CryptoNoteConfig.h>
 #include "CryptoNoteFormatUtils.h"
 #include "CryptoNoteTools.h"
+#include "ICoreDefinitions.h"
 #include "TransactionExtra.h"
 
 using namespace Common;
@@ -473,4 +474,37 @@ void serialize(RawBlock& rawBlock, ISerializer& serializer) {
   }
 }
 
+void serialize(WalletTypes::WalletBlockInfo &walletBlockInfo, ISerializer &s)
+{
+    s(walletBlockInfo.coinbaseTransaction, "coinbaseTX");
+    s(walletBlockInfo.transactions, "transactions");
+    s(walletBlockInfo.blockHeight, "blockHeight");
+    s(walletBlockInfo.blockHash, "blockHash");
+    s(walletBlockInfo.blockTimestamp, "blockTimestamp");
+}
+
+void serialize(WalletTypes::RawTransaction &rawTransaction, ISerializer &s)
+{
+    s(rawTransaction.keyInputs, "inputs");
+    s(rawTransaction.paymentID, "paymentID");
+    s(rawTransaction.keyOutputs, "outputs");
+    s(rawTransaction.hash, "hash");
+    s(rawTransaction.transactionPublicKey, "txPublicKey");
+    s(rawTransaction.unlockTime, "unlockTime");
+}
+
+void serialize(WalletTypes::RawCoinbaseTransaction &rawCoinbaseTransaction, ISerializer &s)
+{
+    s(rawCoinbaseTransaction.keyOutputs, "outputs");
+    s(rawCoinbaseTransaction.hash, "hash");
+    s(rawCoinbaseTransaction.transactionPublicKey, "txPublicKey");
+    s(rawCoinbaseTransaction.unlockTime, "unlockTime");
+}
+
+void serialize(WalletTypes::KeyOutput &keyOutput, ISerializer &s)
+{
+    s(keyOutput.key, "key");
+    s(keyOutput.amount, "amount");
+}
+
 } //namespace CryptoNote
@@ -69,6 +69,8 @@ bool Currency::init() {
     m_upgradeHeightV3 = static_cast<uint32_t>(-1);
     m_blocksFileName = "testnet_" + m_blocksFileName;
     m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
+    m_mappedBlocksFileName = "testnet_" + m_mappedBlocksFileName;
+    m_mappedBlockIndexesFileName = "testnet_" + m_mappedBlockIndexesFileName;
     m_txPoolFileName = "testnet_" + m_txPoolFileName;
   }
 
@@ -690,6 +692,8 @@ m_upgradeVotingWindow(currency.m_upgradeVotingWindow),
 m_upgradeWindow(currency.m_upgradeWindow),
 m_blocksFileName(currency.m_blocksFileName),
 m_blockIndexesFileName(currency.m_blockIndexesFileName),
+m_mappedBlocksFileName(currency.m_mappedBlocksFileName),
+m_mappedBlockIndexesFileName(currency.m_mappedBlockIndexesFileName),
 m_txPoolFileName(currency.m_txPoolFileName),
 m_genesisBlockReward(currency.m_genesisBlockReward),
 m_zawyDifficultyBlockIndex(currency.m_zawyDifficultyBlockIndex),
@@ -757,6 +761,8 @@ zawyDifficultyBlockVersion(parameters::ZAWY_DIFFICULTY_DIFFICULTY_BLOCK_VERSION)
 
   blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
   blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
+  mappedBlocksFileName(parameters::CRYPTONOTE_MAPPED_BLOCKS_FILENAME);
+  mappedBlockIndexesFileName(parameters::CRYPTONOTE_MAPPED_BLOCKINDEXES_FILENAME);
   txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
 
     isBlockexplorer(false);
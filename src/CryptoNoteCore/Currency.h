@@ -124,6 +124,8 @@ size_t difficultyBlocksCountByBlockVersion(uint8_t blockMajorVersion, uint32_t h
 
   const std::string& blocksFileName() const { return m_blocksFileName; }
   const std::string& blockIndexesFileName() const { return m_blockIndexesFileName; }
+  const std::string& mappedBlocksFileName() const { return m_mappedBlocksFileName; }
+  const std::string& mappedBlockIndexesFileName() const { return m_mappedBlockIndexesFileName; }
   const std::string& txPoolFileName() const { return m_txPoolFileName; }
 
   bool isBlockexplorer() const { return m_isBlockexplorer; }
@@ -232,6 +234,8 @@ private:
 
   std::string m_blocksFileName;
   std::string m_blockIndexesFileName;
+  std::string m_mappedBlocksFileName;
+  std::string m_mappedBlockIndexesFileName;
   std::string m_txPoolFileName;
 
 
@@ -316,6 +320,8 @@ public:
 
   CurrencyBuilder& blocksFileName(const std::string& val) { m_currency.m_blocksFileName = val; return *this; }
   CurrencyBuilder& blockIndexesFileName(const std::string& val) { m_currency.m_blockIndexesFileName = val; return *this; }
+  CurrencyBuilder& mappedBlocksFileName(const std::string& val) { m_currency.m_mappedBlocksFileName = val; return *this; }
+  CurrencyBuilder& mappedBlockIndexesFileName(const std::string& val) { m_currency.m_mappedBlockIndexesFileName = val; return *this; }
   CurrencyBuilder& txPoolFileName(const std::string& val) { m_currency.m_txPoolFileName = val; return *this; }
 
   CurrencyBuilder& isBlockexplorer(const bool val) { m_currency.m_isBlockexplorer = val; return *this; }
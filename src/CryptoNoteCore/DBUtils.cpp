@@ -17,6 +17,8 @@
 
 #include "DBUtils.h"
 
+#include <algorithm>
+
 namespace {
   const std::string RAW_BLOCK_NAME = "raw_block";
   const std::string RAW_TXS_NAME = "raw_txs";
@@ -35,6 +37,20 @@ namespace DB {
     return ss.str();
   }
 
+  std::string serializeOrderedKey(const std::string& keyPrefix, uint64_t key) {
+    std::string orderedKey(sizeof(key), '\0');
+    for (size_t i = 0; i < sizeof(key); ++i) {
+      orderedKey[i] = static_cast<char>(key >> (8 * (sizeof(key) - 1 - i)));
+    }
+
+    return serializeKey(keyPrefix, orderedKey);
+  }
+
+  std::string getCommonKeyStart(const std::string& firstKey, const std::string& secondKey) {
+    auto mismatch = std::mismatch(firstKey.begin(), firstKey.end(), secondKey.begin(), secondKey.end());
+    return std::string(firstKey.begin(), mismatch.first);
+  }
+
   void deserialize(const std::string& serialized, RawBlock& value, const std::string& name) {
     std::stringstream ss(serialized);
     Common::StdInputStream stream(ss);
@@ -85,11 +85,15 @@ namespace DB {
     return DB::serialize(std::make_pair(keyPrefix, key), keyPrefix);
   }
 
+  //Integer keys are serialized little endian, so they don't sort by value. This keys them by a big endian string instead
+  std::string serializeOrderedKey(const std::string& keyPrefix, uint64_t key);
+
+  //The bytes both keys start with, e.g. every key of a payment id for (paymentId, 0) and (paymentId, UINT32_MAX)
+  std::string getCommonKeyStart(const std::string& firstKey, const std::string& secondKey);
+
   template <class Value>
   void deserialize(const std::string& serialized, Value& value, const std::string& name) {
-    std::stringstream ss(serialized);
-    Common::StdInputStream stream(ss);
-    CryptoNote::KVBinaryInputStreamSerializer serializer(stream);
+    CryptoNote::KVBinaryInputStreamSerializer serializer(serialized.data(), serialized.size());
     serializer(value, name);
   }
 
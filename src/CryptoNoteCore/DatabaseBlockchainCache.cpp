@@ -11,9 +11,11 @@
 
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <Common/Math.h>
 #include <Common/ShuffleGenerator.h>
 
 #include "BlockchainUtils.h"
+#include "DBUtils.h"
 
 #include "crypto/hash.h"
 
@@ -415,7 +417,99 @@ private:
   uint32_t schemeVersion;
 };
 
-const uint32_t CURRENT_DB_SCHEME_VERSION = 2;
+class RawDataWriteBatch: public IWriteBatch {
+public:
+  virtual ~RawDataWriteBatch() {}
+
+  virtual std::vector<std::pair<std::string, std::string> > extractRawDataToInsert() override {
+    return std::move(rawDataToInsert);
+  }
+
+  virtual std::vector<std::string> extractRawKeysToRemove() override {
+    return std::move(rawKeysToRemove);
+  }
+
+  std::vector<std::pair<std::string, std::string> > rawDataToInsert;
+  std::vector<std::string> rawKeysToRemove;
+};
+
+//Reads raw blocks into a vector in height order, up to the first missing one
+class RawBlocksReadBatch: public IReadBatch {
+public:
+  RawBlocksReadBatch(uint64_t startHeight, uint64_t endHeight): startHeight(startHeight), endHeight(std::max(startHeight, endHeight)) {}
+  virtual ~RawBlocksReadBatch() {}
+
+  virtual std::vector<std::string> getRawKeys() const override {
+    std::vector<std::string> rawKeys;
+    rawKeys.reserve(endHeight - startHeight);
+    for (uint64_t height = startHeight; height < endHeight; ++height) {
+      rawKeys.emplace_back(DB::serializeKey(DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX, static_cast<uint32_t>(height)));
+    }
+
+    return rawKeys;
+  }
+
+  virtual void submitRawResult(const std::vector<std::string>& values, const std::vector<bool>& resultStates) override {
+    assert(resultStates.size() == values.size());
+
+    size_t count = std::find(resultStates.begin(), resultStates.end(), false) - resultStates.begin();
+    rawBlocks.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      DB::deserialize(values[i], rawBlocks[i], DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX);
+    }
+  }
+
+  std::vector<RawBlock> extractRawBlocks() {
+    return std::move(rawBlocks);
+  }
+
+private:
+  uint64_t startHeight;
+  uint64_t endHeight;
+  std::vector<RawBlock> rawBlocks;
+};
+
+//Version 2 keyed timestamps by little endian integers, which can't be iterated in time order. It is rekeyed in place
+const uint32_t INTEGER_TIMESTAMPS_DB_SCHEME_VERSION = 2;
+const uint32_t CURRENT_DB_SCHEME_VERSION = 3;
+
+const size_t TIMESTAMP_REKEY_BATCH_SIZE = 10000;
+
+void rekeyTimestamps(IDataBase& database, Logging::LoggerRef& logger) {
+  logger(Logging::INFO) << "Upgrading DB scheme, rekeying block timestamps...";
+
+  const std::string integerKeyStart = DB::getCommonKeyStart(
+    DB::serializeKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, uint64_t(0)),
+    DB::serializeKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, std::numeric_limits<uint64_t>::max()));
+
+  //The old and new keys are moved in the same batch, so an interrupted upgrade continues where it stopped
+  RawDataWriteBatch batch;
+  std::error_code error;
+  auto flush = [&database, &batch, &error]() {
+    error = database.write(batch);
+    batch.rawDataToInsert.clear();
+    batch.rawKeysToRemove.clear();
+    return !error;
+  };
+
+  auto iterateError = database.iteratePrefix(integerKeyStart, [&](const std::string& rawKey, const std::string& rawValue) {
+    std::pair<std::string, uint64_t> key;
+    DB::deserialize(rawKey, key, DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX);
+
+    batch.rawDataToInsert.emplace_back(DB::serializeOrderedKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, key.second), rawValue);
+    batch.rawKeysToRemove.push_back(rawKey);
+    return batch.rawKeysToRemove.size() < TIMESTAMP_REKEY_BATCH_SIZE || flush();
+  });
+
+  if (!iterateError && !error) {
+    flush();
+  }
+
+  if (iterateError || error) {
+    logger(Logging::ERROR) << "Failed to rekey block timestamps";
+    throw std::system_error(iterateError ? iterateError : error);
+  }
+}
 
 }
 
@@ -426,7 +520,9 @@ struct DatabaseBlockchainCache::ExtendedPushedBlockInfo {
 
 
 DatabaseBlockchainCache::DatabaseBlockchainCache(const Currency& curr, IDataBase& dataBase, IBlockchainCacheFactory& blockchainCacheFactory, std::shared_ptr<Logging::ILogger> _logger)
-    : currency(curr), database(dataBase), blockchainCacheFactory(blockchainCacheFactory), logger(_logger, "DatabaseBlockchainCache") {
+    : currency(curr), database(dataBase), blockchainCacheFactory(blockchainCacheFactory), logger(_logger, "DatabaseBlockchainCache"),
+      unitsCacheSize(std::max<size_t>({1000, parameters::DIFFICULTY_BLOCKS_COUNT_V3, curr.difficultyBlocksCount()})),
+      lastBlocksSizes(curr.rewardBlocksWindow()), nextBlockDifficulty(0) {
   DatabaseVersionReadBatch readBatch;
   auto ec = database.read(readBatch);
   if (ec) {
@@ -444,12 +540,24 @@ DatabaseBlockchainCache::DatabaseBlockchainCache(const Currency& curr, IDataBase
     }
   } else {
     logger(Logging::DEBUGGING) << "Current db scheme version: " << *version;
+
+    if (*version == INTEGER_TIMESTAMPS_DB_SCHEME_VERSION) {
+      rekeyTimestamps(database, logger);
+
+      DatabaseVersionWriteBatch writeBatch(CURRENT_DB_SCHEME_VERSION);
+      auto writeError = database.write(writeBatch);
+      if (writeError) {
+        throw std::system_error(writeError);
+      }
+    }
   }
 
   if (getTopBlockIndex() == 0) {
     logger(Logging::DEBUGGING) << "top block index is nill, add genesis block";
     addGenesisBlock(CachedBlock (currency.genesisBlock()));
   }
+
+  resetTopBlockState();
 }
 
 bool DatabaseBlockchainCache::checkDBSchemeVersion(IDataBase& database, std::shared_ptr<Logging::ILogger> _logger) {
@@ -465,7 +573,7 @@ bool DatabaseBlockchainCache::checkDBSchemeVersion(IDataBase& database, std::sha
   if (!version) {
     //DB scheme version not found. Looks like it was just created.
     return true;
-  } else if (*version < CURRENT_DB_SCHEME_VERSION) {
+  } else if (*version < INTEGER_TIMESTAMPS_DB_SCHEME_VERSION) {
     logger(Logging::WARNING) << "DB scheme version is less than expected. Expected version " << CURRENT_DB_SCHEME_VERSION << ". Actual version " << *version << ". DB will be destroyed and recreated from blocks.bin file.";
     return false;
   } else if (*version > CURRENT_DB_SCHEME_VERSION) {
@@ -583,6 +691,12 @@ std::unique_ptr<IBlockchainCache> DatabaseBlockchainCache::split(uint32_t splitB
   topBlockHash = boost::none;
   transactionsCount = boost::none;
 
+  /* Read them again now, while the core is locked for writing, so reads
+     from other threads never have to fill them in */
+  getTopBlockHash();
+  getCachedTransactionsCount();
+  resetTopBlockState();
+
   logger(Logging::DEBUGGING) << "split completed";
   // return new cache
   return cache;
@@ -663,7 +777,7 @@ void DatabaseBlockchainCache::requestDeletePaymentId(BlockchainWriteBatch& write
   assert(count >= toDelete);
 
   logger(Logging::DEBUGGING) << "Deleting last " << toDelete << " transaction hashes of payment id " << paymentId;
-  writeBatch.removePaymentId(paymentId, static_cast<uint32_t>(count - toDelete));
+  writeBatch.removePaymentId(paymentId, static_cast<uint32_t>(toDelete), static_cast<uint32_t>(count - toDelete));
 }
 
 void DatabaseBlockchainCache::requestDeleteSpentOutputs(BlockchainWriteBatch& writeBatch, uint32_t blockIndex, const TransactionValidatorState& spentOutputs) {
@@ -733,9 +847,12 @@ void DatabaseBlockchainCache::requestRemoveTimestamp(BlockchainWriteBatch& batch
 void DatabaseBlockchainCache::pushTransaction(const CachedTransaction& cachedTransaction,
                                               uint32_t blockIndex,
                                               uint16_t transactionBlockIndex,
-                                              BlockchainWriteBatch& batch) {
+                                              BlockchainWriteBatch& batch,
+                                              std::unordered_map<Crypto::Hash, uint32_t>& paymentIdCounts) {
 
-  logger(Logging::DEBUGGING) << "push transaction with hash " << cachedTransaction.getTransactionHash();
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "push transaction with hash " << cachedTransaction.getTransactionHash();
+  });
   const auto& tx = cachedTransaction.getTransaction();
 
   ExtendedTransactionInfo transactionCacheInfo;
@@ -796,12 +913,14 @@ void DatabaseBlockchainCache::pushTransaction(const CachedTransaction& cachedTra
 
   Crypto::Hash paymentId;
   if (getPaymentIdFromTxExtra(cachedTransaction.getTransaction().extra, paymentId)) {
-    insertPaymentId(batch, cachedTransaction.getTransactionHash(), paymentId);
+    insertPaymentId(batch, cachedTransaction.getTransactionHash(), paymentId, paymentIdCounts);
   }
 
   batch.insertCachedTransaction(transactionCacheInfo, getCachedTransactionsCount() + 1);
   transactionsCount = *transactionsCount + 1;
-  logger(Logging::DEBUGGING) << "push transaction with hash " << cachedTransaction.getTransactionHash() << " finished";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "push transaction with hash " << cachedTransaction.getTransactionHash() << " finished";
+  });
 }
 
 uint32_t DatabaseBlockchainCache::updateKeyOutputCount(Amount amount, int32_t diff) const {
@@ -834,18 +953,24 @@ uint32_t DatabaseBlockchainCache::updateKeyOutputCount(Amount amount, int32_t di
   return it->second;
 }
 
-void DatabaseBlockchainCache::insertPaymentId(BlockchainWriteBatch& batch, const Crypto::Hash& transactionHash, const Crypto::Hash& paymentId) {
-  BlockchainReadBatch readBatch;
-  uint32_t count = 0;
+void DatabaseBlockchainCache::insertPaymentId(BlockchainWriteBatch& batch, const Crypto::Hash& transactionHash, const Crypto::Hash& paymentId,
+                                              std::unordered_map<Crypto::Hash, uint32_t>& paymentIdCounts) {
+  auto it = paymentIdCounts.find(paymentId);
+  if (it == paymentIdCounts.end()) {
+    BlockchainReadBatch readBatch;
+    uint32_t count = 0;
 
-  auto readResult = readDatabase(readBatch.requestTransactionCountByPaymentId(paymentId));
-  if (readResult.getTransactionCountByPaymentIds().count(paymentId) != 0) {
-    count = readResult.getTransactionCountByPaymentIds().at(paymentId);
+    auto readResult = readDatabase(readBatch.requestTransactionCountByPaymentId(paymentId));
+    if (readResult.getTransactionCountByPaymentIds().count(paymentId) != 0) {
+      count = readResult.getTransactionCountByPaymentIds().at(paymentId);
+    }
+
+    it = paymentIdCounts.emplace(paymentId, count).first;
   }
 
-  count += 1;
+  it->second += 1;
 
-  batch.insertPaymentId(transactionHash, paymentId, count);
+  batch.insertPaymentId(transactionHash, paymentId, it->second);
 }
 
 void DatabaseBlockchainCache::insertBlockTimestamp(BlockchainWriteBatch& batch, uint64_t timestamp, const Crypto::Hash& blockHash) {
@@ -869,8 +994,10 @@ void DatabaseBlockchainCache::pushBlock(const CachedBlock& cachedBlock,
                                         const TransactionValidatorState& validatorState, size_t blockSize,
                                         uint64_t generatedCoins, uint64_t blockDifficulty, RawBlock&& rawBlock) {
   BlockchainWriteBatch batch;
-  logger(Logging::DEBUGGING) << "push block with hash " << cachedBlock.getBlockHash() << ", and "
-                             << cachedTransactions.size() + 1 << " transactions"; //+1 for base transaction
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "push block with hash " << cachedBlock.getBlockHash() << ", and "
+            << cachedTransactions.size() + 1 << " transactions"; //+1 for base transaction
+  });
 
   // TODO: cache top block difficulty, size, timestamp, coins; use it here
   auto lastBlockInfo = getCachedBlockInfo(getTopBlockIndex());
@@ -898,11 +1025,14 @@ void DatabaseBlockchainCache::pushBlock(const CachedBlock& cachedBlock,
   batch.insertCachedBlock(blockInfo, getTopBlockIndex() + 1, txHashes);
   batch.insertRawBlock(getTopBlockIndex() + 1, std::move(rawBlock));
 
+  //Transactions of the same block can share a payment id
+  std::unordered_map<Crypto::Hash, uint32_t> paymentIdCounts;
+
   auto transactionIndex = 0;
-  pushTransaction(cachedBaseTransaction, getTopBlockIndex() + 1, transactionIndex++, batch);
+  pushTransaction(cachedBaseTransaction, getTopBlockIndex() + 1, transactionIndex++, batch, paymentIdCounts);
 
   for (const auto& transaction: cachedTransactions) {
-    pushTransaction(transaction, getTopBlockIndex() + 1, transactionIndex++, batch);
+    pushTransaction(transaction, getTopBlockIndex() + 1, transactionIndex++, batch, paymentIdCounts);
   }
 
   auto closestBlockIndexDb = requestClosestBlockIndexByTimestamp(roundToMidnight(cachedBlock.getBlock().timestamp), database);
@@ -925,12 +1055,17 @@ void DatabaseBlockchainCache::pushBlock(const CachedBlock& cachedBlock,
 
   topBlockIndex = *topBlockIndex + 1;
   topBlockHash = cachedBlock.getBlockHash();
-  logger(Logging::DEBUGGING) << "push block " << cachedBlock.getBlockHash() << " completed";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "push block " << cachedBlock.getBlockHash() << " completed";
+  });
 
   unitsCache.push_back(blockInfo);
   if (unitsCache.size() > unitsCacheSize) {
     unitsCache.pop_front();
   }
+
+  lastBlocksSizes.push(blockInfo.blockSize);
+  nextBlockDifficulty = calculateDifficultyForNextBlock(getTopBlockIndex());
 }
 
 PushedBlockInfo DatabaseBlockchainCache::getPushedBlockInfo(uint32_t blockIndex) const {
@@ -1119,6 +1254,15 @@ std::vector<uint64_t> DatabaseBlockchainCache::getLastBlocksSizes(size_t count,
   return getLastUnits(count, blockIndex, useGenesis, [](const CachedBlockInfo& cb) { return cb.blockSize; });
 }
 
+uint64_t DatabaseBlockchainCache::getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis useGenesis) const {
+  if (count == currency.rewardBlocksWindow() && blockIndex == getTopBlockIndex() && useGenesis) {
+    return lastBlocksSizes.median();
+  }
+
+  auto sizes = getLastBlocksSizes(count, blockIndex, useGenesis);
+  return Common::medianValue(sizes);
+}
+
 std::vector<uint64_t> DatabaseBlockchainCache::getLastCumulativeDifficulties(size_t count, uint32_t blockIndex,
                                                                                UseGenesis useGenesis) const {
   return getLastUnits(count, blockIndex, useGenesis,
@@ -1134,6 +1278,14 @@ uint64_t DatabaseBlockchainCache::getDifficultyForNextBlock() const {
 
 uint64_t DatabaseBlockchainCache::getDifficultyForNextBlock(uint32_t blockIndex) const {
   assert(blockIndex <= getTopBlockIndex());
+  if (blockIndex == getTopBlockIndex()) {
+    return nextBlockDifficulty;
+  }
+
+  return calculateDifficultyForNextBlock(blockIndex);
+}
+
+uint64_t DatabaseBlockchainCache::calculateDifficultyForNextBlock(uint32_t blockIndex) const {
   uint8_t nextBlockMajorVersion = getBlockMajorVersionForHeight(blockIndex+1);
   auto timestamps = getLastTimestamps(currency.difficultyBlocksCountByBlockVersion(nextBlockMajorVersion, blockIndex), blockIndex, UseGenesis{false});
   auto commulativeDifficulties =
@@ -1202,6 +1354,27 @@ std::vector<CachedBlockInfo> DatabaseBlockchainCache::getLastCachedUnits(uint32_
   return cachedResult;
 }
 
+/* Reads the units the cache is short of after loading or a split, and the
+   state derived from them. Called only while the core is locked for
+   writing. */
+void DatabaseBlockchainCache::resetTopBlockState() {
+  const uint32_t topIndex = getTopBlockIndex();
+  const size_t unitsCount = std::min(unitsCacheSize, static_cast<size_t>(topIndex) + 1);
+
+  if (unitsCache.size() < unitsCount) {
+    const uint32_t firstCachedIndex = topIndex + 1 - static_cast<uint32_t>(unitsCache.size());
+    auto units = getLastDbUnits(firstCachedIndex - 1, unitsCount - unitsCache.size(), UseGenesis{true});
+    unitsCache.insert(unitsCache.begin(), units.begin(), units.end());
+  }
+
+  lastBlocksSizes.clear();
+  for (uint64_t size : getLastBlocksSizes(currency.rewardBlocksWindow(), topIndex, UseGenesis{true})) {
+    lastBlocksSizes.push(size);
+  }
+
+  nextBlockDifficulty = calculateDifficultyForNextBlock(topIndex);
+}
+
 std::vector<CachedBlockInfo> DatabaseBlockchainCache::getLastDbUnits(uint32_t blockIndex, size_t count, UseGenesis useGenesis) const {
   uint32_t readFrom = blockIndex + 1 - std::min(blockIndex + 1, static_cast<uint32_t>(count));
   if (readFrom == 0 && !useGenesis) {
@@ -1428,6 +1601,18 @@ void DatabaseBlockchainCache::save() {
 void DatabaseBlockchainCache::load() {
 }
 
+void DatabaseBlockchainCache::beginBatch() {
+  database.beginBatch();
+}
+
+void DatabaseBlockchainCache::commitBatch() {
+  auto error = database.commitBatch();
+  if (error) {
+    logger(Logging::ERROR) << "commit batch write failed: " << error.message();
+    throw std::runtime_error(error.message());
+  }
+}
+
 std::vector<BinaryArray>
 DatabaseBlockchainCache::getRawTransactions(const std::vector<Crypto::Hash>& transactions,
                                             std::vector<Crypto::Hash>& missedTransactions) const {
@@ -1590,19 +1775,49 @@ ExtractOutputKeysResult DatabaseBlockchainCache::extractKeyOutputs(
 }
 
 std::vector<Crypto::Hash> DatabaseBlockchainCache::getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) const {
-  auto countBatch = BlockchainReadBatch().requestTransactionCountByPaymentId(paymentId);
-  uint32_t transactionsCountByPaymentId = readDatabase(countBatch).getTransactionCountByPaymentIds().at(paymentId);
+  //Every (paymentId, index) key starts with the same bytes, which the count key of the payment id doesn't
+  const std::string keyStart = DB::getCommonKeyStart(
+    DB::serializeKey(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, uint32_t(0))),
+    DB::serializeKey(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, std::numeric_limits<uint32_t>::max())));
 
-  BlockchainReadBatch transactionBatch;
-  for (uint32_t i = 0; i < transactionsCountByPaymentId; ++i) {
-    transactionBatch.requestTransactionHashByPaymentId(paymentId, i);
+  //Splits used to remove just one of the hashes they dropped, so older databases can have stale ones past the count
+  const size_t count = requestPaymentIdTransactionsCount(database, paymentId);
+  if (count == 0) {
+    return {};
   }
 
-  auto result = readDatabase(transactionBatch);
+  std::vector<std::pair<uint32_t, Crypto::Hash>> indexedHashes;
+  indexedHashes.reserve(count);
+
+  auto error = database.iteratePrefix(keyStart, [&indexedHashes, count](const std::string& rawKey, const std::string& rawValue) {
+    std::pair<std::string, std::pair<Crypto::Hash, uint32_t>> key;
+    DB::deserialize(rawKey, key, DB::PAYMENT_ID_TO_TX_HASH_PREFIX);
+
+    if (key.second.second >= count) {
+      return true;
+    }
+
+    Crypto::Hash transactionHash;
+    DB::deserialize(rawValue, transactionHash, DB::PAYMENT_ID_TO_TX_HASH_PREFIX);
+
+    indexedHashes.emplace_back(key.second.second, transactionHash);
+    return true;
+  });
+
+  if (error) {
+    logger(Logging::ERROR) << "Failed to read transactions by payment id: " << error.message();
+    throw std::system_error(error);
+  }
+
+  //The indexes are little endian in the keys, so they don't come in order
+  std::sort(indexedHashes.begin(), indexedHashes.end(), [](const std::pair<uint32_t, Crypto::Hash>& lhs, const std::pair<uint32_t, Crypto::Hash>& rhs) {
+    return lhs.first < rhs.first;
+  });
+
   std::vector<Crypto::Hash> transactionHashes;
-  transactionHashes.reserve(result.getTransactionHashesByPaymentIds().size());
-  for(const auto& kv: result.getTransactionHashesByPaymentIds()) {
-    transactionHashes.emplace_back(kv.second);
+  transactionHashes.reserve(indexedHashes.size());
+  for (const auto& indexedHash : indexedHashes) {
+    transactionHashes.emplace_back(indexedHash.second);
   }
 
   return transactionHashes;
@@ -1614,19 +1829,20 @@ std::vector<Crypto::Hash> DatabaseBlockchainCache::getBlockHashesByTimestamps(ui
     return blockHashes;
   }
 
-  BlockchainReadBatch batch;
-  for (uint64_t timestamp = timestampBegin; timestamp < timestampBegin + static_cast<uint64_t>(secondsCount); ++timestamp) {
-    batch.requestBlockHashesByTimestamp(timestamp);
-  }
+  const std::string beginKey = DB::serializeOrderedKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, timestampBegin);
+  const std::string endKey = DB::serializeOrderedKey(DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, timestampBegin + static_cast<uint64_t>(secondsCount));
 
-  auto result = readDatabase(batch);
-  for (uint64_t timestamp = timestampBegin; timestamp < timestampBegin + static_cast<uint64_t>(secondsCount); ++timestamp) {
-    if (result.getBlockHashesByTimestamp().count(timestamp) == 0) {
-      continue;
-    }
+  auto error = database.iterate(beginKey, endKey, [&blockHashes](const std::string& rawKey, const std::string& rawValue) {
+    std::vector<Crypto::Hash> hashes;
+    DB::deserialize(rawValue, hashes, DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX);
 
-    const auto& hashes = result.getBlockHashesByTimestamp().at(timestamp);
     blockHashes.insert(blockHashes.end(), hashes.begin(), hashes.end());
+    return true;
+  });
+
+  if (error) {
+    logger(Logging::ERROR) << "Failed to read block hashes by timestamps: " << error.message();
+    throw std::system_error(error);
   }
 
   return blockHashes;
@@ -1635,20 +1851,16 @@ std::vector<Crypto::Hash> DatabaseBlockchainCache::getBlockHashesByTimestamps(ui
 std::vector<RawBlock> DatabaseBlockchainCache::getBlocksByHeight(
     const uint64_t startHeight, uint64_t endHeight) const
 {
-    auto blockBatch = BlockchainReadBatch().requestRawBlocks(startHeight, endHeight);
-
-    /* Get the info from the DB */
-    auto rawBlocks = readDatabase(blockBatch).getRawBlocks();
-
-    std::vector<RawBlock> orderedBlocks;
+    RawBlocksReadBatch blockBatch(startHeight, endHeight);
 
-    /* Order, and convert from map, to vector */
-    for (uint64_t height = startHeight; height < startHeight + rawBlocks.size(); height++)
+    auto error = database.read(blockBatch);
+    if (error)
     {
-        orderedBlocks.push_back(rawBlocks.at(height));
+        logger(Logging::ERROR) << "Failed to read blocks by height: " << error.message();
+        throw std::system_error(error);
     }
 
-    return orderedBlocks;
+    return blockBatch.extractRawBlocks();
 }
 
 std::unordered_map<Crypto::Hash, std::vector<uint64_t>> DatabaseBlockchainCache::getGlobalIndexes(
@@ -1748,7 +1960,8 @@ void DatabaseBlockchainCache::addGenesisBlock(CachedBlock&& genesisBlock) {
   auto baseTransaction = genesisBlock.getBlock().baseTransaction;
   auto cachedBaseTransaction = CachedTransaction{std::move(baseTransaction)};
 
-  pushTransaction(cachedBaseTransaction, 0, 0, batch);
+  std::unordered_map<Crypto::Hash, uint32_t> paymentIdCounts;
+  pushTransaction(cachedBaseTransaction, 0, 0, batch, paymentIdCounts);
 
   batch.insertCachedBlock(blockInfo, 0, {cachedBaseTransaction.getTransactionHash()});
   batch.insertRawBlock(0, {toBinaryArray(genesisBlock.getBlock()), {}});
@@ -17,12 +17,14 @@
 
 #pragma once
 
+#include "Common/SlidingWindowMedian.h"
 #include "Common/StringView.h"
 #include "Currency.h"
 #include "IBlockchainCache.h"
 #include "CryptoNoteCore/UpgradeManager.h"
 #include <IDataBase.h>
 #include <CryptoNoteCore/BlockchainReadBatch.h>
+#include <CryptoNoteCore/BufferedDataBase.h>
 #include <CryptoNoteCore/BlockchainWriteBatch.h>
 #include <CryptoNoteCore/DatabaseCacheData.h>
 #include <CryptoNoteCore/IBlockchainCacheFactory.h>
@@ -91,6 +93,7 @@ public:
 
   std::vector<uint64_t> getLastBlocksSizes(size_t count) const override;
   std::vector<uint64_t> getLastBlocksSizes(size_t count, uint32_t blockIndex, UseGenesis) const override;
+  uint64_t getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis) const override;
 
   std::vector<uint64_t> getLastCumulativeDifficulties(size_t count, uint32_t blockIndex, UseGenesis) const override;
   std::vector<uint64_t> getLastCumulativeDifficulties(size_t count) const override;
@@ -145,6 +148,9 @@ public:
   virtual void save() override;
   virtual void load() override;
 
+  virtual void beginBatch() override;
+  virtual void commitBatch() override;
+
   virtual std::vector<BinaryArray> getRawTransactions(const std::vector<Crypto::Hash>& transactions,
                                                       std::vector<Crypto::Hash>& missedTransactions) const override;
   virtual std::vector<BinaryArray> getRawTransactions(const std::vector<Crypto::Hash>& transactions) const override;
@@ -169,7 +175,8 @@ public:
 
 private:
   const Currency& currency;
-  IDataBase& database;
+  //Const methods read through it just as they read through a reference to the database
+  mutable BufferedDataBase database;
   IBlockchainCacheFactory& blockchainCacheFactory;
   mutable boost::optional<uint32_t> topBlockIndex;
   mutable boost::optional<Crypto::Hash> topBlockHash;
@@ -178,8 +185,15 @@ private:
   mutable std::unordered_map<Amount, int32_t> keyOutputCountsForAmounts;
   std::vector<IBlockchainCache*> children;
   Logging::LoggerRef logger;
+  /* Enough of the last blocks for any difficulty window, so neither the
+     difficulty nor the medians have to be read from the database */
   std::deque<CachedBlockInfo> unitsCache;
-  const size_t unitsCacheSize = 1000;
+  const size_t unitsCacheSize;
+
+  /* Sizes of the reward window ending at the top block, and the difficulty
+     of the block after it, updated as blocks are pushed */
+  Common::SlidingWindowMedian<uint64_t> lastBlocksSizes;
+  uint64_t nextBlockDifficulty;
 
   struct ExtendedPushedBlockInfo;
   ExtendedPushedBlockInfo getExtendedPushedBlockInfo(uint32_t blockIndex) const;
@@ -192,11 +206,14 @@ private:
   void pushTransaction(const CachedTransaction& cachedTransaction,
                        uint32_t blockIndex,
                        uint16_t transactionBlockIndex,
-                       BlockchainWriteBatch& batch);
+                       BlockchainWriteBatch& batch,
+                       std::unordered_map<Crypto::Hash, uint32_t>& paymentIdCounts);
 
   uint32_t insertKeyOutputToGlobalIndex(uint64_t amount, PackedOutIndex output); //TODO not implemented. Should it be removed?
   uint32_t updateKeyOutputCount(Amount amount, int32_t diff) const;
-  void insertPaymentId(BlockchainWriteBatch& batch, const Crypto::Hash& transactionHash, const Crypto::Hash& paymentId);
+  //paymentIdCounts holds the counts of the payment ids already in the batch, which the database doesn't have yet
+  void insertPaymentId(BlockchainWriteBatch& batch, const Crypto::Hash& transactionHash, const Crypto::Hash& paymentId,
+                       std::unordered_map<Crypto::Hash, uint32_t>& paymentIdCounts);
   void insertBlockTimestamp(BlockchainWriteBatch& batch, uint64_t timestamp, const Crypto::Hash& blockHash);
 
   void addGenesisBlock(CachedBlock&& genesisBlock);
@@ -220,5 +237,8 @@ uint8_t getBlockMajorVersionForHeight(uint32_t height) const;
 
   std::vector<CachedBlockInfo> getLastCachedUnits(uint32_t blockIndex, size_t count, UseGenesis useGenesis) const;
   std::vector<CachedBlockInfo> getLastDbUnits(uint32_t blockIndex, size_t count, UseGenesis useGenesis) const;
+
+  void resetTopBlockState();
+  uint64_t calculateDifficultyForNextBlock(uint32_t blockIndex) const;
 };
 }
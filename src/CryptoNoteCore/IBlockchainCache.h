@@ -124,6 +124,9 @@ public:
 
   virtual std::vector<uint64_t> getLastBlocksSizes(size_t count) const = 0;
   virtual std::vector<uint64_t> getLastBlocksSizes(size_t count, uint32_t blockIndex, UseGenesis) const = 0;
+  /* The median of getLastBlocksSizes(), kept up to date for the reward
+     window ending at the top block */
+  virtual uint64_t getLastBlocksSizesMedian(size_t count, uint32_t blockIndex, UseGenesis) const = 0;
 
   virtual std::vector<uint64_t> getLastCumulativeDifficulties(size_t count, uint32_t blockIndex, UseGenesis) const = 0;
   virtual std::vector<uint64_t> getLastCumulativeDifficulties(size_t count) const = 0;
@@ -176,6 +179,12 @@ public:
   virtual void save() = 0;
   virtual void load() = 0;
 
+  /* Writes to the storage behind the cache may be held back until the
+     matching commitBatch(), so the blocks pushed in between are committed
+     together. Batches may nest. */
+  virtual void beginBatch() = 0;
+  virtual void commitBatch() = 0;
+
   virtual std::vector<uint64_t> getLastUnits(size_t count, uint32_t blockIndex, UseGenesis use,
                                              std::function<uint64_t(const CachedBlockInfo&)> pred) const = 0;
   virtual std::vector<Crypto::Hash> getTransactionHashes() const = 0;
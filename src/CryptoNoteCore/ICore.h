@@ -90,6 +90,26 @@ public:
   virtual std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock) = 0;
   virtual std::error_code addBlock(RawBlock&& rawBlock) = 0;
 
+  /*!
+   * \brief Does the parts of adding a block which don't depend on the chain state -
+   * parsing the transactions and computing the proof of work hash (which is cached in
+   * cachedBlock). Doesn't touch the core, so can be run on other threads, ahead of
+   * addBlock() being called with the prepared transactions.
+   * \return false if the block couldn't be prepared. Call the plain addBlock() to get the error.
+   */
+  virtual bool prepareBlock(const CachedBlock& cachedBlock, const RawBlock& rawBlock,
+                            std::vector<CachedTransaction>& transactions) const = 0;
+  virtual std::error_code addBlock(const CachedBlock& cachedBlock, RawBlock&& rawBlock,
+                                   std::vector<CachedTransaction>&& transactions) = 0;
+
+  /*!
+   * \brief The blocks added until the matching commitBlockBatch() are written to the database
+   * in one go, rather than one write per block. Batches may nest. If the daemon stops before
+   * the commit, the blocks are imported again from the main chain storage on the next start.
+   */
+  virtual void beginBlockBatch() = 0;
+  virtual void commitBlockBatch() = 0;
+
   virtual std::error_code submitBlock(BinaryArray&& rawBlockTemplate) = 0;
 
   virtual bool getTransactionGlobalIndexes(const Crypto::Hash& transactionHash,
@@ -31,6 +31,9 @@ public:
   virtual RawBlock getBlockByIndex(uint32_t index) const = 0;
   virtual uint32_t getBlockCount() const = 0;
 
+  /* A hint that the blocks are about to be read in order */
+  virtual void prefetchBlocks(uint32_t startIndex, uint32_t count) const = 0;
+
   virtual void clear() = 0;
 };
 
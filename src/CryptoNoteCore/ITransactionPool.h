@@ -16,6 +16,8 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
+#include <functional>
+
 #include "CachedTransaction.h"
 
 namespace CryptoNote {
@@ -37,6 +39,11 @@ public:
   virtual const TransactionValidatorState& getPoolTransactionValidationState() const = 0;
   virtual std::vector<CachedTransaction> getPoolTransactions() const = 0;
 
+  //Visits the transactions from the highest fee per byte down without copying them. Returning false stops the visit, the visitor must not change the pool
+  virtual void forEachTransactionByFee(const std::function<bool(const CachedTransaction&)>& visitor) const = 0;
+  //The transactions spending any of the key images of the state
+  virtual std::vector<Crypto::Hash> getConflictingTransactionHashes(const TransactionValidatorState& state) const = 0;
+
   virtual uint64_t getTransactionReceiveTime(const Crypto::Hash& hash) const = 0;
   virtual std::vector<Crypto::Hash> getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) const = 0;
 };
@@ -17,51 +17,398 @@
 
 #include "MainChainStorage.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #include <boost/filesystem.hpp>
 
 #include "CryptoNoteTools.h"
+#include "SwappedVector.h"
+#include "Logging/LoggerRef.h"
 
 namespace CryptoNote {
 
-const size_t STORAGE_CACHE_SIZE = 100;
+namespace {
+
+/* Blocks never straddle segments, so this is also the largest block */
+const uint64_t SEGMENT_SIZE = 256 * 1024 * 1024;
+const size_t MAX_SEGMENTS = 4096;
+
+const size_t OFFSETS_CHUNK_SIZE = 64 * 1024;
+const size_t MAX_OFFSET_CHUNKS = (static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()) + 1) / OFFSETS_CHUNK_SIZE;
+
+/* Keeps the sizes in records aligned */
+const uint64_t RECORD_ALIGNMENT = 8;
+
+/* A multiple of the page size on every platform we run on. Segments are
+   mapped at page boundaries, so offsets rounded down to this are too. */
+const uint64_t PREFETCH_ALIGNMENT = 64 * 1024;
+
+uint64_t alignRecordSize(uint64_t size) {
+  return (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+}
+
+uint64_t getRecordSize(const RawBlock& rawBlock) {
+  uint64_t size = 2 * sizeof(uint32_t) + rawBlock.transactions.size() * sizeof(uint32_t) + rawBlock.block.size();
+  for (const auto& transaction : rawBlock.transactions) {
+    size += transaction.size();
+  }
+
+  return size;
+}
+
+void writeSize(uint8_t*& position, size_t size) {
+  const uint32_t value = static_cast<uint32_t>(size);
+  std::memcpy(position, &value, sizeof(value));
+  position += sizeof(value);
+}
+
+void writeData(uint8_t*& position, const BinaryArray& data) {
+  if (!data.empty()) {
+    std::memcpy(position, data.data(), data.size());
+    position += data.size();
+  }
+}
+
+void prefetch(const uint8_t* data, uint64_t size) {
+#ifndef _WIN32
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(data) / PREFETCH_ALIGNMENT * PREFETCH_ALIGNMENT;
+  posix_madvise(reinterpret_cast<void*>(begin), reinterpret_cast<uintptr_t>(data) + size - begin, POSIX_MADV_WILLNEED);
+#endif
+}
+
+std::string getSegmentFilename(const std::string& blocksFilename, size_t segment) {
+  return blocksFilename + "." + std::to_string(segment);
+}
+
+/* Copies the blocks out of the blocks.bin and blockindexes.bin pair that
+   SwappedVector kept them in */
+void convertSwappedStorage(const std::string& swappedBlocksFilename, const std::string& swappedIndexesFilename,
+                           IMainChainStorage& storage, Logging::LoggerRef& logger) {
+  SwappedVector<RawBlock> swappedStorage;
+  if (!swappedStorage.open(swappedBlocksFilename, swappedIndexesFilename, 1)) {
+    throw std::runtime_error("Failed to open block storage for conversion: " + swappedBlocksFilename);
+  }
+
+  const size_t blockCount = swappedStorage.size();
+  for (size_t i = 0; i < blockCount; ++i) {
+    storage.pushBlock(swappedStorage[i]);
+
+    if ((i + 1) % 100000 == 0) {
+      logger(Logging::INFO) << "Converted " << i + 1 << " of " << blockCount << " blocks";
+    }
+  }
+
+  swappedStorage.close();
+}
+
+}
+
+RawBlockView::RawBlockView(const uint8_t* record) : m_record(record) {
+}
+
+uint32_t RawBlockView::readSize(uint32_t position) const {
+  uint32_t value;
+  std::memcpy(&value, m_record + position * sizeof(uint32_t), sizeof(value));
+  return value;
+}
+
+uint32_t RawBlockView::getTransactionCount() const {
+  return readSize(0);
+}
+
+Common::ArrayView<uint8_t> RawBlockView::getBlock() const {
+  const uint32_t transactionCount = getTransactionCount();
+  const uint8_t* data = m_record + (2 + transactionCount) * sizeof(uint32_t);
+  return Common::ArrayView<uint8_t>(data, readSize(1));
+}
+
+Common::ArrayView<uint8_t> RawBlockView::getTransaction(uint32_t index) const {
+  assert(index < getTransactionCount());
 
-MainChainStorage::MainChainStorage(const std::string& blocksFilename, const std::string& indexesFilename) {
-  if (!storage.open(blocksFilename, indexesFilename, STORAGE_CACHE_SIZE)) {
-    throw std::runtime_error("Failed to load main chain storage: " + blocksFilename);
+  const uint8_t* data = getBlock().getData() + getBlock().getSize();
+  for (uint32_t i = 0; i < index; ++i) {
+    data += readSize(2 + i);
   }
+
+  return Common::ArrayView<uint8_t>(data, readSize(2 + index));
+}
+
+uint64_t RawBlockView::getRecordSize() const {
+  const uint32_t transactionCount = getTransactionCount();
+
+  uint64_t size = (2 + transactionCount) * sizeof(uint32_t) + readSize(1);
+  for (uint32_t i = 0; i < transactionCount; ++i) {
+    size += readSize(2 + i);
+  }
+
+  return size;
+}
+
+RawBlock RawBlockView::toRawBlock() const {
+  RawBlock rawBlock;
+
+  const Common::ArrayView<uint8_t> block = getBlock();
+  rawBlock.block.assign(block.getData(), block.getData() + block.getSize());
+
+  const uint32_t transactionCount = getTransactionCount();
+  rawBlock.transactions.resize(transactionCount);
+
+  const uint8_t* data = block.getData() + block.getSize();
+  for (uint32_t i = 0; i < transactionCount; ++i) {
+    const uint32_t size = readSize(2 + i);
+    rawBlock.transactions[i].assign(data, data + size);
+    data += size;
+  }
+
+  return rawBlock;
+}
+
+MainChainStorage::MainChainStorage(const std::string& blocksFilename, const std::string& indexesFilename) :
+  blocksFilename(blocksFilename), segments(MAX_SEGMENTS), offsets(MAX_OFFSET_CHUNKS), blockCount(0), end(0) {
+
+  try {
+    index.open(indexesFilename);
+  } catch (const std::exception& e) {
+    throw std::runtime_error("Failed to load main chain storage: " + indexesFilename + ", " + e.what());
+  }
+
+  /* The data isn't synced per block either, both are flushed on close */
+  index.setAutoFlush(false);
+
+  if (index.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Failed to load main chain storage: " + indexesFilename + " is corrupted");
+  }
+
+  for (uint64_t i = 0; i < index.size(); ++i) {
+    const uint64_t offset = index[i];
+    if (offset / SEGMENT_SIZE >= MAX_SEGMENTS || (i > 0 && offset <= index[i - 1])) {
+      throw std::runtime_error("Failed to load main chain storage: " + indexesFilename + " is corrupted");
+    }
+
+    if (!offsets[i / OFFSETS_CHUNK_SIZE]) {
+      offsets[i / OFFSETS_CHUNK_SIZE].reset(new uint64_t[OFFSETS_CHUNK_SIZE]);
+    }
+
+    offsets[i / OFFSETS_CHUNK_SIZE][i % OFFSETS_CHUNK_SIZE] = offset;
+  }
+
+  if (!index.empty()) {
+    const uint64_t lastOffset = index.back();
+    for (size_t segment = 0; segment <= lastOffset / SEGMENT_SIZE; ++segment) {
+      mapSegment(segment, false);
+    }
+
+    end = lastOffset + alignRecordSize(RawBlockView(getRecord(lastOffset)).getRecordSize());
+  }
+
+  blockCount = static_cast<uint32_t>(index.size());
 }
 
 MainChainStorage::~MainChainStorage() {
-  storage.close();
+  std::lock_guard<std::mutex> lock(storageMutex);
+
+  for (auto& segment : segments) {
+    if (segment) {
+      segment->flush(segment->data(), segment->size());
+    }
+  }
+
+  index.flush();
 }
 
 void MainChainStorage::pushBlock(const RawBlock& rawBlock) {
-  storage.push_back(rawBlock);
+  std::lock_guard<std::mutex> lock(storageMutex);
+
+  const uint32_t count = blockCount.load();
+  if (count == std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Main chain storage is full");
+  }
+
+  const uint64_t recordSize = getRecordSize(rawBlock);
+  if (recordSize > SEGMENT_SIZE) {
+    throw std::runtime_error("Block of " + std::to_string(recordSize) + " bytes doesn't fit in main chain storage");
+  }
+
+  uint64_t offset = end;
+  if (offset % SEGMENT_SIZE + recordSize > SEGMENT_SIZE) {
+    offset = (offset / SEGMENT_SIZE + 1) * SEGMENT_SIZE;
+  }
+
+  const size_t segment = static_cast<size_t>(offset / SEGMENT_SIZE);
+  if (segment >= MAX_SEGMENTS) {
+    throw std::runtime_error("Main chain storage is full");
+  }
+
+  if (!segments[segment]) {
+    mapSegment(segment, true);
+  }
+
+  uint8_t* position = segments[segment]->data() + offset % SEGMENT_SIZE;
+  writeSize(position, rawBlock.transactions.size());
+  writeSize(position, rawBlock.block.size());
+  for (const auto& transaction : rawBlock.transactions) {
+    writeSize(position, transaction.size());
+  }
+
+  writeData(position, rawBlock.block);
+  for (const auto& transaction : rawBlock.transactions) {
+    writeData(position, transaction);
+  }
+
+  if (!offsets[count / OFFSETS_CHUNK_SIZE]) {
+    offsets[count / OFFSETS_CHUNK_SIZE].reset(new uint64_t[OFFSETS_CHUNK_SIZE]);
+  }
+
+  offsets[count / OFFSETS_CHUNK_SIZE][count % OFFSETS_CHUNK_SIZE] = offset;
+  index.push_back(offset);
+  end = offset + alignRecordSize(recordSize);
+
+  /* Readers see the block only after everything above */
+  blockCount.store(count + 1, std::memory_order_release);
 }
 
 void MainChainStorage::popBlock() {
-  storage.pop_back();
+  std::lock_guard<std::mutex> lock(storageMutex);
+
+  const uint32_t count = blockCount.load();
+  assert(count > 0);
+
+  blockCount.store(count - 1, std::memory_order_release);
+  end = getOffset(count - 1);
+  index.pop_back();
 }
 
 RawBlock MainChainStorage::getBlockByIndex(uint32_t index) const {
-  if (index >= storage.size()) {
-    throw std::out_of_range("Block index " + std::to_string(index) + " is out of range. Blocks count: " + std::to_string(storage.size()));
+  return getBlockViewByIndex(index).toRawBlock();
+}
+
+RawBlockView MainChainStorage::getBlockViewByIndex(uint32_t index) const {
+  const uint32_t count = blockCount.load(std::memory_order_acquire);
+  if (index >= count) {
+    throw std::out_of_range("Block index " + std::to_string(index) + " is out of range. Blocks count: " + std::to_string(count));
   }
 
-  return storage[index];
+  return RawBlockView(getRecord(getOffset(index)));
 }
 
 uint32_t MainChainStorage::getBlockCount() const {
-  return static_cast<uint32_t>(storage.size());
+  return blockCount.load(std::memory_order_acquire);
+}
+
+void MainChainStorage::prefetchBlocks(uint32_t startIndex, uint32_t count) const {
+  const uint32_t storedCount = blockCount.load(std::memory_order_acquire);
+  if (startIndex >= storedCount || count == 0) {
+    return;
+  }
+
+  const uint32_t lastIndex = startIndex + std::min(count, storedCount - startIndex) - 1;
+  const uint64_t begin = getOffset(startIndex);
+  const uint64_t lastOffset = getOffset(lastIndex);
+  const uint64_t last = lastOffset + RawBlockView(getRecord(lastOffset)).getRecordSize();
+
+  /* One call per segment the blocks are in */
+  for (uint64_t offset = begin; offset < last; offset = (offset / SEGMENT_SIZE + 1) * SEGMENT_SIZE) {
+    const uint64_t segmentEnd = std::min(last, (offset / SEGMENT_SIZE + 1) * SEGMENT_SIZE);
+    prefetch(getRecord(offset), segmentEnd - offset);
+  }
 }
 
 void MainChainStorage::clear() {
-  storage.clear();
+  std::lock_guard<std::mutex> lock(storageMutex);
+
+  blockCount.store(0, std::memory_order_release);
+  index.clear();
+  end = 0;
+}
+
+const uint8_t* MainChainStorage::getRecord(uint64_t offset) const {
+  const System::MemoryMappedFile& segment = *segments[static_cast<size_t>(offset / SEGMENT_SIZE)];
+  return segment.data() + offset % SEGMENT_SIZE;
+}
+
+uint64_t MainChainStorage::getOffset(uint32_t index) const {
+  return offsets[index / OFFSETS_CHUNK_SIZE][index % OFFSETS_CHUNK_SIZE];
+}
+
+void MainChainStorage::mapSegment(size_t segment, bool create) {
+  const std::string filename = getSegmentFilename(blocksFilename, segment);
+  std::unique_ptr<System::MemoryMappedFile> file(new System::MemoryMappedFile());
+
+  std::error_code ec;
+  const bool created = create && !boost::filesystem::exists(filename);
+  if (created) {
+    file->create(filename, SEGMENT_SIZE, false, ec);
+  } else {
+    file->open(filename, ec);
+  }
+
+  if (ec) {
+    throw std::runtime_error("Failed to map main chain storage segment " + filename + ": " + ec.message());
+  }
+
+  if (file->size() != SEGMENT_SIZE) {
+    throw std::runtime_error("Main chain storage segment " + filename + " has the wrong size");
+  }
+
+  /* The file is created sparse, and blocks are copied into the mapping, so
+     running out of disk space would raise SIGBUS in the middle of a write.
+     Allocate the segment up front, so a full disk is an error instead. This
+     is also done when reopening the segment to write to, in case we were
+     stopped between creating and allocating it. */
+  if (create) {
+    file->preallocate(ec);
+    if (ec) {
+      std::error_code ignore;
+      file->close(ignore);
+      if (created) {
+        boost::system::error_code ignoreRemove;
+        boost::filesystem::remove(filename, ignoreRemove);
+      }
+
+      throw std::runtime_error("Failed to allocate main chain storage segment " + filename + ": " + ec.message());
+    }
+  }
+
+  segments[segment] = std::move(file);
 }
 
-std::unique_ptr<IMainChainStorage> createSwappedMainChainStorage(const std::string& dataDir, const Currency& currency) {
-  boost::filesystem::path blocksFilename = boost::filesystem::path(dataDir) / currency.blocksFileName();
-  boost::filesystem::path indexesFilename = boost::filesystem::path(dataDir) / currency.blockIndexesFileName();
+std::unique_ptr<IMainChainStorage> createMainChainStorage(const std::string& dataDir, const Currency& currency, std::shared_ptr<Logging::ILogger> logger) {
+  Logging::LoggerRef log(logger, "MainChainStorage");
+
+  boost::filesystem::path blocksFilename = boost::filesystem::path(dataDir) / currency.mappedBlocksFileName();
+  boost::filesystem::path indexesFilename = boost::filesystem::path(dataDir) / currency.mappedBlockIndexesFileName();
+
+  boost::filesystem::path swappedBlocksFilename = boost::filesystem::path(dataDir) / currency.blocksFileName();
+  boost::filesystem::path swappedIndexesFilename = boost::filesystem::path(dataDir) / currency.blockIndexesFileName();
+
+  /* The index is only put in place once every block has been copied, so a
+     conversion that was interrupted starts over */
+  if (!boost::filesystem::exists(indexesFilename) &&
+      boost::filesystem::exists(swappedBlocksFilename) && boost::filesystem::exists(swappedIndexesFilename)) {
+    log(Logging::INFO) << "Converting " << swappedBlocksFilename.string() << " to memory mapped block storage, this may take a while";
+
+    boost::filesystem::path convertingIndexesFilename = indexesFilename;
+    convertingIndexesFilename += ".converting";
+    boost::filesystem::remove(convertingIndexesFilename);
+
+    {
+      MainChainStorage storage(blocksFilename.string(), convertingIndexesFilename.string());
+      convertSwappedStorage(swappedBlocksFilename.string(), swappedIndexesFilename.string(), storage, log);
+    }
+
+    boost::filesystem::rename(convertingIndexesFilename, indexesFilename);
+    boost::filesystem::remove(swappedBlocksFilename);
+    boost::filesystem::remove(swappedIndexesFilename);
+
+    log(Logging::INFO) << "Block storage converted";
+  }
 
   std::unique_ptr<IMainChainStorage> storage(new MainChainStorage(blocksFilename.string(), indexesFilename.string()));
   if (storage->getBlockCount() == 0) {
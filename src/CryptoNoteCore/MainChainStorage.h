@@ -17,15 +17,53 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 #include "IMainChainStorage.h"
 #include "Currency.h"
-#include "SwappedVector.h"
+#include "Common/ArrayView.h"
+#include "Common/FileMappedVector.h"
+#include "Logging/ILogger.h"
+#include "System/MemoryMappedFile.h"
 
 namespace CryptoNote {
 
+/* A block as it is stored in the block file. The data stays in the mapped
+   file, so a view is only valid while the storage is open and the block
+   hasn't been popped. */
+class RawBlockView {
+public:
+  explicit RawBlockView(const uint8_t* record);
+
+  Common::ArrayView<uint8_t> getBlock() const;
+  uint32_t getTransactionCount() const;
+  Common::ArrayView<uint8_t> getTransaction(uint32_t index) const;
+
+  /* Bytes taken by the record, not counting alignment */
+  uint64_t getRecordSize() const;
+
+  RawBlock toRawBlock() const;
+
+private:
+  uint32_t readSize(uint32_t position) const;
+
+  const uint8_t* m_record;
+};
+
+/* Blocks are appended to a set of fixed size memory mapped segment files,
+   and their offsets to a flat index file. A record is the transaction
+   count, the block size, the transaction sizes, then the block and its
+   transactions.
+
+   Writers are serialized by storageMutex. Readers don't lock: segments are
+   never unmapped or moved while the storage is open, and a block is only
+   counted once it has been written. Popping a block a reader is still
+   using is up to the caller to prevent, as with the old storage. */
 class MainChainStorage: public IMainChainStorage {
 public:
-  MainChainStorage(const std::string& blocksFilame, const std::string& indexesFilename);
+  MainChainStorage(const std::string& blocksFilename, const std::string& indexesFilename);
   virtual ~MainChainStorage();
 
   virtual void pushBlock(const RawBlock& rawBlock) override;
@@ -34,12 +72,35 @@ public:
   virtual RawBlock getBlockByIndex(uint32_t index) const override;
   virtual uint32_t getBlockCount() const override;
 
+  virtual void prefetchBlocks(uint32_t startIndex, uint32_t count) const override;
+
   virtual void clear() override;
 
+  RawBlockView getBlockViewByIndex(uint32_t index) const;
+
 private:
-  mutable SwappedVector<RawBlock> storage;
+  const uint8_t* getRecord(uint64_t offset) const;
+  uint64_t getOffset(uint32_t index) const;
+  void mapSegment(size_t segment, bool create);
+
+  std::string blocksFilename;
+
+  /* Taken by writers only */
+  mutable std::mutex storageMutex;
+
+  /* Segments and offset chunks are only ever added, the tables have their
+     final size from the start, so readers can index them while a writer
+     appends */
+  std::vector<std::unique_ptr<System::MemoryMappedFile>> segments;
+  std::vector<std::unique_ptr<uint64_t[]>> offsets;
+  std::atomic<uint32_t> blockCount;
+
+  /* Where the next record goes */
+  uint64_t end;
+
+  Common::FileMappedVector<uint64_t> index;
 };
 
-std::unique_ptr<IMainChainStorage> createSwappedMainChainStorage(const std::string& dataDir, const Currency& currency);
+std::unique_ptr<IMainChainStorage> createMainChainStorage(const std::string& dataDir, const Currency& currency, std::shared_ptr<Logging::ILogger> logger);
 
 }
@@ -17,12 +17,17 @@
 
 #include "RocksDBWrapper.h"
 
+#include <algorithm>
+
 #include "rocksdb/cache.h"
+#include "rocksdb/convenience.h"
+#include "rocksdb/filter_policy.h"
 #include "rocksdb/table.h"
 #include "rocksdb/db.h"
 #include "rocksdb/utilities/backupable_db.h"
 
 #include "DataBaseErrors.h"
+#include "DBUtils.h"
 
 using namespace CryptoNote;
 using namespace Logging;
@@ -30,6 +35,63 @@ using namespace Logging;
 namespace {
   const std::string DB_NAME = "DB";
   const std::string TESTNET_DB_NAME = "testnet_DB";
+
+  //Stored in the default family once every prefix has its own column family
+  const std::string COLUMN_FAMILY_LAYOUT_KEY = "db_column_family_layout";
+
+  const size_t MIGRATION_BATCH_SIZE = 64 * 1024 * 1024;
+
+  const int BLOOM_FILTER_BITS_PER_KEY = 10;
+
+  struct ColumnFamilyInfo {
+    std::string name;
+    std::string prefix;
+    bool bloomFilter;
+  };
+
+  const std::string RAW_BLOCK_FAMILY_NAME = "raw_blocks";
+
+  const std::vector<ColumnFamilyInfo>& getColumnFamilyLayout() {
+    static const std::vector<ColumnFamilyInfo> layout = {
+      { "block_key_images", DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, false },
+      { "block_transaction_hashes", DB::BLOCK_INDEX_TO_TX_HASHES_PREFIX, false },
+      { "block_transaction_infos", DB::BLOCK_INDEX_TO_TRANSACTION_INFO_PREFIX, false },
+      { RAW_BLOCK_FAMILY_NAME, DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX, false },
+      { "block_hash_indexes", DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX, true },
+      { "block_infos", DB::BLOCK_INDEX_TO_BLOCK_INFO_PREFIX, false },
+      { "key_image_indexes", DB::KEY_IMAGE_TO_BLOCK_INDEX_PREFIX, true },
+      { "block_hashes", DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, false },
+      { "transaction_infos", DB::TRANSACTION_HASH_TO_TRANSACTION_INFO_PREFIX, true },
+      { "key_output_amounts", DB::KEY_OUTPUT_AMOUNT_PREFIX, false },
+      { "closest_timestamp_indexes", DB::CLOSEST_TIMESTAMP_BLOCK_INDEX_PREFIX, false },
+      { "payment_id_transactions", DB::PAYMENT_ID_TO_TX_HASH_PREFIX, true },
+      { "timestamp_block_hashes", DB::TIMESTAMP_TO_BLOCKHASHES_PREFIX, false },
+      { "key_output_amounts_counts", DB::KEY_OUTPUT_AMOUNTS_COUNT_PREFIX, false },
+      { "key_output_keys", DB::KEY_OUTPUT_KEY_PREFIX, false }
+    };
+
+    return layout;
+  }
+
+  //Keys are serialized as (prefix, key) pairs, so every key of a prefix starts with the bytes preceding the key itself
+  std::string getKeyHead(const std::string& prefix) {
+    std::string numericKey = DB::serializeKey(prefix, uint32_t(0));
+    std::string stringKey = DB::serializeKey(prefix, std::string());
+
+    return DB::getCommonKeyStart(numericKey, stringKey);
+  }
+
+  //Only what the linked RocksDB was built with can be used, the bundled build has no compression libraries
+  rocksdb::CompressionType getSupportedCompression(std::initializer_list<rocksdb::CompressionType> preferred) {
+    std::vector<rocksdb::CompressionType> supported = rocksdb::GetSupportedCompressions();
+    for (rocksdb::CompressionType compression : preferred) {
+      if (std::find(supported.begin(), supported.end(), compression) != supported.end()) {
+        return compression;
+      }
+    }
+
+    return rocksdb::kNoCompression;
+  }
 }
 
 RocksDBWrapper::RocksDBWrapper(std::shared_ptr<Logging::ILogger> logger) : logger(logger, "RocksDBWrapper"), state(NOT_INITIALIZED){
@@ -44,25 +106,62 @@ void RocksDBWrapper::init(const DataBaseConfig& config) {
   if (state.load() != NOT_INITIALIZED) {
     throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::ALREADY_INITIALIZED));
   }
-  
+
+  std::string dataDir = getDataDir(config);
+
+  open(config, false);
+
+  if (columnFamilies.size() == 1) {
+    logger(WARNING) << "DB in " << dataDir << " uses the old single keyspace layout. "
+      "Run the daemon once with --db-migrate to move it into column families";
+  } else if (!hasColumnFamilyLayout()) {
+    close();
+    logger(ERROR) << "DB in " << dataDir << " was not fully migrated to column families. Run the daemon with --db-migrate to finish the migration";
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
+  }
+
+  state.store(INITIALIZED);
+}
+
+void RocksDBWrapper::open(const DataBaseConfig& config, bool createMissingFamilies) {
   std::string dataDir = getDataDir(config);
 
   logger(INFO) << "Opening DB in " << dataDir;
 
-  rocksdb::DB* dbPtr;
+  uint64_t rawBlockCacheSize = config.getReadCacheSize() / 4;
+  readCache = rocksdb::NewLRUCache(config.getReadCacheSize() - rawBlockCacheSize);
+  rawBlockCache = rocksdb::NewLRUCache(rawBlockCacheSize);
 
   rocksdb::Options dbOptions = getDBOptions(config);
-  rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, &dbPtr);
+
+  std::vector<std::string> familyNames;
+  rocksdb::Status status = rocksdb::DB::ListColumnFamilies(dbOptions, dataDir, &familyNames);
+  bool exists = status.ok();
+  bool legacyLayout = exists && familyNames.size() == 1 && !createMissingFamilies;
+
+  std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+  descriptors.emplace_back(rocksdb::kDefaultColumnFamilyName, getColumnFamilyOptions(config, rocksdb::kDefaultColumnFamilyName));
+  if (!legacyLayout) {
+    for (const ColumnFamilyInfo& family : getColumnFamilyLayout()) {
+      descriptors.emplace_back(family.name, getColumnFamilyOptions(config, family.name));
+    }
+
+    //All families share one memtable budget instead of each taking a full write buffer
+    dbOptions.db_write_buffer_size = static_cast<size_t>(config.getWriteBufferSize() * 2);
+  }
+
+  if (!exists) {
+    logger(INFO) << "DB not found in " << dataDir << ". Creating new DB...";
+  }
+
+  dbOptions.create_if_missing = !exists;
+  dbOptions.create_missing_column_families = !exists || createMissingFamilies;
+
+  rocksdb::DB* dbPtr;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  status = rocksdb::DB::Open(dbOptions, dataDir, descriptors, &handles, &dbPtr);
   if (status.ok()) {
     logger(INFO) << "DB opened in " << dataDir;
-  } else if (!status.ok() && status.IsInvalidArgument()) {
-    logger(INFO) << "DB not found in " << dataDir << ". Creating new DB...";
-    dbOptions.create_if_missing = true;
-    rocksdb::Status status = rocksdb::DB::Open(dbOptions, dataDir, &dbPtr);
-    if (!status.ok()) {
-      logger(ERROR) << "DB Error. DB can't be created in " << dataDir << ". Error: " << status.ToString();
-      throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
-    }
   } else if (status.IsIOError()) {
     logger(ERROR) << "DB Error. DB can't be opened in " << dataDir << ". Error: " << status.ToString();
     throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::IO_ERROR));
@@ -72,7 +171,48 @@ void RocksDBWrapper::init(const DataBaseConfig& config) {
   }
 
   db.reset(dbPtr);
-  state.store(INITIALIZED);
+  columnFamilies = std::move(handles);
+
+  if (!legacyLayout) {
+    const std::vector<ColumnFamilyInfo>& layout = getColumnFamilyLayout();
+    for (size_t i = 0; i < layout.size(); ++i) {
+      routes.push_back({ getKeyHead(layout[i].prefix), i + 1 });
+    }
+  }
+
+  if (!exists) {
+    status = db->Put(rocksdb::WriteOptions(), columnFamilies[0], COLUMN_FAMILY_LAYOUT_KEY, "1");
+    if (!status.ok()) {
+      close();
+      logger(ERROR) << "DB Error. DB can't be created in " << dataDir << ". Error: " << status.ToString();
+      throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
+    }
+  }
+}
+
+void RocksDBWrapper::close() {
+  for (rocksdb::ColumnFamilyHandle* handle : columnFamilies) {
+    db->DestroyColumnFamilyHandle(handle);
+  }
+
+  columnFamilies.clear();
+  routes.clear();
+  db.reset();
+}
+
+bool RocksDBWrapper::hasColumnFamilyLayout() {
+  std::string value;
+  return db->Get(rocksdb::ReadOptions(), columnFamilies[0], COLUMN_FAMILY_LAYOUT_KEY, &value).ok();
+}
+
+rocksdb::ColumnFamilyHandle* RocksDBWrapper::getColumnFamily(const std::string& rawKey) const {
+  for (const ColumnFamilyRoute& route : routes) {
+    if (rawKey.compare(0, route.keyHead.size(), route.keyHead) == 0) {
+      return columnFamilies[route.familyIndex];
+    }
+  }
+
+  return columnFamilies[0];
 }
 
 void RocksDBWrapper::shutdown() {
@@ -81,9 +221,12 @@ void RocksDBWrapper::shutdown() {
   }
 
   logger(INFO) << "Closing DB.";
-  db->Flush(rocksdb::FlushOptions());
+  for (rocksdb::ColumnFamilyHandle* handle : columnFamilies) {
+    db->Flush(rocksdb::FlushOptions(), handle);
+  }
+
   db->SyncWAL();
-  db.reset();
+  close();
   state.store(NOT_INITIALIZED);
 }
 
@@ -107,6 +250,94 @@ void RocksDBWrapper::destroy(const DataBaseConfig& config) {
   }
 }
 
+void RocksDBWrapper::migrate(const DataBaseConfig& config) {
+  if (state.load() != NOT_INITIALIZED) {
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::ALREADY_INITIALIZED));
+  }
+
+  std::string dataDir = getDataDir(config);
+
+  std::vector<std::string> familyNames;
+  if (!rocksdb::DB::ListColumnFamilies(getDBOptions(config), dataDir, &familyNames).ok()) {
+    logger(ERROR) << "DB Error. No DB to migrate in " << dataDir;
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::IO_ERROR));
+  }
+
+  open(config, true);
+
+  if (hasColumnFamilyLayout()) {
+    logger(INFO) << "DB in " << dataDir << " already uses column families";
+    close();
+    return;
+  }
+
+  logger(INFO) << "Migrating DB in " << dataDir << " to column families. This may take a while...";
+
+  rocksdb::ColumnFamilyHandle* defaultFamily = columnFamilies[0];
+
+  //Keys are moved and deleted in the same batch, so an interrupted migration can simply be run again
+  auto writeBatch = [this, &dataDir](rocksdb::WriteBatch& batch) {
+    rocksdb::Status status = db->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+      logger(ERROR) << "DB Error. Can't migrate DB in " << dataDir << ". Error: " << status.ToString();
+    }
+
+    batch.Clear();
+    return status.ok();
+  };
+
+  rocksdb::ReadOptions readOptions;
+  readOptions.fill_cache = false;
+
+  std::unique_ptr<rocksdb::Iterator> iterator(db->NewIterator(readOptions, defaultFamily));
+  rocksdb::WriteBatch batch;
+  uint64_t movedKeys = 0;
+  bool success = true;
+
+  for (iterator->SeekToFirst(); success && iterator->Valid(); iterator->Next()) {
+    rocksdb::ColumnFamilyHandle* family = getColumnFamily(iterator->key().ToString());
+    if (family == defaultFamily) {
+      continue;
+    }
+
+    batch.Put(family, iterator->key(), iterator->value());
+    batch.Delete(defaultFamily, iterator->key());
+    ++movedKeys;
+
+    if (batch.GetDataSize() >= MIGRATION_BATCH_SIZE) {
+      success = writeBatch(batch);
+      logger(INFO) << "Moved " << movedKeys << " keys";
+    }
+  }
+
+  if (success && !iterator->status().ok()) {
+    logger(ERROR) << "DB Error. Can't read DB in " << dataDir << ". Error: " << iterator->status().ToString();
+    success = false;
+  }
+
+  iterator.reset();
+
+  if (success) {
+    batch.Put(defaultFamily, COLUMN_FAMILY_LAYOUT_KEY, "1");
+    success = writeBatch(batch);
+  }
+
+  if (!success) {
+    close();
+    throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR));
+  }
+
+  logger(INFO) << "Moved " << movedKeys << " keys, compacting...";
+  db->CompactRange(rocksdb::CompactRangeOptions(), defaultFamily, nullptr, nullptr);
+
+  for (rocksdb::ColumnFamilyHandle* handle : columnFamilies) {
+    db->Flush(rocksdb::FlushOptions(), handle);
+  }
+
+  close();
+  logger(INFO) << "DB in " << dataDir << " migrated to column families";
+}
+
 std::error_code RocksDBWrapper::write(IWriteBatch& batch) {
   if (state.load() != INITIALIZED) {
     throw std::system_error(make_error_code(CryptoNote::error::DataBaseErrorCodes::NOT_INITIALIZED));
@@ -122,12 +353,12 @@ std::error_code RocksDBWrapper::write(IWriteBatch& batch, bool sync) {
   rocksdb::WriteBatch rocksdbBatch;
   std::vector<std::pair<std::string, std::string>> rawData(batch.extractRawDataToInsert());
   for (const std::pair<std::string, std::string>& kvPair : rawData) {
-    rocksdbBatch.Put(rocksdb::Slice(kvPair.first), rocksdb::Slice(kvPair.second));
+    rocksdbBatch.Put(getColumnFamily(kvPair.first), rocksdb::Slice(kvPair.first), rocksdb::Slice(kvPair.second));
   }
 
   std::vector<std::string> rawKeys(batch.extractRawKeysToRemove());
   for (const std::string& key : rawKeys) {
-    rocksdbBatch.Delete(rocksdb::Slice(key));
+    rocksdbBatch.Delete(getColumnFamily(key), rocksdb::Slice(key));
   }
 
   rocksdb::Status status = db->Write(writeOptions, &rocksdbBatch);
@@ -149,14 +380,17 @@ std::error_code RocksDBWrapper::read(IReadBatch& batch) {
 
   std::vector<std::string> rawKeys(batch.getRawKeys());
   std::vector<rocksdb::Slice> keySlices;
+  std::vector<rocksdb::ColumnFamilyHandle*> keyFamilies;
   keySlices.reserve(rawKeys.size());
+  keyFamilies.reserve(rawKeys.size());
   for (const std::string& key : rawKeys) {
     keySlices.emplace_back(rocksdb::Slice(key));
+    keyFamilies.push_back(getColumnFamily(key));
   }
 
   std::vector<std::string> values;
   values.reserve(rawKeys.size());
-  std::vector<rocksdb::Status> statuses = db->MultiGet(readOptions, keySlices, &values);
+  std::vector<rocksdb::Status> statuses = db->MultiGet(readOptions, keyFamilies, keySlices, &values);
 
   std::error_code error;
   std::vector<bool> resultStates;
@@ -171,12 +405,64 @@ std::error_code RocksDBWrapper::read(IReadBatch& batch) {
   return std::error_code();
 }
 
+std::error_code RocksDBWrapper::iterate(const std::string& beginKey, const std::string& endKey, const IterateFunction& visitor) {
+  rocksdb::Slice upperBound(endKey);
+  return iterate(beginKey, &upperBound, std::string(), visitor);
+}
+
+std::error_code RocksDBWrapper::iteratePrefix(const std::string& keyStart, const IterateFunction& visitor) {
+  //The first key past the prefix is the prefix with its last byte below 0xff incremented
+  std::string endKey = keyStart;
+  while (!endKey.empty() && static_cast<unsigned char>(endKey.back()) == 0xff) {
+    endKey.pop_back();
+  }
+
+  if (endKey.empty()) {
+    return iterate(keyStart, nullptr, keyStart, visitor);
+  }
+
+  endKey.back() = static_cast<char>(static_cast<unsigned char>(endKey.back()) + 1);
+  rocksdb::Slice upperBound(endKey);
+  return iterate(keyStart, &upperBound, keyStart, visitor);
+}
+
+std::error_code RocksDBWrapper::iterate(const std::string& beginKey, const rocksdb::Slice* endKey, const std::string& keyStart, const IterateFunction& visitor) {
+  if (state.load() != INITIALIZED) {
+    throw std::runtime_error("Not initialized.");
+  }
+
+  rocksdb::ReadOptions readOptions;
+  readOptions.iterate_upper_bound = endKey;
+
+  std::unique_ptr<rocksdb::Iterator> iterator(db->NewIterator(readOptions, getColumnFamily(beginKey)));
+  for (iterator->Seek(beginKey); iterator->Valid(); iterator->Next()) {
+    if (!iterator->key().starts_with(keyStart)) {
+      break;
+    }
+
+    if (!visitor(iterator->key().ToString(), iterator->value().ToString())) {
+      break;
+    }
+  }
+
+  if (!iterator->status().ok()) {
+    logger(ERROR) << "Can't iterate DB. " << iterator->status().ToString();
+    return make_error_code(CryptoNote::error::DataBaseErrorCodes::INTERNAL_ERROR);
+  }
+
+  return std::error_code();
+}
+
 rocksdb::Options RocksDBWrapper::getDBOptions(const DataBaseConfig& config) {
   rocksdb::DBOptions dbOptions;
   dbOptions.IncreaseParallelism(config.getBackgroundThreadsCount());
   dbOptions.info_log_level = rocksdb::InfoLogLevel::WARN_LEVEL;
   dbOptions.max_open_files = config.getMaxOpenFiles();
 
+  return rocksdb::Options(dbOptions, getColumnFamilyOptions(config, rocksdb::kDefaultColumnFamilyName));
+}
+
+rocksdb::ColumnFamilyOptions RocksDBWrapper::getColumnFamilyOptions(const DataBaseConfig& config, const std::string& familyName) {
   rocksdb::ColumnFamilyOptions fOptions;
   fOptions.write_buffer_size = static_cast<size_t>(config.getWriteBufferSize());
   // merge two memtables when flushing to L0
@@ -201,17 +487,35 @@ rocksdb::Options RocksDBWrapper::getDBOptions(const DataBaseConfig& config) {
   // level style compaction
   fOptions.compaction_style = rocksdb::kCompactionStyleLevel;
 
+  bool rawBlocks = familyName == RAW_BLOCK_FAMILY_NAME;
+
+  // raw blocks are large, rarely read values: compress everything below the
+  // freshly flushed levels, and the bottommost level as hard as we can
+  rocksdb::CompressionType compression = rawBlocks ? getSupportedCompression({ rocksdb::kLZ4Compression, rocksdb::kSnappyCompression }) : rocksdb::kNoCompression;
   fOptions.compression_per_level.resize(fOptions.num_levels);
   for (int i = 0; i < fOptions.num_levels; ++i) {
-    fOptions.compression_per_level[i] = rocksdb::kNoCompression;
+    fOptions.compression_per_level[i] = i < 2 ? rocksdb::kNoCompression : compression;
+  }
+
+  if (rawBlocks) {
+    fOptions.bottommost_compression = getSupportedCompression({ rocksdb::kZSTD, rocksdb::kLZ4HCCompression, compression });
   }
 
+  auto info = std::find_if(getColumnFamilyLayout().begin(), getColumnFamilyLayout().end(),
+    [&familyName](const ColumnFamilyInfo& family) { return family.name == familyName; });
+
   rocksdb::BlockBasedTableOptions tableOptions;
-  tableOptions.block_cache = rocksdb::NewLRUCache(config.getReadCacheSize());
+  // raw blocks get their own cache so that serving them doesn't evict index data
+  tableOptions.block_cache = rawBlocks ? rawBlockCache : readCache;
+  if (info != getColumnFamilyLayout().end() && info->bloomFilter) {
+    // point lookups by hash or key image mostly miss, let the filter answer them
+    tableOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(BLOOM_FILTER_BITS_PER_KEY, false));
+  }
+
   std::shared_ptr<rocksdb::TableFactory> tfp(NewBlockBasedTableFactory(tableOptions));
   fOptions.table_factory = tfp;
 
-  return rocksdb::Options(dbOptions, fOptions);
+  return fOptions;
 }
 
 std::string RocksDBWrapper::getDataDir(const DataBaseConfig& config) {
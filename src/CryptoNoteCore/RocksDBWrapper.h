@@ -20,7 +20,9 @@
 #include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "rocksdb/cache.h"
 #include "rocksdb/db.h"
 
 #include "IDataBase.h"
@@ -44,14 +46,29 @@ public:
   void init(const DataBaseConfig& config);
   void shutdown();
   void destroy(const DataBaseConfig& config); //Be careful with this method!
+  void migrate(const DataBaseConfig& config); //Moves a single keyspace DB into per prefix column families, offline only
 
   std::error_code write(IWriteBatch& batch) override;
   std::error_code read(IReadBatch& batch) override;
+  std::error_code iterate(const std::string& beginKey, const std::string& endKey, const IterateFunction& visitor) override;
+  std::error_code iteratePrefix(const std::string& keyStart, const IterateFunction& visitor) override;
 
 private:
+  struct ColumnFamilyRoute {
+    std::string keyHead;
+    size_t familyIndex;
+  };
+
   std::error_code write(IWriteBatch& batch, bool sync);
+  std::error_code iterate(const std::string& beginKey, const rocksdb::Slice* endKey, const std::string& keyStart, const IterateFunction& visitor);
+
+  void open(const DataBaseConfig& config, bool createMissingFamilies);
+  void close();
+  bool hasColumnFamilyLayout();
+  rocksdb::ColumnFamilyHandle* getColumnFamily(const std::string& rawKey) const;
 
   rocksdb::Options getDBOptions(const DataBaseConfig& config);
+  rocksdb::ColumnFamilyOptions getColumnFamilyOptions(const DataBaseConfig& config, const std::string& familyName);
   std::string getDataDir(const DataBaseConfig& config);
 
   enum State {
@@ -61,6 +78,11 @@ private:
 
   Logging::LoggerRef logger;
   std::unique_ptr<rocksdb::DB> db;
+  //Index 0 is the default family, the rest follow the prefix layout. Only the default family while the DB uses the legacy single keyspace layout
+  std::vector<rocksdb::ColumnFamilyHandle*> columnFamilies;
+  std::vector<ColumnFamilyRoute> routes;
+  std::shared_ptr<rocksdb::Cache> readCache;
+  std::shared_ptr<rocksdb::Cache> rawBlockCache;
   std::atomic<State> state;
 };
 }
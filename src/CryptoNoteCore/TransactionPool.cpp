@@ -17,6 +17,8 @@
 
 #include "TransactionPool.h"
 
+#include <algorithm>
+
 #include "Common/int-util.h"
 #include "CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/TransactionExtra.h"
@@ -82,10 +84,25 @@ bool TransactionPool::pushTransaction(CachedTransaction&& transaction, Transacti
     return false;
   }
 
+  const Crypto::Hash transactionHash = pendingTx.getTransactionHash();
+
+  /* Insert first, so the state and the key image index are only updated
+     for a transaction that is actually in the pool */
+  if (!transactionHashIndex.insert(std::move(pendingTx)).second) {
+    logger(Logging::DEBUGGING) << "pushTransaction: failed to insert transaction";
+    return false;
+  }
+
   mergeStates(poolState, transactionState);
 
-  logger(Logging::DEBUGGING) << "pushed transaction " << pendingTx.getTransactionHash() << " to pool";
-  return transactionHashIndex.insert(std::move(pendingTx)).second;
+  for (const Crypto::KeyImage& keyImage : transactionState.spentKeyImages) {
+    keyImageIndex.emplace(keyImage, transactionHash);
+  }
+
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "pushed transaction " << transactionHash << " to pool";
+  });
+  return true;
 }
 
 const CachedTransaction& TransactionPool::getTransaction(const Crypto::Hash& hash) const {
@@ -103,9 +120,18 @@ bool TransactionPool::removeTransaction(const Crypto::Hash& hash) {
   }
 
   excludeFromState(poolState, it->cachedTransaction);
+
+  for (const auto& input : it->cachedTransaction.getTransaction().inputs) {
+    if (input.type() == typeid(KeyInput)) {
+      keyImageIndex.erase(boost::get<KeyInput>(input).keyImage);
+    }
+  }
+
   transactionHashIndex.erase(it);
 
-  logger(Logging::DEBUGGING) << "transaction " << hash << " removed from pool";
+  logger.log(Logging::DEBUGGING, [&](std::ostream& message) {
+    message << "transaction " << hash << " removed from pool";
+  });
   return true;
 }
 
@@ -141,6 +167,26 @@ std::vector<CachedTransaction> TransactionPool::getPoolTransactions() const {
   return result;
 }
 
+void TransactionPool::forEachTransactionByFee(const std::function<bool(const CachedTransaction&)>& visitor) const {
+  for (const auto& transactionItem: transactionCostIndex) {
+    if (!visitor(transactionItem.cachedTransaction)) {
+      break;
+    }
+  }
+}
+
+std::vector<Crypto::Hash> TransactionPool::getConflictingTransactionHashes(const TransactionValidatorState& state) const {
+  std::vector<Crypto::Hash> transactionHashes;
+  for (const Crypto::KeyImage& keyImage : state.spentKeyImages) {
+    auto it = keyImageIndex.find(keyImage);
+    if (it != keyImageIndex.end() && std::find(transactionHashes.begin(), transactionHashes.end(), it->second) == transactionHashes.end()) {
+      transactionHashes.push_back(it->second);
+    }
+  }
+
+  return transactionHashes;
+}
+
 uint64_t TransactionPool::getTransactionReceiveTime(const Crypto::Hash& hash) const {
   auto it = transactionHashIndex.find(hash);
   assert(it != transactionHashIndex.end());
@@ -48,6 +48,8 @@ public:
 
   virtual const TransactionValidatorState& getPoolTransactionValidationState() const override;
   virtual std::vector<CachedTransaction> getPoolTransactions() const override;
+  virtual void forEachTransactionByFee(const std::function<bool(const CachedTransaction&)>& visitor) const override;
+  virtual std::vector<Crypto::Hash> getConflictingTransactionHashes(const TransactionValidatorState& state) const override;
 
   virtual uint64_t getTransactionReceiveTime(const Crypto::Hash& hash) const override;
   virtual std::vector<Crypto::Hash> getTransactionHashesByPaymentId(const Crypto::Hash& paymentId) const override;
@@ -109,7 +111,10 @@ private:
   TransactionsContainer::index<TransactionHashTag>::type& transactionHashIndex;
   TransactionsContainer::index<TransactionCostTag>::type& transactionCostIndex;
   TransactionsContainer::index<PaymentIdTag>::type& paymentIdIndex;
-  
+
+  //A transaction has several key images, so this can't be another view of the container. The pool state keeps them unique
+  std::unordered_map<Crypto::KeyImage, Crypto::Hash> keyImageIndex;
+
   Logging::LoggerRef logger;
 };
 
@@ -63,6 +63,14 @@ std::vector<CachedTransaction> TransactionPoolCleanWrapper::getPoolTransactions(
   return transactionPool->getPoolTransactions();
 }
 
+void TransactionPoolCleanWrapper::forEachTransactionByFee(const std::function<bool(const CachedTransaction&)>& visitor) const {
+  transactionPool->forEachTransactionByFee(visitor);
+}
+
+std::vector<Crypto::Hash> TransactionPoolCleanWrapper::getConflictingTransactionHashes(const TransactionValidatorState& state) const {
+  return transactionPool->getConflictingTransactionHashes(state);
+}
+
 uint64_t TransactionPoolCleanWrapper::getTransactionReceiveTime(const Crypto::Hash& hash) const {
   return transactionPool->getTransactionReceiveTime(hash);
 }
@@ -0,0 +1,298 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "BlockDownloadScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+#include <CryptoTypes.h>
+
+namespace CryptoNote {
+
+double BlockDownloadScheduler::PeerStatistics::blocksPerSecond() const {
+  if (downloadTime.count() == 0) {
+    return 0;
+  }
+
+  return static_cast<double>(blocksReceived) * 1000 / downloadTime.count();
+}
+
+BlockDownloadScheduler::BlockDownloadScheduler(size_t windowSize, size_t maxWindowsAhead, std::chrono::seconds windowTimeout) :
+  m_windowSize(windowSize), m_maxWindowsAhead(maxWindowsAhead), m_windowTimeout(windowTimeout) {
+  assert(m_windowSize > 0);
+}
+
+bool BlockDownloadScheduler::addChain(const boost::uuids::uuid& peer, uint32_t startHeight, const std::vector<Crypto::Hash>& hashes) {
+  if (hashes.empty()) {
+    return false;
+  }
+
+  const uint32_t endHeight = startHeight + static_cast<uint32_t>(hashes.size());
+
+  if (startHeight > m_chainEndHeight) {
+    /* The caller starts the hashes at the first block the core doesn't
+       have, so this is only fine if nothing is left to download */
+    if (!m_windows.empty()) {
+      return false;
+    }
+
+    m_chainEndHeight = startHeight;
+  }
+
+  /* The hashes may overlap blocks handed out already, which might not have
+     reached the core yet. Only the last of them is known here. */
+  if (startHeight < m_takenEndHeight && endHeight >= m_takenEndHeight &&
+      hashes[m_takenEndHeight - 1 - startHeight] != m_lastTakenHash) {
+    return false;
+  }
+
+  /* Every hash both chains have must match */
+  for (const Window& window : m_windows) {
+    const uint32_t from = std::max(startHeight, window.startHeight);
+    const uint32_t to = std::min(endHeight, window.startHeight + static_cast<uint32_t>(window.hashes.size()));
+
+    for (uint32_t height = from; height < to; ++height) {
+      if (window.hashes[height - window.startHeight] != hashes[height - startHeight]) {
+        return false;
+      }
+    }
+  }
+
+  for (uint32_t height = m_chainEndHeight; height < endHeight; ++height) {
+    /* A partial window that has been requested already stays as it is, the
+       new hashes start a window of their own */
+    if (m_windows.empty() || m_windows.back().state != Window::PENDING || m_windows.back().hashes.size() == m_windowSize) {
+      Window window;
+      window.startHeight = height;
+      m_windows.push_back(std::move(window));
+    }
+
+    m_windows.back().hashes.push_back(hashes[height - startHeight]);
+  }
+
+  if (endHeight > m_chainEndHeight) {
+    m_chainEndHeight = endHeight;
+    m_lastHash = hashes.back();
+  }
+
+  Peer& state = m_peers[peer];
+  state.chainEndHeight = std::max(state.chainEndHeight, endHeight);
+  state.chainRequested = false;
+
+  return true;
+}
+
+bool BlockDownloadScheduler::assignWindow(const boost::uuids::uuid& peer, Clock::time_point now, std::vector<Crypto::Hash>& hashes) {
+  auto it = m_peers.find(peer);
+  if (it == m_peers.end() || it->second.requestOutstanding) {
+    return false;
+  }
+
+  /* Don't run too far ahead of the blocks that can be added, the downloaded
+     windows are held in memory until the ones before them arrive */
+  const size_t lookahead = std::min(m_windows.size(), m_maxWindowsAhead);
+
+  for (size_t i = 0; i < lookahead; ++i) {
+    Window& window = m_windows[i];
+    if (window.state != Window::PENDING) {
+      continue;
+    }
+
+    if (window.startHeight + window.hashes.size() > it->second.chainEndHeight) {
+      continue;
+    }
+
+    window.state = Window::REQUESTED;
+    window.peer = peer;
+    window.requestedAt = now;
+    it->second.requestOutstanding = true;
+
+    hashes = window.hashes;
+    return true;
+  }
+
+  return false;
+}
+
+bool BlockDownloadScheduler::shouldRequestChain(const boost::uuids::uuid& peer, uint32_t peerHeight) {
+  auto it = m_peers.find(peer);
+  if (it == m_peers.end() || it->second.chainRequested || it->second.chainEndHeight >= peerHeight) {
+    return false;
+  }
+
+  if (m_windows.size() >= m_maxWindowsAhead) {
+    return false;
+  }
+
+  it->second.chainRequested = true;
+  return true;
+}
+
+bool BlockDownloadScheduler::completeWindow(
+  const boost::uuids::uuid& peer,
+  std::vector<RawBlock>&& rawBlocks,
+  std::vector<BlockTemplate>&& blockTemplates,
+  const std::vector<Crypto::Hash>& blockHashes,
+  Clock::time_point now) {
+
+  assert(rawBlocks.size() == blockTemplates.size() && rawBlocks.size() == blockHashes.size());
+
+  auto peerIt = m_peers.find(peer);
+  if (peerIt == m_peers.end()) {
+    return false;
+  }
+
+  peerIt->second.requestOutstanding = false;
+
+  Window* window = findWindow(peer);
+  if (window == nullptr || blockHashes.size() != window->hashes.size()) {
+    return false;
+  }
+
+  std::unordered_map<Crypto::Hash, size_t> positions;
+  for (size_t i = 0; i < window->hashes.size(); ++i) {
+    positions.emplace(window->hashes[i], i);
+  }
+
+  std::vector<RawBlock> orderedRawBlocks(window->hashes.size());
+  std::vector<BlockTemplate> orderedTemplates(window->hashes.size());
+  std::vector<bool> received(window->hashes.size(), false);
+
+  uint64_t bytes = 0;
+
+  for (size_t i = 0; i < blockHashes.size(); ++i) {
+    auto it = positions.find(blockHashes[i]);
+    if (it == positions.end() || received[it->second]) {
+      return false;
+    }
+
+    received[it->second] = true;
+
+    bytes += rawBlocks[i].block.size();
+    for (const auto& transaction : rawBlocks[i].transactions) {
+      bytes += transaction.size();
+    }
+
+    orderedRawBlocks[it->second] = std::move(rawBlocks[i]);
+    orderedTemplates[it->second] = std::move(blockTemplates[i]);
+  }
+
+  window->rawBlocks = std::move(orderedRawBlocks);
+  window->blockTemplates = std::move(orderedTemplates);
+  window->state = Window::DOWNLOADED;
+
+  PeerStatistics& statistics = peerIt->second.statistics;
+  statistics.blocksReceived += window->hashes.size();
+  statistics.bytesReceived += bytes;
+  statistics.downloadTime += std::chrono::duration_cast<std::chrono::milliseconds>(now - window->requestedAt);
+
+  return true;
+}
+
+bool BlockDownloadScheduler::takeNextWindow(boost::uuids::uuid& peer, std::vector<RawBlock>& rawBlocks, std::vector<BlockTemplate>& blockTemplates) {
+  if (m_windows.empty() || m_windows.front().state != Window::DOWNLOADED) {
+    return false;
+  }
+
+  Window& window = m_windows.front();
+  peer = window.peer;
+  m_takenEndHeight = window.startHeight + static_cast<uint32_t>(window.hashes.size());
+  m_lastTakenHash = window.hashes.back();
+  rawBlocks = std::move(window.rawBlocks);
+  blockTemplates = std::move(window.blockTemplates);
+
+  m_windows.pop_front();
+  return true;
+}
+
+std::vector<boost::uuids::uuid> BlockDownloadScheduler::expireWindows(Clock::time_point now) {
+  std::vector<boost::uuids::uuid> peers;
+
+  for (Window& window : m_windows) {
+    if (window.state != Window::REQUESTED || now - window.requestedAt < m_windowTimeout) {
+      continue;
+    }
+
+    /* The window isn't the peer's any more, so a late answer is discarded
+       by completeWindow */
+    window.state = Window::PENDING;
+    peers.push_back(window.peer);
+
+    auto it = m_peers.find(window.peer);
+    if (it != m_peers.end()) {
+      it->second.requestOutstanding = false;
+      ++it->second.statistics.windowsTimedOut;
+    }
+  }
+
+  return peers;
+}
+
+void BlockDownloadScheduler::removePeer(const boost::uuids::uuid& peer) {
+  if (Window* window = findWindow(peer)) {
+    window->state = Window::PENDING;
+  }
+
+  m_peers.erase(peer);
+}
+
+void BlockDownloadScheduler::clear() {
+  m_windows.clear();
+
+  /* Answers still on the way are thrown away when they arrive, so leave
+     requestOutstanding alone */
+  for (auto& peer : m_peers) {
+    peer.second.chainEndHeight = 0;
+    peer.second.chainRequested = false;
+  }
+
+  m_chainEndHeight = 0;
+  m_takenEndHeight = 0;
+}
+
+bool BlockDownloadScheduler::hasPeer(const boost::uuids::uuid& peer) const {
+  return m_peers.count(peer) != 0;
+}
+
+bool BlockDownloadScheduler::isPeerWaiting(const boost::uuids::uuid& peer) const {
+  auto it = m_peers.find(peer);
+  return it != m_peers.end() && !it->second.requestOutstanding;
+}
+
+bool BlockDownloadScheduler::hasPendingWindows() const {
+  return std::any_of(m_windows.begin(), m_windows.end(), [](const Window& window) {
+    return window.state != Window::DOWNLOADED;
+  });
+}
+
+bool BlockDownloadScheduler::empty() const {
+  return m_windows.empty();
+}
+
+uint32_t BlockDownloadScheduler::getChainEndHeight() const {
+  return m_chainEndHeight;
+}
+
+const Crypto::Hash& BlockDownloadScheduler::getLastHash() const {
+  return m_lastHash;
+}
+
+const BlockDownloadScheduler::PeerStatistics* BlockDownloadScheduler::getPeerStatistics(const boost::uuids::uuid& peer) const {
+  auto it = m_peers.find(peer);
+  return it != m_peers.end() ? &it->second.statistics : nullptr;
+}
+
+BlockDownloadScheduler::Window* BlockDownloadScheduler::findWindow(const boost::uuids::uuid& peer) {
+  for (Window& window : m_windows) {
+    if (window.state == Window::REQUESTED && window.peer == peer) {
+      return &window;
+    }
+  }
+
+  return nullptr;
+}
+
+}
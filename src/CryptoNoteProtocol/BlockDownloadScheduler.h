@@ -0,0 +1,128 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/nil_generator.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include <CryptoNote.h>
+
+namespace CryptoNote {
+
+/* Splits the chain a synchronizing node is missing into windows of
+   consecutive blocks and hands them out to peers, so that several peers
+   download at once. Downloaded windows are given back strictly in chain
+   order, whichever order the peers answered in. Windows held by a peer for
+   longer than the timeout go back to the pending ones for someone else.
+
+   Only used from the dispatcher thread, so there is no locking. */
+class BlockDownloadScheduler {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct PeerStatistics {
+    uint64_t blocksReceived = 0;
+    uint64_t bytesReceived = 0;
+    std::chrono::milliseconds downloadTime{0};
+    uint32_t windowsTimedOut = 0;
+
+    double blocksPerSecond() const;
+  };
+
+  BlockDownloadScheduler(size_t windowSize, size_t maxWindowsAhead, std::chrono::seconds windowTimeout);
+
+  /* Adds block hashes a peer reported, the first being at startHeight, and
+     lets the peer take part. Returns false if they contradict the chain
+     being downloaded (the peer is on another fork) or leave a gap. */
+  bool addChain(const boost::uuids::uuid& peer, uint32_t startHeight, const std::vector<Crypto::Hash>& hashes);
+
+  /* Gives the peer the first pending window it has all blocks of, if it
+     isn't still answering an earlier request */
+  bool assignWindow(const boost::uuids::uuid& peer, Clock::time_point now, std::vector<Crypto::Hash>& hashes);
+
+  /* Whether to ask the peer for more of its chain: it has blocks past the
+     hashes it gave, few windows are left and it hasn't been asked yet */
+  bool shouldRequestChain(const boost::uuids::uuid& peer, uint32_t peerHeight);
+
+  /* Stores the peer's answer to its window, ordered as the window. Returns
+     false if the window has been handed to someone else in the meantime. */
+  bool completeWindow(
+    const boost::uuids::uuid& peer,
+    std::vector<RawBlock>&& rawBlocks,
+    std::vector<BlockTemplate>&& blockTemplates,
+    const std::vector<Crypto::Hash>& blockHashes,
+    Clock::time_point now);
+
+  /* Takes the next window in chain order, if it has been downloaded */
+  bool takeNextWindow(boost::uuids::uuid& peer, std::vector<RawBlock>& rawBlocks, std::vector<BlockTemplate>& blockTemplates);
+
+  /* Puts windows requested more than the timeout ago back to pending and
+     returns the peers that held them. The peers no longer count as busy;
+     the caller decides whether to keep them. */
+  std::vector<boost::uuids::uuid> expireWindows(Clock::time_point now);
+
+  /* Forgets the peer, its window goes back to pending */
+  void removePeer(const boost::uuids::uuid& peer);
+
+  /* Drops every window, e.g. after a downloaded block was rejected. The
+     peers stay, to be asked for their chain again. */
+  void clear();
+
+  bool hasPeer(const boost::uuids::uuid& peer) const;
+  bool isPeerWaiting(const boost::uuids::uuid& peer) const;
+  bool hasPendingWindows() const;
+  bool empty() const;
+
+  /* Height just past the last known hash */
+  uint32_t getChainEndHeight() const;
+  const Crypto::Hash& getLastHash() const;
+
+  const PeerStatistics* getPeerStatistics(const boost::uuids::uuid& peer) const;
+
+private:
+  struct Window {
+    enum State {
+      PENDING,
+      REQUESTED,
+      DOWNLOADED
+    };
+
+    uint32_t startHeight = 0;
+    std::vector<Crypto::Hash> hashes;
+    State state = PENDING;
+    boost::uuids::uuid peer = boost::uuids::nil_uuid();
+    Clock::time_point requestedAt;
+    std::vector<RawBlock> rawBlocks;
+    std::vector<BlockTemplate> blockTemplates;
+  };
+
+  struct Peer {
+    uint32_t chainEndHeight = 0;
+    bool chainRequested = false;
+    bool requestOutstanding = false;
+    PeerStatistics statistics;
+  };
+
+  Window* findWindow(const boost::uuids::uuid& peer);
+
+  const size_t m_windowSize;
+  const size_t m_maxWindowsAhead;
+  const std::chrono::seconds m_windowTimeout;
+
+  std::deque<Window> m_windows;
+  uint32_t m_chainEndHeight = 0;
+  Crypto::Hash m_lastHash;
+  uint32_t m_takenEndHeight = 0;
+  Crypto::Hash m_lastTakenHash;
+  std::unordered_map<boost::uuids::uuid, Peer, boost::hash<boost::uuids::uuid>> m_peers;
+};
+
+}
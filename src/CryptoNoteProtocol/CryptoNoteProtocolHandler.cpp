@@ -7,9 +7,14 @@
 #include "CryptoNoteProtocolHandler.h"
 
 #include <future>
+#include <thread>
 #include <boost/scope_exit.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <System/Dispatcher.h>
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+
+#include "Common/ScopeExit.h"
 
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
@@ -30,6 +35,23 @@ namespace CryptoNote {
 
 namespace {
 
+/* How many blocks each thread prepares per chunk when importing a batch of
+   blocks, see processObjects() */
+const size_t BLOCKS_PREPARED_PER_THREAD = 4;
+
+size_t getPrepareWorkerCount() {
+  /* Leave a core for the dispatcher, which adds the blocks meanwhile */
+  const size_t threads = std::thread::hardware_concurrency();
+  return threads > 1 ? threads - 1 : 1;
+}
+
+/* How many windows of BLOCKS_SYNCHRONIZING_DEFAULT_COUNT blocks may be
+   downloaded ahead of the blocks being added while synchronizing */
+const size_t BLOCK_DOWNLOAD_WINDOWS_AHEAD = 16;
+
+/* A window not delivered in this time is handed to another peer */
+const std::chrono::seconds BLOCK_DOWNLOAD_WINDOW_TIMEOUT(30);
+
 template<class t_parametr>
 bool post_notify(IP2pEndpoint& p2p, typename t_parametr::request& arg, const CryptoNoteConnectionContext& context) {
   return p2p.invoke_notify_to_peer(t_parametr::ID, LevinProtocol::encode(arg), context);
@@ -153,6 +175,9 @@ CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency& currency, S
   m_observedHeight(0),
   m_blockchainHeight(0),
   m_peersCount(0),
+  m_downloads(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, BLOCK_DOWNLOAD_WINDOWS_AHEAD, BLOCK_DOWNLOAD_WINDOW_TIMEOUT),
+  m_addingDownloadedBlocks(false),
+  m_prepareWorkers(getPrepareWorkerCount()),
   logger(log, "protocol") {
 
   if (!m_p2p) {
@@ -175,6 +200,8 @@ void CryptoNoteProtocolHandler::onConnectionOpened(CryptoNoteConnectionContext&
 }
 
 void CryptoNoteProtocolHandler::onConnectionClosed(CryptoNoteConnectionContext& context) {
+  m_downloads.removePeer(context.m_connection_id);
+
   bool updated = false;
   {
     std::lock_guard<std::mutex> lock(m_observedHeightMutex);
@@ -207,10 +234,7 @@ bool CryptoNoteProtocolHandler::start_sync(CryptoNoteConnectionContext& context)
     assert(context.m_needed_objects.empty());
     assert(context.m_requested_objects.empty());
 
-    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-    r.block_ids = m_core.buildSparseChain();
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
-    post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    requestChain(context);
   }
 
   return true;
@@ -227,7 +251,8 @@ void CryptoNoteProtocolHandler::log_connections() {
     << std::setw(20) << "Peer ID"
     << std::setw(25) << "Recv/Sent (inactive,sec)"
     << std::setw(25) << "State"
-    << std::setw(20) << "Lifetime(seconds)" << ENDL;
+    << std::setw(20) << "Lifetime(seconds)"
+    << std::setw(20) << "Download(blocks/s)" << ENDL;
 
   m_p2p->for_each_connection([&](const CryptoNoteConnectionContext& cntxt, uint64_t peer_id) {
     ss << std::setw(25) << std::left << std::string(cntxt.m_is_income ? "[INCOMING]" : "[OUTGOING]") +
@@ -235,7 +260,14 @@ void CryptoNoteProtocolHandler::log_connections() {
       << std::setw(20) << std::hex << peer_id
       // << std::setw(25) << std::to_string(cntxt.m_recv_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_recv) + ")" + "/" + std::to_string(cntxt.m_send_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_send) + ")"
       << std::setw(25) << get_protocol_state_string(cntxt.m_state)
-      << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started) << ENDL;
+      << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started);
+
+    const auto statistics = m_downloads.getPeerStatistics(cntxt.m_connection_id);
+    if (statistics != nullptr) {
+      ss << std::setw(20) << std::fixed << std::setprecision(1) << statistics->blocksPerSecond();
+    }
+
+    ss << ENDL;
   });
   logger(INFO) << "Connections: " << ENDL << ss.str();
 }
@@ -484,6 +516,10 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
   std::vector<RawBlock> rawBlocks = convertRawBlocksLegacyToRawBlocks(arg.blocks);
 
+  /* Peers downloading windows for the scheduler may be handing over blocks
+     someone else added meanwhile, that's fine */
+  const bool scheduled = m_downloads.hasPeer(context.m_connection_id);
+
   for (size_t index = 0; index < rawBlocks.size(); ++index) {
     if (!fromBinaryArray(blockTemplates[index], rawBlocks[index].block)) {
       logger(Logging::ERROR) << context << "sent wrong block: failed to parse and validate block: \r\n"
@@ -493,7 +529,7 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
     }
 
     cachedBlocks.emplace_back(blockTemplates[index]);
-    if (index == 1) {
+    if (index == 1 && !scheduled) {
       if (m_core.hasBlock(cachedBlocks.back().getBlockHash())) { //TODO
         context.m_state = CryptoNoteConnectionContext::state_idle;
         context.m_needed_objects.clear();
@@ -532,6 +568,36 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
     return 1;
   }
 
+  if (scheduled) {
+    std::vector<Crypto::Hash> blockHashes;
+    blockHashes.reserve(cachedBlocks.size());
+
+    for (const auto& cachedBlock : cachedBlocks) {
+      blockHashes.push_back(cachedBlock.getBlockHash());
+    }
+
+    /* The cached blocks refer to the templates, which are moved away now */
+    cachedBlocks.clear();
+
+    const bool stored = m_downloads.completeWindow(
+      context.m_connection_id, std::move(rawBlocks), std::move(blockTemplates), blockHashes, BlockDownloadScheduler::Clock::now()
+    );
+
+    if (!stored) {
+      logger(Logging::DEBUGGING) << context << "Blocks arrived after their window was handed to another peer, discarding";
+    }
+
+    /* Keep the peers busy while the blocks are added */
+    wakeWaitingPeers();
+
+    if (stored) {
+      addDownloadedBlocks();
+      wakeWaitingPeers();
+    }
+
+    return 1;
+  }
+
   {
     int result = processObjects(context, std::move(rawBlocks), cachedBlocks);
     if (result != 0) {
@@ -549,12 +615,109 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
 int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& context, std::vector<RawBlock>&& rawBlocks, const std::vector<CachedBlock>& cachedBlocks) {
   assert(rawBlocks.size() == cachedBlocks.size());
+
+  /* Parsing the transactions and computing the proof of work hash of a block
+     don't depend on the chain state. So, while the blocks of one chunk are
+     validated and committed on this thread, the next chunk is prepared on
+     m_prepareWorkers. Only one chunk is prepared ahead, which bounds the
+     memory used and the work thrown away if a block is rejected. */
+  const size_t threadCount = m_prepareWorkers.getThreadCount();
+  const size_t chunkSize = threadCount * BLOCKS_PREPARED_PER_THREAD;
+
+  std::vector<std::vector<CachedTransaction>> transactions(rawBlocks.size());
+
+  /* Not a vector<bool>, since the elements are written by different threads */
+  std::vector<uint8_t> prepared(rawBlocks.size(), 0);
+
+  /* The chunk being prepared. The last job to finish wakes this context
+     through the dispatcher, so other connections are served while we wait */
+  std::atomic<size_t> nextBlock(0);
+  size_t chunkEnd = 0;
+  std::atomic<size_t> jobsRunning(0);
+  std::atomic<bool> stopPreparing(false);
+  System::Event chunkPrepared(m_dispatcher);
+  bool preparing = false;
+
+  const auto prepareChunk = [&](const size_t chunkStart) {
+    nextBlock = chunkStart;
+    chunkEnd = std::min(chunkStart + chunkSize, rawBlocks.size());
+
+    const size_t jobs = std::min(threadCount, chunkEnd - chunkStart);
+    jobsRunning = jobs;
+    chunkPrepared.clear();
+    preparing = true;
+
+    for (size_t job = 0; job < jobs; job++) {
+      m_prepareWorkers.post([&] {
+        for (size_t i = nextBlock++; i < chunkEnd && !stopPreparing; i = nextBlock++) {
+          prepared[i] = m_core.prepareBlock(cachedBlocks[i], rawBlocks[i], transactions[i]);
+        }
+
+        if (--jobsRunning == 0) {
+          m_dispatcher.remoteSpawn([&chunkPrepared] { chunkPrepared.set(); });
+        }
+      });
+    }
+  };
+
+  /* Like RemoteContext::wait(), an interruption is passed on once the jobs,
+     which refer to this frame, are done */
+  const auto waitChunk = [&] {
+    if (!preparing) {
+      return;
+    }
+
+    bool interrupted = false;
+
+    while (!chunkPrepared.get()) {
+      try {
+        chunkPrepared.wait();
+      } catch (System::InterruptedException&) {
+        interrupted = true;
+      }
+    }
+
+    preparing = false;
+
+    if (interrupted) {
+      m_dispatcher.interrupt();
+    }
+  };
+
+  /* On an early return, the jobs still running skip the rest of their chunk */
+  Tools::ScopeExit stopChunk([&] {
+    stopPreparing = true;
+    waitChunk();
+  });
+
+  if (!rawBlocks.empty()) {
+    prepareChunk(0);
+  }
+
+  /* The blocks are written to the database together, whichever way we leave */
+  m_core.beginBlockBatch();
+  Tools::ScopeExit commitBlocks([this] {
+    m_core.commitBlockBatch();
+  });
+
   for (size_t index = 0; index < rawBlocks.size(); ++index) {
     if (m_stop) {
       break;
     }
 
-    auto addResult = m_core.addBlock(cachedBlocks[index], std::move(rawBlocks[index]));
+    if (index % chunkSize == 0) {
+      /* Wait for this chunk, then start on the next one while we add this one */
+      waitChunk();
+
+      if (index + chunkSize < rawBlocks.size()) {
+        prepareChunk(index + chunkSize);
+      }
+    }
+
+    /* If preparing failed, let the core report why */
+    auto addResult = prepared[index]
+      ? m_core.addBlock(cachedBlocks[index], std::move(rawBlocks[index]), std::move(transactions[index]))
+      : m_core.addBlock(cachedBlocks[index], std::move(rawBlocks[index]));
     if (addResult == error::AddBlockErrorCondition::BLOCK_VALIDATION_FAILED ||
         addResult == error::AddBlockErrorCondition::TRANSACTION_VALIDATION_FAILED ||
         addResult == error::AddBlockErrorCondition::DESERIALIZATION_FAILED) {
@@ -579,6 +742,144 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
   return 0;
 }
 
+void CryptoNoteProtocolHandler::requestChain(CryptoNoteConnectionContext& context) {
+  NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+  r.block_ids = m_core.buildSparseChain();
+
+  /* Start from the last block being downloaded, if the peer has it, rather
+     than from our top block, so we don't get hashes we know already */
+  if (!m_downloads.empty()) {
+    r.block_ids.insert(r.block_ids.begin(), m_downloads.getLastHash());
+  }
+
+  logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
+  post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+}
+
+void CryptoNoteProtocolHandler::requestNextWindow(CryptoNoteConnectionContext& context) {
+  NOTIFY_REQUEST_GET_OBJECTS::request req;
+
+  if (m_downloads.assignWindow(context.m_connection_id, BlockDownloadScheduler::Clock::now(), req.blocks)) {
+    context.m_requested_objects.insert(req.blocks.begin(), req.blocks.end());
+    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
+    post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+    return;
+  }
+
+  /* Still answering an earlier request */
+  if (!m_downloads.isPeerWaiting(context.m_connection_id)) {
+    return;
+  }
+
+  if (m_downloads.shouldRequestChain(context.m_connection_id, context.m_remote_blockchain_height)) {
+    requestChain(context);
+    return;
+  }
+
+  /* Wait for the other peers to deliver the blocks still missing */
+  if (!m_downloads.empty() || m_addingDownloadedBlocks || get_current_blockchain_height() < context.m_remote_blockchain_height) {
+    return;
+  }
+
+  m_downloads.removePeer(context.m_connection_id);
+  requestMissingPoolTransactions(context);
+
+  context.m_state = CryptoNoteConnectionContext::state_normal;
+  logger(Logging::INFO, Logging::BRIGHT_GREEN) << context << "Successfully synchronized with the "
+                                               << CryptoNote::CRYPTONOTE_NAME << " Network.";
+  on_connection_synchronized();
+}
+
+void CryptoNoteProtocolHandler::wakeWaitingPeers() {
+  if (m_stop) {
+    return;
+  }
+
+  m_p2p->for_each_connection([this](CryptoNoteConnectionContext& context, uint64_t peerId) {
+    if (context.m_state == CryptoNoteConnectionContext::state_synchronizing && m_downloads.isPeerWaiting(context.m_connection_id)) {
+      requestNextWindow(context);
+    }
+  });
+}
+
+void CryptoNoteProtocolHandler::addDownloadedBlocks() {
+  /* Blocks are added by whichever handler got the next window in order, the
+     others only store theirs. processObjects() yields, so guard against
+     being entered again from another connection meanwhile. */
+  if (m_addingDownloadedBlocks) {
+    return;
+  }
+
+  m_addingDownloadedBlocks = true;
+  Tools::ScopeExit resetAdding([this] { m_addingDownloadedBlocks = false; });
+
+  boost::uuids::uuid peer;
+  std::vector<RawBlock> rawBlocks;
+  std::vector<BlockTemplate> blockTemplates;
+
+  while (!m_stop && m_downloads.takeNextWindow(peer, rawBlocks, blockTemplates)) {
+    std::vector<RawBlock> newRawBlocks;
+    std::vector<CachedBlock> cachedBlocks;
+    newRawBlocks.reserve(rawBlocks.size());
+    cachedBlocks.reserve(rawBlocks.size());
+
+    /* A peer outside the download may have delivered some already */
+    for (size_t i = 0; i < rawBlocks.size(); ++i) {
+      cachedBlocks.emplace_back(blockTemplates[i]);
+      if (m_core.hasBlock(cachedBlocks.back().getBlockHash())) {
+        cachedBlocks.pop_back();
+      } else {
+        newRawBlocks.push_back(std::move(rawBlocks[i]));
+      }
+    }
+
+    /* The connection may go away while the blocks are added, so work on a
+       copy of its context */
+    CryptoNoteConnectionContext context;
+    context.m_connection_id = peer;
+
+    m_p2p->for_each_connection([&](CryptoNoteConnectionContext& connection, uint64_t peerId) {
+      if (connection.m_connection_id == peer) {
+        context = connection;
+      }
+    });
+
+    if (processObjects(context, std::move(newRawBlocks), cachedBlocks) != 0) {
+      if (context.m_state == CryptoNoteConnectionContext::state_shutdown) {
+        m_p2p->for_each_connection([&](CryptoNoteConnectionContext& connection, uint64_t peerId) {
+          if (connection.m_connection_id == peer) {
+            connection.m_state = CryptoNoteConnectionContext::state_shutdown;
+          }
+        });
+
+        m_downloads.removePeer(peer);
+      }
+
+      logger(Logging::DEBUGGING) << "Downloaded blocks were not added, restarting the download";
+      m_downloads.clear();
+      break;
+    }
+
+    logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new index = " << m_core.getTopBlockIndex();
+  }
+}
+
+void CryptoNoteProtocolHandler::onIdle() {
+  for (const auto& peer : m_downloads.expireWindows(BlockDownloadScheduler::Clock::now())) {
+    logger(Logging::DEBUGGING) << "Peer " << peer << " didn't deliver its blocks in time, handing them to another peer and dropping connection";
+
+    m_p2p->for_each_connection([&](CryptoNoteConnectionContext& connection, uint64_t peerId) {
+      if (connection.m_connection_id == peer) {
+        connection.m_state = CryptoNoteConnectionContext::state_shutdown;
+      }
+    });
+
+    m_downloads.removePeer(peer);
+  }
+
+  wakeWaitingPeers();
+}
+
 int CryptoNoteProtocolHandler::doPushLiteBlock(NOTIFY_NEW_LITE_BLOCK::request arg, CryptoNoteConnectionContext &context, std::vector<BinaryArray> missingTxs)
 {
     BlockTemplate newBlockTemplate;
@@ -794,7 +1095,11 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
     return 1;
   }
 
-  if (!m_core.hasBlock(arg.m_block_ids.front())) {
+  /* The chain may also start from the last block being downloaded, see
+     requestChain() */
+  const bool continuesDownload = !m_downloads.empty() && arg.m_block_ids.front() == m_downloads.getLastHash();
+
+  if (!continuesDownload && !m_core.hasBlock(arg.m_block_ids.front())) {
     logger(Logging::ERROR)
       << context << "sent m_block_ids starting from unknown id: "
       << Common::podToHex(arg.m_block_ids.front())
@@ -815,6 +1120,26 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
     context.m_state = CryptoNoteConnectionContext::state_shutdown;
   }
 
+  size_t firstUnknown = 0;
+  while (firstUnknown < arg.m_block_ids.size() && m_core.hasBlock(arg.m_block_ids[firstUnknown])) {
+    ++firstUnknown;
+  }
+
+  /* Download the blocks from all peers agreeing on them. A peer on another
+     chain than the one being downloaded gets the blocks on its own. */
+  if (firstUnknown < arg.m_block_ids.size() && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
+    const std::vector<Crypto::Hash> hashes(arg.m_block_ids.begin() + firstUnknown, arg.m_block_ids.end());
+
+    if (m_downloads.addChain(context.m_connection_id, arg.start_height + static_cast<uint32_t>(firstUnknown), hashes)) {
+      requestNextWindow(context);
+      wakeWaitingPeers();
+      return 1;
+    }
+
+    logger(Logging::DEBUGGING) << context << "Chain differs from the one being downloaded, synchronizing separately";
+    m_downloads.removePeer(context.m_connection_id);
+  }
+
   bool allBlocksKnown = true;
   for (auto& bl_id : arg.m_block_ids) {
     if (allBlocksKnown) {
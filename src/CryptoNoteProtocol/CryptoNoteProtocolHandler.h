@@ -9,9 +9,11 @@
 #include <atomic>
 
 #include <Common/ObserverManager.h>
+#include <Common/ThreadPool.h>
 
 #include "CryptoNoteCore/ICore.h"
 
+#include "CryptoNoteProtocol/BlockDownloadScheduler.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
 #include "CryptoNoteProtocol/CryptoNoteProtocolHandlerCommon.h"
 #include "CryptoNoteProtocol/ICryptoNoteProtocolObserver.h"
@@ -58,6 +60,7 @@ namespace CryptoNote
     virtual uint32_t getObservedHeight() const override;
     virtual uint32_t getBlockchainHeight() const override;
     void requestMissingPoolTransactions(const CryptoNoteConnectionContext& context);
+    void onIdle();
 
   private:
     //----------------- commands handlers ----------------------------------------------
@@ -82,6 +85,10 @@ namespace CryptoNote
     void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext& context);
     void recalculateMaxObservedHeight(const CryptoNoteConnectionContext& context);
     int processObjects(CryptoNoteConnectionContext& context, std::vector<RawBlock>&& rawBlocks, const std::vector<CachedBlock>& cachedBlocks);
+    void requestChain(CryptoNoteConnectionContext& context);
+    void requestNextWindow(CryptoNoteConnectionContext& context);
+    void wakeWaitingPeers();
+    void addDownloadedBlocks();
     Logging::LoggerRef logger;
 
 private:
@@ -105,6 +112,14 @@ private:
     uint32_t m_blockchainHeight;
 
     std::atomic<size_t> m_peersCount;
+
+    BlockDownloadScheduler m_downloads;
+    bool m_addingDownloadedBlocks;
+
+    /* Prepares the blocks of a batch ahead of the dispatcher adding them,
+       see processObjects() */
+    Common::ThreadPool m_prepareWorkers;
+
     Tools::ObserverManager<ICryptoNoteProtocolObserver> m_observerManager;
   };
 }
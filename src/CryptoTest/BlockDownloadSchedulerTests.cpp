@@ -0,0 +1,287 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "BlockDownloadSchedulerTests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/utility/value_init.hpp>
+
+#include "CryptoNoteProtocol/BlockDownloadScheduler.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+typedef BlockDownloadScheduler::Clock Clock;
+
+/* Blocks per window, and windows handed out ahead of the ones taken */
+const size_t windowSize = 4;
+const size_t windowsAhead = 3;
+
+const std::chrono::seconds windowTimeout(30);
+
+/* The chain starts at this height, the blocks before it being known */
+const uint32_t startHeight = 1;
+
+Crypto::Hash getHash(const size_t index)
+{
+    Crypto::Hash hash = Crypto::Hash();
+    hash.data[0] = static_cast<uint8_t>(index);
+    hash.data[1] = 0x5a;
+    return hash;
+}
+
+std::vector<Crypto::Hash> getHashes(const size_t first, const size_t count)
+{
+    std::vector<Crypto::Hash> hashes;
+
+    for (size_t i = first; i < first + count; i++)
+    {
+        hashes.push_back(getHash(i));
+    }
+
+    return hashes;
+}
+
+boost::uuids::uuid getPeer(const uint8_t id)
+{
+    boost::uuids::uuid peer = boost::uuids::nil_uuid();
+    peer.data[0] = id;
+    return peer;
+}
+
+/* A peer's answer to the window of count blocks from first, with the blocks
+   in the given order. The raw block and the template both carry the index
+   of the block, to check they come back in chain order. */
+bool completeWindow(
+    BlockDownloadScheduler &scheduler,
+    const boost::uuids::uuid &peer,
+    const size_t first,
+    const std::vector<size_t> &order,
+    const Clock::time_point now)
+{
+    std::vector<RawBlock> rawBlocks;
+    std::vector<BlockTemplate> blockTemplates;
+    std::vector<Crypto::Hash> blockHashes;
+
+    for (const size_t i : order)
+    {
+        RawBlock rawBlock;
+        rawBlock.block = {static_cast<uint8_t>(first + i)};
+        rawBlocks.push_back(rawBlock);
+
+        BlockTemplate blockTemplate = boost::value_initialized<BlockTemplate>();
+        blockTemplate.timestamp = first + i;
+        blockTemplates.push_back(blockTemplate);
+
+        blockHashes.push_back(getHash(first + i));
+    }
+
+    return scheduler.completeWindow(peer, std::move(rawBlocks), std::move(blockTemplates), blockHashes, now);
+}
+
+void checkAssigned(
+    BlockDownloadScheduler &scheduler,
+    const boost::uuids::uuid &peer,
+    const Clock::time_point now,
+    const size_t first,
+    const size_t count,
+    const std::string &what)
+{
+    std::vector<Crypto::Hash> hashes;
+
+    if (!scheduler.assignWindow(peer, now, hashes))
+    {
+        throw std::runtime_error("BlockDownloadScheduler gave no window " + what);
+    }
+
+    if (hashes != getHashes(first, count))
+    {
+        throw std::runtime_error("BlockDownloadScheduler gave the wrong window " + what);
+    }
+}
+
+void checkNotAssigned(BlockDownloadScheduler &scheduler, const boost::uuids::uuid &peer, const Clock::time_point now, const std::string &what)
+{
+    std::vector<Crypto::Hash> hashes;
+
+    if (scheduler.assignWindow(peer, now, hashes))
+    {
+        throw std::runtime_error("BlockDownloadScheduler gave a window " + what);
+    }
+}
+
+void checkTaken(
+    BlockDownloadScheduler &scheduler,
+    const boost::uuids::uuid &expectedPeer,
+    const size_t first,
+    const size_t count,
+    const std::string &what)
+{
+    boost::uuids::uuid peer;
+    std::vector<RawBlock> rawBlocks;
+    std::vector<BlockTemplate> blockTemplates;
+
+    if (!scheduler.takeNextWindow(peer, rawBlocks, blockTemplates))
+    {
+        throw std::runtime_error("BlockDownloadScheduler had no window to take " + what);
+    }
+
+    if (peer != expectedPeer || rawBlocks.size() != count || blockTemplates.size() != count)
+    {
+        throw std::runtime_error("BlockDownloadScheduler gave back the wrong window " + what);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (rawBlocks[i].block != BinaryArray{static_cast<uint8_t>(first + i)} || blockTemplates[i].timestamp != first + i)
+        {
+            throw std::runtime_error("BlockDownloadScheduler gave back blocks out of chain order " + what);
+        }
+    }
+}
+
+void checkNotTaken(BlockDownloadScheduler &scheduler, const std::string &what)
+{
+    boost::uuids::uuid peer;
+    std::vector<RawBlock> rawBlocks;
+    std::vector<BlockTemplate> blockTemplates;
+
+    if (scheduler.takeNextWindow(peer, rawBlocks, blockTemplates))
+    {
+        throw std::runtime_error("BlockDownloadScheduler gave back a window " + what);
+    }
+}
+
+}
+
+void testBlockDownloadScheduler()
+{
+    BlockDownloadScheduler scheduler(windowSize, windowsAhead, windowTimeout);
+
+    /* 14 blocks, so windows of 0-3, 4-7, 8-11 and 12-13. Peer b only has the
+       first two windows. */
+    const size_t blockCount = 14;
+
+    const auto a = getPeer(1);
+    const auto b = getPeer(2);
+    const auto c = getPeer(3);
+    const auto d = getPeer(4);
+
+    if (!scheduler.addChain(a, startHeight, getHashes(0, blockCount))
+     || !scheduler.addChain(b, startHeight, getHashes(0, 8))
+     || !scheduler.addChain(c, startHeight, getHashes(0, blockCount))
+     || !scheduler.addChain(d, startHeight, getHashes(0, blockCount)))
+    {
+        throw std::runtime_error("BlockDownloadScheduler rejected a chain");
+    }
+
+    const auto start = Clock::now();
+
+    /* Assignment: each peer gets the first pending window it has all the
+       blocks of, one at a time, and never further ahead than allowed */
+    checkAssigned(scheduler, b, start, 0, windowSize, "to the first peer");
+    checkNotAssigned(scheduler, b, start, "to a peer still answering one");
+    checkNotAssigned(scheduler, getPeer(5), start, "to a peer without a chain");
+    checkAssigned(scheduler, a, start, 4, windowSize, "to the second peer");
+    checkAssigned(scheduler, c, start, 8, windowSize, "to the third peer");
+    checkNotAssigned(scheduler, d, start, "past the windows allowed ahead");
+
+    if (scheduler.isPeerWaiting(a) || !scheduler.isPeerWaiting(d))
+    {
+        throw std::runtime_error("BlockDownloadScheduler got which peers are waiting wrong");
+    }
+
+    /* Completion out of order: nothing is given back before the first
+       window arrives, and the blocks of each window come back in order */
+    if (!completeWindow(scheduler, c, 8, {3, 2, 1, 0}, start + std::chrono::seconds(2)))
+    {
+        throw std::runtime_error("BlockDownloadScheduler rejected the third window");
+    }
+
+    checkNotTaken(scheduler, "before the first window arrived");
+
+    if (!completeWindow(scheduler, a, 4, {1, 3, 0, 2}, start + std::chrono::seconds(4)))
+    {
+        throw std::runtime_error("BlockDownloadScheduler rejected the second window");
+    }
+
+    checkNotTaken(scheduler, "before the first window arrived");
+
+    if (completeWindow(scheduler, b, 0, {0, 1, 2, 4}, start + std::chrono::seconds(4)))
+    {
+        throw std::runtime_error("BlockDownloadScheduler accepted a block from another window");
+    }
+
+    if (!completeWindow(scheduler, b, 0, {2, 0, 3, 1}, start + std::chrono::seconds(5)))
+    {
+        throw std::runtime_error("BlockDownloadScheduler rejected the first window");
+    }
+
+    checkTaken(scheduler, b, 0, windowSize, "first");
+    checkTaken(scheduler, a, 4, windowSize, "second");
+    checkTaken(scheduler, c, 8, windowSize, "third");
+    checkNotTaken(scheduler, "before the last window was requested");
+
+    const auto statistics = scheduler.getPeerStatistics(c);
+
+    if (statistics == nullptr || statistics->blocksReceived != windowSize || statistics->downloadTime != std::chrono::seconds(2))
+    {
+        throw std::runtime_error("BlockDownloadScheduler got the peer statistics wrong");
+    }
+
+    /* Expiry and reassignment: the last window times out at d, d is free
+       again, the window goes to a, and d's late answer is thrown away */
+    const auto requested = start + std::chrono::seconds(10);
+
+    checkAssigned(scheduler, d, requested, 12, 2, "once the windows before it were taken");
+
+    if (!scheduler.expireWindows(requested + windowTimeout - std::chrono::seconds(1)).empty())
+    {
+        throw std::runtime_error("BlockDownloadScheduler expired a window before the timeout");
+    }
+
+    const auto expired = scheduler.expireWindows(requested + windowTimeout);
+
+    if (expired != std::vector<boost::uuids::uuid>{d})
+    {
+        throw std::runtime_error("BlockDownloadScheduler didn't expire the window at the timeout");
+    }
+
+    if (!scheduler.isPeerWaiting(d) || scheduler.getPeerStatistics(d)->windowsTimedOut != 1)
+    {
+        throw std::runtime_error("BlockDownloadScheduler still counts a peer as busy after its window timed out");
+    }
+
+    checkAssigned(scheduler, a, requested + windowTimeout, 12, 2, "after it timed out");
+
+    if (completeWindow(scheduler, d, 12, {0, 1}, requested + windowTimeout))
+    {
+        throw std::runtime_error("BlockDownloadScheduler accepted an answer after the window timed out");
+    }
+
+    checkNotTaken(scheduler, "from an answer after the window timed out");
+
+    /* A peer leaving puts its window back too */
+    scheduler.removePeer(a);
+    checkAssigned(scheduler, c, requested + windowTimeout, 12, 2, "after its peer left");
+
+    if (!completeWindow(scheduler, c, 12, {1, 0}, requested + windowTimeout))
+    {
+        throw std::runtime_error("BlockDownloadScheduler rejected the reassigned window");
+    }
+
+    checkTaken(scheduler, c, 12, 2, "reassigned");
+
+    if (!scheduler.empty())
+    {
+        throw std::runtime_error("BlockDownloadScheduler kept windows after all were taken");
+    }
+
+    std::cout << "BlockDownloadScheduler assigns, reorders and reassigns windows" << std::endl;
+}
@@ -0,0 +1,11 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Hands windows of a chain to several peers, completes them out of order
+   and lets some time out. Throws if a window goes to the wrong peer, if the
+   blocks come back out of chain order, or if a timed out window isn't given
+   to another peer. */
+void testBlockDownloadScheduler();
@@ -0,0 +1,732 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "CoreTests.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Common/StringTools.h"
+#include "CryptoNoteCore/AddBlockErrorCondition.h"
+#include "CryptoNoteCore/Checkpoints.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/DatabaseBlockchainCacheFactory.h"
+#include "CryptoNoteCore/IMainChainStorage.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "CryptoNoteCore/TransactionPool.h"
+#include "Logging/ConsoleLogger.h"
+#include "MemoryDataBase.h"
+#include "System/Dispatcher.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+/* Every block the tests mine is below this, so they need no proof of work,
+   and transactions are only checked for their amounts and key images */
+const uint32_t CHECKPOINT_INDEX = 1000000;
+
+/* Keeps the blocks in a vector owned by the TestNode, so another Core can be
+   loaded from a copy of them */
+class MemoryMainChainStorage : public IMainChainStorage
+{
+    public:
+        explicit MemoryMainChainStorage(std::vector<RawBlock> &blocks) : m_blocks(blocks)
+        {
+        }
+
+        virtual void pushBlock(const RawBlock &rawBlock) override
+        {
+            m_blocks.push_back(rawBlock);
+        }
+
+        virtual void popBlock() override
+        {
+            m_blocks.pop_back();
+        }
+
+        virtual RawBlock getBlockByIndex(uint32_t index) const override
+        {
+            return m_blocks.at(index);
+        }
+
+        virtual uint32_t getBlockCount() const override
+        {
+            return static_cast<uint32_t>(m_blocks.size());
+        }
+
+        virtual void prefetchBlocks(uint32_t startIndex, uint32_t count) const override
+        {
+        }
+
+        virtual void clear() override
+        {
+            m_blocks.clear();
+        }
+
+    private:
+        std::vector<RawBlock> &m_blocks;
+};
+
+/* A Core with its chain and database held in memory */
+class TestNode
+{
+    public:
+        TestNode(const Currency &currency, System::Dispatcher &dispatcher, std::shared_ptr<Logging::ILogger> logger) :
+            m_currency(currency),
+            m_dispatcher(dispatcher),
+            m_logger(logger)
+        {
+            m_blocks.push_back(RawBlock{toBinaryArray(currency.genesisBlock()), {}});
+            start();
+        }
+
+        /* Loads a new Core from a copy of other's chain, and gives it the
+           same pool, so nothing it returns has been cached yet */
+        TestNode(const TestNode &other) :
+            m_currency(other.m_currency),
+            m_dispatcher(other.m_dispatcher),
+            m_logger(other.m_logger),
+            m_database(other.m_database),
+            m_blocks(other.m_blocks)
+        {
+            start();
+
+            for (const auto &hash : other.core().getPoolTransactionHashes())
+            {
+                addTransaction(std::get<1>(other.core().getPoolTransaction(hash)));
+            }
+        }
+
+        Core &core() const
+        {
+            return *m_core;
+        }
+
+        void addTransaction(const BinaryArray &transaction)
+        {
+            if (!m_core->addTransactionToPool(transaction))
+            {
+                throw std::runtime_error("Core rejected a transaction from the pool");
+            }
+        }
+
+    private:
+        void start()
+        {
+            Checkpoints checkpoints(m_logger);
+            checkpoints.addCheckpoint(CHECKPOINT_INDEX, Common::podToHex(Crypto::Hash()));
+
+            m_core.reset(new Core(
+                m_currency,
+                m_logger,
+                std::move(checkpoints),
+                m_dispatcher,
+                std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(m_database, m_logger)),
+                std::unique_ptr<IMainChainStorage>(new MemoryMainChainStorage(m_blocks))
+            ));
+
+            m_core->load();
+        }
+
+        const Currency &m_currency;
+        System::Dispatcher &m_dispatcher;
+        std::shared_ptr<Logging::ILogger> m_logger;
+
+        MemoryDataBase m_database;
+        std::vector<RawBlock> m_blocks;
+
+        /* Last, so it goes before the storage it uses */
+        std::unique_ptr<Core> m_core;
+};
+
+struct Template
+{
+    BlockTemplate block;
+    uint64_t difficulty = 0;
+    uint32_t height = 0;
+};
+
+Template getTemplate(const TestNode &node, const AccountPublicAddress &address, const BinaryArray &extraNonce = {})
+{
+    Template result;
+
+    if (!node.core().getBlockTemplate(result.block, address, extraNonce, result.difficulty, result.height))
+    {
+        throw std::runtime_error("Core failed to create a block template");
+    }
+
+    return result;
+}
+
+void submitBlock(TestNode &node, const BlockTemplate &block)
+{
+    if (node.core().submitBlock(toBinaryArray(block)) != error::AddBlockErrorCondition::BLOCK_ADDED)
+    {
+        throw std::runtime_error("Core rejected a block made from its block template");
+    }
+}
+
+AccountPublicAddress generateAddress()
+{
+    AccountPublicAddress address;
+    Crypto::SecretKey secretKey;
+
+    Crypto::generate_keys(address.spendPublicKey, secretKey);
+    Crypto::generate_keys(address.viewPublicKey, secretKey);
+
+    return address;
+}
+
+/* Spends an output which doesn't exist, which is fine below a checkpoint.
+   Outputs are added until the transaction is close to size bytes. */
+Transaction makeTransaction(const uint64_t fee, const size_t size = 0)
+{
+    const uint64_t amount = 1000000;
+
+    Transaction transaction;
+    transaction.version = CURRENT_TRANSACTION_VERSION;
+    transaction.unlockTime = 0;
+
+    Crypto::PublicKey publicKey;
+    Crypto::SecretKey secretKey;
+
+    Crypto::generate_keys(publicKey, secretKey);
+    addTransactionPublicKeyToExtra(transaction.extra, publicKey);
+
+    KeyInput input;
+    input.amount = amount + fee;
+    input.outputIndexes = {0};
+
+    Crypto::generate_keys(publicKey, secretKey);
+    Crypto::generate_key_image(publicKey, secretKey, input.keyImage);
+
+    KeyOutput output;
+    Crypto::generate_keys(output.key, secretKey);
+
+    transaction.inputs.push_back(input);
+    transaction.outputs.push_back(TransactionOutput{amount, output});
+    transaction.signatures.push_back({Crypto::Signature()});
+
+    /* Each output of 1 adds about 34 bytes, and is paid for out of the first */
+    while (getObjectBinarySize(transaction) + 35 <= size)
+    {
+        Crypto::generate_keys(output.key, secretKey);
+        transaction.outputs.push_back(TransactionOutput{1, output});
+        transaction.outputs.front().amount--;
+    }
+
+    return transaction;
+}
+
+BinaryArray generateTransaction(const uint64_t fee)
+{
+    return toBinaryArray(makeTransaction(fee));
+}
+
+bool sameBlock(const BlockTemplate &a, BlockTemplate b)
+{
+    b.timestamp = a.timestamp;
+    return toBinaryArray(a) == toBinaryArray(b);
+}
+
+/* Compares a template to the one a fresh Core loaded from the same chain
+   and pool creates. The miner transaction has a random key, so only its
+   amounts are compared, and the transactions may be in another order. */
+void checkTemplate(const TestNode &node, const Template &actual, const AccountPublicAddress &address,
+                   const BinaryArray &extraNonce, const std::string &when)
+{
+    const TestNode fresh(node);
+    const Template expected = getTemplate(fresh, address, extraNonce);
+
+    const std::unordered_set<Crypto::Hash> actualHashes(
+        actual.block.transactionHashes.begin(), actual.block.transactionHashes.end()
+    );
+
+    const std::unordered_set<Crypto::Hash> expectedHashes(
+        expected.block.transactionHashes.begin(), expected.block.transactionHashes.end()
+    );
+
+    const auto &actualMiner = actual.block.baseTransaction;
+    const auto &expectedMiner = expected.block.baseTransaction;
+
+    if (actual.height != expected.height || actual.difficulty != expected.difficulty
+     || actual.block.majorVersion != expected.block.majorVersion
+     || actual.block.minorVersion != expected.block.minorVersion
+     || actual.block.previousBlockHash != expected.block.previousBlockHash
+     || actual.block.timestamp < expected.block.timestamp - 60
+     || actualHashes != expectedHashes
+     || actualMiner.unlockTime != expectedMiner.unlockTime
+     || actualMiner.inputs.size() != 1 || expectedMiner.inputs.size() != 1
+     || boost::get<BaseInput>(actualMiner.inputs[0]).blockIndex != boost::get<BaseInput>(expectedMiner.inputs[0]).blockIndex
+     || actualMiner.outputs.size() != expectedMiner.outputs.size()
+     || getOutputAmount(actualMiner) != getOutputAmount(expectedMiner))
+    {
+        throw std::runtime_error("Core returned a block template " + when + " which differs from a freshly built one");
+    }
+
+    if (actual.height != node.core().getTopBlockIndex() + 1 || actual.block.previousBlockHash != node.core().getTopBlockHash())
+    {
+        throw std::runtime_error("Core returned a block template " + when + " which isn't on the top block");
+    }
+}
+
+}
+
+void testBlockTemplateCache()
+{
+    System::Dispatcher dispatcher;
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    TestNode node(currency, dispatcher, logger);
+
+    const AccountPublicAddress alice = generateAddress();
+    const AccountPublicAddress bob = generateAddress();
+    const BinaryArray extraNonce = {1, 2, 3, 4};
+
+    /* Past the block version upgrades */
+    for (size_t i = 0; i < 8; i++)
+    {
+        const Template block = getTemplate(node, alice);
+        checkTemplate(node, block, alice, {}, "after a new block");
+        submitBlock(node, block.block);
+    }
+
+    /* The same address again reuses the miner transaction, which has a
+       random key, so a rebuilt one would differ */
+    const Template first = getTemplate(node, alice);
+    const Template second = getTemplate(node, alice);
+
+    if (!sameBlock(first.block, second.block))
+    {
+        throw std::runtime_error("Core didn't reuse the block template for a repeated request");
+    }
+
+    checkTemplate(node, second, alice, {}, "from the cache");
+
+    /* Another address or extra nonce gets its own miner transaction */
+    const Template forBob = getTemplate(node, bob);
+    const Template withNonce = getTemplate(node, bob, extraNonce);
+
+    if (sameBlock(second.block, forBob.block) || sameBlock(forBob.block, withNonce.block))
+    {
+        throw std::runtime_error("Core reused a block template for another address or extra nonce");
+    }
+
+    checkTemplate(node, forBob, bob, {}, "for another address");
+    checkTemplate(node, withNonce, bob, extraNonce, "with an extra nonce");
+
+    /* Transactions entering the pool are added to the cached template */
+    for (uint64_t fee = 10; fee < 60; fee += 10)
+    {
+        node.addTransaction(generateTransaction(fee));
+
+        const Template block = getTemplate(node, alice);
+
+        if (block.block.transactionHashes.size() != fee / 10)
+        {
+            throw std::runtime_error("Core's block template is missing a transaction added to the pool");
+        }
+
+        checkTemplate(node, block, alice, {}, "after a transaction was added to the pool");
+    }
+
+    const Template withTransactions = getTemplate(node, alice);
+
+    if (!sameBlock(withTransactions.block, getTemplate(node, alice).block))
+    {
+        throw std::runtime_error("Core didn't reuse the block template with transactions for a repeated request");
+    }
+
+    /* Arrives after the template was handed out, so it stays in the pool
+       when the block is mined and the others leave it */
+    const BinaryArray late = generateTransaction(100);
+    node.addTransaction(late);
+
+    submitBlock(node, withTransactions.block);
+
+    const Template afterBlock = getTemplate(node, alice);
+
+    if (afterBlock.block.transactionHashes != std::vector<Crypto::Hash>{getBinaryArrayHash(late)})
+    {
+        throw std::runtime_error("Core's block template after a block doesn't hold just the transaction left in the pool");
+    }
+
+    checkTemplate(node, afterBlock, alice, {}, "after a block with transactions");
+
+    submitBlock(node, afterBlock.block);
+    checkTemplate(node, getTemplate(node, bob), bob, {}, "after the pool was emptied");
+
+    std::cout << "Core block templates match freshly built ones after new blocks and transactions" << std::endl;
+}
+
+void testTransactionPool()
+{
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+
+    /* The key image index against a map of which pool transaction spends
+       each key image, over random pushes and removals. The key images come
+       from a small set, so many pushes are double spends. */
+    {
+        TransactionPool pool(logger);
+
+        std::mt19937_64 random(std::random_device{}());
+
+        std::vector<Crypto::KeyImage> keyImages(16);
+
+        for (auto &keyImage : keyImages)
+        {
+            Crypto::PublicKey publicKey;
+            Crypto::SecretKey secretKey;
+
+            Crypto::generate_keys(publicKey, secretKey);
+            Crypto::generate_key_image(publicKey, secretKey, keyImage);
+        }
+
+        std::unordered_map<Crypto::KeyImage, Crypto::Hash> spentBy;
+        std::vector<Transaction> transactions;
+
+        for (uint64_t i = 0; i < 5000; i++)
+        {
+            if (!transactions.empty() && random() % 3 == 0)
+            {
+                const size_t index = random() % transactions.size();
+                const CachedTransaction transaction(transactions[index]);
+
+                if (random() % 4 == 0)
+                {
+                    TransactionValidatorState state;
+
+                    for (const auto &input : transaction.getTransaction().inputs)
+                    {
+                        state.spentKeyImages.insert(boost::get<KeyInput>(input).keyImage);
+                    }
+
+                    if (pool.pushTransaction(CachedTransaction(transaction), std::move(state)))
+                    {
+                        throw std::runtime_error("TransactionPool accepted a transaction it already holds");
+                    }
+                }
+                else
+                {
+                    if (!pool.removeTransaction(transaction.getTransactionHash()) || pool.removeTransaction(transaction.getTransactionHash()))
+                    {
+                        throw std::runtime_error("TransactionPool failed to remove a transaction exactly once");
+                    }
+
+                    for (const auto &input : transaction.getTransaction().inputs)
+                    {
+                        spentBy.erase(boost::get<KeyInput>(input).keyImage);
+                    }
+
+                    transactions.erase(transactions.begin() + index);
+                }
+            }
+            else
+            {
+                /* Up to three distinct key images */
+                Transaction transaction;
+                transaction.version = CURRENT_TRANSACTION_VERSION;
+                transaction.unlockTime = i;
+
+                TransactionValidatorState state;
+                bool spent = false;
+
+                for (size_t j = 1 + random() % 3; j > 0; j--)
+                {
+                    KeyInput input;
+                    input.amount = 1;
+                    input.outputIndexes = {0};
+                    input.keyImage = keyImages[random() % keyImages.size()];
+
+                    if (state.spentKeyImages.insert(input.keyImage).second)
+                    {
+                        spent = spent || spentBy.count(input.keyImage) != 0;
+                        transaction.inputs.push_back(input);
+                        transaction.signatures.push_back({Crypto::Signature()});
+                    }
+                }
+
+                const CachedTransaction cachedTransaction(transaction);
+
+                if (pool.pushTransaction(CachedTransaction(cachedTransaction), std::move(state)) == spent)
+                {
+                    throw std::runtime_error(spent ? "TransactionPool accepted a double spend" : "TransactionPool rejected a transaction");
+                }
+
+                if (!spent)
+                {
+                    for (const auto &input : transaction.inputs)
+                    {
+                        spentBy[boost::get<KeyInput>(input).keyImage] = cachedTransaction.getTransactionHash();
+                    }
+
+                    transactions.push_back(transaction);
+                }
+            }
+
+            if (pool.getTransactionCount() != transactions.size()
+             || pool.getPoolTransactionValidationState().spentKeyImages.size() != spentBy.size())
+            {
+                throw std::runtime_error("TransactionPool holds other transactions or key images than were pushed");
+            }
+
+            for (const auto &keyImage : keyImages)
+            {
+                TransactionValidatorState state;
+                state.spentKeyImages.insert(keyImage);
+
+                const auto it = spentBy.find(keyImage);
+                const std::vector<Crypto::Hash> expected = it != spentBy.end() ? std::vector<Crypto::Hash>{it->second} : std::vector<Crypto::Hash>{};
+
+                if (pool.getConflictingTransactionHashes(state) != expected)
+                {
+                    throw std::runtime_error("TransactionPool's key image index is out of step with its transactions");
+                }
+            }
+        }
+    }
+
+    System::Dispatcher dispatcher;
+
+    /* A block spending a key image a pool transaction spends removes just
+       that transaction from the pool */
+    {
+        const Currency currency = CurrencyBuilder(logger).currency();
+
+        TestNode node(currency, dispatcher, logger);
+
+        const AccountPublicAddress address = generateAddress();
+
+        for (size_t i = 0; i < 8; i++)
+        {
+            submitBlock(node, getTemplate(node, address).block);
+        }
+
+        TestNode other(node);
+
+        const Transaction spend = makeTransaction(10);
+        const Transaction unrelated = makeTransaction(10);
+
+        /* The same input, paying someone else */
+        Transaction doubleSpend = makeTransaction(20);
+        doubleSpend.inputs = spend.inputs;
+        boost::get<KeyInput>(doubleSpend.inputs[0]).amount += 10;
+
+        node.addTransaction(toBinaryArray(spend));
+        node.addTransaction(toBinaryArray(unrelated));
+        other.addTransaction(toBinaryArray(doubleSpend));
+
+        const Template block = getTemplate(other, address);
+        submitBlock(other, block.block);
+
+        if (node.core().addBlock(RawBlock{toBinaryArray(block.block), {toBinaryArray(doubleSpend)}})
+            != error::AddBlockErrorCondition::BLOCK_ADDED)
+        {
+            throw std::runtime_error("Core rejected a block from another node");
+        }
+
+        if (node.core().getPoolTransactionHashes() != std::vector<Crypto::Hash>{getObjectHash(unrelated)})
+        {
+            throw std::runtime_error("Core didn't remove exactly the pool transaction a new block conflicts with");
+        }
+    }
+
+    /* A transaction allowed in while the median block size was raised is
+       removed once the median falls back and it is too big. The sizes are
+       small so a few blocks move the median: transactions may be up to
+       twice the median less 100 bytes, and templates hold 1.25 times the
+       median less 100 bytes, the median being at least 1000 bytes. */
+    {
+        const Currency currency = CurrencyBuilder(logger)
+            .blockGrantedFullRewardZone(1000)
+            .minerTxBlobReservedSize(100)
+            .rewardBlocksWindow(3)
+            .currency();
+
+        TestNode node(currency, dispatcher, logger);
+
+        const AccountPublicAddress address = generateAddress();
+
+        for (size_t i = 0; i < 8; i++)
+        {
+            submitBlock(node, getTemplate(node, address).block);
+        }
+
+        /* Two blocks of over 1100 bytes raise the median, allowing about
+           2100 bytes, but no more than 1900 once it is back at 1000 */
+        for (size_t i = 0; i < 2; i++)
+        {
+            node.addTransaction(toBinaryArray(makeTransaction(10, 1000)));
+
+            const Template block = getTemplate(node, address);
+
+            if (block.block.transactionHashes.size() != 1)
+            {
+                throw std::runtime_error("Core's block template is missing a transaction which fits");
+            }
+
+            submitBlock(node, block.block);
+        }
+
+        const Transaction big = makeTransaction(10, 2050);
+
+        if (getObjectBinarySize(big) <= 2000)
+        {
+            throw std::runtime_error("Generated a transaction smaller than asked for");
+        }
+
+        node.addTransaction(toBinaryArray(big));
+
+        /* Too big for a template, so it stays in the pool while the small
+           blocks push the others out of the median */
+        const std::vector<Crypto::Hash> bigHashes = {getObjectHash(big)};
+
+        submitBlock(node, getTemplate(node, address).block);
+
+        if (node.core().getPoolTransactionHashes() != bigHashes)
+        {
+            throw std::runtime_error("Core removed a pool transaction which is still small enough");
+        }
+
+        submitBlock(node, getTemplate(node, address).block);
+
+        if (!node.core().getPoolTransactionHashes().empty())
+        {
+            throw std::runtime_error("Core kept a pool transaction which is too big since the median block size fell");
+        }
+    }
+
+    std::cout << "TransactionPool key image index and evictions by conflict and size are correct" << std::endl;
+}
+
+void testWalletSyncDataLimits()
+{
+    System::Dispatcher dispatcher;
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    TestNode node(currency, dispatcher, logger);
+
+    const AccountPublicAddress alice = generateAddress();
+
+    /* Blocks follow each other quickly, so few are mined before the
+       difficulty gets in the way */
+    for (size_t i = 0; i < 8; i++)
+    {
+        submitBlock(node, getTemplate(node, alice).block);
+    }
+
+    /* The heights of the blocks returned for a request of count blocks from
+       startHeight */
+    const auto getHeights = [&node](const uint64_t startHeight, const uint64_t count)
+    {
+        std::vector<WalletTypes::WalletBlockInfo> blocks;
+
+        if (!node.core().getWalletSyncData({}, startHeight, 0, count, blocks))
+        {
+            throw std::runtime_error("Core failed to return wallet sync data");
+        }
+
+        std::vector<uint64_t> heights;
+
+        for (const auto &block : blocks)
+        {
+            heights.push_back(block.blockHeight);
+        }
+
+        return heights;
+    };
+
+    const auto expectHeights = [&getHeights](const uint64_t startHeight, const uint64_t count,
+                                             const uint64_t expectedCount, const std::string &when)
+    {
+        std::vector<uint64_t> expected(expectedCount);
+        std::iota(expected.begin(), expected.end(), startHeight);
+
+        if (getHeights(startHeight, count) != expected)
+        {
+            throw std::runtime_error("Core returned the wrong wallet sync data blocks " + when);
+        }
+    };
+
+    /* The default limits don't get in the way of a small chain */
+    expectHeights(1, 100, 8, "with the default limits");
+
+    node.core().setWalletSyncDataLimits(5, WALLET_SYNC_DATA_MAX_RESPONSE_MB_DEFAULT_SIZE * 1024 * 1024);
+    expectHeights(1, 100, 5, "with a block count limit");
+    expectHeights(3, 2, 2, "asking for fewer blocks than the limit");
+
+    /* A single block is always returned, however large */
+    node.core().setWalletSyncDataLimits(100, 1);
+    expectHeights(4, 100, 1, "with a response size limit");
+
+    std::cout << "Core limits wallet sync data by block count and response size" << std::endl;
+}
+
+void benchmarkBlockTemplateCache()
+{
+    System::Dispatcher dispatcher;
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    TestNode node(currency, dispatcher, logger);
+
+    const AccountPublicAddress address = generateAddress();
+
+    /* The blocks all get about the same timestamp, which the difficulty
+       algorithm doesn't cope with for long */
+    for (size_t i = 0; i < 8; i++)
+    {
+        submitBlock(node, getTemplate(node, address).block);
+    }
+
+    for (uint64_t i = 0; i < 200; i++)
+    {
+        node.addTransaction(generateTransaction(10 + i));
+    }
+
+    const auto timeTemplates = [&address](const std::vector<const TestNode *> &nodes)
+    {
+        const auto startTimer = std::chrono::high_resolution_clock::now();
+
+        for (const auto testNode : nodes)
+        {
+            getTemplate(*testNode, address);
+        }
+
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - startTimer
+        ).count() / static_cast<double>(nodes.size());
+    };
+
+    /* The first request on a freshly loaded Core builds the whole template */
+    std::vector<std::unique_ptr<TestNode>> freshNodes;
+    std::vector<const TestNode *> fresh;
+
+    for (size_t i = 0; i < 20; i++)
+    {
+        freshNodes.emplace_back(new TestNode(node));
+        fresh.push_back(freshNodes.back().get());
+    }
+
+    const double rebuiltTime = timeTemplates(fresh);
+
+    getTemplate(node, address);
+
+    const double cachedTime = timeTemplates(std::vector<const TestNode *>(1000, &node));
+
+    std::cout << "Time to get a block template with 200 pool transactions: " << cachedTime << " us ("
+              << rebuiltTime << " us building it from scratch)" << std::endl;
+}
@@ -0,0 +1,24 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Mines blocks and adds pool transactions on a Core backed by memory, and
+   checks each block template it hands out against one built from scratch
+   by a fresh Core loaded from the same chain and pool. Also checks repeated
+   requests reuse the cached template. Throws on any difference. */
+void testBlockTemplateCache();
+
+/* Pushes and removes random transactions, many of them double spends, and
+   checks the pool's key image index against what was pushed after each.
+   Then checks a Core drops the pool transaction a new block conflicts with,
+   and one which became too big when the median block size fell. */
+void testTransactionPool();
+
+/* Mines some blocks and asks a Core for wallet sync data with its default
+   limits, then with a lower block count and response size limit. Throws if
+   more or other blocks come back than the limits allow. */
+void testWalletSyncDataLimits();
+
+void benchmarkBlockTemplateCache();
@@ -0,0 +1,460 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "DatabaseBlockchainCacheTests.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <boost/utility/value_init.hpp>
+
+#include "CryptoNoteCore/BufferedDataBase.h"
+#include "CryptoNoteCore/CachedBlock.h"
+#include "CryptoNoteCore/CachedTransaction.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/DatabaseBlockchainCacheFactory.h"
+#include "CryptoNoteCore/DBUtils.h"
+#include "CryptoNoteCore/IBlockchainCache.h"
+#include "CryptoNoteCore/RocksDBWrapper.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "CryptoNoteCore/TransactionValidatiorState.h"
+#include "Common/FileSystemShim.h"
+#include "Common/StringTools.h"
+#include "Logging/ConsoleLogger.h"
+#include "MemoryDataBase.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+/* Adds a block with transactionCount transactions carrying paymentId, and
+   returns their hashes */
+std::vector<Crypto::Hash> pushBlock(IBlockchainCache &cache, const Crypto::Hash &paymentId, size_t transactionCount)
+{
+    const uint32_t blockIndex = cache.getTopBlockIndex() + 1;
+
+    BlockTemplate block = boost::value_initialized<BlockTemplate>();
+    block.majorVersion = BLOCK_MAJOR_VERSION_1;
+    block.previousBlockHash = cache.getTopBlockHash();
+    block.timestamp = 1000000 + blockIndex;
+    block.baseTransaction.version = CURRENT_TRANSACTION_VERSION;
+    block.baseTransaction.unlockTime = blockIndex;
+    block.baseTransaction.inputs.push_back(BaseInput{blockIndex});
+
+    BinaryArray extraNonce;
+    setPaymentIdToTransactionExtraNonce(extraNonce, paymentId);
+
+    std::vector<CachedTransaction> transactions;
+    RawBlock rawBlock;
+
+    for (size_t i = 0; i < transactionCount; i++)
+    {
+        Transaction transaction;
+        transaction.version = CURRENT_TRANSACTION_VERSION;
+        /* Gives each transaction its own hash */
+        transaction.unlockTime = blockIndex * 1000 + i;
+        addExtraNonceToTransactionExtra(transaction.extra, extraNonce);
+
+        transactions.emplace_back(transaction);
+        block.transactionHashes.push_back(transactions.back().getTransactionHash());
+        rawBlock.transactions.push_back(toBinaryArray(transaction));
+    }
+
+    rawBlock.block = toBinaryArray(block);
+
+    size_t blockSize = getObjectBinarySize(block.baseTransaction);
+
+    for (const auto &transaction : transactions)
+    {
+        blockSize += transaction.getTransactionBinaryArray().size();
+    }
+
+    cache.pushBlock(CachedBlock(block), transactions, TransactionValidatorState(), blockSize, 0, 1, std::move(rawBlock));
+
+    return block.transactionHashes;
+}
+
+void checkPaymentIdHashes(
+    const IBlockchainCache &cache,
+    MemoryDataBase &database,
+    const Crypto::Hash &paymentId,
+    const std::vector<Crypto::Hash> &expected,
+    const std::string &when)
+{
+    if (cache.getTransactionHashesByPaymentId(paymentId) != expected)
+    {
+        throw std::runtime_error("DatabaseBlockchainCache returned the wrong transaction hashes for a payment id " + when);
+    }
+
+    /* Every (paymentId, index) key, but not the count key */
+    const std::string keyStart = DB::getCommonKeyStart(
+        DB::serializeKey(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, uint32_t(0))),
+        DB::serializeKey(DB::PAYMENT_ID_TO_TX_HASH_PREFIX, std::make_pair(paymentId, std::numeric_limits<uint32_t>::max()))
+    );
+
+    size_t keys = 0;
+
+    database.iteratePrefix(keyStart, [&keys](const std::string &, const std::string &)
+    {
+        keys++;
+        return true;
+    });
+
+    if (keys != expected.size())
+    {
+        throw std::runtime_error("DatabaseBlockchainCache left " + std::to_string(keys) + " payment id keys for "
+                               + std::to_string(expected.size()) + " transactions " + when);
+    }
+}
+
+class TestWriteBatch : public IWriteBatch
+{
+    public:
+        std::vector<std::pair<std::string, std::string>> inserts;
+        std::vector<std::string> removals;
+
+        virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override
+        {
+            return inserts;
+        }
+
+        virtual std::vector<std::string> extractRawKeysToRemove() override
+        {
+            return removals;
+        }
+};
+
+class TestReadBatch : public IReadBatch
+{
+    public:
+        std::vector<std::string> keys;
+        std::vector<std::string> values;
+        std::vector<bool> found;
+
+        virtual std::vector<std::string> getRawKeys() const override
+        {
+            return keys;
+        }
+
+        virtual void submitRawResult(const std::vector<std::string> &values, const std::vector<bool> &resultStates) override
+        {
+            this->values = values;
+            found = resultStates;
+        }
+};
+
+typedef std::vector<std::pair<std::string, std::string>> KeyValues;
+
+/* Every key and value in the database, in raw key order */
+KeyValues getContents(IDataBase &database)
+{
+    KeyValues contents;
+
+    database.iteratePrefix("", [&contents](const std::string &key, const std::string &value)
+    {
+        contents.emplace_back(key, value);
+        return true;
+    });
+
+    return contents;
+}
+
+/* The first count keys iterate() or iteratePrefix() visit */
+KeyValues getVisited(const std::function<void(const IDataBase::IterateFunction &)> &iterate, const size_t count)
+{
+    KeyValues visited;
+
+    iterate([&visited, count](const std::string &key, const std::string &value)
+    {
+        visited.emplace_back(key, value);
+        return visited.size() < count;
+    });
+
+    return visited;
+}
+
+}
+
+void testPaymentIdsAfterSplit()
+{
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    MemoryDataBase database;
+    DatabaseBlockchainCacheFactory factory(database, logger);
+
+    auto cache = factory.createRootBlockchainCache(currency);
+
+    Crypto::Hash paymentId;
+    Common::podFromHex("2b3c9e7e6ba5a84e2c4d0a3e3b0c8f6b5d3f7e1a9c2b4d6e8f0a1b3c5d7e9f10", paymentId);
+
+    /* Blocks 1 to 4, with two transactions each */
+    std::vector<Crypto::Hash> hashes;
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        const auto blockHashes = pushBlock(*cache, paymentId, 2);
+        hashes.insert(hashes.end(), blockHashes.begin(), blockHashes.end());
+    }
+
+    checkPaymentIdHashes(*cache, database, paymentId, hashes, "before a split");
+
+    /* Blocks 3 and 4 move to the new segment, taking four transactions */
+    auto segment = cache->split(3);
+    hashes.resize(4);
+
+    checkPaymentIdHashes(*cache, database, paymentId, hashes, "after a split");
+
+    /* Reuses the first index which was split off */
+    const auto blockHashes = pushBlock(*cache, paymentId, 1);
+    hashes.insert(hashes.end(), blockHashes.begin(), blockHashes.end());
+
+    checkPaymentIdHashes(*cache, database, paymentId, hashes, "after a split and a new block");
+
+    std::cout << "DatabaseBlockchainCache payment id lookups are correct after a split" << std::endl;
+}
+
+void testBufferedDataBase()
+{
+    std::mt19937_64 random(std::random_device{}());
+
+    /* expected gets the writes straight away, buffered passes them on to
+       database once the outermost batch is committed */
+    MemoryDataBase expected;
+    MemoryDataBase database;
+    BufferedDataBase buffered(database);
+
+    size_t depth = 0;
+
+    /* Two prefixes, and bytes above 0x7f to check the raw key order */
+    const auto randomKey = [&random]()
+    {
+        return std::string(1, "ab"[random() % 2]) + std::string(1, static_cast<char>(random() % 40 * 6));
+    };
+
+    for (size_t i = 0; i < 20000; i++)
+    {
+        const uint64_t operation = random() % 10;
+
+        if (operation == 0 && depth < 3)
+        {
+            buffered.beginBatch();
+            depth++;
+        }
+        else if (operation == 1 && depth > 0)
+        {
+            if (buffered.commitBatch())
+            {
+                throw std::runtime_error("BufferedDataBase failed to commit a batch");
+            }
+
+            depth--;
+        }
+        else if (operation < 5)
+        {
+            /* A key both inserted and removed ends up removed */
+            TestWriteBatch batch;
+
+            for (size_t j = random() % 4; j > 0; j--)
+            {
+                batch.inserts.emplace_back(randomKey(), std::to_string(random() % 1000));
+            }
+
+            for (size_t j = random() % 3; j > 0; j--)
+            {
+                batch.removals.push_back(randomKey());
+            }
+
+            TestWriteBatch copy = batch;
+
+            expected.write(batch);
+            buffered.write(copy);
+        }
+        else if (operation < 7)
+        {
+            TestReadBatch expectedBatch;
+
+            for (size_t j = 1 + random() % 4; j > 0; j--)
+            {
+                expectedBatch.keys.push_back(randomKey());
+            }
+
+            TestReadBatch batch = expectedBatch;
+
+            expected.read(expectedBatch);
+            buffered.read(batch);
+
+            if (batch.found != expectedBatch.found || batch.values != expectedBatch.values)
+            {
+                throw std::runtime_error("BufferedDataBase read values other than were written");
+            }
+        }
+        else
+        {
+            /* Sometimes stopping the iteration early */
+            const size_t count = 1 + random() % 50;
+
+            std::string beginKey = randomKey();
+            std::string endKey = randomKey();
+
+            if (endKey < beginKey)
+            {
+                std::swap(beginKey, endKey);
+            }
+
+            const std::string prefix = beginKey.substr(0, random() % 2);
+
+            const bool byPrefix = operation == 9;
+
+            const auto visited = [&](IDataBase &db)
+            {
+                return getVisited([&](const IDataBase::IterateFunction &visitor)
+                {
+                    if (byPrefix)
+                    {
+                        db.iteratePrefix(prefix, visitor);
+                    }
+                    else
+                    {
+                        db.iterate(beginKey, endKey, visitor);
+                    }
+                }, count);
+            };
+
+            if (visited(buffered) != visited(expected))
+            {
+                throw std::runtime_error("BufferedDataBase iterated over other keys than were written");
+            }
+        }
+
+        /* Outside a batch, the writes have reached the database */
+        if (depth == 0 && getContents(database) != getContents(expected))
+        {
+            throw std::runtime_error("BufferedDataBase didn't pass the writes on to the database");
+        }
+    }
+
+    /* Blocks pushed in one batch, with a split in the middle of it, leave
+       the same database as blocks pushed one write at a time, and nothing
+       reaches the database before the commit */
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    MemoryDataBase plainDatabase;
+    MemoryDataBase batchedDatabase;
+    DatabaseBlockchainCacheFactory plainFactory(plainDatabase, logger);
+    DatabaseBlockchainCacheFactory batchedFactory(batchedDatabase, logger);
+
+    auto plain = plainFactory.createRootBlockchainCache(currency);
+    auto batched = batchedFactory.createRootBlockchainCache(currency);
+
+    Crypto::Hash paymentId;
+    Common::podFromHex("7c1f0b7a3c55e2d1a8e04c9b6f2d3a5e8b1c7d9f0e2a4c6b8d0f1e3a5c7b9d11", paymentId);
+
+    const KeyValues before = getContents(batchedDatabase);
+
+    batched->beginBatch();
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        pushBlock(*plain, paymentId, 2);
+        pushBlock(*batched, paymentId, 2);
+    }
+
+    auto plainSegment = plain->split(3);
+    auto batchedSegment = batched->split(3);
+
+    batched->beginBatch();
+    pushBlock(*plain, paymentId, 1);
+    pushBlock(*batched, paymentId, 1);
+    batched->commitBatch();
+
+    if (batched->getTopBlockIndex() != plain->getTopBlockIndex() || batched->getTopBlockHash() != plain->getTopBlockHash()
+     || batched->getTransactionHashesByPaymentId(paymentId) != plain->getTransactionHashesByPaymentId(paymentId))
+    {
+        throw std::runtime_error("DatabaseBlockchainCache returned other blocks or transactions in a batch");
+    }
+
+    if (getContents(batchedDatabase) != before)
+    {
+        throw std::runtime_error("DatabaseBlockchainCache wrote to the database before the batch was committed");
+    }
+
+    batched->commitBatch();
+
+    if (getContents(batchedDatabase) != getContents(plainDatabase))
+    {
+        throw std::runtime_error("DatabaseBlockchainCache wrote another database in a batch than block by block");
+    }
+
+    std::cout << "BufferedDataBase matches the database it holds writes back from" << std::endl;
+}
+
+void benchmarkBlockBatchCommits()
+{
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    Crypto::Hash paymentId;
+    Common::podFromHex("0d6e3f5a2b8c1d4e7f0a3b6c9d2e5f8a1b4c7d0e3f6a9b2c5d8e1f4a7b0c3d12", paymentId);
+
+    const size_t blockCount = 2000;
+
+    /* Blocks per commit, 1 being a write per block as before batching */
+    const auto timeImport = [&](const size_t batchSize)
+    {
+        const fs::path dataDir = fs::temp_directory_path() / ("cryptotest-db-" + std::to_string(batchSize));
+        fs::remove_all(dataDir);
+        fs::create_directories(dataDir);
+
+        DataBaseConfig config;
+        config.init(dataDir.string(), 2, 100, 64, 64);
+
+        RocksDBWrapper database(logger);
+        database.init(config);
+
+        double seconds = 0;
+
+        {
+            DatabaseBlockchainCacheFactory factory(database, logger);
+            auto cache = factory.createRootBlockchainCache(currency);
+
+            const auto startTimer = std::chrono::high_resolution_clock::now();
+
+            cache->beginBatch();
+
+            for (size_t i = 1; i <= blockCount; i++)
+            {
+                pushBlock(*cache, paymentId, 10);
+
+                if (i % batchSize == 0)
+                {
+                    cache->commitBatch();
+                    cache->beginBatch();
+                }
+            }
+
+            cache->commitBatch();
+
+            seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::high_resolution_clock::now() - startTimer
+            ).count() / 1000000.0;
+        }
+
+        database.shutdown();
+        fs::remove_all(dataDir);
+
+        return blockCount / seconds;
+    };
+
+    const double perBlock = timeImport(1);
+    const double batched = timeImport(100);
+
+    std::cout << "Blocks of 10 transactions pushed to RocksDB: " << perBlock << " blocks/s with a write per block, "
+              << batched << " blocks/s with a write per 100 blocks (" << batched / perBlock << "x)" << std::endl;
+}
@@ -0,0 +1,21 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Splits a DatabaseBlockchainCache, backed by an in memory database, through
+   blocks with transactions sharing a payment id, then adds a block again.
+   Throws if the payment id lookup returns hashes which were split off, or if
+   their keys are left behind in the database. */
+void testPaymentIdsAfterSplit();
+
+/* Writes, reads and iterates at random through a BufferedDataBase, in and
+   out of nested batches, and compares everything with a database the
+   writes went to straight away. Then pushes blocks to a DatabaseBlockchainCache
+   in a batch and one by one, and throws if the databases differ. */
+void testBufferedDataBase();
+
+/* Pushes blocks to a DatabaseBlockchainCache on RocksDB with a write per
+   block and with a write per 100 blocks */
+void benchmarkBlockBatchCommits();
@@ -0,0 +1,279 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "HttpTests.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "HTTP/HttpParser.h"
+#include "HTTP/HttpRequestReader.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+/* Reads from memory, at most maxRead bytes at a time (or a random amount up
+   to it, if random is given), like a TcpConnection would */
+HttpRequestReader::ReadFunction readFrom(
+    const std::string &data,
+    size_t &position,
+    const size_t maxRead,
+    std::mt19937_64 *random = nullptr)
+{
+    return [&data, &position, maxRead, random](uint8_t *buffer, size_t size)
+    {
+        size_t read = std::min({size, maxRead, data.size() - position});
+
+        if (random != nullptr && read > 1)
+        {
+            read = 1 + (*random)() % read;
+        }
+
+        std::memcpy(buffer, data.data() + position, read);
+        position += read;
+
+        return read;
+    };
+}
+
+std::string randomString(std::mt19937_64 &random, const size_t length, const std::string &characters)
+{
+    std::string result;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        result += characters[random() % characters.size()];
+    }
+
+    return result;
+}
+
+/* A well formed request - HttpParser keeps trailing whitespace in header
+   values and drops colons inside them, so those are left out */
+std::string randomRequest(std::mt19937_64 &random, const size_t maxBodySize)
+{
+    const std::string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ-";
+    const std::string text = letters + "0123456789/.,;=\"{}[] ";
+
+    const bool hasBody = random() % 4 != 0;
+
+    std::string request = hasBody ? "POST" : "GET";
+    request += " /" + randomString(random, random() % 32, letters) + " HTTP/1.1\r\n";
+
+    const size_t headers = random() % 6;
+
+    for (size_t i = 0; i < headers; i++)
+    {
+        std::string value = randomString(random, random() % 64, text);
+
+        /* Trim, which both parsers do with a single leading space */
+        value.erase(0, value.find_first_not_of(' '));
+        value.erase(value.find_last_not_of(' ') + 1);
+
+        request += randomString(random, 1 + random() % 16, letters) + ": " + value + "\r\n";
+    }
+
+    std::string body;
+
+    if (hasBody)
+    {
+        body = randomString(random, random() % (maxBodySize + 1), text + "\r\n");
+    }
+
+    /* Last, so a random header of the same name doesn't override it */
+    request += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+
+    return request + body;
+}
+
+void checkRequest(const HttpRequest &request, const HttpRequest &expected, const size_t index)
+{
+    if (request.getMethod() != expected.getMethod()
+     || request.getUrl() != expected.getUrl()
+     || request.getHeaders() != expected.getHeaders()
+     || request.getBody() != expected.getBody())
+    {
+        throw std::runtime_error("HttpRequestReader parsed request " + std::to_string(index)
+                               + " differently to HttpParser");
+    }
+}
+
+template<typename Parse>
+double millisecondsToParse(Parse parse, const size_t loopIterations)
+{
+    const auto startTimer = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < loopIterations; i++)
+    {
+        parse();
+    }
+
+    const auto elapsedTime = std::chrono::high_resolution_clock::now() - startTimer;
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count()
+         / static_cast<double>(loopIterations) / 1000.0;
+}
+
+void benchmarkRequests(const size_t requestCount, const size_t bodySize, const size_t loopIterations)
+{
+    std::string request = "POST /json_rpc HTTP/1.1\r\n"
+                          "Host: 127.0.0.1:11898\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: " + std::to_string(bodySize) + "\r\n\r\n";
+
+    request += std::string(bodySize, 'a');
+
+    std::string stream;
+
+    for (size_t i = 0; i < requestCount; i++)
+    {
+        stream += request;
+    }
+
+    size_t bodyBytes = 0;
+
+    const double parserTime = millisecondsToParse([&]()
+    {
+        std::istringstream input(stream);
+        HttpParser parser;
+
+        for (size_t i = 0; i < requestCount; i++)
+        {
+            HttpRequest parsed;
+            parser.receiveRequest(input, parsed);
+            bodyBytes += parsed.getBody().size();
+        }
+    }, loopIterations);
+
+    const double readerTime = millisecondsToParse([&]()
+    {
+        size_t position = 0;
+        HttpRequestReader reader(readFrom(stream, position, stream.size()));
+
+        HttpRequest parsed;
+
+        while (reader.receiveRequest(parsed))
+        {
+            bodyBytes += parsed.getBody().size();
+            parsed = HttpRequest();
+        }
+    }, loopIterations);
+
+    if (bodyBytes != 2 * loopIterations * requestCount * bodySize)
+    {
+        throw std::runtime_error("HTTP benchmark read the wrong number of body bytes");
+    }
+
+    std::cout << "Time to parse " << requestCount << " requests with " << bodySize << " byte bodies: "
+              << readerTime << " ms (" << parserTime << " ms with HttpParser)" << std::endl;
+}
+
+}
+
+void testHttpRequestReader()
+{
+    std::mt19937_64 random(std::random_device{}());
+
+    const size_t rounds = 500;
+
+    size_t requestsChecked = 0;
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        /* Mostly small bodies, sometimes larger than the reader's buffer */
+        const size_t maxBodySize = round % 10 == 0 ? 100000 : 256;
+
+        std::string stream;
+
+        /* Where each request ends in the stream */
+        std::vector<size_t> requestEnds;
+
+        const size_t requestCount = 1 + random() % 8;
+
+        for (size_t i = 0; i < requestCount; i++)
+        {
+            stream += randomRequest(random, maxBodySize);
+            requestEnds.push_back(stream.size());
+        }
+
+        std::vector<HttpRequest> expected(requestCount);
+
+        std::istringstream input(stream);
+        HttpParser parser;
+
+        for (auto &request : expected)
+        {
+            parser.receiveRequest(input, request);
+        }
+
+        size_t position = 0;
+        HttpRequestReader reader(readFrom(stream, position, 1 + random() % 20000, &random));
+
+        for (size_t i = 0; i < requestCount; i++)
+        {
+            HttpRequest request;
+
+            if (!reader.receiveRequest(request))
+            {
+                throw std::runtime_error("HttpRequestReader stopped after " + std::to_string(i) + " of "
+                                       + std::to_string(requestCount) + " pipelined requests");
+            }
+
+            checkRequest(request, expected[i], i);
+            requestsChecked++;
+        }
+
+        HttpRequest request;
+
+        if (reader.receiveRequest(request))
+        {
+            throw std::runtime_error("HttpRequestReader returned a request past the end of the stream");
+        }
+
+        /* Cut the stream short, in the headers or the body */
+        const std::string truncated = stream.substr(0, 1 + random() % (stream.size() - 1));
+
+        position = 0;
+        HttpRequestReader truncatedReader(readFrom(truncated, position, 1 + random() % 20000, &random));
+
+        bool threw = false;
+
+        try
+        {
+            while (truncatedReader.receiveRequest(request))
+            {
+                request = HttpRequest();
+            }
+        }
+        catch (const std::system_error &)
+        {
+            threw = true;
+        }
+
+        /* Unless it happened to end just after a request */
+        const bool endsMidRequest = std::find(requestEnds.begin(), requestEnds.end(), truncated.size()) == requestEnds.end();
+
+        if (threw != endsMidRequest)
+        {
+            throw std::runtime_error(threw ? "HttpRequestReader rejected a stream which ended between requests"
+                                           : "HttpRequestReader did not reject a stream which ended mid request");
+        }
+    }
+
+    std::cout << "HttpRequestReader matches HttpParser on " << requestsChecked << " pipelined requests" << std::endl;
+}
+
+void benchmarkHttpRequestReader()
+{
+    benchmarkRequests(20000, 200, 5);
+    benchmarkRequests(50, 1024 * 1024, 5);
+}
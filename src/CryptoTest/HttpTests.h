@@ -0,0 +1,12 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Feeds random pipelined requests to HttpRequestReader in random sized
+   reads, and checks it parses them the same as HttpParser, and rejects
+   streams which end mid request. Throws on any difference. */
+void testHttpRequestReader();
+
+void benchmarkHttpRequestReader();
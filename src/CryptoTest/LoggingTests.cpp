@@ -0,0 +1,164 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "LoggingTests.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "Common/StringTools.h"
+#include "CryptoTypes.h"
+#include "Logger/Logger.h"
+#include "Logging/LoggerRef.h"
+#include "Logging/StreamLogger.h"
+
+namespace
+{
+
+const uint64_t loopIterations = 1000000;
+
+/* Something like a block hash, for the messages to format */
+Crypto::Hash getHash(const uint64_t i)
+{
+    Crypto::Hash hash;
+
+    for (size_t j = 0; j < sizeof(hash.data); j++)
+    {
+        hash.data[j] = static_cast<uint8_t>(i >> (j % 8));
+    }
+
+    return hash;
+}
+
+template<typename LogFunction>
+double nanosecondsPerCall(LogFunction logFunction)
+{
+    const auto startTimer = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t i = 0; i < loopIterations; i++)
+    {
+        logFunction(i);
+    }
+
+    const auto elapsedTime = std::chrono::high_resolution_clock::now() - startTimer;
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsedTime).count()
+         / static_cast<double>(loopIterations);
+}
+
+}
+
+void testLogging()
+{
+    Logger::Logger walletLogger;
+    walletLogger.setLogLevel(Logger::INFO);
+
+    std::string loggedMessage;
+
+    walletLogger.setLogCallback([&loggedMessage](
+        const std::string prettyMessage,
+        const std::string message,
+        const Logger::LogLevel level,
+        const std::vector<Logger::LogCategory> categories)
+    {
+        loggedMessage = message;
+    });
+
+    size_t messagesBuilt = 0;
+
+    walletLogger.log([&messagesBuilt]() { messagesBuilt++; return std::string("debug"); }, Logger::DEBUG, {Logger::SYNC});
+    walletLogger.log("debug", Logger::DEBUG, {Logger::SYNC});
+
+    if (messagesBuilt != 0 || !loggedMessage.empty())
+    {
+        throw std::runtime_error("Logger::log built or wrote a message at a disabled level");
+    }
+
+    walletLogger.log([&messagesBuilt]() { messagesBuilt++; return std::string("info"); }, Logger::INFO, {Logger::SYNC});
+
+    if (messagesBuilt != 1 || loggedMessage != "info")
+    {
+        throw std::runtime_error("Logger::log did not write a message at an enabled level");
+    }
+
+    std::stringstream stream;
+
+    Logging::LoggerRef logger(std::make_shared<Logging::StreamLogger>(stream, Logging::INFO), "test");
+
+    size_t messagesWritten = 0;
+
+    logger.log(Logging::DEBUGGING, [&messagesWritten](std::ostream &message) { messagesWritten++; message << "debug"; });
+    logger(Logging::DEBUGGING) << "debug";
+
+    if (messagesWritten != 0 || !stream.str().empty())
+    {
+        throw std::runtime_error("LoggerRef::log wrote a message at a disabled level");
+    }
+
+    logger.log(Logging::INFO, [&messagesWritten](std::ostream &message) { messagesWritten++; message << "info"; });
+
+    if (messagesWritten != 1 || stream.str().find("info") == std::string::npos)
+    {
+        throw std::runtime_error("LoggerRef::log did not write a message at an enabled level");
+    }
+
+    std::cout << "Logger::log and LoggerRef::log skip disabled levels" << std::endl;
+}
+
+void benchmarkLogging()
+{
+    /* Logs at INFO, like a wallet or daemon left at the default level, so
+       none of the DEBUG messages below are written */
+    Logger::Logger walletLogger;
+    walletLogger.setLogLevel(Logger::INFO);
+
+    const double walletEager = nanosecondsPerCall([&walletLogger](const uint64_t i)
+    {
+        walletLogger.log(
+            "Processing block " + std::to_string(i) + ", hash " + Common::podToHex(getHash(i)),
+            Logger::DEBUG,
+            {Logger::SYNC}
+        );
+    });
+
+    const double walletLazy = nanosecondsPerCall([&walletLogger](const uint64_t i)
+    {
+        walletLogger.log(
+            [&]() { return "Processing block " + std::to_string(i) + ", hash " + Common::podToHex(getHash(i)); },
+            Logger::DEBUG,
+            {Logger::SYNC}
+        );
+    });
+
+    std::stringstream stream;
+
+    Logging::LoggerRef logger(std::make_shared<Logging::StreamLogger>(stream, Logging::INFO), "test");
+
+    const double coreEager = nanosecondsPerCall([&logger](const uint64_t i)
+    {
+        logger(Logging::DEBUGGING) << "Pushing block " << i << ", hash " << getHash(i);
+    });
+
+    const double coreLazy = nanosecondsPerCall([&logger](const uint64_t i)
+    {
+        logger.log(Logging::DEBUGGING, [&](std::ostream &message)
+        {
+            message << "Pushing block " << i << ", hash " << getHash(i);
+        });
+    });
+
+    if (!stream.str().empty())
+    {
+        throw std::runtime_error("Logging benchmark wrote a message at a disabled level");
+    }
+
+    std::cout << "Time to log a disabled message with Logger::log: "
+              << walletEager << " ns (" << walletLazy << " ns building it lazily)" << std::endl;
+
+    std::cout << "Time to log a disabled message with LoggerRef: "
+              << coreEager << " ns (" << coreLazy << " ns with LoggerRef::log)" << std::endl;
+}
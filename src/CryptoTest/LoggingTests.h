@@ -0,0 +1,13 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Checks Logger::log and LoggerRef::log only build the message when its
+   level is enabled, and still write it when it is. Throws if not. */
+void testLogging();
+
+/* Times logging a typical per block message at a disabled level, building
+   the message up front versus through the lazy overloads */
+void benchmarkLogging();
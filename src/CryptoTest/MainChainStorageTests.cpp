@@ -0,0 +1,360 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "MainChainStorageTests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include "Common/FileSystemShim.h"
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MainChainStorage.h"
+#include "CryptoNoteCore/SwappedVector.h"
+#include "Logging/ConsoleLogger.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+/* As in MainChainStorage.cpp. The segment boundary test checks the second
+   segment file was created, so this can't go stale unnoticed */
+const uint64_t SEGMENT_SIZE = 256 * 1024 * 1024;
+
+/* Records are padded to this in the segment files */
+const uint64_t RECORD_ALIGNMENT = 8;
+
+/* A block whose contents and transaction count depend on index, so a block
+   read back from the wrong place, or half written, doesn't match */
+RawBlock makeBlock(uint32_t index)
+{
+    RawBlock rawBlock;
+
+    rawBlock.block.assign(100 + index % 50, static_cast<uint8_t>(index));
+    rawBlock.block[0] = static_cast<uint8_t>(index >> 8);
+
+    for (uint32_t i = 0; i < index % 4; i++)
+    {
+        rawBlock.transactions.emplace_back(20 + i * 7 + index % 13, static_cast<uint8_t>(index + i));
+    }
+
+    return rawBlock;
+}
+
+bool sameBlock(const RawBlock &a, const RawBlock &b)
+{
+    return a.block == b.block && a.transactions == b.transactions;
+}
+
+void checkBlocks(const MainChainStorage &storage, const std::vector<RawBlock> &expected, const std::string &when)
+{
+    if (storage.getBlockCount() != expected.size())
+    {
+        throw std::runtime_error(
+            "MainChainStorage has " + std::to_string(storage.getBlockCount()) + " blocks " + when
+          + ", expected " + std::to_string(expected.size())
+        );
+    }
+
+    for (uint32_t i = 0; i < expected.size(); i++)
+    {
+        const RawBlockView view = storage.getBlockViewByIndex(i);
+
+        const bool viewMatches = view.getTransactionCount() == expected[i].transactions.size()
+                              && std::equal(view.getBlock().begin(), view.getBlock().end(),
+                                            expected[i].block.begin(), expected[i].block.end());
+
+        if (!viewMatches || !sameBlock(storage.getBlockByIndex(i), expected[i]))
+        {
+            throw std::runtime_error("MainChainStorage returned the wrong block at " + std::to_string(i) + " " + when);
+        }
+    }
+}
+
+/* Where the next record goes, while every block is in the first segment */
+uint64_t getFirstSegmentEnd(const MainChainStorage &storage)
+{
+    uint64_t end = 0;
+
+    for (uint32_t i = 0; i < storage.getBlockCount(); i++)
+    {
+        const uint64_t recordSize = storage.getBlockViewByIndex(i).getRecordSize();
+        end += (recordSize + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+    }
+
+    return end;
+}
+
+void testReopen(const std::string &blocksFilename, const std::string &indexesFilename)
+{
+    std::vector<RawBlock> expected;
+
+    {
+        MainChainStorage storage(blocksFilename, indexesFilename);
+
+        for (uint32_t i = 0; i < 50; i++)
+        {
+            expected.push_back(makeBlock(i));
+            storage.pushBlock(expected.back());
+        }
+
+        for (uint32_t i = 0; i < 5; i++)
+        {
+            storage.popBlock();
+            expected.pop_back();
+        }
+
+        checkBlocks(storage, expected, "after pushing and popping");
+    }
+
+    /* Reopening has to find the end of the last block, or the next push
+       would write over it */
+    {
+        MainChainStorage storage(blocksFilename, indexesFilename);
+
+        checkBlocks(storage, expected, "after reopening");
+
+        for (uint32_t i = 100; i < 110; i++)
+        {
+            expected.push_back(makeBlock(i));
+            storage.pushBlock(expected.back());
+        }
+
+        checkBlocks(storage, expected, "after pushing to a reopened storage");
+    }
+
+    MainChainStorage storage(blocksFilename, indexesFilename);
+
+    checkBlocks(storage, expected, "after reopening twice");
+}
+
+void testSegmentBoundary(const std::string &blocksFilename, const std::string &indexesFilename)
+{
+    std::vector<RawBlock> expected;
+
+    {
+        MainChainStorage storage(blocksFilename, indexesFilename);
+
+        for (uint32_t i = 0; i < 10; i++)
+        {
+            expected.push_back(makeBlock(i));
+            storage.pushBlock(expected.back());
+        }
+
+        /* A block with no transactions which leaves less room at the end of
+           the first segment than the next block needs */
+        RawBlock bigBlock;
+        bigBlock.block.assign(SEGMENT_SIZE - getFirstSegmentEnd(storage) - 2 * sizeof(uint32_t) - 16, 0xab);
+
+        expected.push_back(std::move(bigBlock));
+        storage.pushBlock(expected.back());
+
+        expected.push_back(makeBlock(10));
+        storage.pushBlock(expected.back());
+
+        if (!fs::exists(blocksFilename + ".1"))
+        {
+            throw std::runtime_error("MainChainStorage didn't start a second segment for a block which doesn't fit the first");
+        }
+
+        checkBlocks(storage, expected, "after pushing across a segment boundary");
+
+        /* The next block goes back to the start of the second segment */
+        storage.popBlock();
+        expected.pop_back();
+
+        expected.push_back(makeBlock(11));
+        storage.pushBlock(expected.back());
+
+        checkBlocks(storage, expected, "after popping and pushing at the start of a segment");
+    }
+
+    MainChainStorage storage(blocksFilename, indexesFilename);
+
+    checkBlocks(storage, expected, "after reopening with two segments");
+
+    /* Pop back into the first segment, which is written to again */
+    storage.popBlock();
+    storage.popBlock();
+    expected.resize(expected.size() - 2);
+
+    for (uint32_t i = 12; i < 20; i++)
+    {
+        expected.push_back(makeBlock(i));
+        storage.pushBlock(expected.back());
+    }
+
+    checkBlocks(storage, expected, "after popping back to the first segment");
+}
+
+void testConversion(const fs::path &dataDir)
+{
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::ERROR);
+    const Currency currency = CurrencyBuilder(logger).currency();
+
+    const std::string swappedBlocksFilename = (dataDir / currency.blocksFileName()).string();
+    const std::string swappedIndexesFilename = (dataDir / currency.blockIndexesFileName()).string();
+    const std::string blocksFilename = (dataDir / currency.mappedBlocksFileName()).string();
+    const std::string indexesFilename = (dataDir / currency.mappedBlockIndexesFileName()).string();
+
+    std::vector<RawBlock> expected;
+
+    {
+        SwappedVector<RawBlock> swappedStorage;
+
+        if (!swappedStorage.open(swappedBlocksFilename, swappedIndexesFilename, 1))
+        {
+            throw std::runtime_error("Failed to create a SwappedVector block file");
+        }
+
+        for (uint32_t i = 0; i < 300; i++)
+        {
+            expected.push_back(makeBlock(i));
+            swappedStorage.push_back(expected.back());
+        }
+
+        swappedStorage.close();
+    }
+
+    /* What a conversion stopped part way leaves behind. It has to be
+       started over, not picked up from. */
+    {
+        MainChainStorage storage(blocksFilename, indexesFilename + ".converting");
+
+        for (uint32_t i = 1000; i < 1100; i++)
+        {
+            storage.pushBlock(makeBlock(i));
+        }
+    }
+
+    {
+        auto storage = createMainChainStorage(dataDir.string(), currency, logger);
+
+        checkBlocks(dynamic_cast<const MainChainStorage &>(*storage), expected, "after converting a SwappedVector");
+    }
+
+    if (fs::exists(indexesFilename + ".converting") || fs::exists(swappedBlocksFilename) || fs::exists(swappedIndexesFilename))
+    {
+        throw std::runtime_error("Converting a SwappedVector left the old or partly converted files behind");
+    }
+
+    auto storage = createMainChainStorage(dataDir.string(), currency, logger);
+
+    checkBlocks(dynamic_cast<const MainChainStorage &>(*storage), expected, "after reopening a converted storage");
+}
+
+void testReadsDuringAppend(const std::string &blocksFilename, const std::string &indexesFilename)
+{
+    const uint32_t blockCount = 20000;
+
+    MainChainStorage storage(blocksFilename, indexesFilename);
+
+    std::atomic<bool> readerStarted(false);
+    std::atomic<bool> done(false);
+    std::atomic<bool> failed(false);
+
+    /* Only written by the reader, before it sets failed */
+    std::string failure;
+    size_t reads = 0;
+
+    std::thread reader([&]()
+    {
+        std::mt19937 random(1);
+
+        readerStarted = true;
+
+        while (!done)
+        {
+            const uint32_t count = storage.getBlockCount();
+
+            if (count == 0)
+            {
+                continue;
+            }
+
+            /* The block just appended, and one written a while ago */
+            for (const uint32_t index : {count - 1, static_cast<uint32_t>(random() % count)})
+            {
+                if (!sameBlock(storage.getBlockByIndex(index), makeBlock(index)))
+                {
+                    failure = "MainChainStorage returned the wrong block at " + std::to_string(index)
+                            + " while appending block " + std::to_string(count);
+                    failed = true;
+                    return;
+                }
+            }
+
+            reads++;
+        }
+    });
+
+    while (!readerStarted)
+    {
+        std::this_thread::yield();
+    }
+
+    for (uint32_t i = 0; i < blockCount && !failed; i++)
+    {
+        storage.pushBlock(makeBlock(i));
+    }
+
+    done = true;
+    reader.join();
+
+    if (failed)
+    {
+        throw std::runtime_error(failure);
+    }
+
+    std::vector<RawBlock> expected;
+
+    for (uint32_t i = 0; i < blockCount; i++)
+    {
+        expected.push_back(makeBlock(i));
+    }
+
+    checkBlocks(storage, expected, "after appending while reading");
+
+    if (reads == 0)
+    {
+        throw std::runtime_error("No blocks were read while appending to MainChainStorage");
+    }
+}
+
+}
+
+void testMainChainStorage()
+{
+    const fs::path dataDir = fs::temp_directory_path() / "cryptotest-mainchainstorage";
+    const std::string blocksFilename = (dataDir / "blocks.dat").string();
+    const std::string indexesFilename = (dataDir / "blockindexes.dat").string();
+
+    /* Each part starts from an empty directory */
+    const auto reset = [&dataDir]()
+    {
+        fs::remove_all(dataDir);
+        fs::create_directories(dataDir);
+    };
+
+    reset();
+    testReopen(blocksFilename, indexesFilename);
+
+    reset();
+    testSegmentBoundary(blocksFilename, indexesFilename);
+
+    reset();
+    testConversion(dataDir);
+
+    reset();
+    testReadsDuringAppend(blocksFilename, indexesFilename);
+
+    fs::remove_all(dataDir);
+
+    std::cout << "MainChainStorage reopens, crosses segments, converts and reads while appending" << std::endl;
+}
@@ -0,0 +1,12 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Pushes and pops blocks on a MainChainStorage, reopening it in between, and
+   across the boundary between two segment files. Converts a SwappedVector
+   block file left with the remains of an interrupted conversion, and reads
+   blocks on another thread while they are appended. Throws if a block reads
+   back different from what was pushed. */
+void testMainChainStorage();
@@ -0,0 +1,78 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "IDataBase.h"
+
+/* Stands in for RocksDBWrapper: writes are applied inserts first, then
+   removals, and keys are iterated in raw order */
+class MemoryDataBase : public CryptoNote::IDataBase
+{
+    public:
+        virtual std::error_code write(CryptoNote::IWriteBatch &batch) override
+        {
+            for (auto &[key, value] : batch.extractRawDataToInsert())
+            {
+                m_data[key] = value;
+            }
+
+            for (const auto &key : batch.extractRawKeysToRemove())
+            {
+                m_data.erase(key);
+            }
+
+            return std::error_code();
+        }
+
+        virtual std::error_code read(CryptoNote::IReadBatch &batch) override
+        {
+            std::vector<std::string> values;
+            std::vector<bool> resultStates;
+
+            for (const auto &key : batch.getRawKeys())
+            {
+                const auto it = m_data.find(key);
+
+                values.push_back(it == m_data.end() ? std::string() : it->second);
+                resultStates.push_back(it != m_data.end());
+            }
+
+            batch.submitRawResult(values, resultStates);
+            return std::error_code();
+        }
+
+        virtual std::error_code iterate(const std::string &beginKey, const std::string &endKey, const IterateFunction &visitor) override
+        {
+            for (auto it = m_data.lower_bound(beginKey); it != m_data.end() && it->first < endKey; ++it)
+            {
+                if (!visitor(it->first, it->second))
+                {
+                    break;
+                }
+            }
+
+            return std::error_code();
+        }
+
+        virtual std::error_code iteratePrefix(const std::string &keyStart, const IterateFunction &visitor) override
+        {
+            for (auto it = m_data.lower_bound(keyStart); it != m_data.end() && it->first.compare(0, keyStart.size(), keyStart) == 0; ++it)
+            {
+                if (!visitor(it->first, it->second))
+                {
+                    break;
+                }
+            }
+
+            return std::error_code();
+        }
+
+    private:
+        std::map<std::string, std::string> m_data;
+};
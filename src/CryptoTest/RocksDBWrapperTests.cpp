@@ -0,0 +1,394 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "RocksDBWrapperTests.h"
+
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+
+#include "rocksdb/db.h"
+
+#include "Common/FileSystemShim.h"
+#include "CryptoNoteCore/DataBaseConfig.h"
+#include "CryptoNoteCore/DBUtils.h"
+#include "CryptoNoteCore/RocksDBWrapper.h"
+#include "Logging/ConsoleLogger.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+typedef std::map<std::string, std::string> KeyValues;
+
+class TestWriteBatch : public IWriteBatch
+{
+    public:
+        std::vector<std::pair<std::string, std::string>> inserts;
+
+        virtual std::vector<std::pair<std::string, std::string>> extractRawDataToInsert() override
+        {
+            return inserts;
+        }
+
+        virtual std::vector<std::string> extractRawKeysToRemove() override
+        {
+            return {};
+        }
+};
+
+class TestReadBatch : public IReadBatch
+{
+    public:
+        std::vector<std::string> keys;
+        std::vector<std::string> values;
+        std::vector<bool> found;
+
+        virtual std::vector<std::string> getRawKeys() const override
+        {
+            return keys;
+        }
+
+        virtual void submitRawResult(const std::vector<std::string> &values, const std::vector<bool> &resultStates) override
+        {
+            this->values = values;
+            found = resultStates;
+        }
+};
+
+const std::vector<std::string> prefixes = {
+    DB::BLOCK_INDEX_TO_KEY_IMAGE_PREFIX, DB::BLOCK_INDEX_TO_RAW_BLOCK_PREFIX, DB::BLOCK_HASH_TO_BLOCK_INDEX_PREFIX,
+    DB::BLOCK_INDEX_TO_BLOCK_HASH_PREFIX, DB::PAYMENT_ID_TO_TX_HASH_PREFIX, DB::KEY_OUTPUT_KEY_PREFIX
+};
+
+/* A key of no prefix at all, which stays in the default family */
+const std::string unprefixedKey = "unprefixed";
+
+/* The bytes every key of prefix starts with */
+std::string getKeyStart(const std::string &prefix)
+{
+    return DB::getCommonKeyStart(DB::serializeKey(prefix, uint32_t(0)),
+                                 DB::serializeKey(prefix, std::numeric_limits<uint32_t>::max()));
+}
+
+std::string getPrefix(const std::string &key)
+{
+    for (const std::string &prefix : prefixes)
+    {
+        if (key.compare(0, getKeyStart(prefix).size(), getKeyStart(prefix)) == 0)
+        {
+            return prefix;
+        }
+    }
+
+    return std::string();
+}
+
+/* The keys from first up to last of every prefix */
+KeyValues getKeyValues(const uint32_t first, const uint32_t last)
+{
+    KeyValues keyValues;
+
+    for (const std::string &prefix : prefixes)
+    {
+        for (uint32_t i = first; i < last; i++)
+        {
+            keyValues[DB::serializeKey(prefix, i)] = prefix + std::to_string(i);
+        }
+    }
+
+    return keyValues;
+}
+
+/* Every key in keyValues must be read, and every key of a prefix visited */
+void checkKeyValues(RocksDBWrapper &database, const KeyValues &keyValues, const std::string &when)
+{
+    TestReadBatch batch;
+
+    for (const auto &keyValue : keyValues)
+    {
+        batch.keys.push_back(keyValue.first);
+    }
+
+    if (database.read(batch))
+    {
+        throw std::runtime_error("RocksDBWrapper failed to read " + when);
+    }
+
+    for (size_t i = 0; i < batch.keys.size(); i++)
+    {
+        if (!batch.found[i] || batch.values[i] != keyValues.at(batch.keys[i]))
+        {
+            throw std::runtime_error("RocksDBWrapper read the wrong value " + when);
+        }
+    }
+
+    for (const std::string &prefix : prefixes)
+    {
+        const std::string keyStart = getKeyStart(prefix);
+
+        KeyValues expected;
+
+        for (const auto &keyValue : keyValues)
+        {
+            if (keyValue.first.compare(0, keyStart.size(), keyStart) == 0)
+            {
+                expected.insert(keyValue);
+            }
+        }
+
+        KeyValues visited;
+
+        database.iteratePrefix(keyStart, [&visited](const std::string &key, const std::string &value)
+        {
+            visited[key] = value;
+            return true;
+        });
+
+        if (visited != expected)
+        {
+            throw std::runtime_error("RocksDBWrapper iterated over " + std::to_string(visited.size()) + " keys of prefix "
+                                   + prefix + " instead of " + std::to_string(expected.size()) + " " + when);
+        }
+    }
+}
+
+void writeKeyValues(RocksDBWrapper &database, const KeyValues &keyValues)
+{
+    TestWriteBatch batch;
+    batch.inserts.assign(keyValues.begin(), keyValues.end());
+
+    if (database.write(batch))
+    {
+        throw std::runtime_error("RocksDBWrapper failed to write");
+    }
+}
+
+/* The keys of each column family, read with RocksDB itself */
+std::map<std::string, KeyValues> getFamilies(const std::string &path)
+{
+    std::vector<std::string> names;
+    rocksdb::DB::ListColumnFamilies(rocksdb::Options(), path, &names);
+
+    std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+
+    for (const std::string &name : names)
+    {
+        descriptors.emplace_back(name, rocksdb::ColumnFamilyOptions());
+    }
+
+    rocksdb::DB *db;
+    std::vector<rocksdb::ColumnFamilyHandle *> handles;
+
+    if (!rocksdb::DB::OpenForReadOnly(rocksdb::Options(), path, descriptors, &handles, &db).ok())
+    {
+        throw std::runtime_error("RocksDB failed to open the DB in " + path);
+    }
+
+    std::map<std::string, KeyValues> families;
+
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        KeyValues &keyValues = families[names[i]];
+
+        std::unique_ptr<rocksdb::Iterator> iterator(db->NewIterator(rocksdb::ReadOptions(), handles[i]));
+
+        for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next())
+        {
+            keyValues[iterator->key().ToString()] = iterator->value().ToString();
+        }
+
+        db->DestroyColumnFamilyHandle(handles[i]);
+    }
+
+    delete db;
+
+    return families;
+}
+
+}
+
+void testRocksDBWrapper()
+{
+    auto logger = std::make_shared<Logging::ConsoleLogger>(Logging::FATAL);
+
+    const fs::path dataDir = fs::temp_directory_path() / "cryptotest-rocksdb";
+    const std::string path = (dataDir / "DB").string();
+
+    fs::remove_all(dataDir);
+    fs::create_directories(dataDir);
+
+    DataBaseConfig config;
+    config.init(dataDir.string(), 2, 100, 8, 8);
+
+    /* The DB as an older daemon left it, everything in the default family */
+    KeyValues keyValues = getKeyValues(0, 200);
+    keyValues[unprefixedKey] = "value";
+
+    {
+        rocksdb::Options options;
+        options.create_if_missing = true;
+
+        rocksdb::DB *db;
+
+        if (!rocksdb::DB::Open(options, path, &db).ok())
+        {
+            throw std::runtime_error("RocksDB failed to create a DB in " + path);
+        }
+
+        for (const auto &keyValue : keyValues)
+        {
+            db->Put(rocksdb::WriteOptions(), keyValue.first, keyValue.second);
+        }
+
+        delete db;
+    }
+
+    RocksDBWrapper database(logger);
+
+    /* Still usable before the migration, and keeps what is written to it */
+    database.init(config);
+    checkKeyValues(database, keyValues, "in the old layout");
+
+    const KeyValues written = getKeyValues(200, 300);
+    writeKeyValues(database, written);
+    keyValues.insert(written.begin(), written.end());
+
+    checkKeyValues(database, keyValues, "after a write in the old layout");
+    database.shutdown();
+
+    if (getFamilies(path).size() != 1)
+    {
+        throw std::runtime_error("RocksDBWrapper added column families to a DB in the old layout without a migration");
+    }
+
+    database.migrate(config);
+
+    std::map<std::string, KeyValues> families = getFamilies(path);
+
+    /* Only the unprefixed key and the layout marker stay in the default family */
+    const KeyValues defaultFamily = families[rocksdb::kDefaultColumnFamilyName];
+
+    if (defaultFamily.size() != 2 || defaultFamily.count(unprefixedKey) == 0)
+    {
+        throw std::runtime_error("RocksDBWrapper left " + std::to_string(defaultFamily.size())
+                               + " keys in the default family after a migration");
+    }
+
+    size_t movedKeys = 0;
+
+    for (const auto &family : families)
+    {
+        if (family.first != rocksdb::kDefaultColumnFamilyName)
+        {
+            movedKeys += family.second.size();
+
+            std::set<std::string> familyPrefixes;
+
+            for (const auto &keyValue : family.second)
+            {
+                if (keyValues.count(keyValue.first) == 0)
+                {
+                    throw std::runtime_error("RocksDBWrapper moved a key which wasn't written in a migration");
+                }
+
+                familyPrefixes.insert(getPrefix(keyValue.first));
+            }
+
+            if (familyPrefixes.size() > 1)
+            {
+                throw std::runtime_error("RocksDBWrapper moved keys of several prefixes into family " + family.first);
+            }
+        }
+    }
+
+    if (movedKeys != keyValues.size() - 1)
+    {
+        throw std::runtime_error("RocksDBWrapper moved " + std::to_string(movedKeys) + " keys out of "
+                               + std::to_string(keyValues.size() - 1) + " in a migration");
+    }
+
+    /* A second migration finds nothing to do */
+    database.migrate(config);
+
+    if (getFamilies(path) != families)
+    {
+        throw std::runtime_error("RocksDBWrapper changed a DB migrating it twice");
+    }
+
+    /* Reopened in the new layout, twice to see the writes were kept */
+    for (size_t i = 0; i < 2; i++)
+    {
+        database.init(config);
+        checkKeyValues(database, keyValues, "after a migration");
+
+        const KeyValues more = getKeyValues(300 + i * 10, 310 + i * 10);
+        writeKeyValues(database, more);
+        keyValues.insert(more.begin(), more.end());
+
+        database.shutdown();
+    }
+
+    /* A DB with the column families but without the layout marker is one
+       whose migration was interrupted, and must not open */
+    {
+        fs::remove_all(dataDir);
+        fs::create_directories(dataDir);
+
+        rocksdb::Options options;
+        options.create_if_missing = true;
+        options.create_missing_column_families = true;
+
+        std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+
+        for (const auto &family : families)
+        {
+            descriptors.emplace_back(family.first, rocksdb::ColumnFamilyOptions());
+        }
+
+        rocksdb::DB *db;
+        std::vector<rocksdb::ColumnFamilyHandle *> handles;
+
+        if (!rocksdb::DB::Open(options, path, descriptors, &handles, &db).ok())
+        {
+            throw std::runtime_error("RocksDB failed to create a DB in " + path);
+        }
+
+        for (rocksdb::ColumnFamilyHandle *handle : handles)
+        {
+            db->DestroyColumnFamilyHandle(handle);
+        }
+
+        delete db;
+    }
+
+    bool opened = true;
+
+    try
+    {
+        database.init(config);
+    }
+    catch (const std::system_error &)
+    {
+        opened = false;
+    }
+
+    if (opened)
+    {
+        throw std::runtime_error("RocksDBWrapper opened a DB whose migration didn't finish");
+    }
+
+    /* Finishing the migration makes it usable */
+    database.migrate(config);
+    database.init(config);
+    database.shutdown();
+
+    fs::remove_all(dataDir);
+
+    std::cout << "RocksDBWrapper reads old and migrated DBs" << std::endl;
+}
@@ -0,0 +1,12 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Creates a DB in the old single keyspace layout with RocksDB itself, and
+   reads, iterates and writes it through RocksDBWrapper before and after
+   migrating it to column families. Throws if a key is lost or lands in the
+   wrong family, if migrating twice changes anything, or if a DB whose
+   migration didn't finish opens. */
+void testRocksDBWrapper();
@@ -0,0 +1,1102 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "SerializationTests.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+
+#ifdef __linux__
+#include <fstream>
+#include <malloc.h>
+#endif
+
+#include "Common/MemoryInputStream.h"
+#include "Common/StreamTools.h"
+#include "Common/VectorOutputStream.h"
+#include "Serialization/JsonInputValueSerializer.h"
+#include "Serialization/JsonOutputStreamSerializer.h"
+#include "Serialization/JsonStringOutputSerializer.h"
+#include "Serialization/KVBinaryCommon.h"
+#include "Serialization/KVBinaryInputStreamSerializer.h"
+#include "Serialization/KVBinaryOutputStreamSerializer.h"
+#include "Rpc/CoreRpcServerCommandsDefinitions.h"
+#include "Serialization/SerializationOverloads.h"
+#include "Serialization/SerializationTools.h"
+#include "rapidjson/document.h"
+
+using namespace CryptoNote;
+
+namespace
+{
+
+/* The reader KVBinaryInputStreamSerializer replaced: the whole payload is
+   loaded into a JsonValue, which is then walked */
+namespace Reference
+{
+    uint64_t readVarint(Common::IInputStream& s)
+    {
+        uint8_t b = Common::read<uint8_t>(s);
+        uint64_t bytesLeft = 0;
+
+        switch (b & PORTABLE_RAW_SIZE_MARK_MASK)
+        {
+            case PORTABLE_RAW_SIZE_MARK_WORD: bytesLeft = 1; break;
+            case PORTABLE_RAW_SIZE_MARK_DWORD: bytesLeft = 3; break;
+            case PORTABLE_RAW_SIZE_MARK_INT64: bytesLeft = 7; break;
+        }
+
+        uint64_t value = b;
+
+        for (uint64_t i = 1; i <= bytesLeft; i++)
+        {
+            value |= static_cast<uint64_t>(Common::read<uint8_t>(s)) << (i * 8);
+        }
+
+        return value >> 2;
+    }
+
+    template<typename T, typename JsonT = int64_t>
+    Common::JsonValue readPod(Common::IInputStream& s)
+    {
+        T value;
+        Common::read(s, &value, sizeof(T));
+
+        Common::JsonValue json;
+        json = static_cast<JsonT>(value);
+        return json;
+    }
+
+    std::string readString(Common::IInputStream& s)
+    {
+        const uint64_t size = readVarint(s);
+
+        /* Corrupted sizes would otherwise have us allocate gigabytes before
+           finding the stream is too short */
+        if (size > (1 << 24))
+        {
+            throw std::runtime_error("String too long");
+        }
+
+        std::string str(size, '\0');
+
+        if (size)
+        {
+            Common::read(s, &str[0], size);
+        }
+
+        return str;
+    }
+
+    Common::JsonValue loadSection(Common::IInputStream& s);
+    Common::JsonValue loadArray(Common::IInputStream& s, uint8_t itemType);
+
+    Common::JsonValue loadValue(Common::IInputStream& s, uint8_t type)
+    {
+        switch (type)
+        {
+            case BIN_KV_SERIALIZE_TYPE_INT64:  return readPod<int64_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_INT32:  return readPod<int32_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_INT16:  return readPod<int16_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_INT8:   return readPod<int8_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_UINT64: return readPod<uint64_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_UINT32: return readPod<uint32_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_UINT16: return readPod<uint16_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_UINT8:  return readPod<uint8_t>(s);
+            case BIN_KV_SERIALIZE_TYPE_DOUBLE: return readPod<double, double>(s);
+            case BIN_KV_SERIALIZE_TYPE_BOOL:   return Common::JsonValue(Common::read<uint8_t>(s) != 0);
+            case BIN_KV_SERIALIZE_TYPE_STRING: return Common::JsonValue(readString(s));
+            case BIN_KV_SERIALIZE_TYPE_OBJECT: return loadSection(s);
+            case BIN_KV_SERIALIZE_TYPE_ARRAY:  return loadArray(s, type);
+            default:
+                throw std::runtime_error("Unknown data type");
+        }
+    }
+
+    Common::JsonValue loadEntry(Common::IInputStream& s)
+    {
+        const uint8_t type = Common::read<uint8_t>(s);
+
+        if (type & BIN_KV_SERIALIZE_FLAG_ARRAY)
+        {
+            return loadArray(s, type & ~BIN_KV_SERIALIZE_FLAG_ARRAY);
+        }
+
+        return loadValue(s, type);
+    }
+
+    Common::JsonValue loadArray(Common::IInputStream& s, uint8_t itemType)
+    {
+        Common::JsonValue array(Common::JsonValue::ARRAY);
+        uint64_t count = readVarint(s);
+
+        while (count--)
+        {
+            array.pushBack(loadValue(s, itemType));
+        }
+
+        return array;
+    }
+
+    Common::JsonValue loadSection(Common::IInputStream& s)
+    {
+        Common::JsonValue section(Common::JsonValue::OBJECT);
+        uint64_t count = readVarint(s);
+
+        while (count--)
+        {
+            const uint8_t nameSize = Common::read<uint8_t>(s);
+            std::string name(nameSize, '\0');
+
+            if (nameSize)
+            {
+                Common::read(s, &name[0], nameSize);
+            }
+
+            /* Doesn't replace an entry already there, so the first wins */
+            section.insert(name, loadEntry(s));
+        }
+
+        return section;
+    }
+
+    Common::JsonValue parseBinary(Common::IInputStream& s)
+    {
+        KVBinaryStorageBlockHeader hdr;
+        Common::read(s, &hdr, sizeof(hdr));
+
+        if (hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA
+         || hdr.m_signature_b != PORTABLE_STORAGE_SIGNATUREB
+         || hdr.m_ver != PORTABLE_STORAGE_FORMAT_VER)
+        {
+            throw std::runtime_error("Invalid binary storage header");
+        }
+
+        return loadSection(s);
+    }
+
+    class KVBinaryInputValueSerializer : public JsonInputValueSerializer
+    {
+        public:
+            KVBinaryInputValueSerializer(Common::IInputStream& s) : JsonInputValueSerializer(parseBinary(s))
+            {
+            }
+
+            virtual bool binary(void* value, uint64_t size, Common::StringView name) override
+            {
+                std::string str;
+
+                if (!(*this)(str, name))
+                {
+                    return false;
+                }
+
+                if (str.size() != size)
+                {
+                    throw std::runtime_error("Binary block size mismatch");
+                }
+
+                memcpy(value, str.data(), size);
+                return true;
+            }
+
+            virtual bool binary(std::string& value, Common::StringView name) override
+            {
+                return (*this)(value, name);
+            }
+    };
+}
+
+struct Inner
+{
+    uint64_t amount = 0;
+    std::string text;
+    uint8_t hash[32] = {};
+    std::vector<uint32_t> indexes;
+
+    void serialize(ISerializer& s)
+    {
+        s(amount, "amount");
+        s(text, "text");
+        s.binary(hash, sizeof(hash), "hash");
+        s(indexes, "indexes");
+    }
+
+    bool operator==(const Inner& other) const
+    {
+        return amount == other.amount && text == other.text
+            && memcmp(hash, other.hash, sizeof(hash)) == 0 && indexes == other.indexes;
+    }
+};
+
+struct Outer
+{
+    uint32_t u32 = 0;
+    int16_t i16 = 0;
+    uint8_t u8 = 0;
+    bool flag = false;
+    int64_t i64 = 0;
+    uint16_t u16 = 0;
+    int32_t i32 = 0;
+    std::vector<Inner> items;
+    std::vector<uint64_t> numbers;
+    Inner object;
+    std::string blob;
+    std::vector<std::string> strings;
+
+    /* Reading the fields in reverse misses the in order lookup every time */
+    void serialize(ISerializer& s, bool reversed)
+    {
+        const std::function<void()> fields[] = {
+            [&] { s(u32, "u32"); },
+            [&] { s(i16, "i16"); },
+            [&] { s(u8, "u8"); },
+            [&] { s(flag, "flag"); },
+            [&] { s(i64, "i64"); },
+            [&] { s(u16, "u16"); },
+            [&] { s(i32, "i32"); },
+            [&] { s(items, "items"); },
+            [&] { s(numbers, "numbers"); },
+            [&] { s(object, "object"); },
+            [&] { s.binary(blob, "blob"); },
+            [&] { s(strings, "strings"); }
+        };
+
+        const size_t count = sizeof(fields) / sizeof(fields[0]);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            fields[reversed ? count - 1 - i : i]();
+        }
+    }
+
+    void serialize(ISerializer& s)
+    {
+        serialize(s, false);
+    }
+
+    bool operator==(const Outer& other) const
+    {
+        return u32 == other.u32 && i16 == other.i16 && u8 == other.u8 && flag == other.flag
+            && i64 == other.i64 && u16 == other.u16 && i32 == other.i32 && items == other.items
+            && numbers == other.numbers && object == other.object && blob == other.blob
+            && strings == other.strings;
+    }
+};
+
+class Generator
+{
+    public:
+        Generator() : m_random(12345)
+        {
+        }
+
+        uint64_t next()
+        {
+            return m_random();
+        }
+
+        std::string string(size_t maxSize)
+        {
+            std::string str(m_random() % (maxSize + 1), '\0');
+
+            for (auto &c : str)
+            {
+                c = static_cast<char>(m_random());
+            }
+
+            return str;
+        }
+
+        Inner inner()
+        {
+            Inner inner;
+            inner.amount = m_random();
+            inner.text = string(20);
+
+            for (auto &b : inner.hash)
+            {
+                b = static_cast<uint8_t>(m_random());
+            }
+
+            inner.indexes.resize(m_random() % 5);
+
+            for (auto &i : inner.indexes)
+            {
+                i = static_cast<uint32_t>(m_random());
+            }
+
+            return inner;
+        }
+
+        Outer outer()
+        {
+            Outer outer;
+            outer.u32 = static_cast<uint32_t>(m_random());
+            outer.i16 = static_cast<int16_t>(m_random());
+            outer.u8 = static_cast<uint8_t>(m_random());
+            outer.flag = m_random() & 1;
+            outer.i64 = static_cast<int64_t>(m_random());
+            outer.u16 = static_cast<uint16_t>(m_random());
+            outer.i32 = static_cast<int32_t>(m_random());
+
+            outer.items.resize(m_random() % 6);
+
+            for (auto &item : outer.items)
+            {
+                item = inner();
+            }
+
+            outer.numbers.resize(m_random() % 8);
+
+            for (auto &n : outer.numbers)
+            {
+                n = m_random();
+            }
+
+            outer.object = inner();
+            outer.blob = string(64);
+            outer.strings.resize(m_random() % 4);
+
+            for (auto &s : outer.strings)
+            {
+                s = string(10);
+            }
+
+            return outer;
+        }
+
+        /* Flips bits, overwrites, truncates, inserts and erases bytes */
+        void corrupt(std::string &data)
+        {
+            const size_t mutations = 1 + m_random() % 4;
+
+            for (size_t i = 0; i < mutations; i++)
+            {
+                switch (m_random() % 5)
+                {
+                    case 0:
+                        if (!data.empty())
+                        {
+                            data[m_random() % data.size()] ^= 1 << (m_random() % 8);
+                        }
+                        break;
+                    case 1:
+                        if (!data.empty())
+                        {
+                            data[m_random() % data.size()] = static_cast<char>(m_random());
+                        }
+                        break;
+                    case 2:
+                        data.resize(m_random() % (data.size() + 1));
+                        break;
+                    case 3:
+                        data.insert(data.begin() + m_random() % (data.size() + 1), static_cast<char>(m_random()));
+                        break;
+                    case 4:
+                        /* Past the header, which only ever gets rejected */
+                        if (data.size() > sizeof(KVBinaryStorageBlockHeader))
+                        {
+                            const size_t start = sizeof(KVBinaryStorageBlockHeader)
+                                               + m_random() % (data.size() - sizeof(KVBinaryStorageBlockHeader));
+
+                            data.erase(start, std::min<size_t>(m_random() % 8, data.size() - start));
+                        }
+                        break;
+                }
+            }
+        }
+
+    private:
+        std::mt19937_64 m_random;
+};
+
+template<typename T>
+std::string toBinary(T &value)
+{
+    KVBinaryOutputStreamSerializer serializer;
+    value.serialize(serializer);
+
+    std::vector<uint8_t> buffer;
+    Common::VectorOutputStream stream(buffer);
+    serializer.dump(stream);
+
+    return std::string(buffer.begin(), buffer.end());
+}
+
+bool fromBinaryReference(const std::string &data, Outer &value, bool reversed)
+{
+    try
+    {
+        Common::MemoryInputStream stream(data.data(), data.size());
+        Reference::KVBinaryInputValueSerializer serializer(stream);
+        value.serialize(serializer, reversed);
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+bool fromBinary(const std::string &data, Outer &value, bool reversed)
+{
+    try
+    {
+        KVBinaryInputStreamSerializer serializer(data.data(), data.size());
+        value.serialize(serializer, reversed);
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+/* A single section with count entries, named after i % distinctNames, so
+   all but the first entry of each name are duplicates */
+struct WideSection
+{
+    size_t count;
+    size_t distinctNames;
+
+    void serialize(ISerializer& s)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t value = i;
+            s(value, "k" + std::to_string(i % distinctNames));
+        }
+    }
+};
+
+/* Decodes a WideSection, reading its names in a scattered order, and some
+   names which aren't there. Returns the time taken in microseconds. */
+double readWideSection(const std::string &data, size_t distinctNames)
+{
+    const auto startTimer = std::chrono::high_resolution_clock::now();
+
+    KVBinaryInputStreamSerializer serializer(data.data(), data.size());
+
+    for (size_t i = 0; i < distinctNames; i++)
+    {
+        const size_t name = (i * 7919) % distinctNames;
+
+        uint64_t value = 0;
+
+        if (!serializer(value, "k" + std::to_string(name)) || value != name)
+        {
+            throw std::runtime_error("KVBinaryInputStreamSerializer didn't return the first entry named k" + std::to_string(name));
+        }
+
+        if (i % 16 == 0 && serializer(value, "missing" + std::to_string(i)))
+        {
+            throw std::runtime_error("KVBinaryInputStreamSerializer found a name which isn't there");
+        }
+    }
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - startTimer
+    ).count();
+}
+
+/* Like an RPC response: a status, some numbers, and a list of objects */
+struct JsonResponse
+{
+    std::string status;
+    double difficulty = 0;
+    uint64_t height = 0;
+    std::vector<Outer> blocks;
+
+    void serialize(ISerializer& s)
+    {
+        s(status, "status");
+        s(difficulty, "difficulty");
+        s(height, "height");
+        s(blocks, "blocks");
+    }
+};
+
+JsonResponse randomResponse(Generator &generator, size_t blocks)
+{
+    JsonResponse response;
+    response.status = generator.string(8);
+
+    /* Small, large, negative and fractional */
+    response.difficulty = static_cast<double>(static_cast<int64_t>(generator.next()))
+                        / static_cast<double>(1ULL << (generator.next() % 64));
+
+    response.height = generator.next();
+
+    for (size_t i = 0; i < blocks; i++)
+    {
+        response.blocks.push_back(generator.outer());
+    }
+
+    return response;
+}
+
+/* JsonValue writes strings as they are, so only strings which need no
+   escaping come out as valid JSON */
+void makePrintable(std::string &str)
+{
+    for (auto &c : str)
+    {
+        c = static_cast<char>(' ' + static_cast<uint8_t>(c) % ('~' - ' ' + 1));
+
+        if (c == '"' || c == '\\')
+        {
+            c = '_';
+        }
+    }
+}
+
+void makePrintable(JsonResponse &response)
+{
+    makePrintable(response.status);
+
+    for (auto &block : response.blocks)
+    {
+        makePrintable(block.object.text);
+
+        for (auto &item : block.items)
+        {
+            makePrintable(item.text);
+        }
+
+        for (auto &str : block.strings)
+        {
+            makePrintable(str);
+        }
+    }
+}
+
+/* What RpcServer wrote before JsonStringOutputSerializer */
+std::string toJsonValueString(JsonResponse &response)
+{
+    JsonOutputStreamSerializer serializer;
+    response.serialize(serializer);
+    return serializer.getValue().toString();
+}
+
+std::string toJsonString(JsonResponse &response)
+{
+    std::string result;
+    JsonStringOutputSerializer serializer(result);
+    response.serialize(serializer);
+    serializer.finish();
+    return result;
+}
+
+bool stringEquals(const rapidjson::Value &value, const std::string &expected)
+{
+    return value.IsString() && std::string(value.GetString(), value.GetStringLength()) == expected;
+}
+
+/* Checks every string in the response made it through escaping */
+bool stringsEqual(const rapidjson::Document &document, const JsonResponse &response)
+{
+    if (!document.IsObject() || !stringEquals(document["status"], response.status)
+     || document["blocks"].Size() != response.blocks.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < response.blocks.size(); i++)
+    {
+        const auto &block = response.blocks[i];
+        const auto &value = document["blocks"][static_cast<rapidjson::SizeType>(i)];
+
+        if (!stringEquals(value["object"]["text"], block.object.text)
+         || value["items"].Size() != block.items.size()
+         || value["strings"].Size() != block.strings.size())
+        {
+            return false;
+        }
+
+        for (size_t j = 0; j < block.items.size(); j++)
+        {
+            if (!stringEquals(value["items"][static_cast<rapidjson::SizeType>(j)]["text"], block.items[j].text))
+            {
+                return false;
+            }
+        }
+
+        for (size_t j = 0; j < block.strings.size(); j++)
+        {
+            if (!stringEquals(value["strings"][static_cast<rapidjson::SizeType>(j)], block.strings[j]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/* getblocks serializes its response with a free function in RpcServer.cpp,
+   this writes the same fields */
+struct GetBlocksResponse : COMMAND_RPC_GET_BLOCKS_FAST::response
+{
+    void serialize(ISerializer &s)
+    {
+        KV_MEMBER(blocks)
+        KV_MEMBER(start_height)
+        KV_MEMBER(current_height)
+        KV_MEMBER(status)
+    }
+};
+
+template<typename T>
+T randomPod(Generator &generator)
+{
+    T value;
+
+    for (auto &b : value.data)
+    {
+        b = static_cast<uint8_t>(generator.next());
+    }
+
+    return value;
+}
+
+BinaryArray randomBlob(Generator &generator, size_t size)
+{
+    BinaryArray blob(size);
+
+    for (auto &b : blob)
+    {
+        b = static_cast<uint8_t>(generator.next());
+    }
+
+    return blob;
+}
+
+KeyInput randomKeyInput(Generator &generator)
+{
+    KeyInput input;
+    input.amount = generator.next() % 1000000000;
+    input.keyImage = randomPod<Crypto::KeyImage>(generator);
+
+    /* A ring of three */
+    for (size_t i = 0; i < 4; i++)
+    {
+        input.outputIndexes.push_back(static_cast<uint32_t>(generator.next() % 1000000));
+    }
+
+    return input;
+}
+
+/* Sized like mainnet: blocks of 10 transactions, each spending 2 inputs
+   into 3 outputs, and 100 blocks a request except for getwalletsyncdata,
+   which returns up to WALLET_SYNC_DATA_DEFAULT_MAX_BLOCK_COUNT */
+const size_t BENCHMARK_TRANSACTIONS = 10;
+const size_t BENCHMARK_BLOCKS = 100;
+
+GetBlocksResponse randomGetBlocks(Generator &generator)
+{
+    GetBlocksResponse response;
+    response.status = CORE_RPC_STATUS_OK;
+    response.start_height = generator.next() % 1000000;
+    response.current_height = response.start_height + BENCHMARK_BLOCKS;
+
+    for (size_t i = 0; i < BENCHMARK_BLOCKS; i++)
+    {
+        RawBlock block;
+        block.block = randomBlob(generator, 200);
+
+        for (size_t j = 0; j < BENCHMARK_TRANSACTIONS; j++)
+        {
+            block.transactions.push_back(randomBlob(generator, 1200));
+        }
+
+        response.blocks.push_back(std::move(block));
+    }
+
+    return response;
+}
+
+COMMAND_RPC_GET_WALLET_SYNC_DATA::response randomGetWalletSyncData(Generator &generator)
+{
+    COMMAND_RPC_GET_WALLET_SYNC_DATA::response response;
+    response.status = CORE_RPC_STATUS_OK;
+
+    const auto randomOutputs = [&generator](const size_t count)
+    {
+        std::vector<WalletTypes::KeyOutput> outputs(count);
+
+        for (auto &output : outputs)
+        {
+            output.key = randomPod<Crypto::PublicKey>(generator);
+            output.amount = generator.next() % 1000000000;
+        }
+
+        return outputs;
+    };
+
+    for (size_t i = 0; i < WALLET_SYNC_DATA_DEFAULT_MAX_BLOCK_COUNT; i++)
+    {
+        WalletTypes::WalletBlockInfo block;
+        block.blockHeight = i;
+        block.blockHash = randomPod<Crypto::Hash>(generator);
+        block.blockTimestamp = generator.next() % 2000000000;
+
+        block.coinbaseTransaction.keyOutputs = randomOutputs(1);
+        block.coinbaseTransaction.hash = randomPod<Crypto::Hash>(generator);
+        block.coinbaseTransaction.transactionPublicKey = randomPod<Crypto::PublicKey>(generator);
+        block.coinbaseTransaction.unlockTime = i + 40;
+
+        for (size_t j = 0; j < BENCHMARK_TRANSACTIONS; j++)
+        {
+            WalletTypes::RawTransaction transaction;
+            transaction.keyOutputs = randomOutputs(3);
+            transaction.hash = randomPod<Crypto::Hash>(generator);
+            transaction.transactionPublicKey = randomPod<Crypto::PublicKey>(generator);
+            transaction.unlockTime = 0;
+            transaction.paymentID = j % 2 ? Common::podToHex(randomPod<Crypto::Hash>(generator)) : "";
+            transaction.keyInputs = {randomKeyInput(generator), randomKeyInput(generator)};
+
+            block.transactions.push_back(std::move(transaction));
+        }
+
+        response.items.push_back(std::move(block));
+    }
+
+    return response;
+}
+
+COMMAND_RPC_QUERY_BLOCKS_DETAILED::response randomQueryBlocksDetailed(Generator &generator)
+{
+    COMMAND_RPC_QUERY_BLOCKS_DETAILED::response response;
+    response.status = CORE_RPC_STATUS_OK;
+
+    for (size_t i = 0; i < BENCHMARK_BLOCKS; i++)
+    {
+        BlockDetails block;
+        block.majorVersion = 4;
+        block.timestamp = generator.next() % 2000000000;
+        block.prevBlockHash = randomPod<Crypto::Hash>(generator);
+        block.nonce = static_cast<uint32_t>(generator.next());
+        block.index = static_cast<uint32_t>(i);
+        block.hash = randomPod<Crypto::Hash>(generator);
+        block.difficulty = generator.next() % 1000000000;
+        block.reward = generator.next() % 1000000000;
+        block.baseReward = block.reward;
+        block.blockSize = 12500;
+        block.transactionsCumulativeSize = 12000;
+        block.alreadyGeneratedCoins = generator.next();
+        block.alreadyGeneratedTransactions = generator.next() % 10000000;
+        block.sizeMedian = 100000;
+
+        for (size_t j = 0; j < BENCHMARK_TRANSACTIONS; j++)
+        {
+            TransactionDetails transaction;
+            transaction.hash = randomPod<Crypto::Hash>(generator);
+            transaction.size = 1200;
+            transaction.fee = 10;
+            transaction.mixin = 3;
+            transaction.timestamp = block.timestamp;
+            transaction.inBlockchain = true;
+            transaction.blockHash = block.hash;
+            transaction.blockIndex = block.index;
+            transaction.extra.publicKey = randomPod<Crypto::PublicKey>(generator);
+            transaction.extra.raw = randomBlob(generator, 33);
+
+            for (size_t k = 0; k < 2; k++)
+            {
+                KeyInputDetails input;
+                input.input = randomKeyInput(generator);
+                input.mixin = 3;
+                input.output.transactionHash = randomPod<Crypto::Hash>(generator);
+                input.output.number = generator.next() % 10;
+
+                transaction.inputs.push_back(input);
+                transaction.signatures.push_back(std::vector<Crypto::Signature>(4, randomPod<Crypto::Signature>(generator)));
+            }
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                TransactionOutputDetails output;
+                output.output.amount = generator.next() % 1000000000;
+                output.output.target = KeyOutput{randomPod<Crypto::PublicKey>(generator)};
+                output.globalIndex = generator.next() % 1000000;
+
+                transaction.outputs.push_back(output);
+            }
+
+            block.transactions.push_back(std::move(transaction));
+        }
+
+        response.blocks.push_back(std::move(block));
+    }
+
+    return response;
+}
+
+COMMAND_RPC_GET_TRANSACTIONS::response randomGetTransactions(Generator &generator)
+{
+    COMMAND_RPC_GET_TRANSACTIONS::response response;
+    response.status = CORE_RPC_STATUS_OK;
+
+    for (size_t i = 0; i < BENCHMARK_BLOCKS; i++)
+    {
+        response.txs_as_hex.push_back(Common::toHex(randomBlob(generator, 1200)));
+    }
+
+    return response;
+}
+
+#ifdef __linux__
+/* A field of /proc/self/status, in KB */
+size_t readStatus(const std::string &field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size() + 1, field + ":") == 0)
+        {
+            return std::stoull(line.substr(field.size() + 1));
+        }
+    }
+
+    return 0;
+}
+#endif
+
+/* How far above where it started the resident set grew while run ran, in
+   KB. Only measured on Linux, which can reset the peak, 0 elsewhere. */
+size_t getPeakMemoryGrowth(const std::function<void()> &run)
+{
+#ifdef __linux__
+    /* Hands memory freed by earlier runs back, so reusing it shows up */
+    malloc_trim(0);
+
+    std::ofstream("/proc/self/clear_refs") << "5";
+
+    const size_t start = readStatus("VmRSS");
+
+    run();
+
+    const size_t peak = readStatus("VmHWM");
+
+    return peak > start ? peak - start : 0;
+#else
+    run();
+    return 0;
+#endif
+}
+
+/* Writing speed in MB/s and peak memory growth in KB of write, repeated
+   until about 50 MB was written */
+std::tuple<double, size_t> measureWriting(const std::function<std::string()> &write, size_t responseSize)
+{
+    const size_t loopIterations = std::max<size_t>(1, 50 * 1024 * 1024 / responseSize);
+
+    size_t bytes = 0;
+
+    const auto startTimer = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < loopIterations; i++)
+    {
+        bytes += write().size();
+    }
+
+    const double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - startTimer
+    ).count() / 1000000.0;
+
+    const size_t peak = getPeakMemoryGrowth([&write]() { write(); });
+
+    return {bytes / seconds / (1024 * 1024), peak};
+}
+
+/* Compares writing response through a JsonValue, as RpcServer did, with
+   JsonStringOutputSerializer, as it does now. A JsonValue object keeps only
+   the last of repeated keys, as RawBlock writes for each transaction, so the
+   reference is only printed when both write the same document */
+template<typename T>
+void benchmarkResponse(const std::string &name, const T &response)
+{
+    const size_t responseSize = storeToJsonString(response).size();
+
+    const auto [speed, peak] = measureWriting([&response]() { return storeToJsonString(response); }, responseSize);
+
+    std::cout << "Writing a " << responseSize / 1024 << " KB " << name << " response: "
+              << speed << " MB/s, " << peak / 1024.0 << " MB peak RSS growth with JsonStringOutputSerializer";
+
+    if (storeToJson(response).size() == responseSize)
+    {
+        const auto [referenceSpeed, referencePeak] = measureWriting([&response]() { return storeToJson(response); }, responseSize);
+
+        std::cout << " (" << referenceSpeed << " MB/s, " << referencePeak / 1024.0 << " MB building a JsonValue first)";
+    }
+
+    std::cout << std::endl;
+}
+
+}
+
+void testKVBinaryInputStreamSerializer()
+{
+    Generator generator;
+
+    const size_t iterations = 50000;
+
+    size_t decoded = 0;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        Outer original = generator.outer();
+        std::string data = toBinary(original);
+
+        /* Every tenth payload is left intact, and has to round trip */
+        const bool intact = i % 10 == 0;
+
+        if (!intact)
+        {
+            generator.corrupt(data);
+        }
+
+        const bool reversed = generator.next() & 1;
+
+        Outer expected;
+        Outer actual;
+
+        const bool expectedSuccess = fromBinaryReference(data, expected, reversed);
+        const bool actualSuccess = fromBinary(data, actual, reversed);
+
+        if (expectedSuccess != actualSuccess || (actualSuccess && !(expected == actual)))
+        {
+            throw std::runtime_error("KVBinaryInputStreamSerializer disagrees with the JsonValue reader on fuzz input "
+                                   + std::to_string(i));
+        }
+
+        if (intact && !(actualSuccess && actual == original))
+        {
+            throw std::runtime_error("KVBinaryInputStreamSerializer failed to round trip fuzz input " + std::to_string(i));
+        }
+
+        decoded += actualSuccess;
+    }
+
+    std::cout << "KVBinaryInputStreamSerializer matches the JsonValue reader on " << iterations
+              << " fuzzed payloads (" << decoded << " decoded)" << std::endl;
+
+    /* Indexing a section has to stay well under quadratic in its size, as
+       the sections come straight off the network */
+    const auto timeSection = [](size_t count)
+    {
+        WideSection section = { count, count / 2 };
+        const std::string data = toBinary(section);
+        return std::max(readWideSection(data, section.distinctNames), 1000.0);
+    };
+
+    const double smallTime = timeSection(10000);
+    const double largeTime = timeSection(160000);
+
+    /* 16 times the entries; quadratic would take 256 times as long */
+    if (largeTime > smallTime * 64)
+    {
+        throw std::runtime_error("KVBinaryInputStreamSerializer is too slow with large sections: "
+                               + std::to_string(smallTime / 1000) + " ms for 10000 entries, "
+                               + std::to_string(largeTime / 1000) + " ms for 160000");
+    }
+
+    std::cout << "KVBinaryInputStreamSerializer reads a section of 160000 entries in "
+              << largeTime / 1000 << " ms" << std::endl;
+}
+
+void benchmarkKVBinaryInputStreamSerializer()
+{
+    Generator generator;
+
+    std::vector<std::string> payloads;
+
+    for (size_t i = 0; i < 20000; i++)
+    {
+        Outer value = generator.outer();
+        payloads.push_back(toBinary(value));
+    }
+
+    const auto timeDecoding = [&](const auto &decode)
+    {
+        const auto startTimer = std::chrono::high_resolution_clock::now();
+
+        for (const auto &payload : payloads)
+        {
+            Outer value;
+            decode(payload, value, false);
+        }
+
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - startTimer
+        ).count() / static_cast<double>(payloads.size());
+    };
+
+    const double referenceTime = timeDecoding(fromBinaryReference);
+    const double time = timeDecoding(fromBinary);
+
+    std::cout << "Time to decode a KV binary payload with KVBinaryInputStreamSerializer: " << time << " us ("
+              << referenceTime << " us loading it into a JsonValue first)" << std::endl;
+}
+
+void testJsonStringOutputSerializer()
+{
+    Generator generator;
+
+    const size_t iterations = 2000;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        JsonResponse response = randomResponse(generator, generator.next() % 4);
+
+        /* Any bytes at all have to be escaped into JSON which reads back */
+        rapidjson::Document document;
+        document.Parse(toJsonString(response).c_str());
+
+        if (document.HasParseError() || !stringsEqual(document, response))
+        {
+            throw std::runtime_error("JsonStringOutputSerializer wrote strings which don't read back, on input "
+                                   + std::to_string(i));
+        }
+
+        /* Otherwise it has to be the same JSON as before, other than the key
+           order */
+        makePrintable(response);
+
+        rapidjson::Document expected;
+        rapidjson::Document actual;
+
+        expected.Parse(toJsonValueString(response).c_str());
+        actual.Parse(toJsonString(response).c_str());
+
+        if (expected.HasParseError() || actual.HasParseError() || expected != actual)
+        {
+            throw std::runtime_error("JsonStringOutputSerializer disagrees with JsonOutputStreamSerializer on input "
+                                   + std::to_string(i));
+        }
+    }
+
+    std::cout << "JsonStringOutputSerializer matches JsonOutputStreamSerializer on " << iterations
+              << " responses" << std::endl;
+}
+
+void benchmarkJsonStringOutputSerializer()
+{
+    Generator generator;
+
+    benchmarkResponse("/getblocks", randomGetBlocks(generator));
+    benchmarkResponse("/getwalletsyncdata", randomGetWalletSyncData(generator));
+    benchmarkResponse("/queryblocksdetailed and /get_blocks_details_by_heights", randomQueryBlocksDetailed(generator));
+    benchmarkResponse("/gettransactions", randomGetTransactions(generator));
+}
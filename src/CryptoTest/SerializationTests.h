@@ -0,0 +1,24 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Fuzzes KVBinaryInputStreamSerializer against the JsonValue based reader
+   it replaced, with random and corrupted payloads, and checks sections with
+   many (and duplicated) names are indexed in better than quadratic time.
+   Throws on any difference. */
+void testKVBinaryInputStreamSerializer();
+
+void benchmarkKVBinaryInputStreamSerializer();
+
+/* Writes random RPC like responses with JsonStringOutputSerializer, and
+   checks they parse to the same JSON as JsonOutputStreamSerializer gave,
+   and that strings of any bytes are escaped so they read back. Throws on
+   any difference. */
+void testJsonStringOutputSerializer();
+
+/* Writes responses of the heaviest JSON RPC endpoints, sized like mainnet,
+   through a JsonValue as RpcServer did and with JsonStringOutputSerializer,
+   and prints the speed and peak resident memory growth of each */
+void benchmarkJsonStringOutputSerializer();
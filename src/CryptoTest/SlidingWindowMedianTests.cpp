@@ -0,0 +1,88 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "SlidingWindowMedianTests.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Common/Math.h"
+#include "Common/SlidingWindowMedian.h"
+
+namespace
+{
+
+/* The median of the last windowSize values, the slow way */
+uint64_t expectedMedian(const std::vector<uint64_t> &values, const size_t windowSize)
+{
+    const size_t count = std::min(values.size(), windowSize);
+
+    std::vector<uint64_t> window(values.end() - count, values.end());
+
+    return Common::medianValue(window);
+}
+
+void checkWindow(const size_t windowSize, const uint64_t maxValue, std::mt19937_64 &random)
+{
+    Common::SlidingWindowMedian<uint64_t> median(windowSize);
+
+    /* Every value pushed, the window being the last windowSize of them */
+    std::vector<uint64_t> values;
+
+    for (size_t i = 0; i < 5000; i++)
+    {
+        if (random() % 8 == 0 && !values.empty())
+        {
+            /* Pops up to a window of values, and refills the window with
+               the ones before them */
+            values.resize(values.size() - std::min<size_t>(values.size(), 1 + random() % windowSize));
+
+            median.clear();
+
+            for (size_t j = values.size() - std::min(values.size(), windowSize); j < values.size(); j++)
+            {
+                median.push(values[j]);
+            }
+        }
+        else
+        {
+            values.push_back(random() % (maxValue + 1));
+            median.push(values.back());
+        }
+
+        if (median.size() != std::min(values.size(), windowSize))
+        {
+            throw std::runtime_error("SlidingWindowMedian of window size " + std::to_string(windowSize)
+                                   + " holds " + std::to_string(median.size()) + " values");
+        }
+
+        if (median.median() != expectedMedian(values, windowSize))
+        {
+            throw std::runtime_error("SlidingWindowMedian of window size " + std::to_string(windowSize)
+                                   + " returned " + std::to_string(median.median()) + " instead of "
+                                   + std::to_string(expectedMedian(values, windowSize)));
+        }
+    }
+}
+
+}
+
+void testSlidingWindowMedian()
+{
+    std::mt19937_64 random(std::random_device{}());
+
+    for (const size_t windowSize : {1, 2, 3, 4, 7, 10, 100, 101})
+    {
+        /* Few distinct values gives many duplicates in the window */
+        checkWindow(windowSize, 3, random);
+        checkWindow(windowSize, 1000000, random);
+    }
+
+    std::cout << "SlidingWindowMedian matches Common::medianValue" << std::endl;
+}
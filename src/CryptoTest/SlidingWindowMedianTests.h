@@ -0,0 +1,11 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Pushes random values, with plenty of duplicates, to SlidingWindowMedians
+   of odd and even window sizes, and pops blocks off the end the way the
+   blockchain caches do, by refilling the window. Throws if a median differs
+   from Common::medianValue() of the values in the window. */
+void testSlidingWindowMedian();
@@ -0,0 +1,295 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "SubWalletsTests.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "CryptoNote.h"
+#include "JsonHelper.h"
+#include "SubWallets/SubWallets.h"
+#include "Utilities/Addresses.h"
+
+namespace
+{
+
+const uint64_t MAX_HEIGHT = 200;
+
+class TransactionGenerator
+{
+    public:
+        TransactionGenerator(const std::vector<Crypto::PublicKey> &publicSpendKeys) :
+            m_publicSpendKeys(publicSpendKeys)
+        {
+            /* Transfers to someone else's key come back from no subwallet */
+            Crypto::PublicKey otherKey;
+            Crypto::SecretKey otherSecretKey;
+
+            Crypto::generate_keys(otherKey, otherSecretKey);
+
+            m_publicSpendKeys.push_back(otherKey);
+        }
+
+        WalletTypes::Transaction transaction(const uint64_t blockHeight)
+        {
+            std::unordered_map<Crypto::PublicKey, int64_t> transfers;
+
+            const size_t transferCount = 1 + m_random() % 2;
+
+            for (size_t i = 0; i < transferCount; i++)
+            {
+                transfers[m_publicSpendKeys[m_random() % m_publicSpendKeys.size()]] = 1 + m_random() % 1000;
+            }
+
+            Crypto::Hash hash;
+
+            std::generate(std::begin(hash.data), std::end(hash.data), [this]() { return m_random(); });
+
+            return WalletTypes::Transaction(transfers, hash, 10, 0, blockHeight, "", 0, false);
+        }
+
+        uint64_t next()
+        {
+            return m_random();
+        }
+
+    private:
+        std::mt19937_64 m_random {1};
+
+        std::vector<Crypto::PublicKey> m_publicSpendKeys;
+};
+
+std::vector<Crypto::Hash> getHashes(const std::vector<WalletTypes::Transaction> &transactions)
+{
+    std::vector<Crypto::Hash> hashes;
+
+    for (const auto &tx : transactions)
+    {
+        hashes.push_back(tx.hash);
+    }
+
+    return hashes;
+}
+
+/* What getTransactionsRange() did before the transactions were indexed:
+   every transaction filtered, sorted by height beforehand */
+std::vector<Crypto::Hash> filterTransactions(
+    const std::vector<WalletTypes::Transaction> &sortedTransactions,
+    const uint64_t startHeight,
+    const uint64_t endHeight,
+    const Crypto::PublicKey *publicSpendKey)
+{
+    std::vector<WalletTypes::Transaction> result;
+
+    for (const auto &tx : sortedTransactions)
+    {
+        if (tx.blockHeight < startHeight || tx.blockHeight >= endHeight)
+        {
+            continue;
+        }
+
+        if (publicSpendKey != nullptr && tx.transfers.find(*publicSpendKey) == tx.transfers.end())
+        {
+            continue;
+        }
+
+        result.push_back(tx);
+    }
+
+    return getHashes(result);
+}
+
+void checkTransactions(
+    const SubWallets &subWallets,
+    std::vector<WalletTypes::Transaction> expected,
+    TransactionGenerator &generator,
+    const std::string &when)
+{
+    /* SubWallets keeps them sorted by height, and those at the same height
+       in the order added */
+    std::stable_sort(expected.begin(), expected.end(), [](const auto &a, const auto &b)
+    {
+        return a.blockHeight < b.blockHeight;
+    });
+
+    std::vector<Crypto::PublicKey> publicSpendKeys = subWallets.m_publicSpendKeys;
+
+    /* A key no transaction has a transfer to */
+    publicSpendKeys.push_back(Crypto::PublicKey());
+
+    for (size_t i = 0; i < 200; i++)
+    {
+        /* The whole range, and ones which are empty or past either end */
+        uint64_t startHeight = i == 0 ? 0 : generator.next() % (MAX_HEIGHT + 20);
+        uint64_t endHeight = i == 0 ? MAX_HEIGHT + 1 : generator.next() % (MAX_HEIGHT + 20);
+
+        if (getHashes(subWallets.getTransactionsRange(startHeight, endHeight))
+         != filterTransactions(expected, startHeight, endHeight, nullptr))
+        {
+            throw std::runtime_error(
+                "SubWallets returned the wrong transactions from " + std::to_string(startHeight)
+              + " to " + std::to_string(endHeight) + " " + when
+            );
+        }
+
+        for (const auto &publicSpendKey : publicSpendKeys)
+        {
+            if (getHashes(subWallets.getTransactionsRange(startHeight, endHeight, publicSpendKey))
+             != filterTransactions(expected, startHeight, endHeight, &publicSpendKey))
+            {
+                throw std::runtime_error(
+                    "SubWallets returned the wrong transactions for a subwallet from " + std::to_string(startHeight)
+                  + " to " + std::to_string(endHeight) + " " + when
+                );
+            }
+        }
+    }
+
+    if (getHashes(subWallets.getTransactions()) != filterTransactions(expected, 0, MAX_HEIGHT + 1, nullptr))
+    {
+        throw std::runtime_error("SubWallets returned the wrong transactions " + when);
+    }
+}
+
+/* Loads a copy of the wallets the way WalletBackend does */
+std::unique_ptr<SubWallets> saveAndLoad(const SubWallets &subWallets)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    writer.StartObject();
+    writer.Key("subWallets");
+    subWallets.toJSON(writer);
+    writer.EndObject();
+
+    rapidjson::Document document;
+
+    if (document.Parse(buffer.GetString()).HasParseError())
+    {
+        throw std::runtime_error("SubWallets wrote invalid json");
+    }
+
+    std::unique_ptr<SubWallets> loaded(new SubWallets());
+
+    loaded->fromJSON(getObjectFromJSON(document, "subWallets"));
+
+    return loaded;
+}
+
+}
+
+void testSubWallets()
+{
+    CryptoNote::KeyPair spendKey;
+    CryptoNote::KeyPair viewKey;
+
+    Crypto::generate_keys(spendKey.publicKey, spendKey.secretKey);
+    Crypto::generate_keys(viewKey.publicKey, viewKey.secretKey);
+
+    const std::string address = Utilities::privateKeysToAddress(spendKey.secretKey, viewKey.secretKey);
+
+    SubWallets subWallets(spendKey.secretKey, viewKey.secretKey, address, 0, false);
+
+    subWallets.addSubWallet();
+    subWallets.addSubWallet();
+
+    TransactionGenerator generator(subWallets.m_publicSpendKeys);
+
+    std::vector<WalletTypes::Transaction> expected;
+
+    /* Mostly in height order, as blocks are synced, but every tenth one
+       at some lower height */
+    for (uint64_t i = 0; i < 2000; i++)
+    {
+        const uint64_t height = i * MAX_HEIGHT / 2000;
+
+        expected.push_back(generator.transaction(i % 10 == 9 ? generator.next() % (height + 1) : height));
+
+        subWallets.addTransaction(expected.back());
+    }
+
+    checkTransactions(subWallets, expected, generator, "after adding them");
+
+    /* Rewinding a fork has to forget the hashes and indexes of the forked
+       transactions, so they can be added again once they're in the new
+       chain, without the old indexes pointing past the end */
+    const uint64_t forkHeight = MAX_HEIGHT / 2;
+
+    std::vector<WalletTypes::Transaction> forked;
+
+    for (const auto &tx : expected)
+    {
+        if (tx.blockHeight >= forkHeight)
+        {
+            forked.push_back(tx);
+        }
+    }
+
+    expected.erase(std::remove_if(expected.begin(), expected.end(), [forkHeight](const auto &tx)
+    {
+        return tx.blockHeight >= forkHeight;
+    }), expected.end());
+
+    subWallets.removeForkedTransactions(forkHeight);
+
+    checkTransactions(subWallets, expected, generator, "after rewinding a fork");
+
+    for (size_t i = 0; i < forked.size(); i += 2)
+    {
+        expected.push_back(forked[i]);
+        subWallets.addTransaction(forked[i]);
+
+        expected.push_back(generator.transaction(forkHeight + generator.next() % (MAX_HEIGHT - forkHeight)));
+        subWallets.addTransaction(expected.back());
+    }
+
+    checkTransactions(subWallets, expected, generator, "after adding transactions back after a fork");
+
+    bool threwOnDuplicate = false;
+
+    try
+    {
+        subWallets.addTransaction(expected.front());
+    }
+    catch (const std::runtime_error &)
+    {
+        threwOnDuplicate = true;
+    }
+
+    if (!threwOnDuplicate)
+    {
+        throw std::runtime_error("SubWallets accepted a transaction it already had");
+    }
+
+    /* Unconfirmed transactions have to stay out of the transactions when
+       the wallets are loaded */
+    const WalletTypes::Transaction unconfirmed = generator.transaction(0);
+
+    subWallets.addUnconfirmedTransaction(unconfirmed);
+
+    const auto loaded = saveAndLoad(subWallets);
+
+    checkTransactions(*loaded, expected, generator, "after saving and loading the wallets");
+
+    if (getHashes(loaded->getUnconfirmedTransactions()) != std::vector<Crypto::Hash>{unconfirmed.hash})
+    {
+        throw std::runtime_error("SubWallets lost an unconfirmed transaction when loading the wallets");
+    }
+
+    /* Once it is in a block, it moves over */
+    expected.push_back(unconfirmed);
+    loaded->addTransaction(unconfirmed);
+
+    checkTransactions(*loaded, expected, generator, "after an unconfirmed transaction got into a block");
+
+    if (!loaded->getUnconfirmedTransactions().empty())
+    {
+        throw std::runtime_error("SubWallets kept a transaction as unconfirmed after it got into a block");
+    }
+
+    std::cout << "SubWallets transaction ranges match filtering every transaction" << std::endl;
+}
@@ -0,0 +1,13 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Adds random transactions, some out of height order, to SubWallets with
+   three subwallets, and checks both getTransactionsRange() overloads
+   against filtering every transaction. Repeats after rewinding a fork, and
+   re-adding the forked transactions, and after saving the wallets with an
+   unconfirmed transaction and loading them again. Throws on any
+   difference. */
+void testSubWallets();
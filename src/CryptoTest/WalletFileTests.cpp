@@ -0,0 +1,310 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "WalletFileTests.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <cryptopp/aes.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/modes.h>
+#include <cryptopp/pwdbased.h>
+#include <cryptopp/sha.h>
+
+#include "CryptoTypes.h"
+#include "Common/FileSystemShim.h"
+#include "WalletBackend/Constants.h"
+#include "WalletBackend/WalletFile.h"
+
+namespace
+{
+
+const std::string PASSWORD = "correct horse";
+
+/* A wallet file as WalletBackend wrote them before WalletFile: the salt is
+   the IV too, and there is no SEPARATE_IV_IDENTIFIER */
+void writeLegacyWallet(const std::string &filename, const std::string &password, const std::string &walletJson)
+{
+    CryptoPP::byte salt[16];
+    CryptoPP::byte key[16];
+
+    std::fill(std::begin(salt), std::end(salt), 0x5a);
+
+    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
+
+    pbkdf2.DeriveKey(
+        key, sizeof(key), 0,
+        reinterpret_cast<const CryptoPP::byte *>(password.c_str()),
+        password.size(), salt, sizeof(salt),
+        Constants::PBKDF2_ITERATIONS
+    );
+
+    CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption cbcEncryption;
+    cbcEncryption.SetKeyWithIV(key, sizeof(key), salt);
+
+    const std::string plaintext = std::string(
+        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.begin(),
+        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.end()
+    ) + walletJson;
+
+    std::string encryptedData;
+
+    CryptoPP::StringSource(plaintext, true, new CryptoPP::StreamTransformationFilter(
+        cbcEncryption, new CryptoPP::StringSink(encryptedData))
+    );
+
+    std::ofstream file(filename, std::ios_base::binary);
+
+    file.write(Constants::IS_A_WALLET_IDENTIFIER.data(), Constants::IS_A_WALLET_IDENTIFIER.size());
+    file.write(reinterpret_cast<const char *>(salt), sizeof(salt));
+    file.write(encryptedData.data(), encryptedData.size());
+}
+
+std::unique_ptr<WalletFile> openWallet(
+    const std::string &filename,
+    const std::string &password,
+    const std::string &expectedJson,
+    const std::string &when)
+{
+    auto [error, walletFile, walletJson] = WalletFile::open(filename, password);
+
+    if (error)
+    {
+        throw std::runtime_error("Failed to open the wallet file " + when + ": " + error.getErrorMessage());
+    }
+
+    if (walletJson != expectedJson)
+    {
+        throw std::runtime_error("Opening the wallet file " + when + " returned the wrong snapshot");
+    }
+
+    return std::move(walletFile);
+}
+
+void checkWrongPassword(const std::string &filename, const std::string &when)
+{
+    const auto [error, walletFile, walletJson] = WalletFile::open(filename, "wrong horse");
+
+    if (error != WRONG_PASSWORD)
+    {
+        throw std::runtime_error("Opening the wallet file " + when + " with the wrong password didn't report WRONG_PASSWORD");
+    }
+}
+
+void checkJournal(WalletFile &walletFile, const std::vector<std::string> &expected, const std::string &when)
+{
+    if (walletFile.readJournal() != expected)
+    {
+        throw std::runtime_error("Replaying the wallet journal " + when + " returned the wrong records");
+    }
+}
+
+void checkSnapshotRequired(const WalletFile &walletFile, const bool expected, const std::string &when)
+{
+    if (walletFile.snapshotRequired() != expected)
+    {
+        throw std::runtime_error(
+            std::string("WalletFile ") + (expected ? "didn't ask" : "asked") + " for a snapshot " + when
+        );
+    }
+}
+
+void testLegacyWallet(const std::string &filename)
+{
+    writeLegacyWallet(filename, PASSWORD, "{\"legacy\": true}");
+
+    checkWrongPassword(filename, "in the old layout");
+
+    {
+        auto walletFile = openWallet(filename, PASSWORD, "{\"legacy\": true}", "in the old layout");
+
+        checkJournal(*walletFile, {}, "of a wallet in the old layout");
+        checkSnapshotRequired(*walletFile, false, "after opening a wallet in the old layout");
+
+        walletFile->appendToJournal("first");
+    }
+
+    /* The journal of a wallet in the old layout starts with the salt, which
+       is its IV */
+    auto walletFile = openWallet(filename, PASSWORD, "{\"legacy\": true}", "in the old layout with a journal");
+
+    checkJournal(*walletFile, {"first"}, "of a wallet in the old layout");
+}
+
+void testJournal(const std::string &filename)
+{
+    const std::string journalFilename = filename + ".journal";
+
+    {
+        WalletFile walletFile(filename, PASSWORD);
+
+        checkSnapshotRequired(walletFile, true, "for a new wallet");
+
+        walletFile.writeSnapshot("{\"snapshot\": 1}");
+
+        checkSnapshotRequired(walletFile, false, "after writing the first snapshot");
+
+        walletFile.appendToJournal("first");
+        walletFile.appendToJournal(std::string(1000, 'x'));
+    }
+
+    checkWrongPassword(filename, "with a journal");
+
+    {
+        auto walletFile = openWallet(filename, PASSWORD, "{\"snapshot\": 1}", "with a journal");
+
+        checkJournal(*walletFile, {"first", std::string(1000, 'x')}, "after a save");
+
+        walletFile->appendToJournal("third");
+    }
+
+    /* Cut the last record off part way, as if we were killed writing it */
+    const uint64_t fullSize = fs::file_size(journalFilename);
+
+    fs::resize_file(journalFilename, fullSize - 10);
+
+    {
+        auto walletFile = openWallet(filename, PASSWORD, "{\"snapshot\": 1}", "with a torn journal");
+
+        checkJournal(*walletFile, {"first", std::string(1000, 'x')}, "with a torn record at the end");
+
+        if (fs::file_size(journalFilename) >= fullSize - 10)
+        {
+            throw std::runtime_error("The torn record at the end of the wallet journal wasn't truncated");
+        }
+
+        walletFile->appendToJournal("fourth");
+    }
+
+    {
+        auto walletFile = openWallet(filename, PASSWORD, "{\"snapshot\": 1}", "after appending to a truncated journal");
+
+        checkJournal(*walletFile, {"first", std::string(1000, 'x'), "fourth"}, "after appending to a truncated journal");
+
+        /* Keep the journal of this snapshot, as though removing it after the
+           next snapshot failed */
+        fs::copy_file(journalFilename, journalFilename + ".old", fs::copy_options::overwrite_existing);
+
+        walletFile->writeSnapshot("{\"snapshot\": 2}");
+
+        if (fs::exists(journalFilename))
+        {
+            throw std::runtime_error("Writing a wallet snapshot didn't remove the journal");
+        }
+
+        fs::rename(journalFilename + ".old", journalFilename);
+    }
+
+    auto walletFile = openWallet(filename, PASSWORD, "{\"snapshot\": 2}", "with a stale journal");
+
+    checkJournal(*walletFile, {}, "left by an older snapshot");
+
+    if (fs::exists(journalFilename))
+    {
+        throw std::runtime_error("The wallet journal left by an older snapshot wasn't removed");
+    }
+}
+
+void testChangePassword(const std::string &filename)
+{
+    {
+        WalletFile walletFile(filename, PASSWORD);
+
+        walletFile.writeSnapshot("{\"password\": 1}");
+        walletFile.appendToJournal("first");
+
+        walletFile.changePassword("new horse");
+
+        checkSnapshotRequired(walletFile, true, "after changing the password");
+
+        walletFile.writeSnapshot("{\"password\": 2}");
+
+        checkSnapshotRequired(walletFile, false, "after the snapshot with the new password");
+    }
+
+    const auto [error, walletFile, walletJson] = WalletFile::open(filename, PASSWORD);
+
+    if (error != WRONG_PASSWORD)
+    {
+        throw std::runtime_error("The wallet file still opens with the old password after changing it");
+    }
+
+    openWallet(filename, "new horse", "{\"password\": 2}", "with the changed password");
+}
+
+/* The journal is folded in once it is over MIN_JOURNAL_COMPACTION_SIZE, or
+   half the snapshot if that is larger */
+void testCompaction(const std::string &filename, const size_t snapshotSize)
+{
+    const std::string journalFilename = filename + ".journal";
+
+    WalletFile walletFile(filename, PASSWORD);
+
+    walletFile.writeSnapshot(std::string(snapshotSize, 's'));
+
+    const uint64_t threshold = std::max<uint64_t>(Constants::MIN_JOURNAL_COMPACTION_SIZE, fs::file_size(filename) / 2);
+
+    const std::string record(10000, 'r');
+
+    while (!walletFile.snapshotRequired())
+    {
+        walletFile.appendToJournal(record);
+
+        if (fs::file_size(journalFilename) <= threshold)
+        {
+            checkSnapshotRequired(walletFile, false, "with the journal under the compaction threshold");
+        }
+    }
+
+    const uint64_t journalSize = fs::file_size(journalFilename);
+
+    if (journalSize <= threshold || journalSize > threshold + record.size() + 100)
+    {
+        throw std::runtime_error(
+            "WalletFile asked for a snapshot with a " + std::to_string(journalSize)
+          + " byte journal, the threshold is " + std::to_string(threshold)
+        );
+    }
+
+    walletFile.writeSnapshot(std::string(snapshotSize, 's'));
+
+    checkSnapshotRequired(walletFile, false, "after compacting the journal");
+}
+
+}
+
+void testWalletFile()
+{
+    const fs::path dataDir = fs::temp_directory_path() / "cryptotest-walletfile";
+    const std::string filename = (dataDir / "wallet.wallet").string();
+
+    /* Each part starts from an empty directory */
+    const auto reset = [&dataDir]()
+    {
+        fs::remove_all(dataDir);
+        fs::create_directories(dataDir);
+    };
+
+    reset();
+    testLegacyWallet(filename);
+
+    reset();
+    testJournal(filename);
+
+    reset();
+    testChangePassword(filename);
+
+    reset();
+    testCompaction(filename, 100);
+
+    reset();
+    testCompaction(filename, 5 * 1024 * 1024);
+
+    fs::remove_all(dataDir);
+
+    std::cout << "WalletFile opens, replays and compacts journals, and changes passwords" << std::endl;
+}
@@ -0,0 +1,13 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+/* Opens wallet files written in the old layout and by WalletFile, with the
+   right and wrong passwords, and replays journals appended after a save,
+   one cut off part way through a record, and one left by an older snapshot.
+   Checks a changed password takes over from the next snapshot, and that a
+   snapshot is asked for once the journal passes the compaction threshold.
+   Throws on the first difference. */
+void testWalletFile();
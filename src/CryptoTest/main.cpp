@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <chrono>
+#include <random>
+#include <stdexcept>
 #include <assert.h>
 
 #include <cxxopts.hpp>
@@ -15,6 +17,17 @@
 #include "CryptoTypes.h"
 #include "Common/StringTools.h"
 #include "crypto/crypto.h"
+#include "BlockDownloadSchedulerTests.h"
+#include "CoreTests.h"
+#include "DatabaseBlockchainCacheTests.h"
+#include "HttpTests.h"
+#include "LoggingTests.h"
+#include "MainChainStorageTests.h"
+#include "RocksDBWrapperTests.h"
+#include "SerializationTests.h"
+#include "SlidingWindowMedianTests.h"
+#include "SubWalletsTests.h"
+#include "WalletFileTests.h"
 
 #define PERFORMANCE_ITERATIONS  1000
 #define PERFORMANCE_ITERATIONS_LONG_MULTIPLIER 10
@@ -187,18 +200,35 @@ void benchmark(T hashFunction, std::string hashFunctionName, uint64_t iterations
 
     Hash hash = Hash();
 
-    auto startTimer = std::chrono::high_resolution_clock::now();
-
-    for (uint64_t i = 0; i < iterations; i++)
+    /* Time the hash with the scratchpad released after every hash, which is
+       how every hash used to work, and with the thread's scratchpad reused */
+    const auto hashesPerSecond = [&](const bool releaseScratchpad)
     {
-        hashFunction(rawData.data(), rawData.size(), hash);
-    }
+        Crypto::cn_slow_hash_release_state();
 
-    auto elapsedTime = std::chrono::high_resolution_clock::now() - startTimer;
+        auto startTimer = std::chrono::high_resolution_clock::now();
+
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            hashFunction(rawData.data(), rawData.size(), hash);
+
+            if (releaseScratchpad)
+            {
+                Crypto::cn_slow_hash_release_state();
+            }
+        }
+
+        auto elapsedTime = std::chrono::high_resolution_clock::now() - startTimer;
+
+        return iterations / (std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count() / 1000000.0);
+    };
+
+    const auto freshScratchpad = hashesPerSecond(true);
+    const auto reusedScratchpad = hashesPerSecond(false);
 
     std::cout << hashFunctionName << ": "
-              << (iterations / std::chrono::duration_cast<std::chrono::seconds>(elapsedTime).count())
-              << " H/s\n";
+              << static_cast<uint64_t>(reusedScratchpad) << " H/s ("
+              << static_cast<uint64_t>(freshScratchpad) << " H/s allocating the scratchpad per hash)\n";
 }
 
 void benchmarkUnderivePublicKey()
@@ -262,6 +292,252 @@ void benchmarkGenerateKeyDerivation()
     std::cout << "Time to perform generateKeyDerivation: " << timePerDerivation / 1000.0 << " ms" << std::endl;
 }
 
+/* Runs the batched underive_public_keys over random outputs - runs of outputs
+   sharing a transaction key, keys which are not points, and outputs which do
+   and don't belong to us - and throws if any result differs from
+   generate_key_derivation + underive_public_key */
+void testUnderivePublicKeys()
+{
+    std::mt19937_64 random(std::random_device{}());
+
+    /* Most 32 byte strings aren't on the curve, so this gives a mix of
+       valid and invalid keys */
+    const auto randomBytes = [&random]()
+    {
+        Crypto::PublicKey key;
+
+        for (auto &byte : key.data)
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+
+        return key;
+    };
+
+    const auto randomKey = []()
+    {
+        Crypto::PublicKey publicKey;
+        Crypto::SecretKey secretKey;
+
+        Crypto::generate_keys(publicKey, secretKey);
+
+        return publicKey;
+    };
+
+    const size_t rounds = 200;
+
+    size_t checked = 0;
+    size_t ours = 0;
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        Crypto::PublicKey publicSpendKey;
+        Crypto::SecretKey privateViewKey;
+
+        Crypto::generate_keys(publicSpendKey, privateViewKey);
+
+        std::vector<std::tuple<Crypto::PublicKey, Crypto::PublicKey, size_t>> outputs;
+
+        const size_t transactions = random() % 20;
+
+        for (size_t i = 0; i < transactions; i++)
+        {
+            const bool validTxKey = random() % 10 != 0;
+            const Crypto::PublicKey txPublicKey = validTxKey ? randomKey() : randomBytes();
+
+            Crypto::KeyDerivation derivation;
+            Crypto::generate_key_derivation(txPublicKey, privateViewKey, derivation);
+
+            const size_t outputCount = 1 + random() % 8;
+
+            for (size_t j = 0; j < outputCount; j++)
+            {
+                /* Mostly in order, sometimes an arbitrary index */
+                const size_t outputIndex = random() % 8 == 0 ? random() : j;
+
+                Crypto::PublicKey outputKey;
+
+                switch (random() % 3)
+                {
+                    case 0:
+                    {
+                        if (!Crypto::derive_public_key(derivation, outputIndex, publicSpendKey, outputKey))
+                        {
+                            outputKey = randomKey();
+                        }
+
+                        break;
+                    }
+                    case 1:
+                    {
+                        outputKey = randomKey();
+                        break;
+                    }
+                    default:
+                    {
+                        outputKey = randomBytes();
+                        break;
+                    }
+                }
+
+                outputs.emplace_back(txPublicKey, outputKey, outputIndex);
+            }
+
+            /* Now and then repeat an earlier transaction key, so it isn't
+               only ever seen as a single run */
+            if (!outputs.empty() && random() % 8 == 0)
+            {
+                const auto &[earlierTxKey, earlierKey, earlierIndex] = outputs[random() % outputs.size()];
+                outputs.emplace_back(earlierTxKey, earlierKey, earlierIndex + 1);
+            }
+        }
+
+        std::vector<Crypto::KeyDerivation> derivations;
+        std::vector<Crypto::PublicKey> spendKeys;
+        std::vector<bool> valid;
+
+        Crypto::underive_public_keys(privateViewKey, outputs, derivations, spendKeys, valid);
+
+        if (derivations.size() != outputs.size() || spendKeys.size() != outputs.size() || valid.size() != outputs.size())
+        {
+            throw std::runtime_error("underive_public_keys returned " + std::to_string(valid.size())
+                                   + " results for " + std::to_string(outputs.size()) + " outputs");
+        }
+
+        for (size_t i = 0; i < outputs.size(); i++)
+        {
+            const auto &[txPublicKey, outputKey, outputIndex] = outputs[i];
+
+            Crypto::KeyDerivation derivation;
+            Crypto::PublicKey spendKey;
+
+            const bool derived = Crypto::generate_key_derivation(txPublicKey, privateViewKey, derivation);
+            const bool underived = derived && Crypto::underive_public_key(derivation, outputIndex, outputKey, spendKey);
+
+            const std::string output = "output " + std::to_string(i) + " (tx key "
+                                     + Common::podToHex(txPublicKey) + ", output key "
+                                     + Common::podToHex(outputKey) + ", index "
+                                     + std::to_string(outputIndex) + ")";
+
+            if (valid[i] != underived)
+            {
+                throw std::runtime_error("underive_public_keys marked " + output + (underived ? " invalid" : " valid")
+                                       + ", but generate_key_derivation + underive_public_key did not");
+            }
+
+            if (!underived)
+            {
+                continue;
+            }
+
+            if (derivations[i] != derivation)
+            {
+                throw std::runtime_error("underive_public_keys returned derivation " + Common::podToHex(derivations[i])
+                                       + " for " + output + ", expected " + Common::podToHex(derivation));
+            }
+
+            if (spendKeys[i] != spendKey)
+            {
+                throw std::runtime_error("underive_public_keys returned spend key " + Common::podToHex(spendKeys[i])
+                                       + " for " + output + ", expected " + Common::podToHex(spendKey));
+            }
+
+            if (spendKey == publicSpendKey)
+            {
+                ours++;
+            }
+
+            checked++;
+        }
+    }
+
+    if (ours == 0)
+    {
+        throw std::runtime_error("underive_public_keys test generated no outputs belonging to the view key");
+    }
+
+    std::cout << "underive_public_keys matches generate_key_derivation + underive_public_key for "
+              << checked << " outputs (" << ours << " ours)" << std::endl;
+}
+
+void benchmarkUnderivePublicKeys()
+{
+    Crypto::SecretKey privateViewKey;
+    Common::podFromHex("89df8c4d34af41a51cfae0267e8254cadd2298f9256439fa1cfa7e25ee606606", privateViewKey);
+
+    Crypto::PublicKey outputKey;
+    Common::podFromHex("4a078e76cd41a3d3b534b83dc6f2ea2de500b653ca82273b7bfad8045d85a400", outputKey);
+
+    /* Roughly what a busy block looks like - a few hundred transactions,
+       with a handful of outputs each */
+    const size_t transactions = 250;
+    const size_t outputsPerTransaction = 4;
+
+    std::vector<std::tuple<Crypto::PublicKey, Crypto::PublicKey, size_t>> outputs;
+
+    for (size_t i = 0; i < transactions; i++)
+    {
+        Crypto::PublicKey txPublicKey;
+        Crypto::SecretKey txPrivateKey;
+
+        Crypto::generate_keys(txPublicKey, txPrivateKey);
+
+        for (size_t j = 0; j < outputsPerTransaction; j++)
+        {
+            outputs.emplace_back(txPublicKey, outputKey, j);
+        }
+    }
+
+    const uint64_t loopIterations = 60;
+
+    std::vector<Crypto::KeyDerivation> derivations;
+    std::vector<Crypto::PublicKey> spendKeys;
+    std::vector<bool> valid;
+
+    auto startTimer = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t i = 0; i < loopIterations; i++)
+    {
+        Crypto::underive_public_keys(privateViewKey, outputs, derivations, spendKeys, valid);
+    }
+
+    auto elapsedTime = std::chrono::high_resolution_clock::now() - startTimer;
+
+    const double batchedTime = std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count()
+                             / static_cast<double>(loopIterations * outputs.size());
+
+    startTimer = std::chrono::high_resolution_clock::now();
+
+    for (uint64_t i = 0; i < loopIterations; i++)
+    {
+        Crypto::KeyDerivation derivation;
+        Crypto::PublicKey spendKey;
+
+        for (size_t j = 0; j < outputs.size(); j++)
+        {
+            const auto &[txPublicKey, key, outputIndex] = outputs[j];
+
+            if (outputIndex == 0)
+            {
+                Crypto::generate_key_derivation(txPublicKey, privateViewKey, derivation);
+            }
+
+            Crypto::underive_public_key(derivation, outputIndex, key, spendKey);
+        }
+    }
+
+    elapsedTime = std::chrono::high_resolution_clock::now() - startTimer;
+
+    const double scalarTime = std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count()
+                            / static_cast<double>(loopIterations * outputs.size());
+
+    std::cout << "Time to scan an output with generateKeyDerivation + underivePublicKey: "
+              << scalarTime / 1000.0 << " ms" << std::endl;
+
+    std::cout << "Time to scan an output with underivePublicKeys (batched): "
+              << batchedTime / 1000.0 << " ms" << std::endl;
+}
+
 int main(int argc, char** argv)
 {
     bool o_help, o_version, o_benchmark;
@@ -369,12 +645,38 @@ int main(int argc, char** argv)
             TEST_HASH_FUNCTION_WITH_HEIGHT(cn_soft_shell_slow_hash_v2, CN_SOFT_SHELL_V2[height / 512], height);
         }
 
+        std::cout << std::endl;
+
+        testUnderivePublicKeys();
+        testKVBinaryInputStreamSerializer();
+        testJsonStringOutputSerializer();
+        testPaymentIdsAfterSplit();
+        testBufferedDataBase();
+        testRocksDBWrapper();
+        testMainChainStorage();
+        testBlockTemplateCache();
+        testTransactionPool();
+        testSlidingWindowMedian();
+        testWalletSyncDataLimits();
+        testLogging();
+        testHttpRequestReader();
+        testBlockDownloadScheduler();
+        testWalletFile();
+        testSubWallets();
+
         if (o_benchmark)
         {
             std::cout <<  "\nPerformance Tests: Please wait, this may take a while depending on your system...\n\n";
 
             benchmarkUnderivePublicKey();
             benchmarkGenerateKeyDerivation();
+            benchmarkUnderivePublicKeys();
+            benchmarkKVBinaryInputStreamSerializer();
+            benchmarkJsonStringOutputSerializer();
+            benchmarkLogging();
+            benchmarkHttpRequestReader();
+            benchmarkBlockTemplateCache();
+            benchmarkBlockBatchCommits();
 
             BENCHMARK(cn_slow_hash_v0, o_iterations);
             BENCHMARK(cn_slow_hash_v1, o_iterations);
@@ -404,5 +706,6 @@ int main(int argc, char** argv)
     catch (std::exception& e)
     {
         std::cout << "Something went terribly wrong...\n" << e.what() << "\n\n";
+        return 1;
     }
 }
@@ -268,6 +268,13 @@ int main(int argc, char* argv[])
     }
 
     RocksDBWrapper database(logManager);
+
+    if (config.dbMigrate)
+    {
+      database.migrate(dbConfig);
+      return 0;
+    }
+
     database.init(dbConfig);
     Tools::ScopeExit dbShutdownOnExit([&database] () { database.shutdown(); });
 
@@ -290,7 +297,11 @@ int main(int argc, char* argv[])
       std::move(checkpoints),
       dispatcher,
       std::unique_ptr<IBlockchainCacheFactory>(new DatabaseBlockchainCacheFactory(database, logger.getLogger())),
-      createSwappedMainChainStorage(config.dataDirectory, currency));
+      createMainChainStorage(config.dataDirectory, currency, logger.getLogger()));
+
+    ccore.setWalletSyncDataLimits(
+      static_cast<uint64_t>(std::max(config.walletSyncMaxBlocks, 1)),
+      static_cast<size_t>(std::max(config.walletSyncMaxResponseSizeMB, 1)) * 1024 * 1024);
 
     ccore.load();
     logger(INFO) << "Core initialized OK";
@@ -320,6 +331,7 @@ int main(int argc, char* argv[])
     rpcServer.setFeeAddress(config.feeAddress);
     rpcServer.setFeeAmount(config.feeAmount);
     rpcServer.enableCors(config.enableCors);
+    rpcServer.setWorkerThreads(static_cast<size_t>(std::max(config.rpcThreads, 0)));
     rpcServer.start(config.rpcInterface, config.rpcPort);
     logger(INFO) << "Core rpc server started ok";
 
@@ -54,7 +54,13 @@ namespace DaemonConfig{
       ("enable-cors", "Adds header 'Access-Control-Allow-Origin' to the RPC responses using the <domain>. Uses the value specified as the domain. Use * for all.",
         cxxopts::value<std::vector<std::string>>(), "<domain>")
       ("fee-address", "Sets the convenience charge <address> for light wallets that use the daemon", cxxopts::value<std::string>(), "<address>")
-      ("fee-amount", "Sets the convenience charge amount for light wallets that use the daemon", cxxopts::value<int>()->default_value("0"), "#");
+      ("fee-amount", "Sets the convenience charge amount for light wallets that use the daemon", cxxopts::value<int>()->default_value("0"), "#")
+      ("rpc-threads", "Number of threads serving the RPC calls that only read the blockchain. 0 serves them on the network thread",
+        cxxopts::value<int>()->default_value(std::to_string(config.rpcThreads)), "#")
+      ("wallet-sync-max-blocks", "Most blocks a single getwalletsyncdata request is answered with",
+        cxxopts::value<int>()->default_value(std::to_string(config.walletSyncMaxBlocks)), "#")
+      ("wallet-sync-max-response-size", "Stop adding blocks to a getwalletsyncdata response after this many megabytes (MB) of block data",
+        cxxopts::value<int>()->default_value(std::to_string(config.walletSyncMaxResponseSizeMB)), "#");
 
     options.add_options("Network")
       ("allow-local-ip", "Allow the local IP to be added to the peer list", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))
@@ -72,6 +78,7 @@ namespace DaemonConfig{
       ("seed-node", "Connect to a node to retrieve the peer list and then disconnect", cxxopts::value<std::vector<std::string>>(), "<ip:port>");
 
     options.add_options("Database")
+      ("db-migrate", "Move a database using the old single keyspace layout into per prefix column families and exit", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))
       ("db-max-open-files", "Number of files that can be used by the database at one time", cxxopts::value<int>()->default_value(std::to_string(config.dbMaxOpenFiles)), "#")
       ("db-read-buffer-size", "Size of the database read cache in megabytes (MB)", cxxopts::value<int>()->default_value(std::to_string(config.dbReadCacheSizeMB)), "#")
       ("db-threads", "Number of background threads used for compaction and flush operations", cxxopts::value<int>()->default_value(std::to_string(config.dbThreads)), "#")
@@ -121,6 +128,11 @@ namespace DaemonConfig{
         config.dumpConfig = cli["dump-config"].as<bool>();
       }
 
+      if (cli.count("db-migrate") > 0)
+      {
+        config.dbMigrate = cli["db-migrate"].as<bool>();
+      }
+
       if (cli.count("data-dir") > 0)
       {
         config.dataDirectory = cli["data-dir"].as<std::string>();
@@ -241,6 +253,21 @@ namespace DaemonConfig{
         config.feeAmount = cli["fee-amount"].as<int>();
       }
 
+      if (cli.count("rpc-threads") > 0)
+      {
+        config.rpcThreads = cli["rpc-threads"].as<int>();
+      }
+
+      if (cli.count("wallet-sync-max-blocks") > 0)
+      {
+        config.walletSyncMaxBlocks = cli["wallet-sync-max-blocks"].as<int>();
+      }
+
+      if (cli.count("wallet-sync-max-response-size") > 0)
+      {
+        config.walletSyncMaxResponseSizeMB = cli["wallet-sync-max-response-size"].as<int>();
+      }
+
       if (config.help) // Do we want to display the help message?
       {
         std::cout << options.help({}) << std::endl;
@@ -492,6 +519,42 @@ namespace DaemonConfig{
             throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey );
           }
         }
+        else if (cfgKey.compare("rpc-threads") == 0)
+        {
+          try
+          {
+            config.rpcThreads = std::stoi(cfgValue);
+            updated = true;
+          }
+          catch(std::exception& e)
+          {
+            throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey );
+          }
+        }
+        else if (cfgKey.compare("wallet-sync-max-blocks") == 0)
+        {
+          try
+          {
+            config.walletSyncMaxBlocks = std::stoi(cfgValue);
+            updated = true;
+          }
+          catch(std::exception& e)
+          {
+            throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey );
+          }
+        }
+        else if (cfgKey.compare("wallet-sync-max-response-size") == 0)
+        {
+          try
+          {
+            config.walletSyncMaxResponseSizeMB = std::stoi(cfgValue);
+            updated = true;
+          }
+          catch(std::exception& e)
+          {
+            throw std::runtime_error(std::string(e.what()) + " - Invalid value for " + cfgKey );
+          }
+        }
         else
         {
           for (auto c: cfgKey) 
@@ -655,6 +718,21 @@ namespace DaemonConfig{
     {
       config.feeAmount = j["fee-amount"].get<int>();
     }
+
+    if (j.find("rpc-threads") != j.end())
+    {
+      config.rpcThreads = j["rpc-threads"].get<int>();
+    }
+
+    if (j.find("wallet-sync-max-blocks") != j.end())
+    {
+      config.walletSyncMaxBlocks = j["wallet-sync-max-blocks"].get<int>();
+    }
+
+    if (j.find("wallet-sync-max-response-size") != j.end())
+    {
+      config.walletSyncMaxResponseSizeMB = j["wallet-sync-max-response-size"].get<int>();
+    }
   }
 
   json asJSON(const DaemonConfiguration& config)
@@ -684,6 +762,9 @@ namespace DaemonConfig{
       {"enable-cors", config.enableCors},
       {"fee-address", config.feeAddress},
       {"fee-amount", config.feeAmount},
+      {"rpc-threads", config.rpcThreads},
+      {"wallet-sync-max-blocks", config.walletSyncMaxBlocks},
+      {"wallet-sync-max-response-size", config.walletSyncMaxResponseSizeMB},
     };
 
     return j;
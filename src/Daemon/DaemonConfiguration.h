@@ -33,6 +33,9 @@ namespace DaemonConfig {
       p2pExternalPort = 0;
       rpcInterface = "127.0.0.1";
       rpcPort = CryptoNote::RPC_DEFAULT_PORT;
+      rpcThreads = CryptoNote::RPC_DEFAULT_WORKER_THREADS_COUNT;
+      walletSyncMaxBlocks = CryptoNote::WALLET_SYNC_DATA_DEFAULT_MAX_BLOCK_COUNT;
+      walletSyncMaxResponseSizeMB = CryptoNote::WALLET_SYNC_DATA_MAX_RESPONSE_MB_DEFAULT_SIZE;
       noConsole = false;
       enableBlockExplorer = false;
       localIp = false;
@@ -42,6 +45,7 @@ namespace DaemonConfig {
       osVersion = false;
       printGenesisTx = false;
       dumpConfig = false; 
+      dbMigrate = false;
     }
 
     std::string dataDirectory;
@@ -60,6 +64,9 @@ namespace DaemonConfig {
     int logLevel;
     int feeAmount;
     int rpcPort;
+    int rpcThreads;
+    int walletSyncMaxBlocks;
+    int walletSyncMaxResponseSizeMB;
     int p2pPort;
     int p2pExternalPort;
     int dbThreads;
@@ -80,6 +87,7 @@ namespace DaemonConfig {
     bool osVersion;
     bool printGenesisTx;
     bool dumpConfig;
+    bool dbMigrate;
   };
 
   DaemonConfiguration initConfiguration(const char* path);
@@ -27,7 +27,9 @@ enum HttpParserErrorCodes {
   STREAM_NOT_GOOD = 1,
   END_OF_STREAM,
   UNEXPECTED_SYMBOL,
-  EMPTY_HEADER
+  EMPTY_HEADER,
+  HEADERS_TOO_LARGE,
+  BODY_TOO_LARGE
 };
 
 // custom category:
@@ -49,6 +51,8 @@ public:
       case END_OF_STREAM: return "The stream is ended";
       case UNEXPECTED_SYMBOL: return "Unexpected symbol";
       case EMPTY_HEADER: return "The header name is empty";
+      case HEADERS_TOO_LARGE: return "The headers are too large";
+      case BODY_TOO_LARGE: return "The body is too large";
       default: return "Unknown error";
     }
   }
@@ -37,6 +37,7 @@ namespace CryptoNote {
 
   private:
     friend class HttpParser;
+    friend class HttpRequestReader;
 
     std::string method;
     std::string url;
@@ -0,0 +1,160 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "HttpRequestReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <System/TcpConnection.h>
+
+#include "HttpParserErrorCodes.h"
+
+namespace {
+
+const size_t READ_SIZE = 16 * 1024;
+
+/* Request line and headers, anything longer is not an RPC request */
+const size_t MAX_HEADERS_SIZE = 64 * 1024;
+
+const size_t MAX_BODY_SIZE = 64 * 1024 * 1024;
+
+const char HEADERS_END[] = "\r\n\r\n";
+const size_t HEADERS_END_SIZE = sizeof(HEADERS_END) - 1;
+
+void throwParserError(CryptoNote::error::HttpParserErrorCodes code) {
+  throw std::system_error(make_error_code(code));
+}
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+}
+
+namespace CryptoNote {
+
+HttpRequestReader::HttpRequestReader(System::TcpConnection& connection) :
+  HttpRequestReader([&connection](uint8_t* data, size_t size) { return connection.read(data, size); }) {
+}
+
+HttpRequestReader::HttpRequestReader(ReadFunction read) : m_read(std::move(read)), m_begin(0), m_end(0) {
+}
+
+bool HttpRequestReader::receiveRequest(HttpRequest& request) {
+  size_t headersEnd;
+
+  while ((headersEnd = findHeadersEnd()) == m_end) {
+    if (m_end - m_begin > MAX_HEADERS_SIZE) {
+      throwParserError(error::HttpParserErrorCodes::HEADERS_TOO_LARGE);
+    }
+
+    if (!readMore()) {
+      if (m_begin == m_end) {
+        return false;
+      }
+
+      throwParserError(error::HttpParserErrorCodes::END_OF_STREAM);
+    }
+  }
+
+  parseHeaders(m_buffer.data() + m_begin, m_buffer.data() + headersEnd, request);
+  m_begin = headersEnd + HEADERS_END_SIZE;
+
+  auto it = request.headers.find("content-length");
+  if (it != request.headers.end()) {
+    const unsigned long long bodyLength = std::stoull(it->second);
+    if (bodyLength > MAX_BODY_SIZE) {
+      throwParserError(error::HttpParserErrorCodes::BODY_TOO_LARGE);
+    }
+
+    readBody(request.body, static_cast<size_t>(bodyLength));
+  }
+
+  return true;
+}
+
+bool HttpRequestReader::readMore() {
+  /* Move what is left of the previous requests to the front, rather than
+     growing the buffer */
+  if (m_begin != 0) {
+    std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+  }
+
+  if (m_buffer.size() - m_end < READ_SIZE) {
+    m_buffer.resize(m_end + READ_SIZE);
+  }
+
+  const size_t read = m_read(reinterpret_cast<uint8_t*>(m_buffer.data() + m_end), m_buffer.size() - m_end);
+  m_end += read;
+
+  return read != 0;
+}
+
+size_t HttpRequestReader::findHeadersEnd() {
+  auto begin = m_buffer.begin() + m_begin;
+  auto end = m_buffer.begin() + m_end;
+  return std::search(begin, end, HEADERS_END, HEADERS_END + HEADERS_END_SIZE) - m_buffer.begin();
+}
+
+void HttpRequestReader::parseHeaders(const char* begin, const char* end, HttpRequest& request) {
+  const char* lineEnd = std::search(begin, end, HEADERS_END, HEADERS_END + 2);
+
+  /* Request line: method, url and version, separated by spaces */
+  const char* methodEnd = std::find(begin, lineEnd, ' ');
+  const char* urlEnd = std::find(std::min(methodEnd + 1, lineEnd), lineEnd, ' ');
+  if (methodEnd == begin || urlEnd == lineEnd) {
+    throwParserError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+  }
+
+  request.method.assign(begin, methodEnd);
+  request.url.assign(methodEnd + 1, urlEnd);
+
+  while (lineEnd != end) {
+    const char* line = lineEnd + 2;
+    lineEnd = std::search(line, end, HEADERS_END, HEADERS_END + 2);
+
+    const char* nameEnd = std::find(line, lineEnd, ':');
+    if (nameEnd == line) {
+      throwParserError(error::HttpParserErrorCodes::EMPTY_HEADER);
+    }
+
+    const char* valueBegin = nameEnd == lineEnd ? lineEnd : nameEnd + 1;
+    while (valueBegin != lineEnd && isSpace(*valueBegin)) {
+      ++valueBegin;
+    }
+
+    const char* valueEnd = lineEnd;
+    while (valueEnd != valueBegin && isSpace(*(valueEnd - 1))) {
+      --valueEnd;
+    }
+
+    std::string name(line, nameEnd);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    request.headers[name].assign(valueBegin, valueEnd);
+  }
+}
+
+void HttpRequestReader::readBody(std::string& body, size_t bodyLength) {
+  const size_t buffered = std::min(bodyLength, m_end - m_begin);
+
+  body.resize(bodyLength);
+  std::copy(m_buffer.data() + m_begin, m_buffer.data() + m_begin + buffered, &body[0]);
+  m_begin += buffered;
+
+  /* The rest goes straight into the body */
+  for (size_t offset = buffered; offset < bodyLength;) {
+    const size_t read = m_read(reinterpret_cast<uint8_t*>(&body[offset]), bodyLength - offset);
+    if (read == 0) {
+      throwParserError(error::HttpParserErrorCodes::END_OF_STREAM);
+    }
+
+    offset += read;
+  }
+}
+
+}
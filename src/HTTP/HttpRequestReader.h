@@ -0,0 +1,47 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "HttpRequest.h"
+
+namespace System {
+class TcpConnection;
+}
+
+namespace CryptoNote {
+
+/* Reads HTTP requests from a connection into a buffer kept for the whole
+   connection, and parses them from there. Bytes past the end of a request
+   stay buffered for the next one, so pipelined keep-alive requests work.
+   The body is copied at once, or read straight into the request, as given
+   by Content-Length. */
+class HttpRequestReader {
+public:
+  /* Reads up to size bytes into data, returns 0 at the end of the stream */
+  typedef std::function<size_t(uint8_t* data, size_t size)> ReadFunction;
+
+  explicit HttpRequestReader(System::TcpConnection& connection);
+  explicit HttpRequestReader(ReadFunction read);
+
+  /* Returns false if the stream ended before the next request started,
+     throws if it ended in the middle of one or the request is malformed */
+  bool receiveRequest(HttpRequest& request);
+
+private:
+  bool readMore();
+  size_t findHeadersEnd();
+  void parseHeaders(const char* begin, const char* end, HttpRequest& request);
+  void readBody(std::string& body, size_t bodyLength);
+
+  ReadFunction m_read;
+  std::vector<char> m_buffer;
+  size_t m_begin;
+  size_t m_end;
+};
+
+}
@@ -77,7 +77,8 @@ namespace Logger
         const LogLevel level,
         const std::vector<LogCategory> categories) const
     {
-        if (level == DISABLED)
+        /* Check before formatting, this is called on every block */
+        if (!shouldLog(level))
         {
             return;
         }
@@ -96,17 +97,14 @@ namespace Logger
 
         output << ": " << message;
 
-        if (level <= m_logLevel)
+        /* If the user provides a callback, log to that instead */
+        if (m_callback)
         {
-            /* If the user provides a callback, log to that instead */
-            if (m_callback)
-            {
-                m_callback(output.str(), message, level, categories);
-            }
-            else
-            {
-                std::cout << output.str() << std::endl;
-            }
+            m_callback(output.str(), message, level, categories);
+        }
+        else
+        {
+            std::cout << output.str() << std::endl;
         }
     }
 
@@ -6,8 +6,12 @@
 
 #include <functional>
 
+#include <initializer_list>
+
 #include <string>
 
+#include <type_traits>
+
 #include <vector>
 
 namespace Logger
@@ -40,6 +44,34 @@ namespace Logger
                 const LogLevel level,
                 const std::vector<LogCategory> categories) const;
 
+            /* Only calls getMessage() if the level is enabled, so messages
+               logged once per block or transaction cost nothing to build
+               when they're going to be discarded. For example:
+
+               logger.log(
+                   [&]() { return "Processing block " + std::to_string(height); },
+                   DEBUG,
+                   {SYNC}
+               ); */
+            template<typename MessageGenerator,
+                     typename = std::enable_if_t<std::is_invocable_r_v<std::string, MessageGenerator>>>
+            void log(
+                const MessageGenerator &getMessage,
+                const LogLevel level,
+                const std::initializer_list<LogCategory> categories) const
+            {
+                if (shouldLog(level))
+                {
+                    log(getMessage(), level, categories);
+                }
+            }
+
+            /* Whether a message at this level will be logged */
+            bool shouldLog(const LogLevel level) const
+            {
+                return level != DISABLED && level <= m_logLevel;
+            }
+
             void setLogLevel(const LogLevel level);
 
             void setLogCallback(
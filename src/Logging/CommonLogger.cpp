@@ -56,7 +56,7 @@ std::string formatPattern(const std::string& pattern, const std::string& categor
 }
 
 void CommonLogger::operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) {
-  if (level <= logLevel && disabledCategories.count(category) == 0) {
+  if (CommonLogger::isEnabled(category, level)) {
     std::string body2 = body;
     if (!pattern.empty()) {
       size_t insertPos = 0;
@@ -74,6 +74,10 @@ void CommonLogger::operator()(const std::string& category, Level level, boost::p
   }
 }
 
+bool CommonLogger::isEnabled(const std::string& category, Level level) const {
+  return level <= logLevel && disabledCategories.count(category) == 0;
+}
+
 void CommonLogger::setPattern(const std::string& pattern) {
   this->pattern = pattern;
 }
@@ -28,6 +28,7 @@ public:
   virtual ~CommonLogger() {};
 
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual bool isEnabled(const std::string& category, Level level) const override;
   virtual void disableCategory(const std::string& category);
   virtual void setMaxLevel(Level level);
 
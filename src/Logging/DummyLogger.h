@@ -18,6 +18,11 @@ class DummyLogger : public ILogger
         {
             // do nothing
         }
+
+        virtual bool isEnabled(const std::string &category, Level level) const override
+        {
+            return false;
+        }
 };
 
 } // namespace Logging
@@ -59,6 +59,12 @@ public:
   const static std::array<std::string, 6> LEVEL_NAMES;
 
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) = 0;
+
+  /* Whether a message with this category and level would be written
+     anywhere, so callers can skip formatting it when it won't be */
+  virtual bool isEnabled(const std::string& category, Level level) const {
+    return true;
+  }
 };
 
 #ifndef ENDL
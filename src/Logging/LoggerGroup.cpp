@@ -28,11 +28,21 @@ void LoggerGroup::addLogger(ILogger& logger) {
 }
 
 void LoggerGroup::operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) {
-  if (level <= logLevel && disabledCategories.count(category) == 0) {
+  if (CommonLogger::isEnabled(category, level)) {
     for (auto& logger : loggers) {
       (*logger)(category, level, time, body);
     }
   }
 }
 
+bool LoggerGroup::isEnabled(const std::string& category, Level level) const {
+  if (!CommonLogger::isEnabled(category, level)) {
+    return false;
+  }
+
+  return std::any_of(loggers.begin(), loggers.end(), [&](const ILogger* logger) {
+    return logger->isEnabled(category, level);
+  });
+}
+
 }
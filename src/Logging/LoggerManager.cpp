@@ -32,6 +32,11 @@ void LoggerManager::operator()(const std::string& category, Level level, boost::
   LoggerGroup::operator()(category, level, time, body);
 }
 
+bool LoggerManager::isEnabled(const std::string& category, Level level) const {
+  std::unique_lock<std::mutex> lock(reconfigureLock);
+  return LoggerGroup::isEnabled(category, level);
+}
+
 void LoggerManager::configure(const JsonValue& val) {
   std::unique_lock<std::mutex> lock(reconfigureLock);
   loggers.clear();
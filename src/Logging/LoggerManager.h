@@ -30,10 +30,11 @@ public:
   LoggerManager();
   void configure(const Common::JsonValue& val);
   virtual void operator()(const std::string& category, Level level, boost::posix_time::ptime time, const std::string& body) override;
+  virtual bool isEnabled(const std::string& category, Level level) const override;
 
 private:
   std::vector<std::unique_ptr<CommonLogger>> loggers;
-  std::mutex reconfigureLock;
+  mutable std::mutex reconfigureLock;
 };
 
 }
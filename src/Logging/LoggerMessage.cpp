@@ -26,8 +26,14 @@ LoggerMessage::LoggerMessage(std::shared_ptr<ILogger> logger, const std::string&
   , category(category)
   , logLevel(level)
   , message(color)
-  , timestamp(boost::posix_time::microsec_clock::local_time())
   , gotText(false) {
+  /* If nothing is going to be written, don't take the timestamp, and set
+     badbit so anything streamed in isn't formatted */
+  if (logger->isEnabled(category, level)) {
+    timestamp = boost::posix_time::microsec_clock::local_time();
+  } else {
+    setstate(std::ios_base::badbit);
+  }
 }
 
 LoggerMessage::~LoggerMessage() {
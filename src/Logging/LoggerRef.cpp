@@ -30,4 +30,8 @@ std::shared_ptr<ILogger> LoggerRef::getLogger() const {
   return logger;
 }
 
+bool LoggerRef::isEnabled(Level level) const {
+  return logger->isEnabled(category, level);
+}
+
 }
@@ -28,6 +28,32 @@ public:
   LoggerMessage operator()(Level level = INFO, const std::string& color = DEFAULT) const;
   std::shared_ptr<ILogger> getLogger() const;
 
+  /* Whether a message logged at this level would be written anywhere */
+  bool isEnabled(Level level) const;
+
+  /* Only calls writeMessage() with the message stream if the level is
+     enabled, so the arguments aren't evaluated or formatted otherwise.
+     For use on paths run once per block or transaction:
+
+     logger.log(DEBUGGING, [&](std::ostream& message) {
+       message << "Pushing block " << cachedBlock.getBlockHash();
+     }); */
+  template<typename MessageWriter>
+  void log(Level level, MessageWriter&& writeMessage) const {
+    if (isEnabled(level)) {
+      LoggerMessage message = (*this)(level);
+      writeMessage(message);
+    }
+  }
+
+  template<typename MessageWriter>
+  void log(Level level, const std::string& color, MessageWriter&& writeMessage) const {
+    if (isEnabled(level)) {
+      LoggerMessage message = (*this)(level, color);
+      writeMessage(message);
+    }
+  }
+
 private:
   std::shared_ptr<ILogger> logger;
   std::string category;
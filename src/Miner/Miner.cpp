@@ -6,6 +6,7 @@
 
 #include "Miner.h"
 
+#include <cstring>
 #include <iostream>
 
 #include <functional>
@@ -105,24 +106,48 @@ void Miner::workerFunc(const BlockTemplate& blockTemplate, uint64_t difficulty,
     {
         BlockTemplate block = blockTemplate;
 
+        CachedBlock cachedBlock(block);
+
+        /* Serialize the block once, and then just patch each nonce we try
+           into the hashing blob, rather than reserializing the whole block
+           (and recomputing the merkle root) for every hash */
+        BinaryArray hashingBlob = cachedBlock.getBlockLongHashingBinaryArray();
+        const size_t nonceOffset = cachedBlock.getBlockLongHashingNonceOffset();
+
+        uint32_t nonce = block.nonce;
+
         while (m_state == MiningState::MINING_IN_PROGRESS)
         {
-            CachedBlock cachedBlock(block);
-            Crypto::Hash hash = cachedBlock.getBlockLongHash();
+            /* Try a few nonces between checking the state and updating the
+               shared hash count, which is contended between all the workers */
+            size_t hashesTried = 0;
 
-            if (check_hash(hash, difficulty))
+            while (hashesTried < NONCES_PER_BATCH)
             {
-                if (!setStateBlockFound())
+                std::memcpy(hashingBlob.data() + nonceOffset, &nonce, sizeof(nonce));
+
+                Crypto::Hash hash;
+
+                CachedBlock::getBlockLongHash(block.majorVersion, hashingBlob, hash);
+
+                hashesTried++;
+
+                if (check_hash(hash, difficulty))
                 {
-                    return;
+                    if (setStateBlockFound())
+                    {
+                        block.nonce = nonce;
+                        m_block = block;
+                    }
+
+                    break;
                 }
 
-                m_block = block;
-                return;
+                nonce += nonceStep;
             }
 
-            incrementHashCount();
-            block.nonce += nonceStep;
+            /* Only the hashes we actually did, if we stopped early */
+            incrementHashCount(hashesTried);
         }
     }
     catch (const std::exception &e)
@@ -167,9 +192,9 @@ bool Miner::setStateBlockFound()
     }
 }
 
-void Miner::incrementHashCount()
+void Miner::incrementHashCount(uint64_t hashes)
 {
-    m_hash_count++;
+    m_hash_count += hashes;
 }
 
 uint64_t Miner::getHashCount()
@@ -44,6 +44,10 @@ class Miner
 
         std::vector<std::unique_ptr<System::RemoteContext<void>>>  m_workers;
 
+        /* How many nonces each worker tries before checking if mining has
+           stopped, and adding to the hash count */
+        static constexpr size_t NONCES_PER_BATCH = 4;
+
         BlockTemplate m_block;
         std::atomic<uint64_t> m_hash_count = 0;
         std::mutex m_hashes_mutex;
@@ -51,7 +55,7 @@ class Miner
         void runWorkers(BlockMiningParameters blockMiningParameters, size_t threadCount);
         void workerFunc(const BlockTemplate& blockTemplate, uint64_t difficulty, uint32_t nonceStep);
         bool setStateBlockFound();
-        void incrementHashCount();
+        void incrementHashCount(uint64_t hashes);
 };
 
 } //namespace CryptoNote
@@ -101,16 +101,22 @@ void MinerManager::start()
 void MinerManager::printHashRate()
 {
     uint64_t last_hash_count = m_miner.getHashCount();
+    auto last_report = std::chrono::steady_clock::now();
 
     while (isRunning)
     {
         std::this_thread::sleep_for(std::chrono::seconds(60));
 
         uint64_t current_hash_count = m_miner.getHashCount();
+        auto now = std::chrono::steady_clock::now();
 
-        double hashes = static_cast<double>((current_hash_count - last_hash_count) / 60);
+        /* Divide by the time that actually passed, not the time we asked to sleep for */
+        const double seconds = std::chrono::duration<double>(now - last_report).count();
+
+        double hashes = static_cast<double>(current_hash_count - last_hash_count) / seconds;
 
         last_hash_count = current_hash_count;
+        last_report = now;
 
         std::cout << SuccessMsg("\nMining at ")
                   << SuccessMsg(Utilities::get_mining_speed(hashes))
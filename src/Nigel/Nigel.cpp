@@ -14,6 +14,8 @@
 
 #include <Logger/Logger.h>
 
+#include <Serialization/SerializationTools.h>
+
 #include <Utilities/Utilities.h>
 
 using json = nlohmann::json;
@@ -57,6 +59,7 @@ void Nigel::swapNode(const std::string daemonHost, const uint16_t daemonPort)
     m_networkBlockCount = 0;
     m_peerCount = 0;
     m_lastKnownHashrate = 0;
+    m_binarySyncData = true;
 
     m_daemonHost = daemonHost;
     m_daemonPort = daemonPort;
@@ -71,7 +74,8 @@ void Nigel::swapNode(const std::string daemonHost, const uint16_t daemonPort)
 std::tuple<bool, std::vector<WalletTypes::WalletBlockInfo>> Nigel::getWalletSyncData(
     const std::vector<Crypto::Hash> blockHashCheckpoints,
     uint64_t startHeight,
-    uint64_t startTimestamp) const
+    uint64_t startTimestamp,
+    uint64_t blockCount) const
 {
     Logger::logger.log(
         "Fetching blocks from the daemon",
@@ -79,10 +83,64 @@ std::tuple<bool, std::vector<WalletTypes::WalletBlockInfo>> Nigel::getWalletSync
         {Logger::SYNC, Logger::DAEMON}
     );
 
+    if (m_binarySyncData)
+    {
+        CryptoNote::COMMAND_RPC_GET_WALLET_SYNC_DATA::request request;
+
+        request.blockIds = blockHashCheckpoints;
+        request.startHeight = startHeight;
+        request.startTimestamp = startTimestamp;
+        request.blockCount = blockCount;
+
+        const auto res = m_httpClient->Post(
+            "/getwalletsyncdata.bin",
+            CryptoNote::storeToBinaryKeyValue(request),
+            "application/octet-stream"
+        );
+
+        if (res && res->status == 200)
+        {
+            CryptoNote::COMMAND_RPC_GET_WALLET_SYNC_DATA::response response;
+
+            if (!CryptoNote::loadFromBinaryKeyValue(response, res->body))
+            {
+                Logger::logger.log(
+                    "Failed to parse blocks from daemon",
+                    Logger::INFO,
+                    {Logger::SYNC, Logger::DAEMON}
+                );
+
+                return {false, {}};
+            }
+
+            if (response.status != "OK")
+            {
+                return {false, {}};
+            }
+
+            return {true, std::move(response.items)};
+        }
+
+        /* Daemon predates the binary endpoint, fall back to JSON */
+        if (!res || res->status != 404)
+        {
+            return {false, {}};
+        }
+
+        Logger::logger.log(
+            "Daemon does not support binary sync data, using JSON",
+            Logger::DEBUG,
+            {Logger::SYNC, Logger::DAEMON}
+        );
+
+        m_binarySyncData = false;
+    }
+
     json j = {
         {"blockHashCheckpoints", blockHashCheckpoints},
         {"startHeight", startHeight},
-        {"startTimestamp", startTimestamp}
+        {"startTimestamp", startTimestamp},
+        {"blockCount", blockCount}
     };
 
     const auto res = m_httpClient->Post(
@@ -60,10 +60,13 @@ class Nigel
 
         std::tuple<std::string, uint16_t> nodeAddress() const;
 
+        /* The daemon may return fewer than blockCount blocks, it bounds both
+           the block count and the response size */
         std::tuple<bool, std::vector<WalletTypes::WalletBlockInfo>> getWalletSyncData(
             const std::vector<Crypto::Hash> blockHashCheckpoints,
             uint64_t startHeight,
-            uint64_t startTimestamp) const;
+            uint64_t startTimestamp,
+            uint64_t blockCount) const;
 
         /* Returns a bool on success or not */
         bool getTransactionsStatus(
@@ -125,6 +128,10 @@ class Nigel
         /* The hashrate (based on the last local block the daemon has synced) */
         std::atomic<uint64_t> m_lastKnownHashrate = 0;
 
+        /* Whether the daemon serves /getwalletsyncdata.bin. Cleared the first
+           time an older daemon answers 404, then we stick to JSON */
+        mutable std::atomic<bool> m_binarySyncData = true;
+
         /* The address to send the node fee to (May be "") */
         std::string m_nodeFeeAddress;
 
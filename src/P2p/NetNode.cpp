@@ -292,22 +292,31 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
 
   //-----------------------------------------------------------------------------------
   void NodeServer::externalRelayNotifyToAll(int command, const BinaryArray& data_buff, const boost::uuids::uuid* excludeConnection) {
-    m_dispatcher.remoteSpawn([this, command, data_buff, excludeConnection] {
-      relay_notify_to_all(command, data_buff, excludeConnection);
+    auto buffer = std::make_shared<const BinaryArray>(data_buff);
+    boost::uuids::uuid excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<boost::uuids::uuid>();
+
+    m_dispatcher.remoteSpawn([this, command, buffer, excludeId] {
+      relayNotifyToAll(command, buffer, excludeId);
     });
   }
 
   //-----------------------------------------------------------------------------------
   void NodeServer::externalRelayNotifyToList(int command, const BinaryArray& data_buff, const std::list<boost::uuids::uuid> relayList) {
-    m_dispatcher.remoteSpawn([this, command, data_buff, relayList] {
-      forEachConnection([&](P2pConnectionContext& conn) {
-        if (std::find(relayList.begin(), relayList.end(), conn.m_connection_id) != relayList.end()) {
-          if (conn.peerId && (conn.m_state == CryptoNoteConnectionContext::state_normal ||
-               conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
-          }
+    auto buffer = std::make_shared<const BinaryArray>(data_buff);
+
+    m_dispatcher.remoteSpawn([this, command, buffer, relayList] {
+      for (const auto& connectionId : relayList) {
+        auto it = m_connections.find(connectionId);
+        if (it == m_connections.end()) {
+          continue;
         }
-      });
+
+        auto& conn = it->second;
+        if (conn.peerId && (conn.m_state == CryptoNoteConnectionContext::state_normal ||
+             conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
+          conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, buffer));
+        }
+      }
     });
   }
   //-----------------------------------------------------------------------------------
@@ -563,7 +572,7 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
   bool NodeServer::timedSync() {
     COMMAND_TIMED_SYNC::request arg = boost::value_initialized<COMMAND_TIMED_SYNC::request>();
     m_payload_handler.get_payload_sync_data(arg.payload_data);
-    auto cmdBuf = LevinProtocol::encode<COMMAND_TIMED_SYNC::request>(arg);
+    auto cmdBuf = std::make_shared<const BinaryArray>(LevinProtocol::encode<COMMAND_TIMED_SYNC::request>(arg));
 
     forEachConnection([&](P2pConnectionContext& conn) {
       if (conn.peerId &&
@@ -860,6 +869,7 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
     try {
       m_connections_maker_interval.call(std::bind(&NodeServer::connections_maker, this));
       m_peerlist_store_interval.call(std::bind(&NodeServer::store_config, this));
+      m_payload_handler.onIdle();
     } catch (std::exception& e) {
       logger(DEBUGGING) << "exception in idle_worker: " << e.what();
     }
@@ -999,12 +1009,16 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
 
   void NodeServer::relay_notify_to_all(int command, const BinaryArray& data_buff, const boost::uuids::uuid* excludeConnection) {
     boost::uuids::uuid excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<boost::uuids::uuid>();
+    relayNotifyToAll(command, std::make_shared<const BinaryArray>(data_buff), excludeId);
+  }
 
+  //-----------------------------------------------------------------------------------
+  void NodeServer::relayNotifyToAll(int command, const std::shared_ptr<const BinaryArray>& buffer, const boost::uuids::uuid& excludeId) {
     forEachConnection([&](P2pConnectionContext& conn) {
       if (conn.peerId && conn.m_connection_id != excludeId &&
           (conn.m_state == CryptoNoteConnectionContext::state_normal ||
            conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, buffer));
       }
     });
   }
@@ -1016,7 +1030,7 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
       return false;
     }
 
-    it->second.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, buffer));
+    it->second.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, BinaryArray(buffer)));
 
     return true;
   }
@@ -1383,13 +1397,13 @@ std::string print_peerlist_to_string(const std::list<PeerlistEntry>& pl) {
           logger(DEBUGGING) << ctx << "msg " << msg.type << ':' << msg.command;
           switch (msg.type) {
           case P2pMessage::COMMAND:
-            proto.sendMessage(msg.command, msg.buffer, true);
+            proto.sendMessage(msg.command, *msg.buffer, true);
             break;
           case P2pMessage::NOTIFY:
-            proto.sendMessage(msg.command, msg.buffer, false);
+            proto.sendMessage(msg.command, *msg.buffer, false);
             break;
           case P2pMessage::REPLY:
-            proto.sendReply(msg.command, msg.buffer, msg.returnCode);
+            proto.sendReply(msg.command, *msg.buffer, msg.returnCode);
             break;
           default:
             assert(false);
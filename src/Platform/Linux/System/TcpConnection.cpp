@@ -20,6 +20,8 @@
 #include <arpa/inet.h>
 #include <cassert>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <System/ErrorMessage.h>
@@ -164,6 +166,10 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 }
 
 std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
+  return write(data, size, nullptr, 0);
+}
+
+std::size_t TcpConnection::write(const uint8_t* header, std::size_t headerSize, const uint8_t* data, std::size_t size) {
   assert(dispatcher != nullptr);
   assert(contextPair.writeContext == nullptr);
   if (dispatcher->interrupted()) {
@@ -171,7 +177,7 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
   }
 
   std::string message;
-  if(size == 0) {
+  if(headerSize + size == 0) {
     if(shutdown(connection, SHUT_WR) == -1) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + lastErrorMessage());
     }
@@ -179,7 +185,19 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
+  iovec buffers[2];
+  msghdr messageHeader = {};
+  messageHeader.msg_iov = buffers;
+
+  if (headerSize != 0) {
+    buffers[messageHeader.msg_iovlen++] = iovec{const_cast<uint8_t*>(header), headerSize};
+  }
+
+  if (size != 0) {
+    buffers[messageHeader.msg_iovlen++] = iovec{const_cast<uint8_t*>(data), size};
+  }
+
+  ssize_t transferred = ::sendmsg(connection, &messageHeader, MSG_NOSIGNAL);
   if (transferred == -1) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wlogical-op"
@@ -245,11 +263,11 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
           throw std::runtime_error("TcpConnection::write, events & (EPOLLERR | EPOLLHUP) != 0");
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        ssize_t transferred = ::sendmsg(connection, &messageHeader, MSG_NOSIGNAL);
         if (transferred == -1) {
           message = "send failed, "  + lastErrorMessage();
         } else {
-          assert(transferred <= static_cast<ssize_t>(size));
+          assert(transferred <= static_cast<ssize_t>(headerSize + size));
           return transferred;
         }
       }
@@ -258,7 +276,7 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
     throw std::runtime_error("TcpConnection::write, " + message);
   }
 
-  assert(transferred <= static_cast<ssize_t>(size));
+  assert(transferred <= static_cast<ssize_t>(headerSize + size));
   return transferred;
 }
 
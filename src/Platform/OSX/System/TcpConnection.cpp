@@ -22,6 +22,7 @@
 #include <sys/event.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "Dispatcher.h"
@@ -145,6 +146,10 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 }
 
 size_t TcpConnection::write(const uint8_t* data, size_t size) {
+  return write(data, size, nullptr, 0);
+}
+
+size_t TcpConnection::write(const uint8_t* header, size_t headerSize, const uint8_t* data, size_t size) {
   assert(dispatcher != nullptr);
   assert(writeContext == nullptr);
   if (dispatcher->interrupted()) {
@@ -152,7 +157,7 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
   }
 
   std::string message;
-  if (size == 0) {
+  if (headerSize + size == 0) {
     if (shutdown(connection, SHUT_WR) == -1) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + lastErrorMessage());
     }
@@ -160,7 +165,19 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, 0);
+  iovec buffers[2];
+  msghdr messageHeader = {};
+  messageHeader.msg_iov = buffers;
+
+  if (headerSize != 0) {
+    buffers[messageHeader.msg_iovlen++] = iovec{const_cast<uint8_t*>(header), headerSize};
+  }
+
+  if (size != 0) {
+    buffers[messageHeader.msg_iovlen++] = iovec{const_cast<uint8_t*>(data), size};
+  }
+
+  ssize_t transferred = ::sendmsg(connection, &messageHeader, 0);
   if (transferred == -1) {
     if (errno != EAGAIN  && errno != EWOULDBLOCK) {
       message = "send failed, " + lastErrorMessage();
@@ -202,11 +219,11 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
           throw InterruptedException();
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        transferred = ::sendmsg(connection, &messageHeader, 0);
         if (transferred == -1) {
           message = "send failed, " + lastErrorMessage();
         } else {
-          assert(transferred <= static_cast<ssize_t>(size));
+          assert(transferred <= static_cast<ssize_t>(headerSize + size));
           return transferred;
         }
       }
@@ -215,7 +232,7 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
     throw std::runtime_error("TcpConnection::write, " + message);
   }
 
-  assert(transferred <= static_cast<ssize_t>(size));
+  assert(transferred <= static_cast<ssize_t>(headerSize + size));
   return transferred;
 }
 
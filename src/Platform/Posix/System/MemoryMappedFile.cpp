@@ -25,6 +25,7 @@
 #include <sys/types.h>
 
 #include <cassert>
+#include <cerrno>
 
 #include "Common/ScopeExit.h"
 
@@ -249,6 +250,40 @@ void MemoryMappedFile::flush(uint8_t* data, uint64_t size) {
   }
 }
 
+void MemoryMappedFile::preallocate(std::error_code& ec) {
+  assert(isOpened());
+
+#ifdef __linux__
+  /* Returns the error rather than setting errno */
+  int result = ::posix_fallocate(m_file, 0, static_cast<off_t>(m_size));
+  ec = result == 0 ? std::error_code() : std::error_code(result, std::system_category());
+#else
+  /* No posix_fallocate, so write to each page to allocate it, as glibc
+     does when the filesystem doesn't support fallocate. The byte already
+     there is written back, as the file may already hold data. */
+  const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+  for (uint64_t offset = 0; offset < m_size; offset += pageSize) {
+    uint8_t byte;
+    if (::pread(m_file, &byte, 1, static_cast<off_t>(offset)) != 1 ||
+        ::pwrite(m_file, &byte, 1, static_cast<off_t>(offset)) != 1) {
+      ec = std::error_code(errno, std::system_category());
+      return;
+    }
+  }
+
+  ec = std::error_code();
+#endif
+}
+
+void MemoryMappedFile::preallocate() {
+  std::error_code ec;
+  preallocate(ec);
+  if (ec) {
+    throw std::system_error(ec, "MemoryMappedFile::preallocate");
+  }
+}
+
 void MemoryMappedFile::swap(MemoryMappedFile& other) {
   std::swap(m_file, other.m_file);
   std::swap(m_path, other.m_path);
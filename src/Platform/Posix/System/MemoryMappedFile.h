@@ -47,6 +47,11 @@ public:
   void flush(uint8_t* data, uint64_t size, std::error_code& ec);
   void flush(uint8_t* data, uint64_t size);
 
+  /* Allocates disk space for the whole file, so writing to the mapping
+     can't fail later on, when the disk is full */
+  void preallocate(std::error_code& ec);
+  void preallocate();
+
   void swap(MemoryMappedFile& other);
 
 private:
@@ -282,6 +282,22 @@ void MemoryMappedFile::flush(uint8_t* data, uint64_t size) {
   }
 }
 
+void MemoryMappedFile::preallocate(std::error_code& ec) {
+  assert(isOpened());
+
+  /* SetEndOfFile() in create() already allocated the space, files are only
+     sparse on NTFS if they are marked as such */
+  ec = std::error_code();
+}
+
+void MemoryMappedFile::preallocate() {
+  std::error_code ec;
+  preallocate(ec);
+  if (ec) {
+    throw std::system_error(ec, "MemoryMappedFile::preallocate");
+  }
+}
+
 void MemoryMappedFile::swap(MemoryMappedFile& other) {
   std::swap(m_fileHandle, other.m_fileHandle);
   std::swap(m_mappingHandle, other.m_mappingHandle);
@@ -18,7 +18,7 @@
 #include "HttpServer.h"
 #include <boost/scope_exit.hpp>
 
-#include <HTTP/HttpParser.h>
+#include <HTTP/HttpRequestReader.h>
 #include <System/InterruptedException.h>
 #include <System/TcpStream.h>
 #include <System/Ipv4Address.h>
@@ -69,22 +69,21 @@ void HttpServer::acceptLoop() {
     logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
 
     System::TcpStreambuf streambuf(connection);
-    std::iostream stream(&streambuf);
-    HttpParser parser;
+    std::ostream stream(&streambuf);
+    HttpRequestReader reader(connection);
 
     for (;;) {
       HttpRequest req;
       HttpResponse resp;
 
-      parser.receiveRequest(stream, req);
+      if (!reader.receiveRequest(req)) {
+        break;
+      }
+
       processRequest(req, resp);
 
       stream << resp;
       stream.flush();
-
-      if (stream.peek() == std::iostream::traits_type::eof()) {
-        break;
-      }
     }
 
     logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
@@ -9,10 +9,12 @@
 #include "HttpServer.h"
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
 #include <Logging/LoggerRef.h>
 #include "Common/Math.h"
+#include "Common/ThreadPool.h"
 #include "CoreRpcServerCommandsDefinitions.h"
 #include "JsonRpc.h"
 
@@ -30,6 +32,10 @@ public:
   bool enableCors(const std::vector<std::string>  domains);
   bool setFeeAddress(const std::string fee_address);
   bool setFeeAmount(const uint32_t fee_amount);
+
+  /* Runs the read only handlers on this many threads of their own, instead
+     of the dispatcher. Zero keeps them on the dispatcher. */
+  void setWorkerThreads(const size_t threadCount);
   std::vector<std::string> getCorsDomains();
 
   bool on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response& res, JsonRpc::JsonRpcError& error_resp);
@@ -41,6 +47,10 @@ private:
   struct RpcHandler {
     const Handler handler;
     const bool allowBusyCore;
+
+    /* Only reads from the core, and touches nothing else that belongs to
+       the dispatcher, so it can run on a worker thread */
+    const bool readOnly;
   };
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
@@ -49,6 +59,7 @@ private:
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) override;
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
   bool isCoreReady();
+  void runOnWorker(const std::function<void()>& job);
 
   // json handlers
   bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
@@ -107,6 +118,7 @@ private:
   std::vector<std::string> m_cors_domains;
   std::string m_fee_address;
   uint32_t m_fee_amount;
+  std::unique_ptr<Common::ThreadPool> m_workers;
 };
 
 }
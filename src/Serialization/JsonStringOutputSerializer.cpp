@@ -0,0 +1,203 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#include "JsonStringOutputSerializer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+
+#include "rapidjson/writer.h"
+
+#include "Common/StringTools.h"
+
+namespace {
+
+/* Lets rapidjson append to a std::string */
+class StringWriteStream {
+public:
+  typedef char Ch;
+
+  explicit StringWriteStream(std::string& output) : m_output(output) {
+  }
+
+  void Put(char c) {
+    m_output.push_back(c);
+  }
+
+  void Flush() {
+  }
+
+private:
+  std::string& m_output;
+};
+
+/* The same format as Common::JsonValue uses for reals */
+std::string formatReal(double value) {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(11) << value;
+  std::string result = stream.str();
+  while (result.size() > 1 && result[result.size() - 2] != '.' && result[result.size() - 1] == '0') {
+    result.resize(result.size() - 1);
+  }
+
+  return result;
+}
+
+}
+
+namespace CryptoNote {
+
+class JsonStringOutputSerializer::Writer {
+public:
+  explicit Writer(std::string& output) : output(output), stream(output), writer(stream) {
+  }
+
+  /* Starts a string value, whose characters and closing quote the caller
+     appends to output. rapidjson would check and copy them one at a time,
+     which is slow for the long hex strings of blocks and transactions. */
+  void beginRawString() {
+    writer.RawValue("", 0, rapidjson::kStringType);
+    output.push_back('"');
+  }
+
+  std::string& output;
+  StringWriteStream stream;
+  rapidjson::Writer<StringWriteStream> writer;
+};
+
+JsonStringOutputSerializer::JsonStringOutputSerializer(std::string& output) : m_writer(new Writer(output)) {
+  m_writer->writer.StartObject();
+  m_inArray.push_back(false);
+}
+
+JsonStringOutputSerializer::~JsonStringOutputSerializer() {
+}
+
+ISerializer::SerializerType JsonStringOutputSerializer::type() const {
+  return ISerializer::OUTPUT;
+}
+
+void JsonStringOutputSerializer::finish() {
+  assert(m_inArray.size() == 1);
+  m_writer->writer.EndObject();
+  m_inArray.pop_back();
+}
+
+void JsonStringOutputSerializer::writeKey(Common::StringView name) {
+  assert(!m_inArray.empty());
+  if (!m_inArray.back()) {
+    m_writer->writer.Key(name.getData(), static_cast<rapidjson::SizeType>(name.getSize()));
+  }
+}
+
+bool JsonStringOutputSerializer::beginObject(Common::StringView name) {
+  writeKey(name);
+  m_writer->writer.StartObject();
+  m_inArray.push_back(false);
+  return true;
+}
+
+void JsonStringOutputSerializer::endObject() {
+  assert(!m_inArray.empty() && !m_inArray.back());
+  m_writer->writer.EndObject();
+  m_inArray.pop_back();
+}
+
+bool JsonStringOutputSerializer::beginArray(uint64_t& size, Common::StringView name) {
+  writeKey(name);
+  m_writer->writer.StartArray();
+  m_inArray.push_back(true);
+  return true;
+}
+
+void JsonStringOutputSerializer::endArray() {
+  assert(!m_inArray.empty() && m_inArray.back());
+  m_writer->writer.EndArray();
+  m_inArray.pop_back();
+}
+
+/* Unsigned values are written as signed ones, as JsonValue stores them */
+bool JsonStringOutputSerializer::operator()(uint64_t& value, Common::StringView name) {
+  int64_t v = static_cast<int64_t>(value);
+  return operator()(v, name);
+}
+
+bool JsonStringOutputSerializer::operator()(uint16_t& value, Common::StringView name) {
+  uint64_t v = static_cast<uint64_t>(value);
+  return operator()(v, name);
+}
+
+bool JsonStringOutputSerializer::operator()(int16_t& value, Common::StringView name) {
+  int64_t v = static_cast<int64_t>(value);
+  return operator()(v, name);
+}
+
+bool JsonStringOutputSerializer::operator()(uint32_t& value, Common::StringView name) {
+  uint64_t v = static_cast<uint64_t>(value);
+  return operator()(v, name);
+}
+
+bool JsonStringOutputSerializer::operator()(int32_t& value, Common::StringView name) {
+  int64_t v = static_cast<int64_t>(value);
+  return operator()(v, name);
+}
+
+bool JsonStringOutputSerializer::operator()(int64_t& value, Common::StringView name) {
+  writeKey(name);
+  m_writer->writer.Int64(value);
+  return true;
+}
+
+bool JsonStringOutputSerializer::operator()(double& value, Common::StringView name) {
+  writeKey(name);
+  const std::string real = formatReal(value);
+  m_writer->writer.RawValue(real.data(), real.size(), rapidjson::kNumberType);
+  return true;
+}
+
+bool JsonStringOutputSerializer::operator()(std::string& value, Common::StringView name) {
+  writeKey(name);
+
+  //The same characters rapidjson escapes
+  const bool needsEscaping = std::any_of(value.begin(), value.end(), [](char c) {
+    return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+  });
+
+  if (needsEscaping) {
+    m_writer->writer.String(value.data(), static_cast<rapidjson::SizeType>(value.size()));
+  } else {
+    m_writer->beginRawString();
+    m_writer->output.append(value);
+    m_writer->output.push_back('"');
+  }
+
+  return true;
+}
+
+bool JsonStringOutputSerializer::operator()(uint8_t& value, Common::StringView name) {
+  int64_t v = static_cast<int64_t>(value);
+  return operator()(v, name);
+}
+
+bool JsonStringOutputSerializer::operator()(bool& value, Common::StringView name) {
+  writeKey(name);
+  m_writer->writer.Bool(value);
+  return true;
+}
+
+bool JsonStringOutputSerializer::binary(void* value, uint64_t size, Common::StringView name) {
+  writeKey(name);
+  m_writer->beginRawString();
+  Common::toHex(value, size, m_writer->output);
+  m_writer->output.push_back('"');
+  return true;
+}
+
+bool JsonStringOutputSerializer::binary(std::string& value, Common::StringView name) {
+  return binary(const_cast<char*>(value.data()), value.size(), name);
+}
+
+}
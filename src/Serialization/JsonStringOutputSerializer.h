@@ -0,0 +1,64 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ISerializer.h"
+
+namespace CryptoNote {
+
+/* Writes JSON straight into a string as the values are serialized, rather
+   than building a JsonValue first like JsonOutputStreamSerializer. Keys come
+   out in the order they are serialized in. The top level is an object,
+   which is closed by finish(). */
+class JsonStringOutputSerializer : public ISerializer {
+public:
+  explicit JsonStringOutputSerializer(std::string& output);
+  virtual ~JsonStringOutputSerializer();
+
+  SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(uint64_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
+  virtual bool binary(void* value, uint64_t size, Common::StringView name) override;
+  virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+  void finish();
+
+private:
+  class Writer;
+
+  void writeKey(Common::StringView name);
+
+  std::unique_ptr<Writer> m_writer;
+
+  /* Whether each open object or array is an array, values in arrays have
+     no key */
+  std::vector<bool> m_inArray;
+};
+
+}
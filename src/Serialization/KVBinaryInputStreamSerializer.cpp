@@ -29,143 +29,181 @@ using namespace CryptoNote;
 
 namespace {
 
-template <typename T>
-T readPod(Common::IInputStream& s) {
-  T v;
-  read(s, &v, sizeof(T));
-  return v;
-}
+/* Sections and arrays nested deeper than this are not valid messages */
+const size_t MAX_DEPTH = 100;
 
-template <typename T, typename JsonT = T>
-JsonValue readPodJson(Common::IInputStream& s) {
-  JsonValue jv;
-  jv = static_cast<JsonT>(readPod<T>(s));
-  return jv;
+void checkAvailable(const uint8_t* p, const uint8_t* end, uint64_t size) {
+  if (static_cast<uint64_t>(end - p) < size) {
+    throw std::runtime_error("Unexpected end of stream");
+  }
 }
 
 template <typename T>
-JsonValue readIntegerJson(Common::IInputStream& s) {
-  return readPodJson<T, int64_t>(s);
+T readPod(const uint8_t*& p, const uint8_t* end) {
+  checkAvailable(p, end, sizeof(T));
+  T v;
+  memcpy(&v, p, sizeof(T));
+  p += sizeof(T);
+  return v;
 }
 
-uint64_t readVarint(Common::IInputStream& s) {
-  uint8_t b = read<uint8_t>(s);
-  uint8_t size_mask = b & PORTABLE_RAW_SIZE_MARK_MASK;
-  uint64_t bytesLeft = 0;
+uint64_t readVarint(const uint8_t*& p, const uint8_t* end) {
+  checkAvailable(p, end, 1);
+  uint8_t size_mask = *p & PORTABLE_RAW_SIZE_MARK_MASK;
+  uint64_t size = 0;
 
-  switch (size_mask){
+  switch (size_mask) {
   case PORTABLE_RAW_SIZE_MARK_BYTE:
-    bytesLeft = 0;
+    size = 1;
     break;
   case PORTABLE_RAW_SIZE_MARK_WORD:
-    bytesLeft = 1;
+    size = 2;
     break;
   case PORTABLE_RAW_SIZE_MARK_DWORD:
-    bytesLeft = 3;
+    size = 4;
     break;
   case PORTABLE_RAW_SIZE_MARK_INT64:
-    bytesLeft = 7;
+    size = 8;
     break;
   }
 
-  uint64_t value = b;
+  checkAvailable(p, end, size);
 
-  for (uint64_t i = 1; i <= bytesLeft; ++i) {
-    uint64_t n = read<uint8_t>(s);
-    value |= n << (i * 8);
+  uint64_t value = 0;
+  for (uint64_t i = 0; i < size; ++i) {
+    value |= static_cast<uint64_t>(p[i]) << (i * 8);
   }
 
-  value >>= 2;
-  return value;
+  p += size;
+  return value >> 2;
 }
 
-std::string readString(Common::IInputStream& s) {
-  auto size = readVarint(s);
-  std::string str;
-  str.resize(size);
-  if (size) {
-    read(s, &str[0], size);
-  }
-  return str;
-}
+const uint8_t* readString(const uint8_t*& p, const uint8_t* end, size_t& size) {
+  uint64_t length = readVarint(p, end);
+  checkAvailable(p, end, length);
 
-JsonValue readStringJson(Common::IInputStream& s) {
-  return JsonValue(readString(s));
+  const uint8_t* data = p;
+  size = static_cast<size_t>(length);
+  p += size;
+  return data;
 }
 
-void readName(Common::IInputStream& s, std::string& name) {
-  uint8_t len = readPod<uint8_t>(s);
-  if (len) {
-    name.resize(len);
-    read(s, &name[0], len);
+int64_t readInteger(const uint8_t*& p, const uint8_t* end, uint8_t type) {
+  switch (type) {
+  case BIN_KV_SERIALIZE_TYPE_INT64:  return readPod<int64_t>(p, end);
+  case BIN_KV_SERIALIZE_TYPE_INT32:  return readPod<int32_t>(p, end);
+  case BIN_KV_SERIALIZE_TYPE_INT16:  return readPod<int16_t>(p, end);
+  case BIN_KV_SERIALIZE_TYPE_INT8:   return readPod<int8_t>(p, end);
+  case BIN_KV_SERIALIZE_TYPE_UINT64: return static_cast<int64_t>(readPod<uint64_t>(p, end));
+  case BIN_KV_SERIALIZE_TYPE_UINT32: return readPod<uint32_t>(p, end);
+  case BIN_KV_SERIALIZE_TYPE_UINT16: return readPod<uint16_t>(p, end);
+  case BIN_KV_SERIALIZE_TYPE_UINT8:  return readPod<uint8_t>(p, end);
+  default:
+    throw std::runtime_error("Integer value expected");
   }
 }
 
-JsonValue loadValue(Common::IInputStream& stream, uint8_t type);
-JsonValue loadSection(Common::IInputStream& stream);
-JsonValue loadEntry(Common::IInputStream& stream);
-JsonValue loadArray(Common::IInputStream& stream, uint8_t itemType);
+void skipValue(const uint8_t*& p, const uint8_t* end, uint8_t type, size_t depth);
 
+void skipSection(const uint8_t*& p, const uint8_t* end, size_t depth) {
+  if (depth > MAX_DEPTH) {
+    throw std::runtime_error("Binary storage is nested too deeply");
+  }
 
-JsonValue loadSection(Common::IInputStream& stream) {
-  JsonValue sec(JsonValue::OBJECT);
-  uint64_t count = readVarint(stream);
-  std::string name;
+  uint64_t count = readVarint(p, end);
 
   while (count--) {
-    readName(stream, name);
-    sec.insert(name, loadEntry(stream));
+    uint8_t nameSize = readPod<uint8_t>(p, end);
+    checkAvailable(p, end, nameSize);
+    p += nameSize;
+
+    uint8_t type = readPod<uint8_t>(p, end);
+    skipValue(p, end, type, depth);
+  }
+}
+
+void skipArray(const uint8_t*& p, const uint8_t* end, uint8_t itemType, size_t depth) {
+  if (depth > MAX_DEPTH) {
+    throw std::runtime_error("Binary storage is nested too deeply");
   }
 
-  return sec;
+  uint64_t count = readVarint(p, end);
+
+  while (count--) {
+    skipValue(p, end, itemType, depth);
+  }
 }
 
-JsonValue loadValue(Common::IInputStream& stream, uint8_t type) {
+void skipValue(const uint8_t*& p, const uint8_t* end, uint8_t type, size_t depth) {
+  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
+    skipArray(p, end, type & ~BIN_KV_SERIALIZE_FLAG_ARRAY, depth + 1);
+    return;
+  }
+
+  size_t size;
+
   switch (type) {
-  case BIN_KV_SERIALIZE_TYPE_INT64:  return readIntegerJson<int64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT32:  return readIntegerJson<int32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT16:  return readIntegerJson<int16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_INT8:   return readIntegerJson<int8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT64: return readIntegerJson<uint64_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT32: return readIntegerJson<uint32_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT16: return readIntegerJson<uint16_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_UINT8:  return readIntegerJson<uint8_t>(stream);
-  case BIN_KV_SERIALIZE_TYPE_DOUBLE: return readPodJson<double>(stream);
-  case BIN_KV_SERIALIZE_TYPE_BOOL:   return JsonValue(read<uint8_t>(stream) != 0);
-  case BIN_KV_SERIALIZE_TYPE_STRING: return readStringJson(stream);
-  case BIN_KV_SERIALIZE_TYPE_OBJECT: return loadSection(stream);
-  case BIN_KV_SERIALIZE_TYPE_ARRAY:  return loadArray(stream, type);
+  case BIN_KV_SERIALIZE_TYPE_INT64:
+  case BIN_KV_SERIALIZE_TYPE_UINT64:
+  case BIN_KV_SERIALIZE_TYPE_DOUBLE:
+    size = 8;
+    break;
+  case BIN_KV_SERIALIZE_TYPE_INT32:
+  case BIN_KV_SERIALIZE_TYPE_UINT32:
+    size = 4;
+    break;
+  case BIN_KV_SERIALIZE_TYPE_INT16:
+  case BIN_KV_SERIALIZE_TYPE_UINT16:
+    size = 2;
+    break;
+  case BIN_KV_SERIALIZE_TYPE_INT8:
+  case BIN_KV_SERIALIZE_TYPE_UINT8:
+  case BIN_KV_SERIALIZE_TYPE_BOOL:
+    size = 1;
+    break;
+  case BIN_KV_SERIALIZE_TYPE_STRING:
+    readString(p, end, size);
+    return;
+  case BIN_KV_SERIALIZE_TYPE_OBJECT:
+    skipSection(p, end, depth + 1);
+    return;
+  case BIN_KV_SERIALIZE_TYPE_ARRAY:
+    skipArray(p, end, type, depth + 1);
+    return;
   default:
     throw std::runtime_error("Unknown data type");
-    break;
   }
-}
-
-JsonValue loadEntry(Common::IInputStream& stream) {
-  uint8_t type = readPod<uint8_t>(stream);
 
-  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
-    type &= ~BIN_KV_SERIALIZE_FLAG_ARRAY;
-    return loadArray(stream, type);
-  }
+  checkAvailable(p, end, size);
+  p += size;
+}
 
-  return loadValue(stream, type);
 }
 
-JsonValue loadArray(Common::IInputStream& stream, uint8_t itemType) {
-  JsonValue arr(JsonValue::ARRAY);
-  uint64_t count = readVarint(stream);
+KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(Common::IInputStream& strm) {
+  uint8_t chunk[4096];
+  size_t size;
 
-  while (count--) {
-    arr.pushBack(loadValue(stream, itemType));
+  while ((size = strm.readSome(chunk, sizeof(chunk))) != 0) {
+    m_buffer.insert(m_buffer.end(), chunk, chunk + size);
   }
 
-  return arr;
+  m_begin = m_buffer.data();
+  m_end = m_begin + m_buffer.size();
+  parseHeader();
+}
+
+KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(const void* data, size_t size) :
+  m_begin(static_cast<const uint8_t*>(data)), m_end(m_begin + size) {
+  parseHeader();
 }
 
+KVBinaryInputStreamSerializer::~KVBinaryInputStreamSerializer() {
+}
 
-JsonValue parseBinary(Common::IInputStream& stream) {
-  auto hdr = readPod<KVBinaryStorageBlockHeader>(stream);
+void KVBinaryInputStreamSerializer::parseHeader() {
+  const uint8_t* p = m_begin;
+  auto hdr = readPod<KVBinaryStorageBlockHeader>(p, m_end);
 
   if (
     hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
@@ -177,30 +215,329 @@ JsonValue parseBinary(Common::IInputStream& stream) {
     throw std::runtime_error("Unknown binary storage format version");
   }
 
-  return loadSection(stream);
+  /* Indexing the root section walks the whole payload, so it is rejected
+     here if it is malformed anywhere, as when it was loaded up front */
+  enterSection(p);
 }
 
+void KVBinaryInputStreamSerializer::enterSection(const uint8_t* section) {
+  const uint8_t* p = section;
+
+  Scope scope = {};
+  scope.isArray = false;
+  scope.firstEntry = m_entries.size();
+
+  uint64_t count = readVarint(p, m_end);
+
+  while (count--) {
+    Entry entry;
+    entry.nameSize = readPod<uint8_t>(p, m_end);
+    checkAvailable(p, m_end, entry.nameSize);
+    entry.name = p;
+    p += entry.nameSize;
+
+    entry.type = readPod<uint8_t>(p, m_end);
+    entry.value = p;
+    skipValue(p, m_end, entry.type, m_scopes.size());
+
+    m_entries.push_back(entry);
+  }
+
+  indexSection(scope.firstEntry);
+  scope.entryCount = m_entries.size() - scope.firstEntry;
+
+  /* Inside an array the section is the next item, which ends here */
+  valueRead(p);
+
+  m_scopes.push_back(scope);
 }
 
-KVBinaryInputStreamSerializer::KVBinaryInputStreamSerializer(Common::IInputStream& strm) : JsonInputValueSerializer(parseBinary(strm)) {
+void KVBinaryInputStreamSerializer::indexSection(size_t firstEntry) {
+  /* Sorted by name, and by position among equal names, so the first of
+     several entries with the same name comes first */
+  const auto byName = [this](size_t a, size_t b) {
+    int order = compareNames(m_entries[a], m_entries[b].name, m_entries[b].nameSize);
+    return order < 0 || (order == 0 && a < b);
+  };
+
+  const auto sameName = [this](size_t a, size_t b) {
+    return compareNames(m_entries[a], m_entries[b].name, m_entries[b].nameSize) == 0;
+  };
+
+  const auto sortIndex = [&] {
+    m_index.resize(firstEntry);
+    for (size_t i = firstEntry; i < m_entries.size(); ++i) {
+      m_index.push_back(i);
+    }
+
+    std::sort(m_index.begin() + firstEntry, m_index.end(), byName);
+  };
+
+  sortIndex();
+
+  auto firstDuplicate = std::adjacent_find(m_index.begin() + firstEntry, m_index.end(), sameName);
+  if (firstDuplicate == m_index.end()) {
+    return;
+  }
+
+  /* The first of several entries with the same name is the one read, the
+     others are dropped, keeping the rest in the order they were written */
+  std::vector<uint8_t> keep(m_entries.size() - firstEntry, 1);
+  for (auto it = firstDuplicate + 1; it != m_index.end(); ++it) {
+    if (sameName(*(it - 1), *it)) {
+      keep[*it - firstEntry] = 0;
+    }
+  }
+
+  size_t kept = firstEntry;
+  for (size_t i = firstEntry; i < m_entries.size(); ++i) {
+    if (keep[i - firstEntry]) {
+      m_entries[kept++] = m_entries[i];
+    }
+  }
+
+  m_entries.resize(kept);
+  sortIndex();
 }
 
-bool KVBinaryInputStreamSerializer::binary(void* value, uint64_t size, Common::StringView name) {
-  std::string str;
+int KVBinaryInputStreamSerializer::compareNames(const Entry& entry, const void* name, size_t nameSize) {
+  int order = memcmp(entry.name, name, std::min<size_t>(entry.nameSize, nameSize));
+  if (order != 0) {
+    return order;
+  }
 
-  if (!(*this)(str, name)) {
+  return entry.nameSize < nameSize ? -1 : entry.nameSize > nameSize ? 1 : 0;
+}
+
+const uint8_t* KVBinaryInputStreamSerializer::findValue(Common::StringView name, uint8_t& type) {
+  assert(!m_scopes.empty());
+  Scope& scope = m_scopes.back();
+
+  if (scope.isArray) {
+    if (scope.itemsLeft == 0) {
+      throw std::runtime_error("Reading past the end of an array");
+    }
+
+    type = scope.itemType;
+    return scope.nextItem;
+  }
+
+  /* Fields are mostly read in the order they were written */
+  if (scope.nextEntry < scope.entryCount) {
+    const Entry& entry = m_entries[scope.firstEntry + scope.nextEntry];
+
+    if (compareNames(entry, name.getData(), name.getSize()) == 0) {
+      ++scope.nextEntry;
+      type = entry.type;
+      return entry.value;
+    }
+  }
+
+  /* Otherwise, and for names which aren't there, ask the index */
+  const auto indexBegin = m_index.begin() + scope.firstEntry;
+  const auto indexEnd = indexBegin + scope.entryCount;
+
+  auto it = std::lower_bound(indexBegin, indexEnd, name, [this](size_t i, Common::StringView name) {
+    return compareNames(m_entries[i], name.getData(), name.getSize()) < 0;
+  });
+
+  if (it == indexEnd || compareNames(m_entries[*it], name.getData(), name.getSize()) != 0) {
+    return nullptr;
+  }
+
+  const Entry& entry = m_entries[*it];
+  scope.nextEntry = *it - scope.firstEntry + 1;
+  type = entry.type;
+  return entry.value;
+}
+
+void KVBinaryInputStreamSerializer::valueRead(const uint8_t* valueEnd) {
+  if (!m_scopes.empty() && m_scopes.back().isArray) {
+    Scope& scope = m_scopes.back();
+    scope.nextItem = valueEnd;
+    --scope.itemsLeft;
+  }
+}
+
+ISerializer::SerializerType KVBinaryInputStreamSerializer::type() const {
+  return ISerializer::INPUT;
+}
+
+bool KVBinaryInputStreamSerializer::beginObject(Common::StringView name) {
+  uint8_t type;
+  const uint8_t* value = findValue(name, type);
+  if (value == nullptr) {
+    return false;
+  }
+
+  if (type != BIN_KV_SERIALIZE_TYPE_OBJECT) {
+    throw std::runtime_error("Object expected");
+  }
+
+  enterSection(value);
+  return true;
+}
+
+void KVBinaryInputStreamSerializer::endObject() {
+  assert(!m_scopes.empty() && !m_scopes.back().isArray);
+  m_entries.resize(m_scopes.back().firstEntry);
+  m_index.resize(m_scopes.back().firstEntry);
+  m_scopes.pop_back();
+}
+
+bool KVBinaryInputStreamSerializer::beginArray(uint64_t& size, Common::StringView name) {
+  assert(!m_scopes.empty());
+  if (m_scopes.back().isArray) {
+    throw std::runtime_error("Arrays of arrays are not supported");
+  }
+
+  uint8_t type;
+  const uint8_t* p = findValue(name, type);
+  if (p == nullptr) {
+    size = 0;
+    return false;
+  }
+
+  Scope scope = {};
+  scope.isArray = true;
+
+  if (type & BIN_KV_SERIALIZE_FLAG_ARRAY) {
+    scope.itemType = type & ~BIN_KV_SERIALIZE_FLAG_ARRAY;
+  } else if (type == BIN_KV_SERIALIZE_TYPE_ARRAY) {
+    scope.itemType = type;
+  } else {
+    throw std::runtime_error("Array expected");
+  }
+
+  scope.itemsLeft = readVarint(p, m_end);
+  scope.nextItem = p;
+  m_scopes.push_back(scope);
+
+  size = scope.itemsLeft;
+  return true;
+}
+
+void KVBinaryInputStreamSerializer::endArray() {
+  assert(!m_scopes.empty() && m_scopes.back().isArray);
+  m_scopes.pop_back();
+}
+
+template<typename T>
+bool KVBinaryInputStreamSerializer::readNumber(Common::StringView name, T& value) {
+  uint8_t type;
+  const uint8_t* p = findValue(name, type);
+  if (p == nullptr) {
+    return false;
+  }
+
+  value = static_cast<T>(readInteger(p, m_end, type));
+  valueRead(p);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::readString(Common::StringView name, const uint8_t*& data, size_t& size) {
+  uint8_t type;
+  const uint8_t* p = findValue(name, type);
+  if (p == nullptr) {
+    return false;
+  }
+
+  if (type != BIN_KV_SERIALIZE_TYPE_STRING) {
+    throw std::runtime_error("String expected");
+  }
+
+  data = ::readString(p, m_end, size);
+  valueRead(p);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::operator()(uint8_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(int16_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(uint16_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(int32_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(uint32_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(int64_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(uint64_t& value, Common::StringView name) {
+  return readNumber(name, value);
+}
+
+bool KVBinaryInputStreamSerializer::operator()(double& value, Common::StringView name) {
+  uint8_t type;
+  const uint8_t* p = findValue(name, type);
+  if (p == nullptr) {
     return false;
   }
 
-  if (str.size() != size) {
+  if (type == BIN_KV_SERIALIZE_TYPE_DOUBLE) {
+    value = readPod<double>(p, m_end);
+  } else {
+    value = static_cast<double>(readInteger(p, m_end, type));
+  }
+
+  valueRead(p);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::operator()(bool& value, Common::StringView name) {
+  uint8_t type;
+  const uint8_t* p = findValue(name, type);
+  if (p == nullptr) {
+    return false;
+  }
+
+  if (type != BIN_KV_SERIALIZE_TYPE_BOOL) {
+    throw std::runtime_error("Bool expected");
+  }
+
+  value = readPod<uint8_t>(p, m_end) != 0;
+  valueRead(p);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::operator()(std::string& value, Common::StringView name) {
+  const uint8_t* data;
+  size_t size;
+  if (!readString(name, data, size)) {
+    return false;
+  }
+
+  value.assign(reinterpret_cast<const char*>(data), size);
+  return true;
+}
+
+bool KVBinaryInputStreamSerializer::binary(void* value, uint64_t size, Common::StringView name) {
+  const uint8_t* data;
+  size_t dataSize;
+  if (!readString(name, data, dataSize)) {
+    return false;
+  }
+
+  if (dataSize != size) {
     throw std::runtime_error("Binary block size mismatch");
   }
 
-  memcpy(value, str.data(), size);
+  memcpy(value, data, size);
   return true;
 }
 
 bool KVBinaryInputStreamSerializer::binary(std::string& value, Common::StringView name) {
   return (*this)(value, name); // load as string
 }
-
@@ -17,18 +17,99 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <Common/IInputStream.h>
 #include "ISerializer.h"
-#include "JsonInputValueSerializer.h"
 
 namespace CryptoNote {
 
-class KVBinaryInputStreamSerializer : public JsonInputValueSerializer {
+/* Reads the key-value binary format in place, as the values are asked
+   for, instead of loading it into a JsonValue first. A section is indexed
+   when it is entered: the names and positions of its entries are noted,
+   and the values are only decoded when they are read. */
+class KVBinaryInputStreamSerializer : public ISerializer {
 public:
+  /* Copies what is left of the stream */
   KVBinaryInputStreamSerializer(Common::IInputStream& strm);
 
+  /* Reads straight from data, which has to outlive the serializer */
+  KVBinaryInputStreamSerializer(const void* data, size_t size);
+
+  virtual ~KVBinaryInputStreamSerializer();
+
+  SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(uint64_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
   virtual bool binary(void* value, uint64_t size, Common::StringView name) override;
   virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+private:
+  struct Entry {
+    const uint8_t* name;
+    uint8_t nameSize;
+    uint8_t type;
+    const uint8_t* value;
+  };
+
+  /* An open section or array */
+  struct Scope {
+    bool isArray;
+
+    /* Section: its entries in m_entries, and where to start looking for the
+       next name, as fields are mostly read in the order they were written */
+    size_t firstEntry;
+    size_t entryCount;
+    size_t nextEntry;
+
+    /* Array: the type of the items, and the next one to read */
+    uint8_t itemType;
+    uint64_t itemsLeft;
+    const uint8_t* nextItem;
+  };
+
+  void parseHeader();
+  void enterSection(const uint8_t* section);
+  void indexSection(size_t firstEntry);
+  static int compareNames(const Entry& entry, const void* name, size_t nameSize);
+  const uint8_t* findValue(Common::StringView name, uint8_t& type);
+  void valueRead(const uint8_t* valueEnd);
+
+  template<typename T>
+  bool readNumber(Common::StringView name, T& value);
+  bool readString(Common::StringView name, const uint8_t*& data, size_t& size);
+
+  std::vector<uint8_t> m_buffer;
+  const uint8_t* m_begin;
+  const uint8_t* m_end;
+
+  std::vector<Entry> m_entries;
+
+  /* Parallel to m_entries: each section's slice holds the positions of its
+     entries, sorted by name, for the lookups which aren't in order */
+  std::vector<size_t> m_index;
+  std::vector<Scope> m_scopes;
 };
 
 }
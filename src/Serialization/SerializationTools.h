@@ -23,6 +23,7 @@
 #include <Common/StringOutputStream.h>
 #include "JsonInputStreamSerializer.h"
 #include "JsonOutputStreamSerializer.h"
+#include "JsonStringOutputSerializer.h"
 #include "KVBinaryInputStreamSerializer.h"
 #include "KVBinaryOutputStreamSerializer.h"
 #include <zedwallet/Types.h>
@@ -113,6 +114,16 @@ std::string storeToJson(const T& v) {
   return storeToJsonValue(v).toString();
 }
 
+/* Like storeToJson() for objects, but without building a JsonValue on the way */
+template <typename T>
+std::string storeToJsonString(const T& v) {
+  std::string result;
+  JsonStringOutputSerializer s(result);
+  serialize(const_cast<T&>(v), s);
+  s.finish();
+  return result;
+}
+
 template <typename T>
 bool loadFromJson(T& v, const std::string& buf) {
   try {
@@ -141,8 +152,7 @@ std::string storeToBinaryKeyValue(const T& v) {
 template <typename T>
 bool loadFromBinaryKeyValue(T& v, const std::string& buf) {
   try {
-    Common::MemoryInputStream stream(buf.data(), buf.size());
-    KVBinaryInputStreamSerializer s(stream);
+    KVBinaryInputStreamSerializer s(buf.data(), buf.size());
     serialize(v, s);
     return true;
   } catch (std::exception&) {
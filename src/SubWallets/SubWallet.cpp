@@ -116,7 +116,7 @@ void SubWallet::storeTransactionInput(
         }
     }
 
-    m_unspentInputs.push_back(input);
+    addInput(m_unspentInputs, m_unspentInputSlots, input);
 }
 
 std::tuple<uint64_t, uint64_t> SubWallet::getBalance(
@@ -157,6 +157,9 @@ void SubWallet::reset(const uint64_t scanHeight)
     m_unconfirmedIncomingAmounts.clear();
     m_unspentInputs.clear();
     m_spentInputs.clear();
+
+    m_unspentInputSlots.clear();
+    m_lockedInputSlots.clear();
 }
 
 bool SubWallet::isPrimaryAddress() const
@@ -171,26 +174,14 @@ std::string SubWallet::address() const
 
 bool SubWallet::hasKeyImage(const Crypto::KeyImage keyImage) const
 {
-    auto it = std::find_if(m_unspentInputs.begin(), m_unspentInputs.end(),
-    [&keyImage](const auto &input)
-    {
-        return input.keyImage == keyImage;
-    });
-
     /* Found the key image */
-    if (it != m_unspentInputs.end())
+    if (m_unspentInputSlots.find(keyImage) != m_unspentInputSlots.end())
     {
         return true;
     }
 
     /* Didn't find it in unlocked inputs, check the locked inputs */
-    it = std::find_if(m_lockedInputs.begin(), m_lockedInputs.end(),
-    [&keyImage](const auto &input)
-    {
-        return input.keyImage == keyImage;
-    });
-
-    return it != m_lockedInputs.end();
+    return m_lockedInputSlots.find(keyImage) != m_lockedInputSlots.end();
 
     /* Note: We don't need to check the spent inputs - it should never show
        up there, as the same key image can only be used once */
@@ -198,6 +189,23 @@ bool SubWallet::hasKeyImage(const Crypto::KeyImage keyImage) const
     /* Also don't need to check unconfirmed inputs - we can't spend those yet */
 }
 
+std::vector<Crypto::KeyImage> SubWallet::getKeyImages() const
+{
+    std::vector<Crypto::KeyImage> keyImages;
+
+    for (const auto &[keyImage, slot] : m_unspentInputSlots)
+    {
+        keyImages.push_back(keyImage);
+    }
+
+    for (const auto &[keyImage, slot] : m_lockedInputSlots)
+    {
+        keyImages.push_back(keyImage);
+    }
+
+    return keyImages;
+}
+
 Crypto::PublicKey SubWallet::publicSpendKey() const
 {
     return m_publicSpendKey;
@@ -213,43 +221,39 @@ void SubWallet::markInputAsSpent(
     const uint64_t spendHeight)
 {
     /* Find the input */
-    auto it = std::find_if(m_unspentInputs.begin(), m_unspentInputs.end(),
-    [&keyImage](const auto x)
-    {
-        return x.keyImage == keyImage;
-    });
+    auto it = m_unspentInputSlots.find(keyImage);
 
-    if (it != m_unspentInputs.end())
+    if (it != m_unspentInputSlots.end())
     {
+        auto &input = m_unspentInputs[it->second];
+
         /* Set the spend height */
-        it->spendHeight = spendHeight;
+        input.spendHeight = spendHeight;
 
         /* Add to the spent inputs vector */
-        m_spentInputs.push_back(*it);
+        m_spentInputs.push_back(input);
 
         /* Remove from the unspent vector */
-        m_unspentInputs.erase(it);
+        removeInput(m_unspentInputs, m_unspentInputSlots, it->second);
 
         return;
     }
 
     /* Didn't find it, lets try in the locked inputs */
-    it = std::find_if(m_lockedInputs.begin(), m_lockedInputs.end(),
-    [&keyImage](const auto x)
-    {
-        return x.keyImage == keyImage;
-    });
+    it = m_lockedInputSlots.find(keyImage);
 
-    if (it != m_lockedInputs.end())
+    if (it != m_lockedInputSlots.end())
     {
+        auto &input = m_lockedInputs[it->second];
+
         /* Set the spend height */
-        it->spendHeight = spendHeight;
+        input.spendHeight = spendHeight;
 
         /* Add to the spent inputs vector */
-        m_spentInputs.push_back(*it);
+        m_spentInputs.push_back(input);
 
         /* Remove from the locked vector */
-        m_lockedInputs.erase(it);
+        removeInput(m_lockedInputs, m_lockedInputSlots, it->second);
 
         return;
     }
@@ -261,23 +265,19 @@ void SubWallet::markInputAsSpent(
 void SubWallet::markInputAsLocked(const Crypto::KeyImage keyImage)
 {
     /* Find the input */
-    auto it = std::find_if(m_unspentInputs.begin(), m_unspentInputs.end(),
-    [&keyImage](const auto x)
-    {
-        return x.keyImage == keyImage;
-    });
+    const auto it = m_unspentInputSlots.find(keyImage);
 
     /* Shouldn't happen */
-    if (it == m_unspentInputs.end())
+    if (it == m_unspentInputSlots.end())
     {
         throw std::runtime_error("Could not find key image to lock!");
     }
 
-    /* Add to the spent inputs vector */
-    m_lockedInputs.push_back(*it);
+    /* Add to the locked inputs vector */
+    addInput(m_lockedInputs, m_lockedInputSlots, m_unspentInputs[it->second]);
 
     /* Remove from the unspent vector */
-    m_unspentInputs.erase(it);
+    removeInput(m_unspentInputs, m_unspentInputSlots, it->second);
 }
 
 void SubWallet::removeForkedInputs(const uint64_t forkHeight)
@@ -321,6 +321,8 @@ void SubWallet::removeForkedInputs(const uint64_t forkHeight)
     {
         m_spentInputs.erase(it, m_spentInputs.end());
     }
+
+    rebuildInputSlots();
 }
 
 /* Cancelled transactions are transactions we sent, but got cancelled and not
@@ -364,6 +366,8 @@ void SubWallet::removeCancelledTransactions(
     {
         m_unconfirmedIncomingAmounts.erase(it2, m_unconfirmedIncomingAmounts.end());
     }
+
+    rebuildInputSlots();
 }
 
 std::vector<WalletTypes::TxInputAndOwner> SubWallet::getSpendableInputs(
@@ -409,6 +413,63 @@ void SubWallet::convertSyncTimestampToHeight(
     }
 }
 
+void SubWallet::addInput(
+    std::vector<WalletTypes::TransactionInput> &inputs,
+    std::unordered_map<Crypto::KeyImage, size_t> &slots,
+    const WalletTypes::TransactionInput &input)
+{
+    /* View wallet inputs all have a blank key image */
+    if (input.keyImage != Crypto::KeyImage())
+    {
+        slots[input.keyImage] = inputs.size();
+    }
+
+    inputs.push_back(input);
+}
+
+void SubWallet::removeInput(
+    std::vector<WalletTypes::TransactionInput> &inputs,
+    std::unordered_map<Crypto::KeyImage, size_t> &slots,
+    const size_t slot)
+{
+    slots.erase(inputs[slot].keyImage);
+
+    /* Move the last input into the gap, and update its position */
+    if (slot != inputs.size() - 1)
+    {
+        inputs[slot] = inputs.back();
+
+        if (inputs[slot].keyImage != Crypto::KeyImage())
+        {
+            slots[inputs[slot].keyImage] = slot;
+        }
+    }
+
+    inputs.pop_back();
+}
+
+void SubWallet::rebuildInputSlots()
+{
+    m_unspentInputSlots.clear();
+    m_lockedInputSlots.clear();
+
+    for (size_t i = 0; i < m_unspentInputs.size(); i++)
+    {
+        if (m_unspentInputs[i].keyImage != Crypto::KeyImage())
+        {
+            m_unspentInputSlots[m_unspentInputs[i].keyImage] = i;
+        }
+    }
+
+    for (size_t i = 0; i < m_lockedInputs.size(); i++)
+    {
+        if (m_lockedInputs[i].keyImage != Crypto::KeyImage())
+        {
+            m_lockedInputSlots[m_lockedInputs[i].keyImage] = i;
+        }
+    }
+}
+
 void SubWallet::fromJSON(const JSONValue &j)
 {
     m_publicSpendKey.fromString(getStringFromJSON(j, "publicSpendKey"));
@@ -450,6 +511,9 @@ void SubWallet::fromJSON(const JSONValue &j)
         amount.fromJSON(x);
         m_unconfirmedIncomingAmounts.push_back(amount);
     }
+
+    /* The slot indexes aren't stored in the wallet file */
+    rebuildInputSlots();
 }
 
 void SubWallet::toJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const
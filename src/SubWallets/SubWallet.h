@@ -14,6 +14,8 @@
 
 #include <string>
 
+#include <unordered_map>
+
 #include <unordered_set>
 
 #include "WalletTypes.h"
@@ -76,6 +78,10 @@ class SubWallet
 
         bool hasKeyImage(const Crypto::KeyImage keyImage) const;
 
+        /* Gets the key images of the unspent and locked inputs, i.e. the
+           ones which we would see being spent in a transaction */
+        std::vector<Crypto::KeyImage> getKeyImages() const;
+
         Crypto::PublicKey publicSpendKey() const;
         
         Crypto::SecretKey privateSpendKey() const;
@@ -111,6 +117,33 @@ class SubWallet
 
     private:
 
+        //////////////////////////////
+        /* Private member functions */
+        //////////////////////////////
+
+        /* Adds the input to the end of the vector, and records its position
+           in the slot index */
+        static void addInput(
+            std::vector<WalletTypes::TransactionInput> &inputs,
+            std::unordered_map<Crypto::KeyImage, size_t> &slots,
+            const WalletTypes::TransactionInput &input);
+
+        /* Removes the input at the given position by swapping the last input
+           into its place - order doesn't matter, inputs are shuffled before
+           use */
+        static void removeInput(
+            std::vector<WalletTypes::TransactionInput> &inputs,
+            std::unordered_map<Crypto::KeyImage, size_t> &slots,
+            const size_t slot);
+
+        /* Regenerates the slot indexes after the input vectors have been
+           modified in bulk */
+        void rebuildInputSlots();
+
+        //////////////////////////////
+        /* Private member variables */
+        //////////////////////////////
+
         /* A vector of the stored transaction input data, to be used for
            sending transactions later */
         std::vector<WalletTypes::TransactionInput> m_unspentInputs;
@@ -119,6 +152,13 @@ class SubWallet
            either be put into a block, or return to our wallet */
         std::vector<WalletTypes::TransactionInput> m_lockedInputs;
 
+        /* The position of each key image in m_unspentInputs and
+           m_lockedInputs, so we don't have to search them. View wallets
+           can't generate key images, so their inputs aren't indexed. */
+        std::unordered_map<Crypto::KeyImage, size_t> m_unspentInputSlots;
+
+        std::unordered_map<Crypto::KeyImage, size_t> m_lockedInputSlots;
+
         /* Inputs which have been spent in a transaction */
         std::vector<WalletTypes::TransactionInput> m_spentInputs;
 
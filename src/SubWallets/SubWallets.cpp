@@ -76,7 +76,10 @@ SubWallets::SubWallets(
 /* Copy constructor */
 SubWallets::SubWallets(const SubWallets &other) :
     m_subWallets(other.m_subWallets),
+    m_keyImageOwners(other.m_keyImageOwners),
     m_transactions(other.m_transactions),
+    m_transactionHashes(other.m_transactionHashes),
+    m_transactionsBySpendKey(other.m_transactionsBySpendKey),
     m_lockedTransactions(other.m_lockedTransactions),
     m_privateViewKey(other.m_privateViewKey),
     m_isViewWallet(other.m_isViewWallet),
@@ -99,6 +102,8 @@ std::tuple<Error, std::string, Crypto::SecretKey> SubWallets::addSubWallet()
 
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     CryptoNote::KeyPair spendKey;
 
     /* Generate a spend key */
@@ -134,6 +139,8 @@ std::tuple<Error, std::string> SubWallets::importSubWallet(
 
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     Crypto::PublicKey publicSpendKey;
 
     Crypto::secret_key_to_public_key(privateSpendKey, publicSpendKey);
@@ -173,6 +180,8 @@ std::tuple<Error, std::string> SubWallets::importViewSubWallet(
 
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     if (m_subWallets.find(publicSpendKey) != m_subWallets.end())
     {
         return {SUBWALLET_ALREADY_EXISTS, std::string()};
@@ -203,6 +212,8 @@ Error SubWallets::deleteSubWallet(const std::string address)
 {
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     const auto [spendKey, viewKey] = Utilities::addressToKeys(address);
 
     const auto it = m_subWallets.find(spendKey);
@@ -220,10 +231,15 @@ Error SubWallets::deleteSubWallet(const std::string address)
 
     m_subWallets.erase(it);
 
+    /* Drop the deleted subwallets key images */
+    rebuildKeyImageOwners();
+
     /* Remove or update the transactions */
     deleteAddressTransactions(m_transactions, spendKey);
     deleteAddressTransactions(m_lockedTransactions, spendKey);
 
+    rebuildTransactionIndexes();
+
     const auto it2 = std::remove(m_publicSpendKeys.begin(), m_publicSpendKeys.end(), spendKey);
 
     if (it2 != m_publicSpendKeys.end())
@@ -267,6 +283,59 @@ void SubWallets::deleteAddressTransactions(
     }
 }
 
+size_t SubWallets::firstTransactionAtHeight(const uint64_t height) const
+{
+    const auto it = std::lower_bound(m_transactions.begin(), m_transactions.end(), height,
+    [](const auto &tx, const uint64_t h)
+    {
+        return tx.blockHeight < h;
+    });
+
+    return it - m_transactions.begin();
+}
+
+void SubWallets::indexTransaction(const size_t index)
+{
+    const auto &tx = m_transactions[index];
+
+    m_transactionHashes.insert(tx.hash);
+
+    for (const auto &[publicKey, amount] : tx.transfers)
+    {
+        m_transactionsBySpendKey[publicKey].push_back(index);
+    }
+}
+
+void SubWallets::rebuildTransactionIndexes()
+{
+    m_transactionHashes.clear();
+    m_transactionsBySpendKey.clear();
+
+    for (size_t i = 0; i < m_transactions.size(); i++)
+    {
+        indexTransaction(i);
+    }
+}
+
+void SubWallets::rebuildKeyImageOwners()
+{
+    m_keyImageOwners.clear();
+
+    /* View wallets can't generate key images */
+    if (m_isViewWallet)
+    {
+        return;
+    }
+
+    for (const auto &[publicKey, subWallet] : m_subWallets)
+    {
+        for (const auto &keyImage : subWallet.getKeyImages())
+        {
+            m_keyImageOwners[keyImage] = publicKey;
+        }
+    }
+}
+
 /* Gets the starting height, and timestamp to begin the sync from. Only one of
    these will be non zero, which will the the lowest one (ignoring null values).
 
@@ -323,6 +392,8 @@ void SubWallets::addUnconfirmedTransaction(const WalletTypes::Transaction tx)
 {
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     const auto it2 = std::find_if(m_lockedTransactions.begin(), m_lockedTransactions.end(),
     [tx](const auto transaction)
     {
@@ -361,13 +432,7 @@ void SubWallets::addTransaction(const WalletTypes::Transaction tx)
         m_lockedTransactions.erase(it, m_lockedTransactions.end());
     }
 
-    const auto it2 = std::find_if(m_transactions.begin(), m_transactions.end(),
-    [tx](const auto transaction)
-    {
-        return tx.hash == transaction.hash;
-    });
-
-    if (it2 != m_transactions.end())
+    if (m_transactionHashes.find(tx.hash) != m_transactionHashes.end())
     {
         std::stringstream stream;
 
@@ -376,7 +441,20 @@ void SubWallets::addTransaction(const WalletTypes::Transaction tx)
         throw std::runtime_error(stream.str());
     }
 
-    m_transactions.push_back(tx);
+    /* Blocks are processed in order, so this is nearly always an append */
+    if (m_transactions.empty() || m_transactions.back().blockHeight <= tx.blockHeight)
+    {
+        m_transactions.push_back(tx);
+        indexTransaction(m_transactions.size() - 1);
+    }
+    else
+    {
+        m_transactions.insert(
+            m_transactions.begin() + firstTransactionAtHeight(tx.blockHeight + 1), tx
+        );
+
+        rebuildTransactionIndexes();
+    }
 }
 
 Crypto::KeyImage SubWallets::getTxInputKeyImage(
@@ -411,6 +489,12 @@ void SubWallets::storeTransactionInput(
     /* Check it exists */
     if (it != m_subWallets.end())
     {
+        /* View wallets can't generate key images, so can't see spends */
+        if (!m_isViewWallet)
+        {
+            m_keyImageOwners[input.keyImage] = publicSpendKey;
+        }
+
         /* If we have a view wallet, don't attempt to derive the key image */
         return it->second.storeTransactionInput(input, m_isViewWallet);
     }
@@ -429,12 +513,11 @@ std::tuple<bool, Crypto::PublicKey>
 
     std::scoped_lock lock(m_mutex);
 
-    for (const auto & [publicKey, subWallet] : m_subWallets)
+    const auto it = m_keyImageOwners.find(keyImage);
+
+    if (it != m_keyImageOwners.end())
     {
-        if (subWallet.hasKeyImage(keyImage))
-        {
-            return {true, subWallet.publicSpendKey()};
-        }
+        return {true, it->second};
     }
 
     return {false, Crypto::PublicKey()};
@@ -712,6 +795,9 @@ void SubWallets::markInputAsSpent(
     std::scoped_lock lock(m_mutex);
 
     m_subWallets.at(publicKey).markInputAsSpent(keyImage, spendHeight);
+
+    /* Spent inputs can't show up in another transaction */
+    m_keyImageOwners.erase(keyImage);
 }
 
 /* Mark a key image as locked, can no longer be used in transactions till it
@@ -726,6 +812,8 @@ void SubWallets::markInputAsLocked(
 
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     m_subWallets.at(publicKey).markInputAsLocked(keyImage);
 }
 
@@ -734,16 +822,25 @@ void SubWallets::removeForkedTransactions(uint64_t forkHeight)
 {
     std::scoped_lock lock(m_mutex);
 
-    const auto it = std::remove_if(m_transactions.begin(), m_transactions.end(),
-    [forkHeight](auto tx)
+    m_nonSyncChanges = true;
+
+    /* Transactions are sorted by height, so the forked ones are all at
+       the end */
+    const size_t firstForked = firstTransactionAtHeight(forkHeight);
+
+    for (size_t i = firstForked; i < m_transactions.size(); i++)
     {
-        /* Remove the transaction if it's height is >= than the fork height */
-        return tx.blockHeight >= forkHeight;
-    });
+        m_transactionHashes.erase(m_transactions[i].hash);
+    }
+
+    m_transactions.erase(m_transactions.begin() + firstForked, m_transactions.end());
 
-    if (it != m_transactions.end())
+    for (auto &[publicKey, indexes] : m_transactionsBySpendKey)
     {
-        m_transactions.erase(it, m_transactions.end());
+        while (!indexes.empty() && indexes.back() >= firstForked)
+        {
+            indexes.pop_back();
+        }
     }
 
     /* Loop through each subwallet */
@@ -751,6 +848,10 @@ void SubWallets::removeForkedTransactions(uint64_t forkHeight)
     {
         subWallet.removeForkedInputs(forkHeight);
     }
+
+    /* Inputs received after the fork are gone, and inputs spent after the
+       fork are unspent again */
+    rebuildKeyImageOwners();
 }
 
 void SubWallets::removeCancelledTransactions(
@@ -761,6 +862,8 @@ void SubWallets::removeCancelledTransactions(
 
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     /* Find any cancelled transactions */
     const auto it = std::remove_if(m_lockedTransactions.begin(), m_lockedTransactions.end(),
     [&cancelledTransactions](const auto &tx)
@@ -834,9 +937,14 @@ void SubWallets::reset(const uint64_t scanHeight)
 {
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     m_lockedTransactions.clear();
     m_transactions.clear();
+    m_transactionHashes.clear();
+    m_transactionsBySpendKey.clear();
     m_transactionPrivateKeys.clear();
+    m_keyImageOwners.clear();
 
     for (auto &[pubKey, subWallet] : m_subWallets)
     {
@@ -879,6 +987,52 @@ std::vector<WalletTypes::Transaction> SubWallets::getTransactions() const
     return m_transactions;
 }
 
+std::vector<WalletTypes::Transaction> SubWallets::getTransactionsRange(
+    const uint64_t startHeight,
+    const uint64_t endHeight) const
+{
+    std::scoped_lock lock(m_mutex);
+
+    const size_t first = firstTransactionAtHeight(startHeight);
+    const size_t last = std::max(first, firstTransactionAtHeight(endHeight));
+
+    return std::vector<WalletTypes::Transaction>(
+        m_transactions.begin() + first, m_transactions.begin() + last
+    );
+}
+
+std::vector<WalletTypes::Transaction> SubWallets::getTransactionsRange(
+    const uint64_t startHeight,
+    const uint64_t endHeight,
+    const Crypto::PublicKey publicSpendKey) const
+{
+    std::scoped_lock lock(m_mutex);
+
+    std::vector<WalletTypes::Transaction> result;
+
+    const auto it = m_transactionsBySpendKey.find(publicSpendKey);
+
+    if (it == m_transactionsBySpendKey.end())
+    {
+        return result;
+    }
+
+    const auto &indexes = it->second;
+
+    auto index = std::lower_bound(indexes.begin(), indexes.end(), startHeight,
+    [this](const size_t i, const uint64_t height)
+    {
+        return m_transactions[i].blockHeight < height;
+    });
+
+    for (; index != indexes.end() && m_transactions[*index].blockHeight < endHeight; ++index)
+    {
+        result.push_back(m_transactions[*index]);
+    }
+
+    return result;
+}
+
 /* Note that this DOES NOT return incoming transactions in the pool. It only
    returns outgoing transactions which we sent but have not encountered in a
    block yet. */
@@ -904,6 +1058,8 @@ void SubWallets::storeTxPrivateKey(
     const Crypto::SecretKey txPrivateKey,
     const Crypto::Hash txHash)
 {
+    m_nonSyncChanges = true;
+
     m_transactionPrivateKeys[txHash] = txPrivateKey;
 }
 
@@ -926,6 +1082,8 @@ void SubWallets::storeUnconfirmedIncomingInput(
 {
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     const auto it = m_subWallets.find(publicSpendKey);
 
     if (it != m_subWallets.end())
@@ -940,6 +1098,8 @@ void SubWallets::convertSyncTimestampToHeight(
 {
     std::scoped_lock lock(m_mutex);
 
+    m_nonSyncChanges = true;
+
     for (auto [pubKey, subWallet] : m_subWallets)
     {
         subWallet.convertSyncTimestampToHeight(timestamp, height);
@@ -961,6 +1121,16 @@ std::vector<std::tuple<std::string, uint64_t, uint64_t>> SubWallets::getBalances
     return balances;
 }
 
+bool SubWallets::takeNonSyncChanges()
+{
+    return m_nonSyncChanges.exchange(false);
+}
+
+void SubWallets::markNonSyncChanges()
+{
+    m_nonSyncChanges = true;
+}
+
 void SubWallets::fromJSON(const JSONObject &j)
 {
     for (const auto &x : getArrayFromJSON(j, "publicSpendKeys"))
@@ -988,9 +1158,18 @@ void SubWallets::fromJSON(const JSONObject &j)
     {
         WalletTypes::Transaction tx;
         tx.fromJSON(x);
-        m_transactions.push_back(tx);
+        m_lockedTransactions.push_back(tx);
     }
 
+    /* Should already be in order, as they are added as blocks are synced */
+    std::stable_sort(m_transactions.begin(), m_transactions.end(),
+    [](const auto &a, const auto &b)
+    {
+        return a.blockHeight < b.blockHeight;
+    });
+
+    rebuildTransactionIndexes();
+
     m_privateViewKey.fromString(getStringFromJSON(j, "privateViewKey"));
 
     m_isViewWallet = getBoolFromJSON(j, "isViewWallet");
@@ -1005,6 +1184,11 @@ void SubWallets::fromJSON(const JSONObject &j)
 
         m_transactionPrivateKeys[txHash] = privateKey;
     }
+
+    rebuildKeyImageOwners();
+
+    /* Nothing to save until something changes */
+    m_nonSyncChanges = false;
 }
 
 void SubWallets::toJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const
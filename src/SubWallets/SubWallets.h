@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include <crypto/crypto.h>
 
 #include <SubWallets/SubWallet.h>
@@ -159,6 +161,18 @@ class SubWallets
 
         std::vector<WalletTypes::Transaction> getTransactions() const;
 
+        /* Returns transactions in the range [startHeight, endHeight) */
+        std::vector<WalletTypes::Transaction> getTransactionsRange(
+            const uint64_t startHeight,
+            const uint64_t endHeight) const;
+
+        /* As above, but only those with a transfer to or from the given
+           subwallet */
+        std::vector<WalletTypes::Transaction> getTransactionsRange(
+            const uint64_t startHeight,
+            const uint64_t endHeight,
+            const Crypto::PublicKey publicSpendKey) const;
+
         /* Note that this DOES NOT return incoming transactions in the pool. It only
            returns outgoing transactions which we sent but have not encountered in a
            block yet. */
@@ -187,6 +201,16 @@ class SubWallets
         std::vector<std::tuple<std::string, uint64_t, uint64_t>> getBalances(
             const uint64_t currentHeight) const;
 
+        /* Whether anything other than scanning blocks (addTransaction,
+           storeTransactionInput and markInputAsSpent) has changed the
+           wallets since the last call. The wallet journal only holds the
+           changes from scanning blocks, so if so, the whole wallet needs
+           to be saved. */
+        bool takeNonSyncChanges();
+
+        /* Used if saving the whole wallet failed */
+        void markNonSyncChanges();
+
         /////////////////////////////
         /* Public member variables */
         /////////////////////////////
@@ -210,6 +234,21 @@ class SubWallets
             std::vector<WalletTypes::Transaction> &txs,
             const Crypto::PublicKey spendKey);
 
+        /* Regenerates m_keyImageOwners from the subwallets. Must be called
+           with the mutex held. */
+        void rebuildKeyImageOwners();
+
+        /* The index in m_transactions of the first transaction at or above
+           the given height. Must be called with the mutex held. */
+        size_t firstTransactionAtHeight(const uint64_t height) const;
+
+        /* Adds m_transactions[index] to the transaction indexes */
+        void indexTransaction(const size_t index);
+
+        /* Regenerates the transaction indexes, when m_transactions is changed
+           other than at the end. Must be called with the mutex held. */
+        void rebuildTransactionIndexes();
+
         //////////////////////////////
         /* Private member variables */
         //////////////////////////////
@@ -217,9 +256,22 @@ class SubWallets
         /* The subwallets, indexed by public spend key */ 
         std::unordered_map<Crypto::PublicKey, SubWallet> m_subWallets;
 
-        /* A vector of transactions */
+        /* The owner of each unspent or locked key image, so we can detect
+           outgoing transactions without asking every subwallet. Not stored
+           in the wallet file - rebuilt on load. */
+        std::unordered_map<Crypto::KeyImage, Crypto::PublicKey> m_keyImageOwners;
+
+        /* A vector of transactions, sorted by block height */
         std::vector<WalletTypes::Transaction> m_transactions;
 
+        /* The hashes of the transactions in m_transactions */
+        std::unordered_set<Crypto::Hash> m_transactionHashes;
+
+        /* The indexes in m_transactions of the transactions with a transfer
+           to or from each subwallet, in ascending order. Not stored in the
+           wallet file - rebuilt on load. */
+        std::unordered_map<Crypto::PublicKey, std::vector<size_t>> m_transactionsBySpendKey;
+
         /* Transactions which we sent, but haven't been added to a block yet */
         std::vector<WalletTypes::Transaction> m_lockedTransactions;
 
@@ -230,6 +282,10 @@ class SubWallets
         /* Transaction private keys of sent transactions, used for auditing */
         std::unordered_map<Crypto::Hash, Crypto::SecretKey> m_transactionPrivateKeys;
 
+        /* See takeNonSyncChanges(). Starts off set, as nothing has been
+           saved yet. */
+        std::atomic<bool> m_nonSyncChanges {true};
+
         /* Need a mutex for accessing inputs, transactions, and locked
            transactions, etc as these are modified on multiple threads */
         mutable std::mutex m_mutex;
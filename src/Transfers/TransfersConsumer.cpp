@@ -8,10 +8,11 @@
 #include "TransfersConsumer.h"
 
 #include <numeric>
-#include <future>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 #include "CommonTypes.h"
-#include "Common/BlockingQueue.h"
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/TransactionApi.h"
@@ -110,8 +111,8 @@ std::vector<Crypto::Hash> getBlockHashes(const CryptoNote::CompleteBlock* blocks
 
 namespace CryptoNote {
 
-TransfersConsumer::TransfersConsumer(const CryptoNote::Currency& currency, INode& node, std::shared_ptr<Logging::ILogger> logger, const SecretKey& viewSecret) :
-  m_node(node), m_viewSecret(viewSecret), m_currency(currency), m_logger(logger, "TransfersConsumer") {
+TransfersConsumer::TransfersConsumer(const CryptoNote::Currency& currency, INode& node, std::shared_ptr<Logging::ILogger> logger, const SecretKey& viewSecret, ThreadPool& workers) :
+  m_node(node), m_viewSecret(viewSecret), m_currency(currency), m_logger(logger, "TransfersConsumer"), m_workers(workers) {
   updateSyncStart();
 }
 
@@ -200,102 +201,126 @@ uint32_t TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t st
   assert(blocks);
   assert(count > 0);
 
+  const auto preprocessStart = std::chrono::steady_clock::now();
+
   struct Tx {
     TransactionBlockInfo blockInfo;
     const ITransactionReader* tx;
     bool isLastTransactionInBlock;
   };
 
-  struct PreprocessedTx : Tx, PreprocessInfo {};
+  /* Shared with the jobs posted to the pool. A job may only start after this
+     call returned, if the pool was busy, and then finds no chunks left. */
+  struct PreprocessBatch {
+    std::vector<Tx> transactions;
+    std::vector<PreprocessInfo> outputs;
+    size_t chunkSize;
+    size_t chunkCount;
+    std::atomic<size_t> nextChunk;
+    std::atomic<bool> stopProcessing;
+
+    std::mutex mutex;
+    std::condition_variable chunksDoneChanged;
+    size_t chunksDone;
+    std::error_code error;
+  };
 
-  std::vector<PreprocessedTx> preprocessedTransactions;
-  std::mutex preprocessedTransactionsMutex;
+  auto batch = std::make_shared<PreprocessBatch>();
+  batch->nextChunk = 0;
+  batch->stopProcessing = false;
+  batch->chunksDone = 0;
 
-  size_t workers = std::thread::hardware_concurrency();
-  if (workers == 0) {
-    workers = 2;
-  }
+  uint32_t emptyBlockCount = 0;
 
-  BlockingQueue<Tx> inputQueue(workers * 2);
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto& block = blocks[i].block;
 
-  std::atomic<bool> stopProcessing(false);
-  std::atomic<size_t> emptyBlockCount(0);
+    if (!block.is_initialized()) {
+      ++emptyBlockCount;
+      continue;
+    }
 
-  auto pushingThread = std::async(std::launch::async, [&] {
-    for( uint32_t i = 0; i < count && !stopProcessing; ++i) {
-      const auto& block = blocks[i].block;
+    // filter by syncStartTimestamp
+    if (m_syncStart.timestamp && block->timestamp < m_syncStart.timestamp) {
+      ++emptyBlockCount;
+      continue;
+    }
 
-      if (!block.is_initialized()) {
-        ++emptyBlockCount;
-        continue;
-      }
+    TransactionBlockInfo blockInfo;
+    blockInfo.height = startHeight + i;
+    blockInfo.timestamp = block->timestamp;
+    blockInfo.transactionIndex = 0; // position in block
 
-      // filter by syncStartTimestamp
-      if (m_syncStart.timestamp && block->timestamp < m_syncStart.timestamp) {
-        ++emptyBlockCount;
+    for (const auto& tx : blocks[i].transactions) {
+      auto pubKey = tx->getTransactionPublicKey();
+      if (pubKey == NULL_PUBLIC_KEY) {
+        ++blockInfo.transactionIndex;
         continue;
       }
 
-      TransactionBlockInfo blockInfo;
-      blockInfo.height = startHeight + i;
-      blockInfo.timestamp = block->timestamp;
-      blockInfo.transactionIndex = 0; // position in block
+      bool isLastTransactionInBlock = blockInfo.transactionIndex + 1 == blocks[i].transactions.size();
+      batch->transactions.push_back({ blockInfo, tx.get(), isLastTransactionInBlock });
+      ++blockInfo.transactionIndex;
+    }
+  }
 
-      for (const auto& tx : blocks[i].transactions) {
-        auto pubKey = tx->getTransactionPublicKey();
-        if (pubKey == NULL_PUBLIC_KEY) {
-          ++blockInfo.transactionIndex;
-          continue;
+  /* Transactions go out in chunks, a few per thread, so that threads which
+     finish early take over the rest of the work */
+  const size_t threads = m_workers.getThreadCount() + 1;
+  batch->outputs.resize(batch->transactions.size());
+  batch->chunkSize = std::max<size_t>(1, (batch->transactions.size() + threads * 4 - 1) / (threads * 4));
+  batch->chunkCount = (batch->transactions.size() + batch->chunkSize - 1) / batch->chunkSize;
+
+  auto processChunks = [this](PreprocessBatch& batch) {
+    size_t chunk;
+    while ((chunk = batch.nextChunk++) < batch.chunkCount) {
+      std::error_code ec;
+
+      const size_t end = std::min(batch.transactions.size(), (chunk + 1) * batch.chunkSize);
+      for (size_t i = chunk * batch.chunkSize; i < end && !batch.stopProcessing; ++i) {
+        try {
+          ec = preprocessOutputs(batch.transactions[i].blockInfo, *batch.transactions[i].tx, batch.outputs[i]);
+        } catch (const std::system_error& e) {
+          ec = e.code();
+        } catch (const std::exception&) {
+          ec = std::make_error_code(std::errc::operation_canceled);
         }
 
-        bool isLastTransactionInBlock = blockInfo.transactionIndex + 1 == blocks[i].transactions.size();
-        Tx item = { blockInfo, tx.get(), isLastTransactionInBlock };
-        inputQueue.push(item);
-        ++blockInfo.transactionIndex;
+        if (ec) {
+          batch.stopProcessing = true;
+        }
       }
-    }
-
-    inputQueue.close();
-  });
 
-  auto processingFunction = [&] {
-    Tx item;
-    std::error_code ec;
-    while (!stopProcessing && inputQueue.pop(item)) {
-      PreprocessedTx output;
-      static_cast<Tx&>(output) = item;
-
-      ec = preprocessOutputs(item.blockInfo, *item.tx, output);
-      if (ec) {
-        stopProcessing = true;
-        break;
+      std::lock_guard<std::mutex> lock(batch.mutex);
+      if (ec && !batch.error) {
+        batch.error = ec;
       }
 
-      std::lock_guard<std::mutex> lk(preprocessedTransactionsMutex);
-      preprocessedTransactions.push_back(std::move(output));
+      if (++batch.chunksDone == batch.chunkCount) {
+        batch.chunksDoneChanged.notify_all();
+      }
     }
-    return ec;
   };
 
-  std::vector<std::future<std::error_code>> processingThreads;
-  for (size_t i = 0; i < workers; ++i) {
-    processingThreads.push_back(std::async(std::launch::async, processingFunction));
+  for (size_t i = 1; i < std::min(threads, batch->chunkCount); ++i) {
+    m_workers.post([batch, processChunks] {
+      processChunks(*batch);
+    });
   }
 
+  /* This thread works on the batch as well, so it never waits on jobs
+     queued behind those of the other consumers */
+  processChunks(*batch);
+
   std::error_code processingError;
-  for (auto& f : processingThreads) {
-    try {
-      std::error_code ec = f.get();
-      if (!processingError && ec) {
-        processingError = ec;
-      }
-    } catch (const std::system_error& e) {
-      processingError = e.code();
-    } catch (const std::exception&) {
-      processingError = std::make_error_code(std::errc::operation_canceled);
-    }
+  {
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->chunksDoneChanged.wait(lock, [&batch] { return batch->chunksDone == batch->chunkCount; });
+    processingError = batch->error;
   }
 
+  const auto processStart = std::chrono::steady_clock::now();
+
   if (processingError) {
     forEachSubscription([&](TransfersSubscription& sub) {
       sub.onError(processingError, startHeight);
@@ -307,20 +332,19 @@ uint32_t TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t st
   std::vector<Crypto::Hash> blockHashes = getBlockHashes(blocks, count);
   m_observerManager.notify(&IBlockchainConsumerObserver::onBlocksAdded, this, blockHashes);
 
-  // sort by block height and transaction index in block
-  std::sort(preprocessedTransactions.begin(), preprocessedTransactions.end(), [](const PreprocessedTx& a, const PreprocessedTx& b) {
-    return std::tie(a.blockInfo.height, a.blockInfo.transactionIndex) < std::tie(b.blockInfo.height, b.blockInfo.transactionIndex);
-  });
-
-  uint32_t processedBlockCount = static_cast<uint32_t>(emptyBlockCount);
+  /* The outputs are stored by position, so they are in block order already */
+  uint32_t processedBlockCount = emptyBlockCount;
   try {
-    for (const auto& tx : preprocessedTransactions) {
-      processTransaction(tx.blockInfo, *tx.tx, tx);
+    for (size_t i = 0; i < batch->transactions.size(); ++i) {
+      const Tx& tx = batch->transactions[i];
+      processTransaction(tx.blockInfo, *tx.tx, batch->outputs[i]);
 
       if (tx.isLastTransactionInBlock) {
         ++processedBlockCount;
-        m_logger(TRACE) << "Processed block " << processedBlockCount << " of " << count << ", last processed block index " << tx.blockInfo.height <<
-            ", hash " << blocks[processedBlockCount - 1].blockHash;
+        m_logger.log(TRACE, [&](std::ostream& message) {
+          message << "Processed block " << processedBlockCount << " of " << count << ", last processed block index " << tx.blockInfo.height <<
+              ", hash " << blocks[processedBlockCount - 1].blockHash;
+        });
 
         auto newHeight = startHeight + processedBlockCount - 1;
         forEachSubscription([newHeight](TransfersSubscription& sub) {
@@ -352,6 +376,21 @@ uint32_t TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t st
     });
   }
 
+  const auto processEnd = std::chrono::steady_clock::now();
+  const auto preprocessTime = std::chrono::duration_cast<std::chrono::microseconds>(processStart - preprocessStart);
+  const auto processTime = std::chrono::duration_cast<std::chrono::microseconds>(processEnd - processStart);
+
+  ++m_statistics.batches;
+  m_statistics.blocks += count;
+  m_statistics.transactions += batch->transactions.size();
+  m_statistics.preprocessTime += preprocessTime;
+  m_statistics.processTime += processTime;
+
+  m_logger(DEBUGGING) << "Batch of " << count << " blocks, " << batch->transactions.size() << " transactions in " <<
+    batch->chunkCount << " chunks: preprocessed in " << preprocessTime.count() << " us, processed in " << processTime.count() <<
+    " us. Total " << m_statistics.batches << " batches, " << m_statistics.blocks << " blocks, preprocessing " <<
+    m_statistics.preprocessTime.count() << " us, processing " << m_statistics.processTime.count() << " us";
+
   return processedBlockCount;
 }
 
@@ -554,7 +593,9 @@ void TransfersConsumer::processTransaction(const TransactionBlockInfo& blockInfo
   std::vector<TransactionOutputInformationIn> emptyOutputs;
   std::vector<ITransfersContainer*> transactionContainers;
 
-  m_logger(TRACE) << "Process transaction, block " << blockInfo.height << ", transaction index " << blockInfo.transactionIndex << ", hash " << tx.getTransactionHash();
+  m_logger.log(TRACE, [&](std::ostream& message) {
+    message << "Process transaction, block " << blockInfo.height << ", transaction index " << blockInfo.transactionIndex << ", hash " << tx.getTransactionHash();
+  });
   bool someContainerUpdated = false;
   for (auto& kv : m_subscriptions) {
     auto it = info.outputs.find(kv.first);
@@ -570,10 +611,14 @@ void TransfersConsumer::processTransaction(const TransactionBlockInfo& blockInfo
   }
 
   if (someContainerUpdated) {
-    m_logger(TRACE) << "Transaction updated some containers, hash " << tx.getTransactionHash();
+    m_logger.log(TRACE, [&](std::ostream& message) {
+      message << "Transaction updated some containers, hash " << tx.getTransactionHash();
+    });
     m_observerManager.notify(&IBlockchainConsumerObserver::onTransactionUpdated, this, tx.getTransactionHash(), transactionContainers);
   } else {
-    m_logger(TRACE) << "Transaction doesn't updated any container, hash " << tx.getTransactionHash();
+    m_logger.log(TRACE, [&](std::ostream& message) {
+      message << "Transaction doesn't updated any container, hash " << tx.getTransactionHash();
+    });
   }
 }
 
@@ -13,10 +13,12 @@
 #include "TypeHelpers.h"
 
 #include "crypto/crypto.h"
+#include "Common/ThreadPool.h"
 #include "Logging/LoggerRef.h"
 
 #include "IObservableImpl.h"
 
+#include <chrono>
 #include <unordered_set>
 
 namespace CryptoNote {
@@ -26,7 +28,9 @@ class INode;
 class TransfersConsumer: public IObservableImpl<IBlockchainConsumerObserver, IBlockchainConsumer> {
 public:
 
-  TransfersConsumer(const CryptoNote::Currency& currency, INode& node, std::shared_ptr<Logging::ILogger> logger, const Crypto::SecretKey& viewSecret);
+  /* The workers preprocess the outputs of new blocks, they are shared by all
+     the consumers of a TransfersSyncronizer */
+  TransfersConsumer(const CryptoNote::Currency& currency, INode& node, std::shared_ptr<Logging::ILogger> logger, const Crypto::SecretKey& viewSecret, Common::ThreadPool& workers);
 
   ITransfersSubscription& addSubscription(const AccountSubscription& subscription);
   // returns true if no subscribers left
@@ -71,6 +75,15 @@ private:
 
   void updateSyncStart();
 
+  /* Totals over the batches passed to onNewBlocks, logged after each one */
+  struct Statistics {
+    uint64_t batches = 0;
+    uint64_t blocks = 0;
+    uint64_t transactions = 0;
+    std::chrono::microseconds preprocessTime{0};
+    std::chrono::microseconds processTime{0};
+  };
+
   SynchronizationStart m_syncStart;
   const Crypto::SecretKey m_viewSecret;
   // map { spend public key -> subscription }
@@ -81,6 +94,8 @@ private:
   INode& m_node;
   const CryptoNote::Currency& m_currency;
   Logging::LoggerRef m_logger;
+  Common::ThreadPool& m_workers;
+  Statistics m_statistics;
 };
 
 }
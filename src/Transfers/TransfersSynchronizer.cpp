@@ -8,6 +8,8 @@
 #include "TransfersSynchronizer.h"
 #include "TransfersConsumer.h"
 
+#include <thread>
+
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
@@ -21,8 +23,18 @@ namespace CryptoNote {
 
 const uint32_t TRANSFERS_STORAGE_ARCHIVE_VERSION = 0;
 
+namespace {
+
+size_t getWorkerCount() {
+  /* The thread calling onNewBlocks does its share of the work too */
+  const size_t threads = std::thread::hardware_concurrency();
+  return threads > 1 ? threads - 1 : 1;
+}
+
+}
+
 TransfersSyncronizer::TransfersSyncronizer(const CryptoNote::Currency& currency, std::shared_ptr<Logging::ILogger> logger, IBlockchainSynchronizer& sync, INode& node) :
-  m_currency(currency), m_logger(logger, "TransfersSyncronizer"), m_sync(sync), m_node(node) {
+  m_currency(currency), m_logger(logger, "TransfersSyncronizer"), m_workers(getWorkerCount()), m_sync(sync), m_node(node) {
 }
 
 TransfersSyncronizer::~TransfersSyncronizer() {
@@ -43,7 +55,7 @@ ITransfersSubscription& TransfersSyncronizer::addSubscription(const AccountSubsc
 
   if (it == m_consumers.end()) {
     std::unique_ptr<TransfersConsumer> consumer(
-      new TransfersConsumer(m_currency, m_node, m_logger.getLogger(), acc.keys.viewSecretKey));
+      new TransfersConsumer(m_currency, m_node, m_logger.getLogger(), acc.keys.viewSecretKey, m_workers));
 
     m_sync.addConsumer(consumer.get());
     consumer->addObserver(this);
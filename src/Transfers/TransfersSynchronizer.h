@@ -8,6 +8,7 @@
 #pragma once
 
 #include "Common/ObserverManager.h"
+#include "Common/ThreadPool.h"
 #include "ITransfersSynchronizer.h"
 #include "IBlockchainSynchronizer.h"
 #include "TypeHelpers.h"
@@ -53,6 +54,11 @@ public:
 private:
   Logging::LoggerRef m_logger;
 
+  /* Shared by the consumers, so syncing many containers doesn't start a set
+     of threads per consumer and batch. Declared before them, as they hold a
+     reference to it. */
+  Common::ThreadPool m_workers;
+
   // map { view public key -> consumer }
   typedef std::unordered_map<Crypto::PublicKey, std::unique_ptr<TransfersConsumer>> ConsumersContainer;
   ConsumersContainer m_consumers;
@@ -36,11 +36,13 @@ ApiDispatcher::ApiDispatcher(
     const uint16_t bindPort,
     const std::string rpcBindIp,
     const std::string rpcPassword,
-    const std::string corsHeader) :
+    const std::string corsHeader,
+    const uint32_t scanThreads) :
     m_port(bindPort),
     m_host(rpcBindIp),
     m_corsHeader(corsHeader),
-    m_rpcPassword(rpcPassword)
+    m_rpcPassword(rpcPassword),
+    m_scanThreads(scanThreads)
 {
     /* Generate the salt used for pbkdf2 api authentication */
     Random::randomBytes(16, m_salt);
@@ -381,6 +383,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::openWallet(
         filename, password, daemonHost, daemonPort
     );
 
+    if (!error)
+    {
+        m_walletBackend->setSyncThreadCount(m_scanThreads);
+    }
+
     return {error, 200};
 }
 
@@ -410,6 +417,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::keyImportWallet(
         daemonHost, daemonPort
     );
 
+    if (!error)
+    {
+        m_walletBackend->setSyncThreadCount(m_scanThreads);
+    }
+
     return {error, 200};
 }
 
@@ -437,6 +449,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::seedImportWallet(
         mnemonicSeed, filename, password, scanHeight, daemonHost, daemonPort
     );
 
+    if (!error)
+    {
+        m_walletBackend->setSyncThreadCount(m_scanThreads);
+    }
+
     return {error, 200};
 }
 
@@ -465,7 +482,12 @@ std::tuple<Error, uint16_t> ApiDispatcher::importViewWallet(
         privateViewKey, address, filename, password, scanHeight,
         daemonHost, daemonPort
     );
-    
+
+    if (!error)
+    {
+        m_walletBackend->setSyncThreadCount(m_scanThreads);
+    }
+
     return {error, 200};
 }
 
@@ -484,6 +506,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::createWallet(
         filename, password, daemonHost, daemonPort
     );
 
+    if (!error)
+    {
+        m_walletBackend->setSyncThreadCount(m_scanThreads);
+    }
+
     return {error, 200};
 }
 
@@ -1254,30 +1281,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightWithAddress(
         uint64_t startHeight = std::stoull(startHeightStr);
 
         const auto txs = m_walletBackend->getTransactionsRange(
-            startHeight, startHeight + 1000
+            startHeight, startHeight + 1000, address
         );
 
-        std::vector<WalletTypes::Transaction> result;
-
-        std::copy_if(txs.begin(), txs.end(), std::back_inserter(result),
-        [address, this](const auto tx)
-        {
-            for (const auto [key, transfer] : tx.transfers)
-            {
-                const auto [error, actualAddress] = m_walletBackend->getAddress(key);
-
-                /* If the transfer contains our address, keep it, else skip */
-                if (actualAddress == address)
-                {
-                    return true;
-                }
-            }
-
-            return false;
-        });
-
         nlohmann::json j {
-            {"transactions", result}
+            {"transactions", txs}
         };
 
         publicKeysToAddresses(j);
@@ -1337,30 +1345,11 @@ std::tuple<Error, uint16_t> ApiDispatcher::getTransactionsFromHeightToHeightWith
         }
 
         const auto txs = m_walletBackend->getTransactionsRange(
-            startHeight, endHeight
+            startHeight, endHeight, address
         );
 
-        std::vector<WalletTypes::Transaction> result;
-
-        std::copy_if(txs.begin(), txs.end(), std::back_inserter(result),
-        [address, this](const auto tx)
-        {
-            for (const auto [key, transfer] : tx.transfers)
-            {
-                const auto [error, actualAddress] = m_walletBackend->getAddress(key);
-
-                /* If the transfer contains our address, keep it, else skip */
-                if (actualAddress == address)
-                {
-                    return true;
-                }
-            }
-
-            return false;
-        });
-
         nlohmann::json j {
-            {"transactions", result}
+            {"transactions", txs}
         };
 
         publicKeysToAddresses(j);
@@ -54,7 +54,8 @@ class ApiDispatcher
             const uint16_t bindPort,
             const std::string rpcBindIp,
             const std::string rpcPassword,
-            std::string corsHeader);
+            std::string corsHeader,
+            const uint32_t scanThreads);
 
         /////////////////////////////
         /* Public member functions */
@@ -376,6 +377,9 @@ class ApiDispatcher
            header is not added. */
         std::string m_corsHeader;
 
+        /* How many threads opened wallets use to scan blocks */
+        uint32_t m_scanThreads;
+
         /* Used along with our password with pbkdf2 */
         CryptoPP::byte m_salt[16];
 };
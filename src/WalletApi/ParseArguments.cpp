@@ -12,6 +12,8 @@
 #include <config/CryptoNoteConfig.h>
 #include <config/WalletConfig.h>
 
+#include <thread>
+
 #include "version.h"
 
 Config parseArguments(int argc, char **argv)
@@ -43,6 +45,10 @@ Config parseArguments(int argc, char **argv)
 
         ("r,rpc-password", "Specify the <password> to access the RPC server.", cxxopts::value<std::string>(config.rpcPassword), "<password>");
 
+    options.add_options("Wallet")
+        ("scan-threads", "The number of threads to use when scanning blocks for transactions",
+        cxxopts::value<uint32_t>(config.scanThreads)->default_value(std::to_string(std::max(1u, std::thread::hardware_concurrency()))), "#");
+
     try
     {
         const auto result = options.parse(argc, argv);
@@ -73,6 +79,12 @@ Config parseArguments(int argc, char **argv)
         exit(0);
     }
 
+    if (config.scanThreads == 0)
+    {
+        std::cout << "Scan threads must be at least 1!" << std::endl;
+        exit(1);
+    }
+
     if (logLevel < Logger::DISABLED || logLevel > Logger::DEBUG)
     {
         std::cout << "Log level must be between " << Logger::DISABLED << " and " << Logger::DEBUG << "!" << std::endl;
@@ -24,6 +24,9 @@ struct Config
 
     /* Controls what level of messages to log */
     Logger::LogLevel logLevel = Logger::DISABLED;
+
+    /* How many threads to use when scanning blocks for transactions */
+    uint32_t scanThreads;
 };
 
 Config parseArguments(int argc, char **argv);
@@ -41,7 +41,7 @@ int main(int argc, char **argv)
         /* Init the API */
         api = std::make_shared<ApiDispatcher>(
             config.port, config.rpcBindIp, config.rpcPassword,
-            config.corsHeader
+            config.corsHeader, config.scanThreads
         );
 
         /* Launch the API */
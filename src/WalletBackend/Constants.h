@@ -30,10 +30,32 @@ namespace Constants
         0x79, 0x6f, 0x75, 0x2e
     }};
 
+    /* Follows IS_A_WALLET_IDENTIFIER in wallet files which store the AES
+       IV after the salt, rather than using the salt as the IV. These are
+       written with a fresh IV every save, so the key derived from the salt
+       can be reused for the whole session. */
+    const std::array<char, 16> SEPARATE_IV_IDENTIFIER =
+    {{
+        0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x77, 0x69,
+        0x74, 0x68, 0x20, 0x49, 0x56
+    }};
+
+    /* The start of the wallet journal file, which holds the blocks synced
+       since the wallet file was last written in full */
+    const std::array<char, 16> IS_A_WALLET_JOURNAL_IDENTIFIER =
+    {{
+        0x57, 0x61, 0x6c, 0x6c, 0x65, 0x74, 0x20, 0x6a, 0x6f, 0x75, 0x72,
+        0x6e, 0x61, 0x6c, 0x2e, 0x0a
+    }};
+
     /* The number of iterations of PBKDF2 to perform on the wallet
        password. */
     const uint64_t PBKDF2_ITERATIONS = 500000;
 
+    /* The journal is folded back into the wallet file once it is larger
+       than this, and larger than half of the wallet file */
+    const uint64_t MIN_JOURNAL_COMPACTION_SIZE = 1024 * 1024;
+
     /* What version of the file format are we on (to make it easier to
        upgrade the wallet format in the future) */
     const uint16_t WALLET_FILE_FORMAT_VERSION = 0;
@@ -60,6 +82,17 @@ namespace Constants
        amount. */
     const uint32_t MAXIMUM_SYNC_QUEUE_SIZE = 1000;
 
+    /* The maximum amount of downloaded batches of blocks we can have waiting
+       to be processed. The block downloader fetches the next batch whilst
+       the current one is being scanned, and waits once this many are
+       queued. */
+    const uint32_t MAXIMUM_SYNC_BATCH_QUEUE_SIZE = 4;
+
+    /* How many blocks to ask the daemon for in each sync request. Older
+       daemons cap this at 100, newer ones at their own limit, and both may
+       return fewer if the blocks are large. */
+    const uint64_t SYNC_DATA_BLOCK_COUNT = 1000;
+
     /* Handy if we don't want to use a secret key (for example, for view wallets)
        and want to make it explicit that this is uninitialized. */
     const Crypto::SecretKey BLANK_SECRET_KEY = Crypto::SecretKey({
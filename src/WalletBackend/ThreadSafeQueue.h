@@ -8,7 +8,7 @@
 
 #include <mutex>
 
-#include <queue>
+#include <deque>
 
 #include <WalletBackend/Constants.h>
 
@@ -17,12 +17,22 @@ class ThreadSafeQueue
 {
     public:
         ThreadSafeQueue() :
-            m_shouldStop(false)
+            m_shouldStop(false),
+            m_maxSize(Constants::MAXIMUM_SYNC_QUEUE_SIZE)
         {
         }
 
         ThreadSafeQueue(bool startStopped) :
-            m_shouldStop(startStopped)
+            m_shouldStop(startStopped),
+            m_maxSize(Constants::MAXIMUM_SYNC_QUEUE_SIZE)
+        {
+        }
+
+        /* Bound the queue to a different amount of items - push() blocks
+           whilst the queue holds maxSize items */
+        ThreadSafeQueue(bool startStopped, size_t maxSize) :
+            m_shouldStop(startStopped),
+            m_maxSize(maxSize)
         {
         }
 
@@ -37,7 +47,7 @@ class ThreadSafeQueue
                 return false;
             }
 
-            if (m_queue.size() >= Constants::MAXIMUM_SYNC_QUEUE_SIZE)
+            if (m_queue.size() >= m_maxSize)
             {
                 m_consumedBlock.wait(lock, [&]
                 {
@@ -49,12 +59,12 @@ class ThreadSafeQueue
 
                     /* Wait for the queue size to fall below the maximum size
                        before pushing our data */
-                    return m_queue.size() < Constants::MAXIMUM_SYNC_QUEUE_SIZE;
+                    return m_queue.size() < m_maxSize;
                 });
             }
 
-            /* Add the item to the front of the queue */
-            m_queue.push(item);
+            /* Add the item to the back of the queue */
+            m_queue.push_back(item);
 
             /* Unlock the mutex before notifying, so it doesn't block after
                waking up */
@@ -86,7 +96,7 @@ class ThreadSafeQueue
             }
 
             /* Remove the first item from the queue */
-            m_queue.pop();
+            m_queue.pop_front();
 
             /* Unlock the mutex before notifying, so it doesn't block after
                waking up */
@@ -94,6 +104,41 @@ class ThreadSafeQueue
 
             m_consumedBlock.notify_all();
         }
+
+        /* Run func on every item currently in the queue, front to back.
+           Items it returns false for are removed. Lets a producer fix up
+           data it has queued but which hasn't been consumed yet. */
+        template <typename Func>
+        void filter(Func func)
+        {
+            /* Aquire the lock */
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            for (auto it = m_queue.begin(); it != m_queue.end();)
+            {
+                if (func(*it))
+                {
+                    it++;
+                }
+                else
+                {
+                    it = m_queue.erase(it);
+                }
+            }
+
+            /* Unlock the mutex before notifying, so it doesn't block after
+               waking up */
+            lock.unlock();
+
+            /* We may have made room for a producer */
+            m_consumedBlock.notify_all();
+        }
+
+        /* Remove every item from the queue */
+        void clear()
+        {
+            filter([](const T &) { return false; });
+        }
         
         T getFirstItem(bool removeFromQueue)
         {
@@ -133,7 +178,7 @@ class ThreadSafeQueue
             /* Remove the first item from the queue */
             if (removeFromQueue)
             {
-                m_queue.pop();
+                m_queue.pop_front();
             }
 
             /* Unlock the mutex before notifying, so it doesn't block after
@@ -183,7 +228,7 @@ class ThreadSafeQueue
 
     private:
         /* The deque data structure */
-        std::queue<T> m_queue;
+        std::deque<T> m_queue;
 
         /* The mutex, to ensure we have atomic access to the queue */
         std::mutex m_mutex;
@@ -196,4 +241,7 @@ class ThreadSafeQueue
 
         /* Whether we're stopping */
         std::atomic<bool> m_shouldStop;
+
+        /* The maximum amount of items to hold before push() blocks */
+        size_t m_maxSize;
 };
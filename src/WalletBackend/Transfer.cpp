@@ -430,25 +430,38 @@ void storeUnconfirmedIncomingInputs(
     const Crypto::PublicKey txPublicKey,
     const Crypto::Hash txHash)
 {
-    Crypto::KeyDerivation derivation;
+    std::vector<std::tuple<Crypto::PublicKey, Crypto::PublicKey, size_t>> outputKeys;
 
-    Crypto::generate_key_derivation(
-        txPublicKey, subWallets->getPrivateViewKey(), derivation
+    outputKeys.reserve(keyOutputs.size());
+
+    for (size_t outputIndex = 0; outputIndex < keyOutputs.size(); outputIndex++)
+    {
+        outputKeys.emplace_back(txPublicKey, keyOutputs[outputIndex].key, outputIndex);
+    }
+
+    std::vector<Crypto::KeyDerivation> derivations;
+    std::vector<Crypto::PublicKey> derivedSpendKeys;
+    std::vector<bool> valid;
+
+    Crypto::underive_public_keys(
+        subWallets->getPrivateViewKey(), outputKeys, derivations,
+        derivedSpendKeys, valid
     );
 
-    uint64_t outputIndex = 0;
+    const auto spendKeys = subWallets->m_publicSpendKeys;
 
-    for (const auto output : keyOutputs)
+    for (size_t outputIndex = 0; outputIndex < keyOutputs.size(); outputIndex++)
     {
-        Crypto::PublicKey spendKey;
-
         /* Not our output */
-        Crypto::underive_public_key(derivation, outputIndex, output.key, spendKey);
-
-        const auto spendKeys = subWallets->m_publicSpendKeys;
+        if (!valid[outputIndex])
+        {
+            continue;
+        }
 
         /* See if the derived spend key is one of ours */
-        const auto it = std::find(spendKeys.begin(), spendKeys.end(), spendKey);
+        const auto it = std::find(
+            spendKeys.begin(), spendKeys.end(), derivedSpendKeys[outputIndex]
+        );
 
         if (it != spendKeys.end())
         {
@@ -462,8 +475,6 @@ void storeUnconfirmedIncomingInputs(
 
             subWallets->storeUnconfirmedIncomingInput(input, ourSpendKey);
         }
-
-        outputIndex++;
     }
 }
 
@@ -11,19 +11,10 @@
 
 #include <config/CryptoNoteConfig.h>
 
-#include <crypto/random.h>
-
 #include <CryptoNoteCore/Account.h>
 #include <CryptoNoteCore/CryptoNoteTools.h>
 #include <CryptoNoteCore/CryptoNoteBasicImpl.h>
 
-#include <cryptopp/aes.h>
-#include <cryptopp/algparam.h>
-#include <cryptopp/filters.h>
-#include <cryptopp/modes.h>
-#include <cryptopp/sha.h>
-#include <cryptopp/pwdbased.h>
-
 #include <Errors/ValidateParameters.h>
 
 #include <fstream>
@@ -56,32 +47,6 @@ using namespace rapidjson;
 /* Anonymous namespace so it doesn't clash with anything else */
 namespace {
 
-/* Check data has the magic indicator from first : last, and remove it if
-   it does. Else, return an error depending on where we failed */
-template <class Buffer, class Identifier>
-Error hasMagicIdentifier(
-    Buffer &data,
-    const Identifier &identifier,
-    const Error tooSmallError,
-    const Error wrongIdentifierError)
-{
-    /* Check we've got space for the identifier */
-    if (data.size() < identifier.size())
-    {
-        return tooSmallError;
-    }
-
-    if (!std::equal(identifier.begin(), identifier.end(), data.begin()))
-    {
-        return wrongIdentifierError;
-    }
-
-    /* Remove the identifier from the string */
-    data.erase(data.begin(), data.begin() + identifier.size());
-
-    return SUCCESS;
-}
-
 /* Check the wallet filename for the new wallet to be created is valid */
 Error checkNewWalletFilename(std::string filename)
 {
@@ -143,6 +108,7 @@ WalletBackend::WalletBackend(
 
     m_filename(filename),
     m_password(password),
+    m_walletFile(std::make_unique<WalletFile>(filename, password)),
     m_daemon(std::make_shared<Nigel>(daemonHost, daemonPort))
 {
     /* Generate the address from the two private keys */
@@ -169,6 +135,7 @@ WalletBackend::WalletBackend(
 
     m_filename(filename),
     m_password(password),
+    m_walletFile(std::make_unique<WalletFile>(filename, password)),
     m_daemon(std::make_shared<Nigel>(daemonHost, daemonPort))
 {
     bool newWallet = false;
@@ -410,93 +377,12 @@ std::tuple<Error, std::shared_ptr<WalletBackend>> WalletBackend::openWallet(
     const std::string daemonHost,
     const uint16_t daemonPort)
 {
-    /* Open in binary mode, since we have encrypted data */
-    std::ifstream file(filename, std::ios_base::binary);
-
-    /* Check we successfully opened the file */
-    if (!file)
-    {
-        return {FILENAME_NON_EXISTENT, nullptr}; 
-    }
-
-    /* Read file into a buffer */
-    std::vector<char> buffer((std::istreambuf_iterator<char>(file)),
-                             (std::istreambuf_iterator<char>()));
-
-    /* Check that the decrypted data has the 'isAWallet' identifier,
-       and remove it it does. If it doesn't, return an error. */
-    Error error = hasMagicIdentifier(
-        buffer, Constants::IS_A_WALLET_IDENTIFIER,
-        NOT_A_WALLET_FILE, NOT_A_WALLET_FILE
-    );
+    /* Derives the key and decrypts the wallet - the slow part */
+    auto [error, walletFile, decryptedData] = WalletFile::open(filename, password);
 
     if (error)
     {
-        return {error, nullptr}; 
-    }
-
-    using namespace CryptoPP;
-
-    /* The salt we use for both PBKDF2, and AES decryption */
-    byte salt[16];
-
-    /* Check the file is large enough for the salt */
-    if (buffer.size() < sizeof(salt))
-    {
-        return {WALLET_FILE_CORRUPTED, nullptr};
-    }
-
-    /* Copy the salt to the salt array */
-    std::copy(buffer.begin(), buffer.begin() + sizeof(salt), salt);
-
-    /* Remove the salt, don't need it anymore */
-    buffer.erase(buffer.begin(), buffer.begin() + sizeof(salt));
-
-    /* The key we use for AES decryption, generated with PBKDF2 */
-    byte key[16];
-
-    /* Using SHA256 as the algorithm */
-    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
-
-    /* Generate the AES Key using pbkdf2 */
-    pbkdf2.DeriveKey(
-        key, sizeof(key), 0, (byte *)password.c_str(),
-        password.size(), salt, sizeof(salt), Constants::PBKDF2_ITERATIONS
-    );
-
-    CBC_Mode<AES>::Decryption cbcDecryption;
-
-    /* Initialize our decrypter with the key and salt/iv */
-    cbcDecryption.SetKeyWithIV(key, sizeof(key), salt);
-
-    /* This will store the decrypted data */
-    std::string decryptedData;
-
-    try
-    {
-        /* Decrypt, handling padding */
-        StringSource((byte *)buffer.data(), buffer.size(), true, new StreamTransformationFilter(
-            cbcDecryption, new StringSink(decryptedData))
-        );
-    }
-    /* do NOT report an alternate error for invalid padding. It allows them
-       to do a padding oracle attack, I believe. Just report the wrong password
-       error. */
-    catch (const CryptoPP::Exception &)
-    {
-        return {WRONG_PASSWORD, nullptr};
-    }
-
-    /* Check that the decrypted data has the 'isCorrectPassword' identifier,
-       and remove it it does. If it doesn't, return an error. */
-    error = hasMagicIdentifier(
-        decryptedData, Constants::IS_CORRECT_PASSWORD_IDENTIFIER,
-        WALLET_FILE_CORRUPTED, WRONG_PASSWORD
-    );
-
-    if (error)
-    {
-        return {error, nullptr}; 
+        return {error, nullptr};
     }
 
     try
@@ -520,6 +406,9 @@ std::tuple<Error, std::shared_ptr<WalletBackend>> WalletBackend::openWallet(
         /* Make our wallet object */
         const auto wallet = std::make_shared<WalletBackend>();
 
+        /* Keep the key for saving */
+        wallet->m_walletFile = std::move(walletFile);
+
         /* Initialize it from the json (We could do this in less steps, but it
            requires a move/copy constructor) */
         error = wallet->fromJSON(
@@ -575,6 +464,8 @@ void WalletBackend::init()
 
     m_walletSynchronizer->m_subWallets = m_subWallets;
 
+    m_walletSynchronizer->setThreadCount(m_syncThreadCount);
+
     /* Launch the wallet sync process in a background thread */
     m_walletSynchronizer->start();
 
@@ -594,80 +485,50 @@ Error WalletBackend::save() const
    blockchain synchronizer first (Call save()) */
 Error WalletBackend::unsafeSave() const
 {
-    /* Add an identifier to the start of the string so we can verify the wallet
-       has been correctly decrypted */
-    std::string identiferAsString(
-        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.begin(),
-        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.end()
-    );
-
-    /* Add magic identifier, and get wallet as a JSON string */
-    std::string walletData = identiferAsString + this->toJSON();
-
-    using namespace CryptoPP;
+    /* Anything other than syncing blocks changed the wallet, or the journal
+       has grown large enough to fold into the wallet file. Check the
+       subwallets first, so any change made whilst we're saving gets saved
+       next time. */
+    if (m_subWallets->takeNonSyncChanges() || m_walletFile->snapshotRequired())
+    {
+        Error error = m_walletFile->writeSnapshot(toJSON());
 
-    /* The key we use for AES encryption, generated with PBKDF2 */
-    byte key[16];
+        if (error)
+        {
+            m_subWallets->markNonSyncChanges();
 
-    /* The salt we use for both PBKDF2, and AES Encryption */
-    byte salt[16];
+            return error;
+        }
 
-    /* Generate 16 random bytes for the salt */
-    Random::randomBytes(16, salt);
+        m_walletSynchronizer->clearUnsavedBlocks();
 
-    /* Using SHA256 as the algorithm */
-    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
+        return SUCCESS;
+    }
 
-    /* Generate the AES Key using pbkdf2 */
-    pbkdf2.DeriveKey(
-        key, sizeof(key), 0, (byte *)m_password.c_str(),
-        m_password.size(), salt, sizeof(salt), Constants::PBKDF2_ITERATIONS
-    );
+    /* Otherwise just append the blocks synced since the last save */
+    if (!m_walletSynchronizer->hasUnsavedBlocks())
+    {
+        return SUCCESS;
+    }
 
-    CBC_Mode<AES>::Encryption cbcEncryption;
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
 
-    /* Initialize our encryptor with the key and salt/iv */
-    cbcEncryption.SetKeyWithIV(key, sizeof(key), salt);
+    writer.StartObject();
 
-    /* This will store the encrypted data */
-    std::string encryptedData;
+    writer.Key("walletSynchronizer");
+    m_walletSynchronizer->unsavedBlocksToJSON(writer);
 
-    /* Encrypt, and pad */
-    StringSource(walletData, true, new StreamTransformationFilter(
-        cbcEncryption, new StringSink(encryptedData))
-    );
+    writer.EndObject();
 
-    std::ofstream file(m_filename, std::ios_base::binary);
+    Error error = m_walletFile->appendToJournal(sb.GetString());
 
-    if (!file)
+    if (!error)
     {
-        Logger::logger.log(
-            std::string("Wallet filename: ") + m_filename + " is invalid",
-            Logger::FATAL,
-            {Logger::FILESYSTEM, Logger::SAVE}
-        );
-
-        return INVALID_WALLET_FILENAME;
+        m_walletSynchronizer->clearUnsavedBlocks();
     }
 
-    std::string saltString = std::string(salt, salt + sizeof(salt));
-
-    /* Write the isAWalletIdentifier to the file, so when we open it we can
-       verify that it is a wallet file */
-    std::copy(Constants::IS_A_WALLET_IDENTIFIER.begin(),
-              Constants::IS_A_WALLET_IDENTIFIER.end(),
-              std::ostreambuf_iterator<char>(file));
-
-    /* Write the salt to the file, so we can use it to unencrypt the file
-       later. Note that the salt is unencrypted. */
-    std::copy(std::begin(salt), std::end(salt),
-              std::ostreambuf_iterator<char>(file));
-
-    /* Write the encrypted wallet data to the file */
-    std::copy(encryptedData.begin(), encryptedData.end(),
-              std::ostreambuf_iterator<char>(file));
-
-    return SUCCESS;
+    return error;
 }
 
 /* Get the balance for one subwallet (error, unlocked, locked) */
@@ -927,6 +788,9 @@ Error WalletBackend::changePassword(const std::string newPassword)
 
     m_password = newPassword;
 
+    /* Writes the wallet out in full, with the new key */
+    m_walletFile->changePassword(newPassword);
+
     return save();
 }
 
@@ -1030,17 +894,24 @@ WalletTypes::WalletStatus WalletBackend::getStatus() const
 std::vector<WalletTypes::Transaction> WalletBackend::getTransactionsRange(
     const uint64_t startHeight, const uint64_t endHeight) const
 {
-    std::vector<WalletTypes::Transaction> result;
+    return m_subWallets->getTransactionsRange(startHeight, endHeight);
+}
 
-    const auto transactions = getTransactions();
+std::vector<WalletTypes::Transaction> WalletBackend::getTransactionsRange(
+    const uint64_t startHeight, const uint64_t endHeight,
+    const std::string address) const
+{
+    const auto [publicSpendKey, publicViewKey] = Utilities::addressToKeys(address);
+
+    const auto [error, actualAddress] = m_subWallets->getAddress(publicSpendKey);
 
-    std::copy_if(transactions.begin(), transactions.end(), std::back_inserter(result),
-    [&startHeight, &endHeight](const auto tx)
+    /* Not one of our addresses */
+    if (error || actualAddress != address)
     {
-        return tx.blockHeight >= startHeight && tx.blockHeight < endHeight;
-    });
+        return {};
+    }
 
-    return result;
+    return m_subWallets->getTransactionsRange(startHeight, endHeight, publicSpendKey);
 }
 
 std::tuple<uint64_t, std::string> WalletBackend::getNodeFee() const
@@ -1066,6 +937,16 @@ void WalletBackend::swapNode(std::string daemonHost, uint16_t daemonPort)
     });
 }
 
+void WalletBackend::setSyncThreadCount(const uint32_t threadCount)
+{
+    m_syncThreadCount = std::max<uint32_t>(1, threadCount);
+
+    if (m_walletSynchronizer != nullptr)
+    {
+        m_walletSynchronizer->setThreadCount(m_syncThreadCount);
+    }
+}
+
 bool WalletBackend::daemonOnline() const
 {
     return m_daemon->isOnline();
@@ -1154,6 +1035,29 @@ Error WalletBackend::fromJSON(
     m_filename = filename;
     m_password = password;
 
+    if (m_walletFile == nullptr)
+    {
+        m_walletFile = std::make_unique<WalletFile>(filename, password);
+    }
+
+    m_walletSynchronizer->m_subWallets = m_subWallets;
+
+    /* Bring the wallet up to date with the blocks synced after the wallet
+       file was last written in full */
+    for (const auto &record : m_walletFile->readJournal())
+    {
+        rapidjson::Document recordJson;
+
+        if (recordJson.Parse(record.c_str()).HasParseError())
+        {
+            return WALLET_FILE_CORRUPTED;
+        }
+
+        m_walletSynchronizer->applyJournalRecord(
+            getObjectFromJSON(recordJson, "walletSynchronizer")
+        );
+    }
+
     m_daemon = std::make_shared<Nigel>(daemonHost, daemonPort);
 
     init();
@@ -10,8 +10,12 @@
 
 #include "rapidjson/document.h"
 
+#include <algorithm>
+
 #include <string>
 
+#include <thread>
+
 #include <tuple>
 
 #include <vector>
@@ -20,6 +24,7 @@
 
 #include <SubWallets/SubWallets.h>
 
+#include <WalletBackend/WalletFile.h>
 #include <WalletBackend/WalletSynchronizer.h>
 #include <WalletBackend/WalletSynchronizerRAIIWrapper.h>
 
@@ -236,6 +241,12 @@ class WalletBackend
         std::vector<WalletTypes::Transaction> getTransactionsRange(
             const uint64_t startHeight, const uint64_t endHeight) const;
 
+        /* As above, but only the transactions which have a transfer to or
+           from the given address */
+        std::vector<WalletTypes::Transaction> getTransactionsRange(
+            const uint64_t startHeight, const uint64_t endHeight,
+            const std::string address) const;
+
         /* Get the node fee and address ({0, ""} if empty) */
         std::tuple<uint64_t, std::string> getNodeFee() const;
 
@@ -245,6 +256,12 @@ class WalletBackend
         /* Swap to a different daemon node */
         void swapNode(std::string daemonHost, uint16_t daemonPort);
 
+        /* Set how many threads to use when scanning blocks for transactions.
+           Takes effect from the next batch of blocks, and is kept for as long
+           as this wallet is open - it isn't saved in the wallet file, since
+           it depends on the machine rather than the wallet. */
+        void setSyncThreadCount(const uint32_t threadCount);
+
         /* Whether we have recieved info from the daemon at some point */
         bool daemonOnline() const;
 
@@ -307,6 +324,10 @@ class WalletBackend
         /* The password the wallet is encrypted with */
         std::string m_password;
 
+        /* Writes the wallet to disk, with the key derived from the password
+           cached */
+        std::unique_ptr<WalletFile> m_walletFile;
+
         /* The sub wallets container (Using a shared_ptr here so
            the WalletSynchronizer has access to it) */
         std::shared_ptr<SubWallets> m_subWallets;
@@ -332,5 +353,9 @@ class WalletBackend
            PS: I want to die */
         std::shared_ptr<WalletSynchronizer> m_walletSynchronizer;
 
+        /* How many threads the synchronizer scans blocks with, given to it
+           whenever it is created or loaded */
+        uint32_t m_syncThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
         std::shared_ptr<WalletSynchronizerRAIIWrapper> m_syncRAIIWrapper;
 };
@@ -0,0 +1,610 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+/////////////////////////////////////
+#include <WalletBackend/WalletFile.h>
+/////////////////////////////////////
+
+#include <Common/FileSystemShim.h>
+
+#include "CryptoTypes.h"
+
+#include <crypto/random.h>
+
+#include <cryptopp/aes.h>
+#include <cryptopp/algparam.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/misc.h>
+#include <cryptopp/modes.h>
+#include <cryptopp/sha.h>
+#include <cryptopp/pwdbased.h>
+
+#include <fstream>
+
+#include <Logger/Logger.h>
+
+#include <new>
+
+#include <WalletBackend/Constants.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+struct WalletFile::Key
+{
+    CryptoPP::byte salt[16];
+
+    CryptoPP::byte key[16];
+};
+
+namespace {
+
+const size_t IV_SIZE = 16;
+
+/* Each journal record is the size of the encrypted data, the IV, and
+   then the encrypted data */
+const size_t RECORD_SIZE_SIZE = 4;
+
+/* Check data has the magic indicator from first : last, and remove it if
+   it does. Else, return an error depending on where we failed */
+template <class Buffer, class Identifier>
+Error hasMagicIdentifier(
+    Buffer &data,
+    const Identifier &identifier,
+    const Error tooSmallError,
+    const Error wrongIdentifierError)
+{
+    /* Check we've got space for the identifier */
+    if (data.size() < identifier.size())
+    {
+        return tooSmallError;
+    }
+
+    if (!std::equal(identifier.begin(), identifier.end(), data.begin()))
+    {
+        return wrongIdentifierError;
+    }
+
+    /* Remove the identifier from the string */
+    data.erase(data.begin(), data.begin() + identifier.size());
+
+    return SUCCESS;
+}
+
+std::string correctPasswordIdentifier()
+{
+    return std::string(
+        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.begin(),
+        Constants::IS_CORRECT_PASSWORD_IDENTIFIER.end()
+    );
+}
+
+} // namespace
+
+///////////////////////////////////
+/* CONSTRUCTORS / DECONSTRUCTORS */
+///////////////////////////////////
+
+WalletFile::WalletFile(const std::string filename, const std::string password) :
+    WalletFile(filename)
+{
+    CryptoPP::byte salt[16];
+
+    Random::randomBytes(sizeof(salt), salt);
+
+    deriveKey(password, salt);
+}
+
+WalletFile::WalletFile(const std::string filename) :
+    m_filename(filename),
+    m_key(allocateKey())
+{
+}
+
+WalletFile::~WalletFile()
+{
+    freeKey(m_key);
+}
+
+//////////////////////
+/* STATIC FUNCTIONS */
+//////////////////////
+
+std::tuple<Error, std::unique_ptr<WalletFile>, std::string> WalletFile::open(
+    const std::string filename,
+    const std::string password)
+{
+    /* Open in binary mode, since we have encrypted data */
+    std::ifstream file(filename, std::ios_base::binary);
+
+    /* Check we successfully opened the file */
+    if (!file)
+    {
+        return {FILENAME_NON_EXISTENT, nullptr, std::string()};
+    }
+
+    /* Read file into a buffer */
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)),
+                             (std::istreambuf_iterator<char>()));
+
+    const uint64_t snapshotSize = buffer.size();
+
+    /* Check that the decrypted data has the 'isAWallet' identifier,
+       and remove it it does. If it doesn't, return an error. */
+    Error error = hasMagicIdentifier(
+        buffer, Constants::IS_A_WALLET_IDENTIFIER,
+        NOT_A_WALLET_FILE, NOT_A_WALLET_FILE
+    );
+
+    if (error)
+    {
+        return {error, nullptr, std::string()};
+    }
+
+    /* Older wallet files use the salt as the IV as well */
+    const bool separateIV = hasMagicIdentifier(
+        buffer, Constants::SEPARATE_IV_IDENTIFIER,
+        NOT_A_WALLET_FILE, NOT_A_WALLET_FILE
+    ) == SUCCESS;
+
+    /* The salt we use for PBKDF2, and the IV for AES decryption */
+    CryptoPP::byte salt[16];
+    CryptoPP::byte iv[IV_SIZE];
+
+    const size_t headerSize = separateIV ? sizeof(salt) + sizeof(iv) : sizeof(salt);
+
+    /* Check the file is large enough for the salt and IV */
+    if (buffer.size() < headerSize)
+    {
+        return {WALLET_FILE_CORRUPTED, nullptr, std::string()};
+    }
+
+    std::copy(buffer.begin(), buffer.begin() + sizeof(salt), salt);
+
+    if (separateIV)
+    {
+        std::copy(buffer.begin() + sizeof(salt), buffer.begin() + headerSize, iv);
+    }
+    else
+    {
+        std::copy(std::begin(salt), std::end(salt), iv);
+    }
+
+    std::unique_ptr<WalletFile> walletFile(new WalletFile(filename));
+
+    walletFile->deriveKey(password, salt);
+
+    /* This will store the decrypted data */
+    std::string decryptedData;
+
+    try
+    {
+        decryptedData = walletFile->decrypt(
+            buffer.data() + headerSize, buffer.size() - headerSize, iv
+        );
+    }
+    /* do NOT report an alternate error for invalid padding. It allows them
+       to do a padding oracle attack, I believe. Just report the wrong password
+       error. */
+    catch (const CryptoPP::Exception &)
+    {
+        return {WRONG_PASSWORD, nullptr, std::string()};
+    }
+
+    /* Check that the decrypted data has the 'isCorrectPassword' identifier,
+       and remove it it does. If it doesn't, return an error. */
+    error = hasMagicIdentifier(
+        decryptedData, Constants::IS_CORRECT_PASSWORD_IDENTIFIER,
+        WALLET_FILE_CORRUPTED, WRONG_PASSWORD
+    );
+
+    if (error)
+    {
+        return {error, nullptr, std::string()};
+    }
+
+    walletFile->m_snapshotIV.assign(std::begin(iv), std::end(iv));
+    walletFile->m_snapshotSize = snapshotSize;
+    walletFile->m_snapshotRequired = false;
+
+    return {SUCCESS, std::move(walletFile), decryptedData};
+}
+
+/////////////////////
+/* CLASS FUNCTIONS */
+/////////////////////
+
+std::vector<std::string> WalletFile::readJournal()
+{
+    std::vector<std::string> records;
+
+    std::ifstream file(journalFilename(), std::ios_base::binary);
+
+    if (!file)
+    {
+        return records;
+    }
+
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)),
+                             (std::istreambuf_iterator<char>()));
+
+    file.close();
+
+    const uint64_t fileSize = buffer.size();
+
+    /* Check the journal was started for this snapshot, and not one which
+       replaced it before the journal could be removed */
+    const bool isOurJournal = hasMagicIdentifier(
+        buffer, Constants::IS_A_WALLET_JOURNAL_IDENTIFIER,
+        NOT_A_WALLET_FILE, NOT_A_WALLET_FILE
+    ) == SUCCESS && buffer.size() >= IV_SIZE
+      && std::equal(m_snapshotIV.begin(), m_snapshotIV.end(),
+                    reinterpret_cast<const uint8_t *>(buffer.data()));
+
+    if (!isOurJournal)
+    {
+        std::error_code ec;
+        fs::remove(journalFilename(), ec);
+
+        return records;
+    }
+
+    size_t offset = IV_SIZE;
+
+    while (buffer.size() - offset >= RECORD_SIZE_SIZE + IV_SIZE)
+    {
+        uint32_t size = 0;
+
+        for (size_t i = 0; i < RECORD_SIZE_SIZE; i++)
+        {
+            size |= static_cast<uint32_t>(static_cast<uint8_t>(buffer[offset + i])) << (8 * i);
+        }
+
+        const size_t dataOffset = offset + RECORD_SIZE_SIZE + IV_SIZE;
+
+        if (buffer.size() - dataOffset < size)
+        {
+            break;
+        }
+
+        std::string record;
+
+        try
+        {
+            record = decrypt(
+                buffer.data() + dataOffset, size,
+                reinterpret_cast<const uint8_t *>(buffer.data() + offset + RECORD_SIZE_SIZE)
+            );
+        }
+        catch (const CryptoPP::Exception &)
+        {
+            break;
+        }
+
+        if (hasMagicIdentifier(
+                record, Constants::IS_CORRECT_PASSWORD_IDENTIFIER,
+                WALLET_FILE_CORRUPTED, WALLET_FILE_CORRUPTED) != SUCCESS)
+        {
+            break;
+        }
+
+        records.push_back(std::move(record));
+
+        offset = dataOffset + size;
+    }
+
+    m_journalSize = Constants::IS_A_WALLET_JOURNAL_IDENTIFIER.size() + offset;
+
+    /* Only blocks synced since the last save are lost, and they'll be
+       synced again */
+    if (m_journalSize != fileSize)
+    {
+        Logger::logger.log(
+            "Discarding incomplete record at the end of the wallet journal",
+            Logger::WARNING,
+            {Logger::FILESYSTEM, Logger::SAVE}
+        );
+
+        std::error_code ec;
+        fs::resize_file(journalFilename(), m_journalSize, ec);
+
+        if (ec)
+        {
+            m_snapshotRequired = true;
+        }
+    }
+
+    return records;
+}
+
+Error WalletFile::writeSnapshot(const std::string &walletJson)
+{
+    /* A fresh IV every time, as the key stays the same */
+    CryptoPP::byte iv[IV_SIZE];
+
+    Random::randomBytes(IV_SIZE, iv);
+
+    /* Add an identifier to the start of the string so we can verify the
+       wallet has been correctly decrypted */
+    const std::string encryptedData = encrypt(
+        correctPasswordIdentifier() + walletJson, iv
+    );
+
+    std::ofstream file(m_filename, std::ios_base::binary);
+
+    if (!file)
+    {
+        Logger::logger.log(
+            std::string("Wallet filename: ") + m_filename + " is invalid",
+            Logger::FATAL,
+            {Logger::FILESYSTEM, Logger::SAVE}
+        );
+
+        return INVALID_WALLET_FILENAME;
+    }
+
+    /* Write the isAWalletIdentifier to the file, so when we open it we can
+       verify that it is a wallet file */
+    std::copy(Constants::IS_A_WALLET_IDENTIFIER.begin(),
+              Constants::IS_A_WALLET_IDENTIFIER.end(),
+              std::ostreambuf_iterator<char>(file));
+
+    std::copy(Constants::SEPARATE_IV_IDENTIFIER.begin(),
+              Constants::SEPARATE_IV_IDENTIFIER.end(),
+              std::ostreambuf_iterator<char>(file));
+
+    /* Write the salt and IV to the file, so we can use them to unencrypt
+       the file later. Note that these are unencrypted. */
+    std::copy(std::begin(m_key->salt), std::end(m_key->salt),
+              std::ostreambuf_iterator<char>(file));
+
+    std::copy(std::begin(iv), std::end(iv),
+              std::ostreambuf_iterator<char>(file));
+
+    /* Write the encrypted wallet data to the file */
+    std::copy(encryptedData.begin(), encryptedData.end(),
+              std::ostreambuf_iterator<char>(file));
+
+    file.flush();
+
+    if (!file)
+    {
+        Logger::logger.log(
+            std::string("Failed to write wallet file: ") + m_filename,
+            Logger::FATAL,
+            {Logger::FILESYSTEM, Logger::SAVE}
+        );
+
+        return INVALID_WALLET_FILENAME;
+    }
+
+    /* Everything in the journal is in the snapshot now. If we fail to
+       remove it, it is ignored anyway, as it starts with the old IV. */
+    std::error_code ec;
+    fs::remove(journalFilename(), ec);
+
+    m_snapshotIV.assign(std::begin(iv), std::end(iv));
+
+    m_snapshotSize = Constants::IS_A_WALLET_IDENTIFIER.size()
+                   + Constants::SEPARATE_IV_IDENTIFIER.size()
+                   + sizeof(m_key->salt) + IV_SIZE + encryptedData.size();
+
+    m_journalSize = 0;
+
+    m_snapshotRequired = false;
+
+    return SUCCESS;
+}
+
+Error WalletFile::appendToJournal(const std::string &record)
+{
+    CryptoPP::byte iv[IV_SIZE];
+
+    Random::randomBytes(IV_SIZE, iv);
+
+    const std::string encryptedData = encrypt(
+        correctPasswordIdentifier() + record, iv
+    );
+
+    std::string data;
+
+    /* Start a new journal for this snapshot, replacing any left over from
+       an older one */
+    if (m_journalSize == 0)
+    {
+        data.append(
+            Constants::IS_A_WALLET_JOURNAL_IDENTIFIER.begin(),
+            Constants::IS_A_WALLET_JOURNAL_IDENTIFIER.end()
+        );
+
+        data.append(m_snapshotIV.begin(), m_snapshotIV.end());
+    }
+
+    const uint32_t size = static_cast<uint32_t>(encryptedData.size());
+
+    for (size_t i = 0; i < RECORD_SIZE_SIZE; i++)
+    {
+        data.push_back(static_cast<char>((size >> (8 * i)) & 0xff));
+    }
+
+    data.append(std::begin(iv), std::end(iv));
+    data.append(encryptedData);
+
+    std::ofstream file(
+        journalFilename(),
+        std::ios_base::binary | (m_journalSize == 0 ? std::ios_base::trunc : std::ios_base::app)
+    );
+
+    if (file)
+    {
+        file.write(data.data(), data.size());
+        file.flush();
+    }
+
+    if (!file)
+    {
+        Logger::logger.log(
+            std::string("Failed to write wallet journal: ") + journalFilename(),
+            Logger::FATAL,
+            {Logger::FILESYSTEM, Logger::SAVE}
+        );
+
+        /* Anything appended after a partly written record would be
+           ignored, so write everything out next time instead */
+        m_snapshotRequired = true;
+
+        return INVALID_WALLET_FILENAME;
+    }
+
+    m_journalSize += data.size();
+
+    return SUCCESS;
+}
+
+bool WalletFile::snapshotRequired() const
+{
+    return m_snapshotRequired
+        || m_journalSize > std::max(Constants::MIN_JOURNAL_COMPACTION_SIZE, m_snapshotSize / 2);
+}
+
+void WalletFile::changePassword(const std::string password)
+{
+    CryptoPP::byte salt[16];
+
+    Random::randomBytes(sizeof(salt), salt);
+
+    deriveKey(password, salt);
+
+    /* The snapshot and journal on disk use the old key */
+    m_snapshotRequired = true;
+}
+
+WalletFile::Key *WalletFile::allocateKey()
+{
+    /* A page to itself, so unlocking it can't unlock anything else */
+#if defined(_WIN32)
+    void *page = VirtualAlloc(
+        nullptr, sizeof(Key), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE
+    );
+
+    const bool locked = page != nullptr && VirtualLock(page, sizeof(Key));
+#else
+    void *page = mmap(
+        nullptr, sizeof(Key), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+
+    if (page == MAP_FAILED)
+    {
+        page = nullptr;
+    }
+
+    const bool locked = page != nullptr && mlock(page, sizeof(Key)) == 0;
+
+#if defined(MADV_DONTDUMP)
+    /* Keep it out of core dumps too */
+    if (page != nullptr)
+    {
+        madvise(page, sizeof(Key), MADV_DONTDUMP);
+    }
+#endif
+#endif
+
+    if (page == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    /* Not fatal, e.g. RLIMIT_MEMLOCK may be too low */
+    if (!locked)
+    {
+        Logger::logger.log(
+            "Failed to lock the wallet key into memory, it may be swapped to disk",
+            Logger::WARNING,
+            {Logger::FILESYSTEM}
+        );
+    }
+
+    return new (page) Key();
+}
+
+void WalletFile::freeKey(Key *key)
+{
+    CryptoPP::SecureWipeArray(reinterpret_cast<CryptoPP::byte *>(key), sizeof(Key));
+
+#if defined(_WIN32)
+    VirtualUnlock(key, sizeof(Key));
+    VirtualFree(key, 0, MEM_RELEASE);
+#else
+    munlock(key, sizeof(Key));
+    munmap(key, sizeof(Key));
+#endif
+}
+
+void WalletFile::deriveKey(const std::string &password, const uint8_t *salt)
+{
+    std::copy(salt, salt + sizeof(m_key->salt), m_key->salt);
+
+    /* Using SHA256 as the algorithm */
+    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf2;
+
+    /* Generate the AES Key using pbkdf2 */
+    pbkdf2.DeriveKey(
+        m_key->key, sizeof(m_key->key), 0,
+        reinterpret_cast<const CryptoPP::byte *>(password.c_str()),
+        password.size(), m_key->salt, sizeof(m_key->salt),
+        Constants::PBKDF2_ITERATIONS
+    );
+}
+
+std::string WalletFile::encrypt(const std::string &plaintext, const uint8_t *iv) const
+{
+    using namespace CryptoPP;
+
+    CBC_Mode<AES>::Encryption cbcEncryption;
+
+    /* Initialize our encryptor with the key and IV */
+    cbcEncryption.SetKeyWithIV(m_key->key, sizeof(m_key->key), iv, IV_SIZE);
+
+    /* This will store the encrypted data */
+    std::string encryptedData;
+
+    /* Encrypt, and pad */
+    StringSource(plaintext, true, new StreamTransformationFilter(
+        cbcEncryption, new StringSink(encryptedData))
+    );
+
+    return encryptedData;
+}
+
+std::string WalletFile::decrypt(const char *data, const size_t size, const uint8_t *iv) const
+{
+    using namespace CryptoPP;
+
+    CBC_Mode<AES>::Decryption cbcDecryption;
+
+    /* Initialize our decrypter with the key and IV */
+    cbcDecryption.SetKeyWithIV(m_key->key, sizeof(m_key->key), iv, IV_SIZE);
+
+    /* This will store the decrypted data */
+    std::string decryptedData;
+
+    /* Decrypt, handling padding */
+    StringSource(reinterpret_cast<const byte *>(data), size, true, new StreamTransformationFilter(
+        cbcDecryption, new StringSink(decryptedData))
+    );
+
+    return decryptedData;
+}
+
+std::string WalletFile::journalFilename() const
+{
+    return m_filename + ".journal";
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2018, The TurtleCoin Developers
+//
+// Please see the included LICENSE file for more information.
+
+#pragma once
+
+#include <Errors/Errors.h>
+
+#include <memory>
+
+#include <string>
+
+#include <tuple>
+
+#include <vector>
+
+/* A wallet is stored as a snapshot of the whole wallet, and a journal next
+   to it (filename + ".journal") of the blocks synced since the snapshot was
+   written. Saving whilst syncing then only has to append the new blocks to
+   the journal, and the journal is folded back into the snapshot once it
+   grows large.
+
+   Both are encrypted with an AES key derived from the password with PBKDF2.
+   Deriving the key is the slow part of saving, so it is done once when the
+   wallet is opened or created, and kept in locked memory (so it doesn't get
+   swapped out to disk) until the wallet is closed or the password changes. */
+class WalletFile
+{
+    public:
+        //////////////////
+        /* Constructors */
+        //////////////////
+
+        /* For a new wallet - nothing is written until writeSnapshot() */
+        WalletFile(const std::string filename, const std::string password);
+
+        /* Deconstructor */
+        ~WalletFile();
+
+        /* Delete the copy constructor */
+        WalletFile(const WalletFile &) = delete;
+
+        /* Delete the assignment operator */
+        WalletFile & operator=(const WalletFile &) = delete;
+
+        /////////////////////////////
+        /* Public static functions */
+        /////////////////////////////
+
+        /* Opens the wallet file, and decrypts the snapshot, returning it as
+           a json string */
+        static std::tuple<Error, std::unique_ptr<WalletFile>, std::string> open(
+            const std::string filename,
+            const std::string password);
+
+        /////////////////////////////
+        /* Public member functions */
+        /////////////////////////////
+
+        /* Decrypts the records in the journal which belong to the snapshot,
+           oldest first. Anything unreadable at the end, e.g. from being
+           killed mid write, is dropped. */
+        std::vector<std::string> readJournal();
+
+        /* Writes the whole wallet out, and discards the journal */
+        Error writeSnapshot(const std::string &walletJson);
+
+        /* Appends a record to the journal */
+        Error appendToJournal(const std::string &record);
+
+        /* Whether the next save should write a snapshot rather than append
+           to the journal - there is no snapshot yet, the password has
+           changed, or the journal is large enough to fold in */
+        bool snapshotRequired() const;
+
+        /* Derives a new key, used from the next snapshot on */
+        void changePassword(const std::string password);
+
+    private:
+
+        /* The PBKDF2 salt and the AES key derived from it */
+        struct Key;
+
+        /* Used by open(), which derives the key from the salt in the file */
+        explicit WalletFile(const std::string filename);
+
+        //////////////////////////////
+        /* Private member functions */
+        //////////////////////////////
+
+        /* Allocates the key in its own page, locked into memory */
+        static Key *allocateKey();
+
+        /* Wipes, unlocks and frees a key from allocateKey() */
+        static void freeKey(Key *key);
+
+        /* Derives the key from the password with PBKDF2 */
+        void deriveKey(const std::string &password, const uint8_t *salt);
+
+        std::string encrypt(const std::string &plaintext, const uint8_t *iv) const;
+
+        /* Throws a CryptoPP::Exception if the padding is invalid */
+        std::string decrypt(const char *data, const size_t size, const uint8_t *iv) const;
+
+        std::string journalFilename() const;
+
+        //////////////////////////////
+        /* Private member variables */
+        //////////////////////////////
+
+        std::string m_filename;
+
+        Key *m_key;
+
+        /* The IV of the current snapshot. The journal starts with it, so we
+           can tell if the journal was written for an older snapshot. */
+        std::vector<uint8_t> m_snapshotIV;
+
+        /* Size of the snapshot file */
+        uint64_t m_snapshotSize = 0;
+
+        /* Size of the journal file, 0 if we haven't started one for this
+           snapshot */
+        uint64_t m_journalSize = 0;
+
+        /* Set until the first snapshot, and when the key changes */
+        bool m_snapshotRequired = true;
+};
@@ -12,10 +12,16 @@
 
 #include <crypto/crypto.h>
 
-#include <future>
+#include <condition_variable>
+
+#include <exception>
 
 #include <iostream>
 
+#include <mutex>
+
+#include <thread>
+
 #include <Logger/Logger.h>
 
 #include <Utilities/Utilities.h>
@@ -29,8 +35,11 @@
 /* Default constructor */
 WalletSynchronizer::WalletSynchronizer() :
     m_shouldStop(false),
+    m_rewindDownloader(false),
+    m_blockDownloaderQueue(true, Constants::MAXIMUM_SYNC_BATCH_QUEUE_SIZE),
     m_startTimestamp(0),
-    m_startHeight(0)
+    m_startHeight(0),
+    m_threadCount(std::max(1u, std::thread::hardware_concurrency()))
 {
 }
 
@@ -44,10 +53,13 @@ WalletSynchronizer::WalletSynchronizer(
 
     m_daemon(daemon),
     m_shouldStop(false),
+    m_rewindDownloader(false),
+    m_blockDownloaderQueue(true, Constants::MAXIMUM_SYNC_BATCH_QUEUE_SIZE),
     m_startHeight(startHeight),
     m_startTimestamp(startTimestamp),
     m_privateViewKey(privateViewKey),
-    m_eventHandler(eventHandler)
+    m_eventHandler(eventHandler),
+    m_threadCount(std::max(1u, std::thread::hardware_concurrency()))
 {
 }
 
@@ -66,8 +78,12 @@ WalletSynchronizer & WalletSynchronizer::operator=(WalletSynchronizer && old)
 
     m_syncThread = std::move(old.m_syncThread);
 
+    m_blockDownloaderThread = std::move(old.m_blockDownloaderThread);
+
     m_syncStatus = std::move(old.m_syncStatus);
 
+    m_downloadStatus = std::move(old.m_downloadStatus);
+
     m_startTimestamp = std::move(old.m_startTimestamp);
     m_startHeight = std::move(old.m_startHeight);
 
@@ -77,6 +93,11 @@ WalletSynchronizer & WalletSynchronizer::operator=(WalletSynchronizer && old)
 
     m_daemon = std::move(old.m_daemon);
 
+    m_threadCount = old.m_threadCount.load();
+
+    m_unsavedBlocks = std::move(old.m_unsavedBlocks);
+    m_savedHeight = old.m_savedHeight;
+
     return *this;
 }
 
@@ -94,16 +115,46 @@ void WalletSynchronizer::mainLoop()
 {
     while (!m_shouldStop)
     {
-        const auto blocks = downloadBlocks();
+        /* Blocks until the downloader has some data for us */
+        const auto blocks = m_blockDownloaderQueue.pop();
 
-        for (const auto block : blocks)
+        if (m_shouldStop)
+        {
+            return;
+        }
+
+        const uint64_t processedHeight = getCurrentScanHeight();
+
+        /* A batch which doesn't carry on from where we are was queued up
+           after we gave up on a block part way through - discard it, and
+           have the downloader resume from our current position */
+        if (!blocks.empty() && processedHeight != 0
+         && blocks.front().blockHeight > processedHeight + 1)
+        {
+            m_rewindDownloader = true;
+            continue;
+        }
+
+        /* Scan the outputs of the whole batch in parallel - this is the
+           expensive part, and doesn't depend on any wallet state which
+           processing a block modifies */
+        auto blockInputs = processBlockOutputs(blocks);
+
+        /* Then commit the blocks one by one, in order, so fork handling and
+           the per block state changes happen just as if done serially */
+        for (size_t i = 0; i < blocks.size(); i++)
         {
             if (m_shouldStop)
             {
                 return;
             }
 
-            processBlock(block);
+            /* Failed to process the block, we need to fetch it again */
+            if (!processBlock(blocks[i], std::move(blockInputs[i])))
+            {
+                m_rewindDownloader = true;
+                break;
+            }
         }
 
         if (blocks.empty() && !m_shouldStop)
@@ -114,11 +165,70 @@ void WalletSynchronizer::mainLoop()
             {
                 checkLockedTransactions();
             }
+        }
+    }
+}
+
+void WalletSynchronizer::downloaderLoop()
+{
+    while (!m_shouldStop)
+    {
+        /* The processing thread couldn't use what we downloaded, go back
+           to where it got up to */
+        if (m_rewindDownloader)
+        {
+            m_blockDownloaderQueue.clear();
+
+            std::scoped_lock lock(m_syncStatusMutex);
+
+            m_downloadStatus = m_syncStatus;
+
+            m_rewindDownloader = false;
+        }
+
+        auto blocks = downloadBlocks();
+
+        if (blocks.empty())
+        {
+            /* Let the processing thread know we're synced, so it can check
+               on locked transactions */
+            m_blockDownloaderQueue.push(blocks);
 
             std::this_thread::sleep_for(std::chrono::seconds(5));
 
             continue;
         }
+
+        const uint64_t firstHeight = blocks.front().blockHeight;
+
+        /* The daemon has given us blocks we have already queued up, so the
+           chain forked. Any queued blocks from the fork point onwards are
+           on the dead chain, so drop them before they get processed. Any
+           already processed will be rolled back by processBlock(). */
+        if (m_downloadStatus.getHeight() >= firstHeight)
+        {
+            m_blockDownloaderQueue.filter([firstHeight](auto &queuedBlocks)
+            {
+                queuedBlocks.erase(
+                    std::remove_if(queuedBlocks.begin(), queuedBlocks.end(), [firstHeight](const auto &block)
+                    {
+                        return block.blockHeight >= firstHeight;
+                    }),
+                    queuedBlocks.end()
+                );
+
+                return !queuedBlocks.empty();
+            });
+        }
+
+        /* So the next request carries on from the end of this batch */
+        for (const auto &block : blocks)
+        {
+            m_downloadStatus.storeBlockHash(block.blockHash, block.blockHeight);
+        }
+
+        /* Blocks whilst the queue is full */
+        m_blockDownloaderQueue.push(std::move(blocks));
     }
 }
 
@@ -126,7 +236,9 @@ std::vector<WalletTypes::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
 {
     const uint64_t localDaemonBlockCount = m_daemon->localDaemonBlockCount();
 
-    const uint64_t walletBlockCount = getCurrentScanHeight();
+    /* The height of the last block we have downloaded, which may not
+       have been processed yet */
+    const uint64_t walletBlockCount = m_downloadStatus.getHeight();
 
     /* Local daemon has less blocks than the wallet:
 
@@ -165,11 +277,12 @@ std::vector<WalletTypes::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
     }
 
     /* The block hashes to try begin syncing from */
-    const auto blockCheckpoints = m_syncStatus.getBlockHashCheckpoints();
+    const auto blockCheckpoints = m_downloadStatus.getBlockHashCheckpoints();
 
     /* Blocks the thread for up to 10 secs */
     const auto [success, blocks] = m_daemon->getWalletSyncData(
-        blockCheckpoints, m_startHeight, m_startTimestamp
+        blockCheckpoints, m_startHeight, m_startTimestamp,
+        Constants::SYNC_DATA_BLOCK_COUNT
     );
 
     /* If we get no blocks, we are fully synced.
@@ -226,34 +339,117 @@ std::vector<WalletTypes::WalletBlockInfo> WalletSynchronizer::downloadBlocks()
     return blocks;
 }
 
-std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> WalletSynchronizer::processBlockOutputs(
-    const WalletTypes::WalletBlockInfo &block) const
+std::vector<std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>>> WalletSynchronizer::processBlockOutputs(
+    const std::vector<WalletTypes::WalletBlockInfo> &blocks)
 {
-    std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> inputs;
+    /* The transactions of a block whose outputs need checking, coinbase
+       first, so the inputs come out in the same order as a serial scan */
+    std::vector<std::vector<const WalletTypes::RawCoinbaseTransaction *>> jobs(blocks.size());
 
-    if (WalletConfig::processCoinbaseTransactions)
+    for (size_t i = 0; i < blocks.size(); i++)
     {
-        const auto newInputs = processTransactionOutputs(
-            block.coinbaseTransaction, block.blockHeight
-        );
+        if (WalletConfig::processCoinbaseTransactions)
+        {
+            jobs[i].push_back(&blocks[i].coinbaseTransaction);
+        }
 
-        inputs.insert(inputs.end(), newInputs.begin(), newInputs.end());
+        for (const auto &tx : blocks[i].transactions)
+        {
+            jobs[i].push_back(&tx);
+        }
     }
 
-    for (const auto tx : block.transactions)
+    /* Indexed by block, like the jobs */
+    std::vector<std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>>> blockInputs(blocks.size());
+
+    /* The next job to be taken by a worker */
+    std::atomic<size_t> nextJob(0);
+
+    /* The first exception a worker hit, rethrown on this thread */
+    std::exception_ptr error;
+
+    std::mutex mutex;
+
+    const auto worker = [&]()
     {
-        const auto newInputs = processTransactionOutputs(tx, block.blockHeight);
+        try
+        {
+            for (size_t i = nextJob++; i < jobs.size() && !m_shouldStop; i = nextJob++)
+            {
+                blockInputs[i] = processTransactionOutputs(jobs[i], blocks[i].blockHeight);
+            }
+        }
+        catch (...)
+        {
+            std::scoped_lock lock(mutex);
 
-        inputs.insert(inputs.end(), newInputs.begin(), newInputs.end());
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+
+            /* Leave the remaining jobs to nobody */
+            nextJob = jobs.size();
+        }
+    };
+
+    const uint32_t threadCount = std::max<uint32_t>(1, m_threadCount);
+
+    if (threadCount == 1)
+    {
+        m_scanWorkers.reset();
+    }
+    else if (m_scanWorkers == nullptr || m_scanWorkers->getThreadCount() != threadCount - 1)
+    {
+        m_scanWorkers = std::make_unique<Common::ThreadPool>(threadCount - 1);
     }
 
-    return inputs;
+    /* No point starting more workers than we have blocks. The current
+       thread works too, so post one less. */
+    const size_t postedWorkers = jobs.empty() ? 0 : std::min<size_t>(threadCount, jobs.size()) - 1;
+
+    size_t finishedWorkers = 0;
+
+    std::condition_variable workerFinished;
+
+    for (size_t i = 0; i < postedWorkers; i++)
+    {
+        m_scanWorkers->post([&]()
+        {
+            worker();
+
+            std::scoped_lock lock(mutex);
+
+            finishedWorkers++;
+
+            workerFinished.notify_one();
+        });
+    }
+
+    worker();
+
+    /* The posted workers use this stack frame, so wait for them even once
+       no jobs are left */
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        workerFinished.wait(lock, [&]() { return finishedWorkers == postedWorkers; });
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    return blockInputs;
 }
 
-void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
+bool WalletSynchronizer::processBlock(
+    const WalletTypes::WalletBlockInfo &block,
+    std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> ourInputs)
 {
     Logger::logger.log(
-        "Processing block " + std::to_string(block.blockHeight),
+        [&]() { return "Processing block " + std::to_string(block.blockHeight); },
         Logger::DEBUG,
         {Logger::SYNC}
     );
@@ -270,8 +466,6 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
         removeForkedTransactions(block.blockHeight);
     }
 
-    auto ourInputs = processBlockOutputs(block);
-
     std::unordered_map<Crypto::Hash, std::vector<uint64_t>> globalIndexes;
 
     for (auto &[publicKey, input] : ourInputs)
@@ -302,7 +496,7 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
                     {Logger::SYNC, Logger::DAEMON}
                 );
 
-                return;
+                return false;
             }
 
             input.globalOutputIndex = it->second[input.transactionIndex];
@@ -311,14 +505,15 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
 
     BlockScanTmpInfo blockScanInfo = processBlockTransactions(block, ourInputs);
 
-    for (const auto tx : blockScanInfo.transactionsToAdd)
+    for (const auto &tx : blockScanInfo.transactionsToAdd)
     {
-        std::stringstream stream;
-
-        stream << "Adding transaction: " << tx.hash;
-
         Logger::logger.log(
-            stream.str(),
+            [&]()
+            {
+                std::stringstream stream;
+                stream << "Adding transaction: " << tx.hash;
+                return stream.str();
+            },
             Logger::INFO,
             {Logger::SYNC, Logger::TRANSACTIONS}
         );
@@ -327,14 +522,16 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
         m_eventHandler->onTransaction.fire(tx);
     }
 
-    for (const auto [publicKey, input] : blockScanInfo.inputsToAdd)
+    for (const auto &[publicKey, input] : blockScanInfo.inputsToAdd)
     {
-        std::stringstream stream;
-
-        stream << "Adding input: " << input.key;
-
         Logger::logger.log(
-            stream.str(),
+            /* Structured bindings can't be captured directly until C++20 */
+            [&key = input.key]()
+            {
+                std::stringstream stream;
+                stream << "Adding input: " << key;
+                return stream.str();
+            },
             Logger::INFO,
             {Logger::SYNC}
         );
@@ -344,14 +541,15 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
 
     /* The input has been spent, discard the key image so we
        don't double spend it */
-    for (const auto [publicKey, keyImage] : blockScanInfo.keyImagesToMarkSpent)
+    for (const auto &[publicKey, keyImage] : blockScanInfo.keyImagesToMarkSpent)
     {
-        std::stringstream stream;
-
-        stream << "Marking key image: " << keyImage << " as spent";
-
         Logger::logger.log(
-            stream.str(),
+            [&keyImage = keyImage]()
+            {
+                std::stringstream stream;
+                stream << "Marking key image: " << keyImage << " as spent";
+                return stream.str();
+            },
             Logger::INFO,
             {Logger::SYNC}
         );
@@ -362,7 +560,18 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
     /* Make sure to do this at the end, once the transactions are fully
        processed! Otherwise, we could miss a transaction depending upon
        when we save */
-    m_syncStatus.storeBlockHash(block.blockHash, block.blockHeight);
+    {
+        std::scoped_lock lock(m_syncStatusMutex);
+        m_syncStatus.storeBlockHash(block.blockHash, block.blockHeight);
+    }
+
+    /* Kept for the wallet journal, until the next save */
+    if (!blockScanInfo.transactionsToAdd.empty()
+     || !blockScanInfo.inputsToAdd.empty()
+     || !blockScanInfo.keyImagesToMarkSpent.empty())
+    {
+        m_unsavedBlocks.emplace_back(block.blockHeight, std::move(blockScanInfo));
+    }
 
     if (block.blockHeight >= m_daemon->networkBlockCount())
     {
@@ -370,10 +579,12 @@ void WalletSynchronizer::processBlock(const WalletTypes::WalletBlockInfo &block)
     }
 
     Logger::logger.log(
-        "Finshed processing block " + std::to_string(block.blockHeight),
+        [&]() { return "Finished processing block " + std::to_string(block.blockHeight); },
         Logger::DEBUG,
         {Logger::SYNC}
     );
+
+    return true;
 }
 
 BlockScanTmpInfo WalletSynchronizer::processBlockTransactions(
@@ -510,24 +721,56 @@ std::tuple<std::optional<WalletTypes::Transaction>, std::vector<std::tuple<Crypt
 }
 
 std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> WalletSynchronizer::processTransactionOutputs(
-    const WalletTypes::RawCoinbaseTransaction &rawTX,
+    const std::vector<const WalletTypes::RawCoinbaseTransaction *> &transactions,
     const uint64_t blockHeight) const
 {
     std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> inputs;
 
-    Crypto::KeyDerivation derivation;
+    std::vector<std::tuple<Crypto::PublicKey, Crypto::PublicKey, size_t>> outputKeys;
 
-    Crypto::generate_key_derivation(rawTX.transactionPublicKey, m_privateViewKey, derivation);
+    /* The transaction each entry of outputKeys is from */
+    std::vector<const WalletTypes::RawCoinbaseTransaction *> outputTransactions;
 
-    const std::vector<Crypto::PublicKey> spendKeys = m_subWallets->m_publicSpendKeys;
+    for (const auto rawTX : transactions)
+    {
+        for (size_t outputIndex = 0; outputIndex < rawTX->keyOutputs.size(); outputIndex++)
+        {
+            outputKeys.emplace_back(
+                rawTX->transactionPublicKey, rawTX->keyOutputs[outputIndex].key, outputIndex
+            );
+
+            outputTransactions.push_back(rawTX);
+        }
+    }
+
+    std::vector<Crypto::KeyDerivation> derivations;
+    std::vector<Crypto::PublicKey> derivedSpendKeys;
+    std::vector<bool> valid;
 
-    uint64_t outputIndex = 0;
+    /* Derive the spend keys of every output in the block in one go - this
+       only computes each transaction's derivation once, and shares the
+       expensive field inversion between all the outputs */
+    Crypto::underive_public_keys(
+        m_privateViewKey, outputKeys, derivations, derivedSpendKeys, valid
+    );
+
+    const std::vector<Crypto::PublicKey> spendKeys = m_subWallets->m_publicSpendKeys;
 
-    for (const auto output : rawTX.keyOutputs)
+    for (size_t i = 0; i < outputKeys.size(); i++)
     {
-        Crypto::PublicKey derivedSpendKey;
+        /* Malformed transaction key or output key, can't be ours */
+        if (!valid[i])
+        {
+            continue;
+        }
 
-        Crypto::underive_public_key(derivation, outputIndex, output.key, derivedSpendKey);
+        const auto &rawTX = *outputTransactions[i];
+
+        const size_t outputIndex = std::get<2>(outputKeys[i]);
+
+        const auto &output = rawTX.keyOutputs[outputIndex];
+
+        const Crypto::PublicKey &derivedSpendKey = derivedSpendKeys[i];
 
         /* See if the derived spend key matches any of our spend keys */
         const auto ourSpendKey = std::find(spendKeys.begin(), spendKeys.end(),
@@ -541,7 +784,7 @@ std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> Wallet
                key. We use the key images to detect outgoing transactions,
                and we use the transaction inputs to make transactions ourself */
             const Crypto::KeyImage keyImage = m_subWallets->getTxInputKeyImage(
-                derivedSpendKey, derivation, outputIndex
+                derivedSpendKey, derivations[i], outputIndex
             );
 
             const uint64_t spendHeight = 0;
@@ -554,8 +797,6 @@ std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> Wallet
 
             inputs.emplace_back(derivedSpendKey, input);
         }
-
-        outputIndex++;
     }
 
     return inputs;
@@ -661,6 +902,18 @@ void WalletSynchronizer::start()
         throw std::runtime_error("Daemon has not been initialized!");
     }
 
+    /* Anything still queued was downloaded before we were stopped, and the
+       sync status may have been changed since then (e.g. reset()), so
+       discard it and resume downloading from what we have processed */
+    m_blockDownloaderQueue.clear();
+    m_blockDownloaderQueue.start();
+
+    m_downloadStatus = m_syncStatus;
+
+    m_rewindDownloader = false;
+
+    m_blockDownloaderThread = std::thread(&WalletSynchronizer::downloaderLoop, this);
+
     m_syncThread = std::thread(&WalletSynchronizer::mainLoop, this);
 }
 
@@ -674,12 +927,21 @@ void WalletSynchronizer::stop()
 
     /* Tell the threads to stop */
     m_shouldStop = true;
+
+    /* Wake up any threads waiting on the queue */
+    m_blockDownloaderQueue.stop();
 	
-    /* Wait for the block downloader thread to finish (if applicable) */
+    /* Wait for the block processing thread to finish (if applicable) */
     if (m_syncThread.joinable())
     {
         m_syncThread.join();
     }
+
+    /* Wait for the block downloader thread to finish (if applicable) */
+    if (m_blockDownloaderThread.joinable())
+    {
+        m_blockDownloaderThread.join();
+    }
 }
 
 void WalletSynchronizer::reset(uint64_t startHeight)
@@ -691,6 +953,8 @@ void WalletSynchronizer::reset(uint64_t startHeight)
     /* Discard sync progress */
     m_syncStatus = SynchronizationStatus();
 
+    m_unsavedBlocks.clear();
+
     /* Need to call start in your calling code - We don't call it here so
        you can schedule the start correctly */
 }
@@ -720,12 +984,138 @@ void WalletSynchronizer::swapNode(const std::shared_ptr<Nigel> daemon)
     m_daemon = daemon;
 }
 
+void WalletSynchronizer::setThreadCount(const uint32_t threadCount)
+{
+    /* Picked up when the next batch of blocks is scanned */
+    m_threadCount = std::max<uint32_t>(1, threadCount);
+}
+
+bool WalletSynchronizer::hasUnsavedBlocks() const
+{
+    return !m_unsavedBlocks.empty() || m_syncStatus.getHeight() != m_savedHeight;
+}
+
+void WalletSynchronizer::clearUnsavedBlocks()
+{
+    m_unsavedBlocks.clear();
+    m_savedHeight = m_syncStatus.getHeight();
+}
+
+void WalletSynchronizer::unsavedBlocksToJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const
+{
+    writer.StartObject();
+
+    writer.Key("blocks");
+    writer.StartArray();
+    for (const auto &[blockHeight, blockScanInfo] : m_unsavedBlocks)
+    {
+        writer.StartObject();
+
+        writer.Key("blockHeight");
+        writer.Uint64(blockHeight);
+
+        writer.Key("transactions");
+        writer.StartArray();
+        for (const auto &tx : blockScanInfo.transactionsToAdd)
+        {
+            tx.toJSON(writer);
+        }
+        writer.EndArray();
+
+        writer.Key("inputs");
+        writer.StartArray();
+        for (const auto &[publicKey, input] : blockScanInfo.inputsToAdd)
+        {
+            writer.StartObject();
+
+            writer.Key("publicSpendKey");
+            publicKey.toJSON(writer);
+
+            writer.Key("input");
+            input.toJSON(writer);
+
+            writer.EndObject();
+        }
+        writer.EndArray();
+
+        writer.Key("spentKeyImages");
+        writer.StartArray();
+        for (const auto &[publicKey, keyImage] : blockScanInfo.keyImagesToMarkSpent)
+        {
+            writer.StartObject();
+
+            writer.Key("publicSpendKey");
+            publicKey.toJSON(writer);
+
+            writer.Key("keyImage");
+            keyImage.toJSON(writer);
+
+            writer.EndObject();
+        }
+        writer.EndArray();
+
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("transactionSynchronizerStatus");
+    m_syncStatus.toJSON(writer);
+
+    writer.EndObject();
+}
+
+/* Makes the same changes as processBlock() did, in the same order */
+void WalletSynchronizer::applyJournalRecord(const JSONObject &j)
+{
+    for (const auto &block : getArrayFromJSON(j, "blocks"))
+    {
+        const uint64_t blockHeight = getUint64FromJSON(block, "blockHeight");
+
+        for (const auto &x : getArrayFromJSON(block, "transactions"))
+        {
+            WalletTypes::Transaction tx;
+            tx.fromJSON(x);
+            m_subWallets->addTransaction(tx);
+        }
+
+        for (const auto &x : getArrayFromJSON(block, "inputs"))
+        {
+            Crypto::PublicKey publicKey;
+            publicKey.fromString(getStringFromJSON(x, "publicSpendKey"));
+
+            WalletTypes::TransactionInput input;
+            input.fromJSON(getJsonValue(x, "input"));
+
+            m_subWallets->storeTransactionInput(publicKey, input);
+        }
+
+        for (const auto &x : getArrayFromJSON(block, "spentKeyImages"))
+        {
+            Crypto::PublicKey publicKey;
+            publicKey.fromString(getStringFromJSON(x, "publicSpendKey"));
+
+            Crypto::KeyImage keyImage;
+            keyImage.fromString(getStringFromJSON(x, "keyImage"));
+
+            m_subWallets->markInputAsSpent(keyImage, publicKey, blockHeight);
+        }
+    }
+
+    SynchronizationStatus syncStatus;
+    syncStatus.fromJSON(getObjectFromJSON(j, "transactionSynchronizerStatus"));
+
+    m_syncStatus = syncStatus;
+    m_savedHeight = m_syncStatus.getHeight();
+}
+
 void WalletSynchronizer::fromJSON(const JSONObject &j)
 {
     m_syncStatus.fromJSON(getObjectFromJSON(j, "transactionSynchronizerStatus"));
     m_startTimestamp = getUint64FromJSON(j, "startTimestamp");
     m_startHeight = getUint64FromJSON(j, "startHeight");
     m_privateViewKey.fromString(getStringFromJSON(j, "privateViewKey"));
+
+    m_savedHeight = m_syncStatus.getHeight();
 }
 
 void WalletSynchronizer::toJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const
@@ -4,8 +4,12 @@
 
 #pragma once
 
+#include <atomic>
+
 #include <memory>
 
+#include <Common/ThreadPool.h>
+
 #include <Nigel/Nigel.h>
 
 #include <SubWallets/SubWallets.h>
@@ -91,6 +95,25 @@ class WalletSynchronizer
 
         void setSyncStart(const uint64_t startTimestamp, const uint64_t startHeight);
 
+        /* Sets how many threads are used to scan block outputs for
+           transactions belonging to us */
+        void setThreadCount(const uint32_t threadCount);
+
+        /* Whether any blocks have been processed since the last call to
+           clearUnsavedBlocks() */
+        bool hasUnsavedBlocks() const;
+
+        /* Writes what the blocks processed since the last save added to
+           the wallet, and the sync status after them, as a record for the
+           wallet journal */
+        void unsavedBlocksToJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) const;
+
+        /* Call once the wallet has been saved */
+        void clearUnsavedBlocks();
+
+        /* Replays a record written by unsavedBlocksToJSON() */
+        void applyJournalRecord(const JSONObject &j);
+
         /////////////////////////////
         /* Public member variables */
         /////////////////////////////
@@ -106,12 +129,20 @@ class WalletSynchronizer
 
         void mainLoop();
 
+        /* Fetches batches of blocks from the daemon, and queues them up
+           for mainLoop() to process */
+        void downloaderLoop();
+
         std::vector<WalletTypes::WalletBlockInfo> downloadBlocks();
 
-        std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> processBlockOutputs(
-            const WalletTypes::WalletBlockInfo &block) const;
+        std::vector<std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>>> processBlockOutputs(
+            const std::vector<WalletTypes::WalletBlockInfo> &blocks);
 
-        void processBlock(const WalletTypes::WalletBlockInfo &block);
+        /* Returns false if we failed to process the block, and should
+           fetch it again */
+        bool processBlock(
+            const WalletTypes::WalletBlockInfo &block,
+            std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> ourInputs);
 
         BlockScanTmpInfo processBlockTransactions(
             const WalletTypes::WalletBlockInfo &block,
@@ -126,8 +157,10 @@ class WalletSynchronizer
             const std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> &inputs,
             const WalletTypes::RawTransaction &tx) const;
 
+        /* Finds the outputs belonging to us in the transactions of one
+           block, scanning all of them with a single batched underivation */
         std::vector<std::tuple<Crypto::PublicKey, WalletTypes::TransactionInput>> processTransactionOutputs(
-            const WalletTypes::RawCoinbaseTransaction &rawTX,
+            const std::vector<const WalletTypes::RawCoinbaseTransaction *> &transactions,
             const uint64_t blockHeight) const;
 
         std::unordered_map<Crypto::Hash, std::vector<uint64_t>> getGlobalIndexes(
@@ -141,9 +174,27 @@ class WalletSynchronizer
         /* Private member variables */
         //////////////////////////////
 
-        /* The thread ID of the block downloader thread */
+        /* The thread ID of the block processing thread */
         std::thread m_syncThread;
 
+        /* The thread ID of the block downloader thread */
+        std::thread m_blockDownloaderThread;
+
+        /* Batches of blocks which have been downloaded but not yet
+           processed. An empty batch means the daemon had no new blocks. */
+        ThreadSafeQueue<std::vector<WalletTypes::WalletBlockInfo>> m_blockDownloaderQueue;
+
+        /* The sync status of the block downloader - this runs ahead of
+           m_syncStatus by however many blocks are sat in the queue */
+        SynchronizationStatus m_downloadStatus;
+
+        /* Set by the processing thread when it needs the downloader to
+           resume from m_syncStatus */
+        std::atomic<bool> m_rewindDownloader;
+
+        /* Guards m_syncStatus whilst the downloader copies it */
+        std::mutex m_syncStatusMutex;
+
         /* An atomic bool to signal if we should stop the sync thread */
         std::atomic<bool> m_shouldStop;
 
@@ -163,4 +214,19 @@ class WalletSynchronizer
 
         /* The daemon connection */
         std::shared_ptr<Nigel> m_daemon;
+
+        /* How many threads to use when scanning block outputs */
+        std::atomic<uint32_t> m_threadCount;
+
+        /* The threads scanning block outputs alongside the sync thread, one
+           less than m_threadCount. Only used from the sync thread, which
+           rebuilds it when the thread count has changed. */
+        std::unique_ptr<Common::ThreadPool> m_scanWorkers;
+
+        /* The blocks processed since the last save which had anything for
+           us in them, along with their heights */
+        std::vector<std::tuple<uint64_t, BlockScanTmpInfo>> m_unsavedBlocks;
+
+        /* The sync height at the last save */
+        uint64_t m_savedHeight = 0;
 };
@@ -189,6 +189,8 @@ static_assert(FORK_HEIGHTS_SIZE == 0 || CURRENT_FORK_INDEX < FORK_HEIGHTS_SIZE,
 
 const char     CRYPTONOTE_BLOCKS_FILENAME[]                  = "blocks.bin";
 const char     CRYPTONOTE_BLOCKINDEXES_FILENAME[]            = "blockindexes.bin";
+const char     CRYPTONOTE_MAPPED_BLOCKS_FILENAME[]           = "blocks.dat";
+const char     CRYPTONOTE_MAPPED_BLOCKINDEXES_FILENAME[]     = "blockindexes.dat";
 const char     CRYPTONOTE_POOLDATA_FILENAME[]                = "poolstate.bin";
 const char     P2P_NET_DATA_FILENAME[]                       = "p2pstate.bin";
 const char     MINER_CONFIG_FILE_NAME[]                      = "miner_conf.json";
@@ -212,10 +214,13 @@ const uint8_t  BLOCK_MINOR_VERSION_1                         =  1;
 const size_t   BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT        =  10000;  //by default, blocks ids count in synchronizing
 const uint64_t BLOCKS_SYNCHRONIZING_DEFAULT_COUNT            =  100;    //by default, blocks count in blocks downloading
 const size_t   COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT         =  1000;
+const uint64_t WALLET_SYNC_DATA_DEFAULT_MAX_BLOCK_COUNT      =  1000;   //by default, most blocks a single getwalletsyncdata request returns
+const uint64_t WALLET_SYNC_DATA_MAX_RESPONSE_MB_DEFAULT_SIZE =  8;      //by default, stop adding blocks to getwalletsyncdata after this many megabytes of block data
 
 const int      P2P_DEFAULT_PORT                              =  18897;
 const int      RPC_DEFAULT_PORT                              =  18898;
 const int      SERVICE_DEFAULT_PORT                          =  8070;
+const int      RPC_DEFAULT_WORKER_THREADS_COUNT              =  4;      //threads serving the read only RPC calls, 0 serves them on the network thread
 
 const size_t   P2P_LOCAL_WHITE_PEERLIST_LIMIT                =  1000;
 const size_t   P2P_LOCAL_GRAY_PEERLIST_LIMIT                 =  5000;
@@ -16,6 +16,7 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "crypto-ops.h"
@@ -2587,6 +2588,49 @@ void ge_mul8(ge_p1p1 *r, const ge_p2 *t) {
   ge_p2_dbl(r, &u);
 }
 
+/*
+Same as calling ge_tobytes on each of the count points, but with a single
+field inversion for the whole batch (Montgomery's trick): invert the
+product of every Z, then recover each 1/Z with two multiplications.
+tmp must have room for count field elements.
+*/
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, fe *tmp, size_t count) {
+  fe acc;
+  fe recip;
+  fe x;
+  fe y;
+  size_t i;
+
+  if (count == 0) {
+    return;
+  }
+
+  /* tmp[i] = Z_0 * ... * Z_i */
+  fe_copy(tmp[0], h[0].Z);
+  for (i = 1; i < count; i++) {
+    fe_mul(tmp[i], tmp[i - 1], h[i].Z);
+  }
+
+  /* acc = 1 / (Z_0 * ... * Z_(count - 1)) */
+  fe_invert(acc, tmp[count - 1]);
+
+  for (i = count; i-- > 0;) {
+    if (i > 0) {
+      /* 1 / Z_i = (Z_0 * ... * Z_(i - 1)) / (Z_0 * ... * Z_i) */
+      fe_mul(recip, acc, tmp[i - 1]);
+      /* Drop Z_i from the accumulated inverse */
+      fe_mul(acc, acc, h[i].Z);
+    } else {
+      fe_copy(recip, acc);
+    }
+    fe_mul(x, h[i].X, recip);
+    fe_mul(y, h[i].Y, recip);
+    fe_tobytes(s + 32 * i, y);
+    s[32 * i + 31] ^= fe_isnegative(x) << 7;
+  }
+}
+
 void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
   fe u, v, w, x, y, z;
   unsigned char sign;
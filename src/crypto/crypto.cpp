@@ -224,6 +224,108 @@ namespace Crypto {
     return true;
   }
 
+  void crypto_ops::underive_public_keys(const SecretKey &private_view_key,
+    const std::vector<std::tuple<PublicKey, PublicKey, size_t>> &outputs,
+    std::vector<KeyDerivation> &derivations, std::vector<PublicKey> &bases,
+    std::vector<bool> &valid) {
+    const size_t count = outputs.size();
+
+    derivations.resize(count);
+    bases.resize(count);
+    valid.assign(count, true);
+
+    if (count == 0) {
+      return;
+    }
+
+    assert(sc_check(reinterpret_cast<const unsigned char*>(&private_view_key)) == 0);
+
+    std::unique_ptr<fe[]> tmp(new fe[count]);
+
+    /* Derivation points, one for each distinct run of transaction keys */
+    std::vector<ge_p2> derivationPoints;
+    derivationPoints.reserve(count);
+
+    /* Which derivation point each output uses */
+    std::vector<size_t> derivationIndexes(count);
+
+    bool lastKeyValid = false;
+
+    for (size_t i = 0; i < count; i++) {
+      const PublicKey &txPublicKey = std::get<0>(outputs[i]);
+
+      if (i == 0 || txPublicKey != std::get<0>(outputs[i - 1])) {
+        ge_p3 point;
+        ge_p2 point2;
+        ge_p1p1 point3;
+
+        lastKeyValid = ge_frombytes_vartime(&point, reinterpret_cast<const unsigned char*>(&txPublicKey)) == 0;
+
+        if (lastKeyValid) {
+          ge_scalarmult(&point2, reinterpret_cast<const unsigned char*>(&private_view_key), &point);
+          ge_mul8(&point3, &point2);
+          ge_p1p1_to_p2(&point2, &point3);
+          derivationPoints.push_back(point2);
+        }
+      }
+
+      valid[i] = lastKeyValid;
+      derivationIndexes[i] = derivationPoints.size() - 1;
+    }
+
+    std::vector<KeyDerivation> uniqueDerivations(derivationPoints.size());
+
+    ge_tobytes_batch(reinterpret_cast<unsigned char*>(uniqueDerivations.data()),
+      derivationPoints.data(), tmp.get(), derivationPoints.size());
+
+    std::vector<ge_p2> basePoints;
+    basePoints.reserve(count);
+
+    /* Which outputs made it into basePoints */
+    std::vector<size_t> baseIndexes;
+    baseIndexes.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+      if (!valid[i]) {
+        continue;
+      }
+
+      const auto &[txPublicKey, derivedKey, outputIndex] = outputs[i];
+
+      derivations[i] = uniqueDerivations[derivationIndexes[i]];
+
+      EllipticCurveScalar scalar;
+      ge_p3 point1;
+      ge_p3 point2;
+      ge_cached point3;
+      ge_p1p1 point4;
+      ge_p2 point5;
+
+      if (ge_frombytes_vartime(&point1, reinterpret_cast<const unsigned char*>(&derivedKey)) != 0) {
+        valid[i] = false;
+        continue;
+      }
+
+      derivation_to_scalar(derivations[i], outputIndex, scalar);
+      ge_scalarmult_base(&point2, reinterpret_cast<unsigned char*>(&scalar));
+      ge_p3_to_cached(&point3, &point2);
+      ge_sub(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&point5, &point4);
+
+      basePoints.push_back(point5);
+      baseIndexes.push_back(i);
+    }
+
+    std::vector<PublicKey> uniqueBases(basePoints.size());
+
+    ge_tobytes_batch(reinterpret_cast<unsigned char*>(uniqueBases.data()),
+      basePoints.data(), tmp.get(), basePoints.size());
+
+    for (size_t i = 0; i < baseIndexes.size(); i++) {
+      bases[baseIndexes[i]] = uniqueBases[i];
+    }
+  }
+
   bool crypto_ops::underive_public_key(const KeyDerivation &derivation, size_t output_index,
     const PublicKey &derived_key, const uint8_t* suffix, size_t suffixLength, PublicKey &base) {
     EllipticCurveScalar scalar;
@@ -10,6 +10,7 @@
 #include <cstddef>
 #include <limits>
 #include <mutex>
+#include <tuple>
 #include <type_traits>
 #include <vector>
 
@@ -61,6 +62,8 @@ struct EllipticCurveScalar {
     friend bool underive_public_key(const KeyDerivation &, size_t, const PublicKey &, PublicKey &);
     static bool underive_public_key(const KeyDerivation &, size_t, const PublicKey &, const uint8_t*, size_t, PublicKey &);
     friend bool underive_public_key(const KeyDerivation &, size_t, const PublicKey &, const uint8_t*, size_t, PublicKey &);
+    static void underive_public_keys(const SecretKey &, const std::vector<std::tuple<PublicKey, PublicKey, size_t>> &, std::vector<KeyDerivation> &, std::vector<PublicKey> &, std::vector<bool> &);
+    friend void underive_public_keys(const SecretKey &, const std::vector<std::tuple<PublicKey, PublicKey, size_t>> &, std::vector<KeyDerivation> &, std::vector<PublicKey> &, std::vector<bool> &);
     static void generate_signature(const Hash &, const PublicKey &, const SecretKey &, Signature &);
     friend void generate_signature(const Hash &, const PublicKey &, const SecretKey &, Signature &);
     static bool check_signature(const Hash &, const PublicKey &, const Signature &);
@@ -163,6 +166,20 @@ struct EllipticCurveScalar {
     return crypto_ops::underive_public_key(derivation, output_index, derived_key, base);
   }
 
+  /* Batched generate_key_derivation + underive_public_key, for scanning many
+   * outputs at once. Each item is (transaction public key, output key, output index).
+   * Fills in the derivation and the underived spend key for each item, and
+   * whether the keys were valid. Runs of items sharing a transaction public key
+   * (i.e. the outputs of one transaction) only have their derivation computed
+   * once, and the conversions of the points to bytes share one field inversion.
+   */
+  inline void underive_public_keys(const SecretKey &private_view_key,
+    const std::vector<std::tuple<PublicKey, PublicKey, size_t>> &outputs,
+    std::vector<KeyDerivation> &derivations, std::vector<PublicKey> &bases,
+    std::vector<bool> &valid) {
+    crypto_ops::underive_public_keys(private_view_key, outputs, derivations, bases, valid);
+  }
+
   /* Generation and checking of a standard signature.
    */
   inline void generate_signature(const Hash &prefix_hash, const PublicKey &pub, const SecretKey &sec, Signature &sig) {
@@ -298,8 +298,14 @@ union cn_slow_hash_state
 };
 #pragma pack(pop)
 
+/* The scratchpad is kept between hashes, so each thread only allocates it
+   once, sized for the largest variant. The C++ wrappers in hash.h free it
+   with slow_hash_free_state() when the thread exits. */
+#define CN_MAX_PAGE_SIZE 2097152
+
 THREADV uint8_t *hp_state = NULL;
 THREADV int hp_allocated = 0;
+THREADV uint32_t hp_size = 0;
 
 #if defined(_MSC_VER)
 #define cpuid(info,x)    __cpuidex(info,x,0)
@@ -577,15 +583,22 @@ BOOL SetLockPagesPrivilege(HANDLE hProcess, BOOL bEnable)
  * during the random accesses to the scratch buffer.  This is one of the
  * important speed optimizations needed to make CryptoNight faster.
  *
- * No parameters.  Updates a thread-local pointer, hp_state, to point to
- * the allocated buffer.
+ * The buffer is reused by later hashes on the same thread, so this only
+ * allocates if there is no buffer yet, or it is smaller than page_size.
+ *
+ * Updates a thread-local pointer, hp_state, to point to the allocated buffer.
  */
 
 void slow_hash_allocate_state(uint32_t page_size)
 {
-    if(hp_state != NULL)
+    if(hp_state != NULL && hp_size >= page_size)
         return;
 
+    slow_hash_free_state();
+
+    if(page_size < CN_MAX_PAGE_SIZE)
+        page_size = CN_MAX_PAGE_SIZE;
+
 #if defined(_MSC_VER) || defined(__MINGW32__)
     SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
     hp_state = (uint8_t *) VirtualAlloc(hp_state, page_size, MEM_LARGE_PAGES |
@@ -608,13 +621,17 @@ void slow_hash_allocate_state(uint32_t page_size)
         hp_allocated = 0;
         hp_state = (uint8_t *) malloc(page_size);
     }
+    hp_size = hp_state == NULL ? 0 : page_size;
 }
 
 /**
  *@brief frees the state allocated by slow_hash_allocate_state
+ *
+ * Called when a thread which has used cn_slow_hash exits, see
+ * SlowHashStateOwner in hash.h, or earlier to release the scratchpad.
  */
 
-void slow_hash_free_state(uint32_t page_size)
+void slow_hash_free_state(void)
 {
     if(hp_state == NULL)
         return;
@@ -626,12 +643,13 @@ void slow_hash_free_state(uint32_t page_size)
 #if defined(_MSC_VER) || defined(__MINGW32__)
         VirtualFree(hp_state, 0, MEM_RELEASE);
 #else
-        munmap(hp_state, page_size);
+        munmap(hp_state, hp_size);
 #endif
     }
 
     hp_state = NULL;
     hp_allocated = 0;
+    hp_size = 0;
 }
 
 /**
@@ -801,7 +819,6 @@ void cn_slow_hash(const void *data, size_t length, char *hash, int light, int va
   memcpy(state.init, text, INIT_SIZE_BYTE);
   hash_permutation(&state.hs);
   extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
-  slow_hash_free_state(page_size);
 }
 
 #elif !defined NO_AES && (defined(__arm__) || defined(__aarch64__))